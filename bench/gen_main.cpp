@@ -0,0 +1,61 @@
+/*
+	gen_main.cpp
+	Writes a generated ccc program to stdout, or to a file with -o.
+
+	usage: ccc-bench-gen [--functions=N] [--statements=N] [--expr-depth=N]
+						 [--loop-nesting=N] [--shadowed=N] [--const-percent=N]
+						 [--seed=N] [-o file]
+*/
+
+#include "generate.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+static void usage()
+{
+	std::cout << "usage: ccc-bench-gen [--functions=N] [--statements=N] [--expr-depth=N]\n"
+			  << "                     [--loop-nesting=N] [--shadowed=N] [--const-percent=N]\n"
+			  << "                     [--seed=N] [-o file]\n";
+}
+
+int main(int argc, char** argv)
+{
+	ProgramShape shape;
+	const char* output = nullptr;
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* equals = strchr(arg, '=');
+		if (strcmp(arg, "-o") == 0 && i + 1 < argc)
+		{
+			output = argv[++i];
+		}
+		else if (strncmp(arg, "--", 2) == 0 && equals && set_shape_knob(shape, std::string(arg + 2, equals), atoi(equals + 1)))
+		{
+			continue;
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	std::string program = generate_program(shape);
+	if (output == nullptr)
+	{
+		std::cout << program;
+		return 0;
+	}
+	std::ofstream out(output);
+	out << program;
+	if (!out)
+	{
+		std::cout << "can't write " << output << "\n";
+		return 1;
+	}
+	return 0;
+}
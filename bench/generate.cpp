@@ -0,0 +1,325 @@
+/*
+	generate.cpp
+	Synthetic program generator, see generate.hpp.
+*/
+
+#include "generate.hpp"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct Variable
+{
+	std::string name;
+	bool assignable;	// not const, and not a loop counter
+};
+
+class Generator
+{
+public:
+	Generator(const ProgramShape& shape) : shape(shape), random(shape.seed) {}
+
+	std::string program()
+	{
+		this->out += "void put_int(int x);\n\n";
+		for (int f = 0; f < this->shape.functions; f++)
+		{
+			this->function(f);
+		}
+		this->main();
+		return std::move(this->out);
+	}
+
+private:
+	const ProgramShape& shape;
+	std::mt19937 random;
+	std::string out;
+	std::vector<std::vector<Variable>> scopes;
+	int nextTemp = 0;
+	std::string declaring;	// C puts a variable in scope in its own initializer, ccc doesn't
+
+	int pick(int n)
+	{
+		return std::uniform_int_distribution<int>(0, n - 1)(this->random);
+	}
+
+	bool chance(int percent)
+	{
+		return this->pick(100) < percent;
+	}
+
+	void indent(int depth)
+	{
+		this->out.append(depth, '\t');
+	}
+
+	std::vector<const Variable*> visible()
+	{
+		// innermost first, and a shadowed variable only shows up once
+		std::vector<const Variable*> vars;
+		for (auto scope = this->scopes.rbegin(); scope != this->scopes.rend(); ++scope)
+		{
+			for (auto& v : *scope)
+			{
+				bool hidden = v.name == this->declaring;
+				for (auto* seen : vars)
+				{
+					hidden = hidden || seen->name == v.name;
+				}
+				if (!hidden)
+				{
+					vars.push_back(&v);
+				}
+			}
+		}
+		return vars;
+	}
+
+	void expression(int depth)
+	{
+		if (depth == 0)
+		{
+			std::vector<const Variable*> vars = this->visible();
+			if (!vars.empty() && this->chance(70))
+			{
+				this->out += vars[this->pick(vars.size())]->name;
+			}
+			else
+			{
+				this->out += std::to_string(this->pick(100));
+			}
+			return;
+		}
+		static const char* ops[] = {" + ", " - ", " * ", " & ", " | ", " ^ "};
+		static const char* relations[] = {" < ", " > ", " <= ", " >= ", " == ", " != "};
+		int kind = this->pick(10);
+		if (kind < 7)
+		{
+			this->out += "(";
+			this->expression(depth - 1);
+			this->out += ops[this->pick(6)];
+			this->expression(depth - 1);
+			this->out += ")";
+		}
+		else if (kind < 8)
+		{
+			this->out += this->chance(50) ? "-" : "~";
+			this->out += "(";
+			this->expression(depth - 1);
+			this->out += ")";
+		}
+		else
+		{
+			this->out += "(";
+			this->condition(depth - 1, relations[this->pick(6)]);
+			this->out += " ? ";
+			this->expression(depth - 1);
+			this->out += " : ";
+			this->expression(depth - 1);
+			this->out += ")";
+		}
+	}
+
+	void condition(int depth, const char* relation)
+	{
+		this->expression(depth);
+		this->out += relation;
+		this->expression(depth);
+	}
+
+	void declare(int depth, const std::string& name, bool allowConst)
+	{
+		bool isConst = allowConst && this->chance(this->shape.constPercent);
+		this->indent(depth);
+		this->out += isConst ? "const int " : "int ";
+		this->out += name + " = ";
+		// leave out the variable this one shadows, C and ccc disagree on which one that means
+		this->declaring = name;
+		this->expression(this->shape.exprDepth);
+		this->declaring.clear();
+		this->out += ";\n";
+		this->scopes.back().push_back({name, !isConst});
+	}
+
+	const Variable* assignable()
+	{
+		std::vector<const Variable*> vars;
+		for (auto* v : this->visible())
+		{
+			if (v->assignable)
+			{
+				vars.push_back(v);
+			}
+		}
+		return vars.empty() ? nullptr : vars[this->pick(vars.size())];
+	}
+
+	void statement(int depth)
+	{
+		static const char* augmented[] = {" += ", " -= ", " *= "};
+		int kind = this->pick(10);
+		const Variable* target = this->assignable();
+		if (kind < 3 || target == nullptr)
+		{
+			this->declare(depth, "t" + std::to_string(this->nextTemp++), true);
+		}
+		else if (kind < 6)
+		{
+			this->indent(depth);
+			this->out += target->name + " = ";
+			this->expression(this->shape.exprDepth);
+			this->out += ";\n";
+		}
+		else if (kind < 8)
+		{
+			this->indent(depth);
+			this->out += target->name + augmented[this->pick(3)];
+			this->expression(this->shape.exprDepth);
+			this->out += ";\n";
+		}
+		else
+		{
+			// a small if, with a scope of its own
+			this->indent(depth);
+			this->out += "if (";
+			this->condition(this->shape.exprDepth > 0 ? this->shape.exprDepth - 1 : 0, " < ");
+			this->out += ") {\n";
+			this->scopes.emplace_back();
+			this->declare(depth + 1, "t" + std::to_string(this->nextTemp++), true);
+			target = this->assignable();
+			this->indent(depth + 1);
+			this->out += target->name + " = ";
+			this->expression(this->shape.exprDepth);
+			this->out += ";\n";
+			this->scopes.pop_back();
+			this->indent(depth);
+			this->out += "}\n";
+		}
+	}
+
+	void block(int depth, int level)
+	{
+		// the shadowed variables first, so the statements after use them
+		for (int s = 0; s < this->shape.shadowed; s++)
+		{
+			this->declare(depth, "s" + std::to_string(s), level > 0);
+		}
+		int loopAt = level < this->shape.loopNesting ? this->pick(this->shape.statements + 1) : -1;
+		for (int i = 0; i <= this->shape.statements; i++)
+		{
+			if (i == loopAt)
+			{
+				this->loop(depth, level + 1);
+			}
+			if (i < this->shape.statements)
+			{
+				this->statement(depth);
+			}
+		}
+	}
+
+	void loop(int depth, int level)
+	{
+		// loops only go round a few times, nested loops multiply
+		std::string counter = "i" + std::to_string(level);
+		this->indent(depth);
+		if (level % 2)
+		{
+			this->out += "for (int " + counter + " = 0; " + counter + " < 3; " + counter + " += 1) {\n";
+			this->scopes.emplace_back();
+			this->scopes.back().push_back({counter, false});
+		}
+		else
+		{
+			this->out += "int " + counter + " = 0;\n";
+			this->scopes.back().push_back({counter, false});
+			this->indent(depth);
+			this->out += "while (" + counter + " < 3) {\n";
+			this->scopes.emplace_back();
+		}
+		this->block(depth + 1, level);
+		if (level % 2 == 0)
+		{
+			this->indent(depth + 1);
+			this->out += counter + " += 1;\n";
+		}
+		this->scopes.pop_back();
+		this->indent(depth);
+		this->out += "}\n";
+	}
+
+	void function(int f)
+	{
+		this->out += "int f" + std::to_string(f) + "(int a, int b) {\n";
+		this->scopes.assign(1, {{"a", true}, {"b", true}});
+		this->nextTemp = 0;
+		this->block(1, 0);
+		// one call each to an earlier function keeps run time linear
+		this->out += "\treturn ";
+		this->expression(this->shape.exprDepth);
+		if (f > 0)
+		{
+			this->out += " + f" + std::to_string(this->pick(f)) + "(a, b)";
+		}
+		this->out += ";\n}\n\n";
+		this->scopes.clear();
+	}
+
+	void main()
+	{
+		this->out += "int main() {\n\tint total = 0;\n";
+		int first = this->shape.functions > 8 ? this->shape.functions - 8 : 0;
+		for (int f = first; f < this->shape.functions; f++)
+		{
+			this->out += "\ttotal += f" + std::to_string(f) + "(" + std::to_string(f) + ", 3);\n";
+		}
+		this->out += "\tput_int(total);\n\treturn 0;\n}\n";
+	}
+};
+
+}
+
+std::string generate_program(const ProgramShape& shape)
+{
+	return Generator(shape).program();
+}
+
+bool set_shape_knob(ProgramShape& shape, const std::string& name, int value)
+{
+	if (name == "functions")
+	{
+		shape.functions = value;
+	}
+	else if (name == "statements")
+	{
+		shape.statements = value;
+	}
+	else if (name == "expr-depth")
+	{
+		shape.exprDepth = value;
+	}
+	else if (name == "loop-nesting")
+	{
+		shape.loopNesting = value;
+	}
+	else if (name == "shadowed")
+	{
+		shape.shadowed = value;
+	}
+	else if (name == "const-percent")
+	{
+		shape.constPercent = value;
+	}
+	else if (name == "seed")
+	{
+		shape.seed = value;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,32 @@
+/*
+	generate.hpp
+	Generates valid ccc programs of a given size and shape, for benchmarking.
+
+	Every program is deterministic for a given shape and seed, type checks,
+	and has a main, so it gets through every stage of the compiler. Loops only
+	run a few times and calls only go to earlier functions, so the programs
+	also finish when they are run.
+*/
+
+#ifndef CCC_BENCH_GENERATE_HPP_INCLUDED
+#define CCC_BENCH_GENERATE_HPP_INCLUDED
+
+#include <string>
+
+struct ProgramShape
+{
+	int functions = 100;		// not counting main
+	int statements = 8;			// statements in each block
+	int exprDepth = 3;			// operators nested this deep in each expression
+	int loopNesting = 2;		// for/while loops nested this deep in each function
+	int shadowed = 2;			// variables each loop body redeclares from the scope around it
+	int constPercent = 20;		// how many declarations are const
+	unsigned seed = 1;
+};
+
+std::string generate_program(const ProgramShape& shape);
+
+// sets the shape's knob called name, false if there isn't one
+bool set_shape_knob(ProgramShape& shape, const std::string& name, int value);
+
+#endif // CCC_BENCH_GENERATE_HPP_INCLUDED
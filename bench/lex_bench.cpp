@@ -0,0 +1,122 @@
+/*
+	lex_bench.cpp
+	Tokens per second of the flex scanner and the hand-written one, on a
+	large generated program.
+
+	Both scanners are run over the same source first and have to agree on
+	every token's kind and position, so the numbers are for the same work.
+
+	usage: ccc-bench-lex [megabytes] [iterations]
+*/
+
+#include "generate.hpp"
+#include "headers/lexer.hpp"
+#include "headers/arena.hpp"
+#include "headers/common.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Token
+{
+	int kind;
+	uint32_t begin;
+	uint32_t end;
+
+	bool operator==(const Token& other) const
+	{
+		return this->kind == other.kind && this->begin == other.begin && this->end == other.end;
+	}
+};
+
+static std::vector<Token> tokens(std::string& source, lexer_kind kind)
+{
+	AstArena arena;
+	SourceLines lines(arena);
+	Lexer lexer(source, &lines, kind);
+	std::vector<Token> list;
+	while (true)
+	{
+		yy::parser::symbol_type s = lexer.next();
+		list.push_back({s.kind(), s.location.begin, s.location.end});
+		if (s.kind() == yy::parser::symbol_kind_type::S_YYEOF)
+		{
+			return list;
+		}
+	}
+}
+
+static double run(std::string& source, lexer_kind kind, int iterations, size_t& count)
+{
+	// returns the best time over all of our iterations
+	double best = 0.0;
+	for (int i = 0; i < iterations; i++)
+	{
+		AstArena arena;
+		SourceLines lines(arena);
+		auto start = std::chrono::steady_clock::now();
+		Lexer lexer(source, &lines, kind);
+		count = 0;
+		while (lexer.next().kind() != yy::parser::symbol_kind_type::S_YYEOF)
+		{
+			count++;
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (i == 0 || elapsed.count() < best)
+		{
+			best = elapsed.count();
+		}
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	size_t megabytes = argc > 1 ? atoi(argv[1]) : 32;
+	int iterations = argc > 2 ? atoi(argv[2]) : 5;
+
+	std::ostringstream sink;
+	set_diag(&sink);
+
+	// size the program from how big a small one of the same shape comes out
+	ProgramShape shape;
+	std::string sample = generate_program(shape);
+	shape.functions = static_cast<int>(shape.functions * (megabytes * 1024.0 * 1024.0) / sample.size()) + 1;
+	std::string source = generate_program(shape);
+
+	if (!(tokens(source, lexer_flex) == tokens(source, lexer_dfa)))
+	{
+		std::cout << "the scanners disagree on the generated program\n";
+		return 1;
+	}
+
+	static const struct
+	{
+		const char* name;
+		lexer_kind kind;
+	} lexers[] = {
+		{"flex", lexer_flex},
+		{"dfa", lexer_dfa},
+	};
+
+	std::cout << "scanning " << std::fixed << std::setprecision(1) << source.size() / (1024.0 * 1024.0) << "MB, best of " << iterations << "\n";
+	double flexSeconds = 0;
+	for (auto& lexer : lexers)
+	{
+		size_t count = 0;
+		double seconds = run(source, lexer.kind, iterations, count);
+		if (lexer.kind == lexer_flex)
+		{
+			flexSeconds = seconds;
+		}
+		std::cout << std::left << std::setw(6) << lexer.name << std::right
+				  << std::setw(10) << count / seconds / 1e6 << "M tokens/s"
+				  << std::setw(10) << source.size() / (1024.0 * 1024.0) / seconds << " MB/s"
+				  << std::setw(8) << std::setprecision(2) << flexSeconds / seconds << "x" << std::setprecision(1) << "\n";
+	}
+	return 0;
+}
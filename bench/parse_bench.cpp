@@ -0,0 +1,138 @@
+/*
+	parse_bench.cpp
+	Parse throughput of the bison parser and the hand-written one, on a
+	large generated program.
+
+	Both parsers read the same tokens from the same scanner, and have to
+	build the same tree before anything is timed, so the difference is
+	the parser's alone. Then both parse parentheses nested as deep as the
+	hand-written parser allows, and it has to turn down one level more
+	with an error rather than run out of stack.
+
+	usage: ccc-bench-parse [megabytes] [iterations] [flex|dfa]
+*/
+
+#include "generate.hpp"
+#include "headers/compiler.hpp"
+#include "headers/astfile.hpp"
+#include "headers/common.hpp"
+#include "headers/pratt.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static std::string tree(std::string& source, lexer_kind lexer, parser_kind parser)
+{
+	AstArena arena;
+	Node* root = nullptr;
+	if (parse(source, arena, root, lexer, parser) != 0)
+	{
+		return "";
+	}
+	return save_ast(root, false);
+}
+
+static std::string deep_parentheses(unsigned depth)
+{
+	// return (((...(1)...))); with depth parentheses around the 1
+	std::string src = "int main() {\n\treturn ";
+	src.append(depth, '(');
+	src += "1";
+	src.append(depth, ')');
+	src += ";\n}\n";
+	return src;
+}
+
+static double run(std::string& source, lexer_kind lexer, parser_kind parser, int iterations)
+{
+	// returns the best time over all of our iterations
+	double best = 0.0;
+	for (int i = 0; i < iterations; i++)
+	{
+		AstArena arena;
+		Node* root = nullptr;
+		auto start = std::chrono::steady_clock::now();
+		parse(source, arena, root, lexer, parser);
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (i == 0 || elapsed.count() < best)
+		{
+			best = elapsed.count();
+		}
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	size_t megabytes = argc > 1 ? atoi(argv[1]) : 32;
+	int iterations = argc > 2 ? atoi(argv[2]) : 5;
+	lexer_kind lexer = argc > 3 && std::string(argv[3]) == "flex" ? lexer_flex : lexer_dfa;
+
+	std::ostringstream sink;
+	set_diag(&sink);
+
+	// size the program from how big a small one of the same shape comes out
+	ProgramShape shape;
+	std::string sample = generate_program(shape);
+	shape.functions = static_cast<int>(shape.functions * (megabytes * 1024.0 * 1024.0) / sample.size()) + 1;
+	std::string source = generate_program(shape);
+
+	std::string expected = tree(source, lexer, parser_bison);
+	if (expected.empty() || tree(source, lexer, parser_pratt) != expected)
+	{
+		std::cout << "the parsers disagree on the generated program\n";
+		return 1;
+	}
+
+	static const struct
+	{
+		const char* name;
+		parser_kind kind;
+	} parsers[] = {
+		{"bison", parser_bison},
+		{"pratt", parser_pratt},
+	};
+
+	std::cout << "parsing " << std::fixed << std::setprecision(1) << source.size() / (1024.0 * 1024.0) << "MB with the "
+			  << (lexer == lexer_flex ? "flex" : "dfa") << " scanner, best of " << iterations << "\n";
+	double bisonSeconds = 0;
+	for (auto& parser : parsers)
+	{
+		double seconds = run(source, lexer, parser.kind, iterations);
+		if (parser.kind == parser_bison)
+		{
+			bisonSeconds = seconds;
+		}
+		std::cout << std::left << std::setw(6) << parser.name << std::right
+				  << std::setw(10) << source.size() / (1024.0 * 1024.0) / seconds << " MB/s"
+				  << std::setw(10) << std::setprecision(3) << seconds << "s"
+				  << std::setw(8) << std::setprecision(2) << bisonSeconds / seconds << "x" << std::setprecision(1) << "\n";
+	}
+
+	// the function's block and the return's expression are two levels already
+	unsigned depth = PrattParser::maxNesting - 2;
+	std::string deep = deep_parentheses(depth);
+	std::string deeper = deep_parentheses(depth + 1);
+	expected = tree(deep, lexer, parser_bison);
+	if (expected.empty() || tree(deep, lexer, parser_pratt) != expected)
+	{
+		std::cout << "the parsers disagree on " << depth << " nested parentheses\n";
+		return 1;
+	}
+	if (!tree(deeper, lexer, parser_pratt).empty() || sink.str().find("nested too deeply") == std::string::npos)
+	{
+		std::cout << "the hand-written parser didn't turn down " << depth + 1 << " nested parentheses\n";
+		return 1;
+	}
+	std::cout << "\n" << depth << " nested parentheses, best of " << iterations << "\n";
+	for (auto& parser : parsers)
+	{
+		double seconds = run(deep, lexer, parser.kind, iterations);
+		std::cout << std::left << std::setw(6) << parser.name << std::right
+				  << std::setw(10) << std::setprecision(3) << seconds * 1000 << "ms" << std::setprecision(1) << "\n";
+	}
+	return 0;
+}
@@ -0,0 +1,102 @@
+/*
+	preprocess_bench.cpp
+	Measures preprocessor throughput (MB/s) on large generated inputs.
+
+	usage: ccc-bench-preprocess [megabytes] [iterations]
+*/
+
+#include "headers/preprocess.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+#include <string>
+
+static std::string generate_source(size_t bytes, int commentEvery)
+{
+	// Repeat a small function over and over, with a comment sprinkled in every
+	// commentEvery lines (0 for no comments at all)
+	static const char* body[] = {
+		"int f(int a, int b) {\n",
+		"\tint total = 0;\n",
+		"\tfor (int i = 0; i < a; i = i + 1) {\n",
+		"\t\ttotal += (i * b) % 7 + (a << 2) - ~b;\n",
+		"\t\tif (total > 1000 && i != b) {\n",
+		"\t\t\ttotal = total / 2;\n",
+		"\t\t}\n",
+		"\t}\n",
+		"\treturn total;\n",
+		"}\n",
+	};
+	const int bodyLines = sizeof(body) / sizeof(body[0]);
+
+	std::string src;
+	src.reserve(bytes + 128);
+	int line = 0;
+	while (src.size() < bytes)
+	{
+		src += body[line % bodyLines];
+		line++;
+		if (commentEvery && line % commentEvery == 0)
+		{
+			if (line % (commentEvery * 2) == 0)
+			{
+				src += "// a line comment with some / slashes and * stars in it\n";
+			}
+			else
+			{
+				src += "/* a block comment\n   that spans a couple of lines\n*/\n";
+			}
+		}
+	}
+	return src;
+}
+
+static double run(const std::string& input, int iterations)
+{
+	// returns the best throughput over all of our iterations
+	preprocess pp;
+	std::string out;
+	double best = 0.0;
+	for (int i = 0; i < iterations; i++)
+	{
+		auto start = std::chrono::steady_clock::now();
+		if (pp.preprocess_buffer(input.data(), input.size(), out) != 0)
+		{
+			std::cout << "preprocessing failed\n";
+			exit(1);
+		}
+		std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		double mbps = (input.size() / (1024.0 * 1024.0)) / elapsed.count();
+		if (mbps > best)
+		{
+			best = mbps;
+		}
+	}
+	return best;
+}
+
+int main(int argc, char** argv)
+{
+	size_t megabytes = argc > 1 ? atoi(argv[1]) : 64;
+	int iterations = argc > 2 ? atoi(argv[2]) : 5;
+
+	struct
+	{
+		const char* name;
+		int commentEvery;
+	} shapes[] = {
+		{"code only", 0},
+		{"comment every 10 lines", 10},
+		{"comment every 2 lines", 2},
+	};
+
+	std::cout << "preprocessing " << megabytes << "MB inputs, best of " << iterations << "\n";
+	for (auto& shape : shapes)
+	{
+		std::string input = generate_source(megabytes * 1024 * 1024, shape.commentEvery);
+		std::cout << std::left << std::setw(26) << shape.name
+				  << std::right << std::fixed << std::setprecision(1) << std::setw(10) << run(input, iterations) << " MB/s\n";
+	}
+	return 0;
+}
@@ -0,0 +1,294 @@
+/*
+	stage_bench.cpp
+	Throughput of each stage of the compiler, in lines and bytes of source per
+	second, on generated programs of a few different shapes.
+
+	Each stage runs on the previous stage's output, exactly as the driver
+	strings them together, and keeps its best time over all the iterations.
+	The results can be saved as a baseline, and compared against one: any
+	stage that got slower than the tolerance allows is reported as a
+	regression and the exit status is 1. Comparing is opt-in, --baseline on
+	its own compares against bench/baseline.json. A baseline records how the
+	benchmark was built, and is only compared against a build that matches.
+
+	usage: ccc-bench-stages [--iterations=N] [--shape=NAME] [--baseline[=FILE]]
+							[--write-baseline=FILE] [--tolerance=PERCENT]
+*/
+
+#include "generate.hpp"
+#include "stages.hpp"
+#include "headers/common.hpp"
+#include "headers/consolecolors.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+struct NamedShape
+{
+	const char* name;
+	ProgramShape shape;
+};
+
+static std::vector<NamedShape> shapes()
+{
+	// each one leans on a different part of the front end, and is around a
+	// megabyte so the whole run takes under a minute
+	std::vector<NamedShape> list;
+	ProgramShape wide;
+	wide.functions = 400;
+	wide.loopNesting = 1;
+	list.push_back({"many functions", wide});
+
+	ProgramShape deep;
+	deep.functions = 25;
+	deep.exprDepth = 6;
+	list.push_back({"deep expressions", deep});
+
+	ProgramShape nested;
+	nested.functions = 80;
+	nested.loopNesting = 5;
+	nested.shadowed = 6;
+	list.push_back({"nested loops", nested});
+
+	ProgramShape constant;
+	constant.functions = 250;
+	constant.constPercent = 90;
+	list.push_back({"mostly const", constant});
+	return list;
+}
+
+struct Result
+{
+	std::string shape;
+	std::string stage;
+	double seconds;
+	double linesPerSec;
+	double bytesPerSec;
+};
+
+static std::string build_description()
+{
+	// the numbers only mean something next to ones from the same kind of
+	// build, the CMake targets are built with -g and no optimization
+#if defined(__OPTIMIZE__)
+	const char* optimized = "optimized";
+#else
+	const char* optimized = "unoptimized";
+#endif
+#if defined(NDEBUG)
+	const char* assertions = "assertions off";
+#else
+	const char* assertions = "assertions on";
+#endif
+#if defined(__clang__)
+	const char* compiler = "clang " __clang_version__;
+#else
+	const char* compiler = "gcc " __VERSION__;
+#endif
+	return std::string(compiler) + ", " + optimized + ", " + assertions;
+}
+
+static std::string json_field(const std::string& line, const std::string& key)
+{
+	// just enough JSON to read back the baseline files write_baseline writes
+	std::string quoted = "\"" + key + "\":";
+	size_t at = line.find(quoted);
+	if (at == std::string::npos)
+	{
+		return "";
+	}
+	at += quoted.size();
+	if (line[at] == '"')
+	{
+		size_t end = line.find('"', at + 1);
+		return line.substr(at + 1, end - at - 1);
+	}
+	size_t end = line.find_first_of(",}", at);
+	return line.substr(at, end - at);
+}
+
+static std::vector<Result> read_baseline(const std::string& path, std::string& build)
+{
+	std::vector<Result> results;
+	std::ifstream in(path);
+	std::string line;
+	while (std::getline(in, line))
+	{
+		if (line.find("\"build\":") != std::string::npos)
+		{
+			build = json_field(line, "build");
+		}
+		std::string stage = json_field(line, "stage");
+		if (!stage.empty())
+		{
+			results.push_back({json_field(line, "shape"), stage, atof(json_field(line, "seconds").c_str()),
+							   atof(json_field(line, "lines_per_sec").c_str()), atof(json_field(line, "bytes_per_sec").c_str())});
+		}
+	}
+	return results;
+}
+
+static bool write_baseline(const std::string& path, const std::vector<Result>& results, int iterations)
+{
+	std::ofstream out(path);
+	out << "{\"iterations\":" << iterations << ",\"build\":\"" << build_description() << "\",\"results\":[\n";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const Result& r = results[i];
+		out << "{\"shape\":\"" << r.shape << "\",\"stage\":\"" << r.stage << "\""
+			<< std::fixed << std::setprecision(6) << ",\"seconds\":" << r.seconds
+			<< std::setprecision(0) << ",\"lines_per_sec\":" << r.linesPerSec << ",\"bytes_per_sec\":" << r.bytesPerSec << "}"
+			<< (i + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "]}\n";
+	return static_cast<bool>(out);
+}
+
+static void usage()
+{
+	std::cout << "usage: ccc-bench-stages [--iterations=N] [--shape=NAME] [--baseline[=FILE]]\n"
+			  << "                        [--write-baseline=FILE] [--tolerance=PERCENT]\n";
+}
+
+int main(int argc, char** argv)
+{
+	int iterations = 5;
+	std::string only;
+	std::string baselinePath;
+	std::string writePath;
+	double tolerance = 25;	// best-of-N still moves this much on a busy machine
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t equals = arg.find('=');
+		std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+		std::string name = arg.substr(0, equals);
+		if (name == "--iterations" && !value.empty())
+		{
+			iterations = atoi(value.c_str());
+		}
+		else if (name == "--shape" && !value.empty())
+		{
+			only = value;
+		}
+		else if (name == "--baseline")
+		{
+			baselinePath = value.empty() ? CCC_BENCH_BASELINE : value;
+		}
+		else if (name == "--write-baseline" && !value.empty())
+		{
+			writePath = value;
+		}
+		else if (name == "--tolerance" && !value.empty())
+		{
+			tolerance = atof(value.c_str());
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	// the lexer prints every token and the compiler reports its progress,
+	// none of which we want to time writing to a terminal
+	std::ostringstream sink;
+	set_diag(&sink);
+
+	std::string baselineBuild;
+	std::vector<Result> baseline = baselinePath.empty() ? std::vector<Result>() : read_baseline(baselinePath, baselineBuild);
+	std::vector<Result> results;
+	int regressions = 0;
+	if (!baselinePath.empty() && baselineBuild != build_description())
+	{
+		// a baseline from some other build would flag (or hide) regressions that aren't there
+		std::cout << "[" << RED << "error" << RESET << "] " << baselinePath << " was recorded from a build with\n  "
+				  << (baselineBuild.empty() ? "(unrecorded)" : baselineBuild) << "\nbut this one is\n  " << build_description()
+				  << "\nrebuild to match it, or record a new one with --write-baseline=FILE\n";
+		return 1;
+	}
+
+	std::cout << "best of " << iterations << ", tolerance " << tolerance << "%"
+			  << (baseline.empty() ? "" : ", against " + baselinePath) << "\n";
+	std::cout << std::left << std::setw(18) << "shape" << std::setw(17) << "stage" << std::right
+			  << std::setw(10) << "ms" << std::setw(14) << "klines/s" << std::setw(10) << "MB/s" << std::setw(12) << "vs base" << "\n";
+	for (auto& named : shapes())
+	{
+		if (!only.empty() && only != named.name)
+		{
+			continue;
+		}
+		std::string program = generate_program(named.shape);
+		size_t lines = 0;
+		for (char c : program)
+		{
+			lines += c == '\n';
+		}
+
+		std::string path = write_temp_source(program);
+		if (path.empty())
+		{
+			std::cout << "can't write a temporary file\n";
+			return 1;
+		}
+
+		std::cout << named.name << ": " << lines << " lines, " << program.size() << " bytes\n";
+		StageMeasurement best;
+		bool ok = true;
+		for (int i = 0; i < iterations && ok; i++)
+		{
+			sink.str("");
+			ok = run_stages(path, best);
+		}
+		unlink(path.c_str());
+		if (!ok)
+		{
+			std::cout << "[" << RED << "error" << RESET << "] " << named.name << " didn't compile:\n" << sink.str();
+			return 1;
+		}
+
+		for (int i = 0; i < stageCount; i++)
+		{
+			Result r {named.name, stageNames[i], best.seconds[i], lines / best.seconds[i], program.size() / best.seconds[i]};
+			results.push_back(r);
+			std::cout << std::left << std::setw(18) << r.shape << std::setw(17) << r.stage << std::right << std::fixed
+					  << std::setw(10) << std::setprecision(2) << r.seconds * 1000
+					  << std::setw(14) << std::setprecision(1) << r.linesPerSec / 1000
+					  << std::setw(10) << std::setprecision(1) << r.bytesPerSec / (1024 * 1024);
+			for (auto& b : baseline)
+			{
+				if (b.shape != r.shape || b.stage != r.stage || b.linesPerSec <= 0)
+				{
+					continue;
+				}
+				double change = 100.0 * (r.linesPerSec / b.linesPerSec - 1);
+				std::cout << std::setw(11) << std::showpos << std::setprecision(1) << change << "%" << std::noshowpos;
+				if (change < -tolerance)
+				{
+					std::cout << "  [" << RED << "regression" << RESET << "]";
+					regressions++;
+				}
+			}
+			std::cout << "\n";
+		}
+	}
+
+	if (!writePath.empty() && !write_baseline(writePath, results, iterations))
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Problem writing " << writePath << "\n";
+		return 1;
+	}
+	if (regressions)
+	{
+		std::cout << regressions << " stage" << (regressions == 1 ? "" : "s") << " slower than the baseline allows\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,139 @@
+/*
+	stages.cpp
+	Runs the compiler one stage at a time, see stages.hpp.
+*/
+
+#include "stages.hpp"
+#include "headers/compiler.hpp"
+#include "headers/flatast.hpp"
+#include "headers/nodes.hpp"
+#include "headers/preprocess.hpp"
+#include "llvm/Support/raw_ostream.h"
+#include <chrono>
+#include <cstdlib>
+#include <malloc.h>
+#include <unistd.h>
+
+const char* const stageNames[stageCount] = {"preprocess_file", "lex", "parse", "verify_ast", "optimize", "flatten", "unflatten", "compile", "dump"};
+
+namespace
+{
+
+class StageMeter
+{
+	// measures one stage from construction to stop()
+public:
+	StageMeter() : heap(heap_in_use()), start(std::chrono::steady_clock::now()) {}
+
+	void stop(StageMeasurement& best, int stage)
+	{
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->start).count();
+		size_t heap = heap_in_use();
+		size_t grew = heap > this->heap ? heap - this->heap : 0;
+		if (best.seconds[stage] == 0.0 || seconds < best.seconds[stage])
+		{
+			best.seconds[stage] = seconds;
+		}
+		if (grew > best.heapBytes[stage])
+		{
+			best.heapBytes[stage] = grew;
+		}
+	}
+
+private:
+	static size_t heap_in_use()
+	{
+		struct mallinfo2 info = mallinfo2();
+		return info.uordblks + info.hblkhd;
+	}
+
+	size_t heap;
+	std::chrono::steady_clock::time_point start;
+};
+
+}
+
+bool run_stages(const std::string& path, StageMeasurement& best)
+{
+	preprocess pp;
+	std::string source;
+	StageMeter preprocessing;
+	if (pp.preprocess_file(path, source) != 0)
+	{
+		return false;
+	}
+	preprocessing.stop(best, 0);
+
+	StageMeter lexing;
+	if (lex(source) != 0)
+	{
+		return false;
+	}
+	lexing.stop(best, 1);
+
+	AstArena arena;
+	Node* root = nullptr;
+	StageMeter parsing;
+	if (parse(source, arena, root) != 0)
+	{
+		return false;
+	}
+	parsing.stop(best, 2);
+
+	StageMeter verifying;
+	if (!verify_ast(root))
+	{
+		return false;
+	}
+	verifying.stop(best, 3);
+
+	StageMeter optimizing;
+	root = optimize(arena, root);
+	optimizing.stop(best, 4);
+
+	// compile gets the round-tripped tree, so a conversion that loses
+	// anything shows up as a failure here rather than going unnoticed
+	StageMeter flattening;
+	FlatAst flat = to_flat(root);
+	flattening.stop(best, 5);
+
+	AstArena rebuilt;
+	StageMeter unflattening;
+	root = from_flat(flat, rebuilt);
+	unflattening.stop(best, 6);
+
+	StageMeter compiling;
+	std::unique_ptr<CompilationUnit> unit = compile(root);
+	if (unit == nullptr)
+	{
+		return false;
+	}
+	compiling.stop(best, 7);
+
+	std::string ir;
+	llvm::raw_string_ostream out(ir);
+	StageMeter dumping;
+	unit->dump(out);
+	out.flush();
+	dumping.stop(best, 8);
+	return true;
+}
+
+std::string write_temp_source(const std::string& program)
+{
+	const char* dir = getenv("TMPDIR");
+	std::string path = std::string(dir && *dir ? dir : "/tmp") + "/ccc-bench-XXXXXX.c";
+	int fd = mkstemps(&path[0], 2);
+	if (fd < 0)
+	{
+		return "";
+	}
+	bool ok = write(fd, program.data(), program.size()) == static_cast<ssize_t>(program.size());
+	close(fd);
+	if (!ok)
+	{
+		unlink(path.c_str());
+		return "";
+	}
+	return path;
+}
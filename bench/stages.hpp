@@ -0,0 +1,32 @@
+/*
+	stages.hpp
+	Runs a source file through each stage of the compiler in turn, timing
+	each one, for the benchmarks.
+*/
+
+#ifndef CCC_BENCH_STAGES_HPP_INCLUDED
+#define CCC_BENCH_STAGES_HPP_INCLUDED
+
+#include <cstddef>
+#include <string>
+
+extern const char* const stageNames[];
+constexpr int stageCount = 9;
+
+struct StageMeasurement
+{
+	double seconds[stageCount] = {};	// fastest time seen for each stage
+	size_t heapBytes[stageCount] = {};	// most heap each stage has left allocated when it finished
+};
+
+// one trip through preprocess_file, lex, parse, verify_ast, optimize, compile
+// and dump, the way the driver strings them together, with the tree taken
+// through to_flat and from_flat before it's compiled. Folds the results
+// into best, and returns false if the file didn't compile
+bool run_stages(const std::string& path, StageMeasurement& best);
+
+// writes program to a new temporary file and returns its name, or an empty
+// string if it couldn't
+std::string write_temp_source(const std::string& program);
+
+#endif // CCC_BENCH_STAGES_HPP_INCLUDED
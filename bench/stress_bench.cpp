@@ -0,0 +1,276 @@
+/*
+	stress_bench.cpp
+	Catches compile time or memory that grows faster than the input.
+
+	Each axis is a pathological kind of program that gets doubled in size a
+	few times. Every stage is timed at each size, and the growth of its time
+	and of the heap it leaves allocated is fitted to n^k. A stage fails when
+	k comes out above --max-exponent, and the exit status is then 1. The
+	default of 1.5 sits between the 2 a quadratic stage fits to and the
+	1.1-1.4 a linear one can reach once the larger inputs stop fitting in
+	cache. Stages that stay too quick or too small to measure at the largest
+	size aren't judged.
+
+	usage: ccc-bench-stress [--axis=NAME] [--iterations=N] [--max-exponent=K]
+*/
+
+#include "stages.hpp"
+#include "headers/common.hpp"
+#include "headers/consolecolors.hpp"
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// below these a stage is mostly noise. The heap has to have grown at the
+// smallest size too, a buffer left over from the last run can hide it there
+static constexpr double minSeconds = 0.005;
+static constexpr size_t minHeapBytes = 1024 * 1024;
+static constexpr size_t minSmallestHeapBytes = 64 * 1024;
+static constexpr int sizes = 5;
+
+static std::string false_ifs(int n)
+{
+	// one long block of statements, most of them ifs the optimizer can decide
+	std::string src = "int main() {\n\tint x = 0;\n";
+	for (int i = 0; i < n; i++)
+	{
+		switch (i % 4)
+		{
+			case 0:
+				src += "\tif (false) {\n\t\tx = x + 1;\n\t}\n";
+				break;
+			case 1:
+				src += "\tif (1 > 2) {\n\t\tx = x * 3;\n\t}\n";
+				break;
+			case 2:
+				src += "\tif (2 > 1) {\n\t\tx = x + 2;\n\t}\n";
+				break;
+			default:
+				src += "\tx = x - 1;\n";
+				break;
+		}
+	}
+	src += "\treturn x;\n}\n";
+	return src;
+}
+
+static std::string deep_expression(int n)
+{
+	// (a + (a + (a + ... (a)))) nested n deep
+	std::string src = "int f(int a) {\n\treturn ";
+	for (int i = 0; i < n; i++)
+	{
+		src += "(a + ";
+	}
+	src += "a";
+	src.append(n, ')');
+	src += ";\n}\n\nint main() {\n\treturn f(1);\n}\n";
+	return src;
+}
+
+static std::string long_chain(int n)
+{
+	// a + a + ... + a, which parses flat but leaves a tree n deep down the
+	// left. At the largest size any pass that recursed down it would run
+	// out of stack long before it got slow
+	std::string src = "int f(int a) {\n\treturn a";
+	for (int i = 0; i < n; i++)
+	{
+		src += " + a";
+	}
+	src += ";\n}\n\nint main() {\n\treturn f(1);\n}\n";
+	return src;
+}
+
+static std::string many_functions(int n)
+{
+	std::string src;
+	for (int i = 0; i < n; i++)
+	{
+		std::string name = "f" + std::to_string(i);
+		src += "int " + name + "(int a) {\n\treturn a + " + std::to_string(i % 100) + ";\n}\n\n";
+	}
+	src += "int main() {\n\treturn f" + std::to_string(n - 1) + "(1);\n}\n";
+	return src;
+}
+
+static std::string nested_blocks(int n)
+{
+	// every level shadows x and looks at a, which is declared at the top.
+	// Not indented, or the source itself would grow quadratically
+	std::string src = "int f(int a) {\n\tint x = a;\n";
+	for (int i = 0; i < n; i++)
+	{
+		src += "\tif (x < a) {\n\tint x = a + " + std::to_string(i % 100) + ";\n";
+	}
+	for (int i = 0; i < n; i++)
+	{
+		src += "\t}\n";
+	}
+	src += "\treturn x;\n}\n\nint main() {\n\treturn f(1);\n}\n";
+	return src;
+}
+
+struct Axis
+{
+	const char* name;
+	std::string (*generate)(int n);
+	int smallest;	// doubled sizes - 1 times
+};
+
+static const Axis axes[] = {
+	{"false ifs", false_ifs, 1000},
+	{"deep expression", deep_expression, 625},
+	{"long chain", long_chain, 62500},
+	{"many functions", many_functions, 6250},
+	{"nested blocks", nested_blocks, 250},
+};
+
+static double fit_exponent(const int* n, const double* y)
+{
+	// least squares slope of log y against log n
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	for (int i = 0; i < sizes; i++)
+	{
+		double x = std::log(n[i]);
+		double l = std::log(y[i]);
+		sx += x;
+		sy += l;
+		sxx += x * x;
+		sxy += x * l;
+	}
+	return (sizes * sxy - sx * sy) / (sizes * sxx - sx * sx);
+}
+
+static void usage()
+{
+	std::cout << "usage: ccc-bench-stress [--axis=NAME] [--iterations=N] [--max-exponent=K]\n";
+}
+
+int main(int argc, char** argv)
+{
+	std::string only;
+	int iterations = 3;
+	double maxExponent = 1.5;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		size_t equals = arg.find('=');
+		std::string value = equals == std::string::npos ? "" : arg.substr(equals + 1);
+		std::string name = arg.substr(0, equals);
+		if (name == "--axis" && !value.empty())
+		{
+			only = value;
+		}
+		else if (name == "--iterations" && !value.empty())
+		{
+			iterations = atoi(value.c_str());
+		}
+		else if (name == "--max-exponent" && !value.empty())
+		{
+			maxExponent = atof(value.c_str());
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	std::ostringstream sink;
+	set_diag(&sink);
+
+	int failures = 0;
+	for (auto& axis : axes)
+	{
+		if (!only.empty() && only != axis.name)
+		{
+			continue;
+		}
+		int n[sizes];
+		StageMeasurement measured[sizes];
+		std::cout << axis.name << "\n" << std::setw(17) << "n";
+		for (int s = 0; s < sizes; s++)
+		{
+			n[s] = axis.smallest << s;
+			std::cout << std::setw(10) << n[s];
+		}
+		std::cout << std::setw(10) << "k time" << std::setw(8) << "k heap" << "\n";
+
+		for (int s = 0; s < sizes; s++)
+		{
+			std::string path = write_temp_source(axis.generate(n[s]));
+			if (path.empty())
+			{
+				std::cout << "can't write a temporary file\n";
+				return 1;
+			}
+			bool ok = true;
+			for (int i = 0; i < iterations && ok; i++)
+			{
+				sink.str("");
+				ok = run_stages(path, measured[s]);
+			}
+			unlink(path.c_str());
+			if (!ok)
+			{
+				std::cout << "[" << RED << "error" << RESET << "] " << axis.name << " " << n[s] << " didn't compile:\n" << sink.str();
+				return 1;
+			}
+		}
+
+		for (int stage = 0; stage < stageCount; stage++)
+		{
+			double seconds[sizes];
+			double heap[sizes];
+			std::cout << std::left << "  " << std::setw(15) << stageNames[stage] << std::right << std::fixed << std::setprecision(1);
+			for (int s = 0; s < sizes; s++)
+			{
+				seconds[s] = measured[s].seconds[stage];
+				heap[s] = measured[s].heapBytes[stage] + 1.0;
+				std::cout << std::setw(8) << seconds[s] * 1000 << "ms";
+			}
+
+			bool slow = false;
+			std::cout << std::setprecision(2);
+			if (seconds[sizes - 1] >= minSeconds)
+			{
+				double k = fit_exponent(n, seconds);
+				slow = k > maxExponent;
+				std::cout << std::setw(10) << k;
+			}
+			else
+			{
+				std::cout << std::setw(10) << "-";
+			}
+			if (heap[sizes - 1] >= minHeapBytes && heap[0] >= minSmallestHeapBytes)
+			{
+				double k = fit_exponent(n, heap);
+				slow = slow || k > maxExponent;
+				std::cout << std::setw(8) << k;
+			}
+			else
+			{
+				std::cout << std::setw(8) << "-";
+			}
+			if (slow)
+			{
+				std::cout << "  [" << RED << "superlinear" << RESET << "]";
+				failures++;
+			}
+			std::cout << "\n";
+		}
+	}
+
+	if (failures)
+	{
+		std::cout << failures << " stage" << (failures == 1 ? "" : "s") << " grew faster than n^" << maxExponent << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,14 @@
+void putint(int x);
+
+int main() {
+    int x = 5;
+    putint(~5);
+    putint(~x);
+    putint(-x);
+    if (-x == -(5)) {
+        putint(1);
+    }
+    float f = 2.5;
+    putint((int) -f);
+    return 0;
+}
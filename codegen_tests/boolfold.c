@@ -0,0 +1,11 @@
+void putint(int x);
+
+int main() {
+    if (true && false) {
+        putint(1);
+    }
+    if (false || true) {
+        putint(2);
+    }
+    return 0;
+}
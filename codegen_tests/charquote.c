@@ -0,0 +1,20 @@
+void putint(int x);
+
+// the quote inside '\"' doesn't start a string literal, which would take
+// the comments below along with it
+int main() {
+    char q = '\"';
+    char t = '\'';
+    char b = '\\';
+    /* the preprocessor still sees this comment */
+    if (q == '\"') {
+        putint(1);    // and this one
+    }
+    if (t == '\'') {
+        putint(2);
+    }
+    if (b == '\\') {
+        putint(3);
+    }
+    return 0;
+}
@@ -0,0 +1,7 @@
+void putint(int x);
+
+int main() {
+    const int x = 3;
+    putint(x + 1);
+    return x * 2;
+}
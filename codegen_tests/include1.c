@@ -0,0 +1,10 @@
+#include "include1.h"
+#include "include2.h"
+#include "include1.h"
+#include "include2.h"
+
+int main() {
+    putint(square(7));
+    putascii(10);
+    return 0;
+}
@@ -0,0 +1,8 @@
+// prototypes for the runtime, guarded so it can be included more than once
+#ifndef INCLUDE1_H
+#define INCLUDE1_H
+
+void putint(int x);
+void putascii(int x);
+
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+#include "include1.h"
+
+int square(int x) {
+    return x * x;
+}
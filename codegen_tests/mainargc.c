@@ -0,0 +1,5 @@
+void putint(int x);
+int main(int argc) {
+  putint(argc);
+  return argc;
+}
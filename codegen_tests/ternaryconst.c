@@ -0,0 +1,11 @@
+void putint(int x);
+
+int pick(int a) {
+    return (a > 1 ? 2 : 3) + 1;
+}
+
+int main() {
+    putint(pick(0));
+    putint(pick(5));
+    return 0;
+}
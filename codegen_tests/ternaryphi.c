@@ -0,0 +1,12 @@
+void putint(int x);
+
+int classify(int a, int b) {
+    return a > 0 ? 1 : (b > 0 ? 2 : 3);
+}
+
+int main() {
+    putint(classify(1, 0));
+    putint(classify(0, 1));
+    putint(classify(0, 0));
+    return 0;
+}
@@ -0,0 +1,33 @@
+/*
+	arena.cpp
+*/
+#include "headers/arena.hpp"
+#include <cstdlib>
+
+// big enough that a chunk holds a few thousand nodes
+static constexpr size_t chunkSize = 256 * 1024;
+
+AstArena::~AstArena()
+{
+	for (char* chunk : this->chunks)
+	{
+		free(chunk);
+	}
+}
+
+void* AstArena::grow(size_t size, size_t align)
+{
+	// whatever is left of the current chunk is wasted, a chunk of its own
+	// for anything that wouldn't fit in a fresh one
+	size_t bytes = size + align > chunkSize ? size + align : chunkSize;
+	char* chunk = static_cast<char*>(malloc(bytes));
+	if (chunk == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	this->chunks.push_back(chunk);
+	this->reserved += bytes;
+	this->next = chunk;
+	this->end = chunk + bytes;
+	return this->allocate(size, align);
+}
@@ -2,6 +2,67 @@
 #include <iostream>
 #include <getopt.h>
 
+// long options that don't have a short version
+enum long_only_options
+{
+    opt_server_stats = 256,
+    opt_cache_stats,
+    opt_tiered,
+    opt_emit,
+    opt_passes,
+    opt_time_report,
+    opt_trace,
+    opt_lexer,
+    opt_parser,
+};
+
+static int parse_emit(const std::string& list, int* emit)
+{
+	// a comma separated list of output formats
+	*emit = 0;
+	size_t start = 0;
+	while (start <= list.size())
+	{
+		size_t end = list.find(',', start);
+		if (end == std::string::npos)
+		{
+			end = list.size();
+		}
+		std::string kind = list.substr(start, end - start);
+		if (kind == "ll")
+		{
+			*emit |= emit_ll;
+		}
+		else if (kind == "bc")
+		{
+			*emit |= emit_bc;
+		}
+		else if (kind == "asm")
+		{
+			*emit |= emit_asm;
+		}
+		else if (kind == "obj")
+		{
+			*emit |= emit_obj;
+		}
+		else if (kind == "exe")
+		{
+			*emit |= emit_exe;
+		}
+		else if (kind == "ast-bin")
+		{
+			*emit |= emit_ast;
+		}
+		else
+		{
+			std::cerr << "Unknown output format " << kind << " (expected ll, bc, asm, obj, exe or ast-bin)" << std::endl;
+			return 1;
+		}
+		start = end + 1;
+	}
+	return 0;
+}
+
 int parse_commands(int argc, char** argv, cmd_line_args* cmds)
 {
 	int index;
@@ -22,12 +83,26 @@ int parse_commands(int argc, char** argv, cmd_line_args* cmds)
         // {"print-pp", no_argument, 0, 'e'},
         {"optimization-level", required_argument, 0, 'o'},
         {"keep-preprocessed", no_argument, 0, 'e'},
+        {"include-dir", required_argument, 0, 'I'},
+        {"jobs", required_argument, 0, 'j'},
+        {"emit", required_argument, 0, opt_emit},
+        {"passes", required_argument, 0, opt_passes},
+        {"time-report", no_argument, 0, opt_time_report},
+        {"trace", required_argument, 0, opt_trace},
+        {"lexer", required_argument, 0, opt_lexer},
+        {"parser", required_argument, 0, opt_parser},
+        {"run", no_argument, 0, 'r'},
+        {"tiered", no_argument, 0, opt_tiered},
+        {"server", no_argument, 0, 'S'},
+        {"client", no_argument, 0, 'C'},
+        {"server-stats", no_argument, 0, opt_server_stats},
+        {"cache-stats", no_argument, 0, opt_cache_stats},
         {"help", no_argument, 0, 'h'},
         {"version", no_argument, 0, 'v'},
         {0, 0, 0, 0}
     };
 
-    while ((optcode = getopt_long(argc, argv, "eialo:hv", longopts, &index)) != -1)
+    while ((optcode = getopt_long(argc, argv, "eialo:O:j:I:rSChv", longopts, &index)) != -1)
     {
         switch (optcode)
         {
@@ -51,12 +126,109 @@ int parse_commands(int argc, char** argv, cmd_line_args* cmds)
                 break;
             case 'o':
                 cmds->optlevel = atoi(optarg);
+                if (cmds->optlevel < 0 || cmds->optlevel > 3)
+                {
+                    std::cerr << "Optimization level has to be between 0 and 3" << std::endl;
+                    return 1;
+                }
+                break;
+            case 'O':
+                // -O0 to -O3 like the long option, or -Os and -Oz
+                cmds->sizelevel = 0;
+                if (optarg[0] == 's' || optarg[0] == 'z')
+                {
+                    cmds->optlevel = 2;
+                    cmds->sizelevel = optarg[0] == 's' ? 1 : 2;
+                }
+                else if (optarg[0] >= '0' && optarg[0] <= '3' && optarg[1] == '\0')
+                {
+                    cmds->optlevel = optarg[0] - '0';
+                }
+                else
+                {
+                    std::cerr << "Unknown optimization level -O" << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case opt_passes:
+                cmds->passes = optarg;
+                break;
+            case opt_time_report:
+                cmds->time_report = 1;
+                break;
+            case opt_trace:
+                cmds->trace_file = optarg;
+                break;
+            case opt_lexer:
+                if (std::string(optarg) == "flex")
+                {
+                    cmds->lexer = lexer_flex;
+                }
+                else if (std::string(optarg) == "dfa")
+                {
+                    cmds->lexer = lexer_dfa;
+                }
+                else
+                {
+                    std::cerr << "Unknown lexer " << optarg << " (expected flex or dfa)" << std::endl;
+                    return 1;
+                }
+                break;
+            case opt_parser:
+                if (std::string(optarg) == "bison")
+                {
+                    cmds->parser = parser_bison;
+                }
+                else if (std::string(optarg) == "pratt")
+                {
+                    cmds->parser = parser_pratt;
+                }
+                else
+                {
+                    std::cerr << "Unknown parser " << optarg << " (expected bison or pratt)" << std::endl;
+                    return 1;
+                }
                 break;
             case 'e':
                 cmds->keep_pp = 1;
                 break;
+            case 'I':
+                cmds->include_dirs.push_back(optarg);
+                break;
+            case 'j':
+                cmds->jobs = atoi(optarg);
+                if (cmds->jobs < 0)
+                {
+                    std::cerr << "Number of jobs can't be negative" << std::endl;
+                    return 1;
+                }
+                break;
+            case opt_emit:
+                if (parse_emit(optarg, &cmds->emit) != 0)
+                {
+                    return 1;
+                }
+                break;
+            case 'r':
+                cmds->run = 1;
+                break;
+            case opt_tiered:
+                cmds->tiered = 1;
+                break;
+            case 'S':
+                cmds->server = 1;
+                break;
+            case 'C':
+                cmds->client = 1;
+                break;
+            case opt_server_stats:
+                cmds->server_stats = 1;
+                break;
+            case opt_cache_stats:
+                cmds->cache_stats = 1;
+                break;
             case '?':
-                if (optopt == 'o')
+                if (optopt == 'o' || optopt == 'O' || optopt == 'j' || optopt == 'I')
                 {
                     std::cerr << "Option -" << optopt << " requires an argument." << std::endl;
                 }
@@ -76,29 +248,44 @@ int parse_commands(int argc, char** argv, cmd_line_args* cmds)
 
 	for (index = optind; index < argc; index++)
 	{
-		cmds->filename = argv[index];
-		// todo: gather the rest of argv to use as the arguments to our program?
-        // or should we be able to build multiple programs probably? ie strcat it onto filename?
+		// every remaining argument is a separate program to build
+		cmds->filenames.push_back(argv[index]);
 	}
 	return 0;
 }
 
 void usage() 
 {
-	std::cout  	<< "[usage] ccc <args> <file>\n"
+	std::cout  	<< "[usage] ccc <args> <file> [file ...]\n"
 				<< " -o0\t--optimization-level 0\t\t: Disable optimization\n"
 				<< " -o1\t--optimization-level 1\t\t: Basic optimizations (default)\n"
+				<< " -O2\t--optimization-level 2\t\t: Also run LLVM's optimization pipeline (-O3 for more)\n"
+				<< " -Os, -Oz\t\t\t\t: Run LLVM's pipeline, optimizing for size\n"
+				<< "\t--passes=PIPELINE\t\t: Run this LLVM pass pipeline (as opt -passes) instead\n"
 				<< " -l\t--print-lex\t\t\t: Display lexer output\n"
+				<< "\t--lexer=flex|dfa\t\t: Scan with the flex lexer (default) or the hand-written one\n"
+				<< "\t--parser=bison|pratt\t\t: Parse with the bison parser (default) or the hand-written one\n"
 				<< " -a\t--print-ast\t\t\t: Display AST\n"
 				<< " -i\t--print-ir\t\t\t: Display generated IR\n"
-				<< " -e\t--keep-preprocessed\t\t: Keep preprocessed file (as filename.pp)\n"
+				<< " -e\t--keep-preprocessed\t\t: Write preprocessed file (as filename.pp)\n"
+				<< " -I DIR\t--include-dir DIR\t\t: Look for #include'd headers in DIR too\n"
+				<< "\t--emit=ll,bc,...\t\t: Output formats: ll (default), bc, asm (.s), obj (.o), exe, ast-bin (.ast)\n"
+				<< " -j N\t--jobs N\t\t\t: Compile files on N threads (0 for one per core)\n"
+				<< " -r\t--run <file> [args]\t\t: Compile file and run it right away (use -- before args starting with -)\n"
+				<< "\t--tiered\t\t\t: With --run, start unoptimized and recompile hot functions at -O3\n"
+				<< "\t--time-report\t\t\t: Show the time and memory each compiler phase took\n"
+				<< "\t--trace=FILE\t\t\t: Write a Chrome trace (for Perfetto) of the phases to FILE\n"
+				<< " -S\t--server\t\t\t: Run as a compile server on $CCC_SOCKET\n"
+				<< " -C\t--client\t\t\t: Have the compile server compile the files\n"
+				<< "\t--server-stats\t\t\t: Show the compile server's request statistics\n"
+				<< "\t--cache-stats\t\t\t: Show what's in the compilation cache ($CCC_CACHE_DIR)\n"
                 << " -h\t--help\t\t\t\t: Display this help message\n"
                 << " -v\t--version\t\t\t: Display version information\n";
 }
 
 void version_info()
 {
-    std::cout   << "ccc version 0.1\n"
+    std::cout   << "ccc version " CCC_VERSION "\n"
                 << "By Tyler Weston\n"
                 << "2020-2022\n";
 }
@@ -0,0 +1,514 @@
+/*
+	astfile.cpp
+	Layout of an .ast file, everything in the byte order of the machine that
+	wrote it (the magic number doesn't match otherwise):
+		AstFileHeader
+		types, locations, firsts, a, b, c	one uint32 per node each
+		lists								lists uint32s
+		line starts							lines uint32s
+		name lengths						names uint32s
+		kinds, ops, flags					one byte per node each
+		name bytes							nameBytes of them, one name after the other
+	The name operands of nodes hold an index into the names, not a Symbol.
+*/
+#include "headers/astfile.hpp"
+#include "headers/flatast.hpp"
+#include "headers/trace.hpp"
+#include <cstring>
+#include <unordered_map>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+constexpr uint32_t astMagic = 0x41434343;	// "CCCA"
+// bump whenever the layout, NodeKind or any of the op enums change
+constexpr uint32_t astVersion = 1;
+
+constexpr uint32_t optimizedFlag = 1;
+
+struct AstFileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t flags;
+	uint32_t nodes;
+	uint32_t lists;
+	uint32_t lines;
+	uint32_t names;
+	uint32_t nameBytes;
+};
+
+bool has_name(NodeKind kind)
+{
+	// the kinds whose a operand is a Symbol
+	switch (kind)
+	{
+		case NodeKind::Variable:
+		case NodeKind::Declaration:
+		case NodeKind::FuncDecl:
+		case NodeKind::FuncCall:
+		case NodeKind::Assignment:
+		case NodeKind::AugmentedAssignment:
+			return true;
+		default:
+			return false;
+	}
+}
+
+template <typename T> void put(std::string& out, const std::vector<T>& items)
+{
+	out.append(reinterpret_cast<const char*>(items.data()), items.size() * sizeof(T));
+}
+
+class Reader
+{
+	// hands out the file's arrays in order, and notices if it runs short
+private:
+	const char* next;
+	const char* end;
+
+public:
+	Reader(const char* data, size_t size) : next(data), end(data + size) {}
+
+	template <typename T> bool get(std::vector<T>& into, size_t count)
+	{
+		size_t bytes = count * sizeof(T);
+		if (static_cast<size_t>(this->end - this->next) < bytes)
+		{
+			return false;
+		}
+		into.resize(count);
+		memcpy(into.data(), this->next, bytes);
+		this->next += bytes;
+		return true;
+	}
+
+	const char* take(size_t bytes)
+	{
+		if (static_cast<size_t>(this->end - this->next) < bytes)
+		{
+			return nullptr;
+		}
+		const char* at = this->next;
+		this->next += bytes;
+		return at;
+	}
+
+	bool finished() const { return this->next == this->end; }
+};
+
+bool is_statement(NodeKind kind)
+{
+	switch (kind)
+	{
+		case NodeKind::Declaration:
+		case NodeKind::DeclAndAssign:
+		case NodeKind::Block:
+		case NodeKind::Assignment:
+		case NodeKind::AugmentedAssignment:
+		case NodeKind::If:
+		case NodeKind::For:
+		case NodeKind::While:
+		case NodeKind::Return:
+		case NodeKind::Break:
+		case NodeKind::Continue:
+		case NodeKind::ExpressionStatement:
+			return true;
+		default:
+			return false;
+	}
+}
+
+bool is_function(NodeKind kind)
+{
+	return kind == NodeKind::FuncDefn || kind == NodeKind::FuncDecl;
+}
+
+class TreeCheck
+{
+	// from_flat and codegen believe every index they're given, so before a
+	// file gets to them this makes sure they all are what they're taken for:
+	// every child comes before its parent and belongs to no other node, lists
+	// stay inside the lists, each child is the kind of node its parent needs,
+	// slots are inside their function's frame and function ids are in range
+private:
+	const FlatAst& flat;
+	std::vector<NodeIndex> parents;	// noNode until a node's parent claims it
+
+	bool claim(NodeIndex child, NodeIndex parent, bool (*accepts)(NodeKind))
+	{
+		if (child >= parent || this->parents[child] != noNode || !accepts(this->flat.kinds[child]))
+		{
+			return false;
+		}
+		this->parents[child] = parent;
+		return true;
+	}
+
+	bool maybe(NodeIndex child, NodeIndex parent, bool (*accepts)(NodeKind))
+	{
+		return child == noNode || this->claim(child, parent, accepts);
+	}
+
+	bool list(uint32_t at, NodeIndex parent, bool (*accepts)(NodeKind))
+	{
+		const std::vector<uint32_t>& lists = this->flat.lists;
+		if (at >= lists.size() || lists[at] > lists.size() - at - 1)
+		{
+			return false;
+		}
+		for (const NodeIndex* i = this->flat.list_begin(at); i != this->flat.list_end(at); ++i)
+		{
+			if (!this->claim(*i, parent, accepts))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool node(NodeIndex i)
+	{
+		auto declaration = [](NodeKind kind) { return kind == NodeKind::Declaration; };
+		auto funcDecl = [](NodeKind kind) { return kind == NodeKind::FuncDecl; };
+		auto block = [](NodeKind kind) { return kind == NodeKind::Block; };
+		uint32_t a = this->flat.a[i];
+		uint32_t b = this->flat.b[i];
+		uint32_t c = this->flat.c[i];
+		uint8_t op = this->flat.ops[i];
+		switch (this->flat.kinds[i])
+		{
+			case NodeKind::Variable:
+			case NodeKind::Declaration:
+			case NodeKind::ConstantBool:
+			case NodeKind::ConstantInt:
+			case NodeKind::ConstantFloat:
+			case NodeKind::ConstantChar:
+			case NodeKind::ConstantDouble:
+			case NodeKind::Break:
+			case NodeKind::Continue:
+				return true;
+			case NodeKind::DeclAndAssign:
+				return this->claim(a, i, declaration) && this->claim(b, i, is_expression);
+			case NodeKind::BinaryOp:
+			case NodeKind::LogicalOp:
+				return op <= static_cast<uint8_t>(BinaryOps::RightShift) &&
+					this->claim(a, i, is_expression) && this->claim(b, i, is_expression);
+			case NodeKind::RelationalOp:
+				return op <= static_cast<uint8_t>(RelationalOps::Ge) &&
+					this->claim(a, i, is_expression) && this->claim(b, i, is_expression);
+			case NodeKind::Root:
+				// and it has to be the last node, that's checked with the rest of the tree
+				return this->list(a, i, is_function);
+			case NodeKind::Block:
+				return this->list(a, i, is_statement);
+			case NodeKind::FuncDefn:
+				return this->claim(a, i, funcDecl) && this->claim(b, i, block);
+			case NodeKind::FuncDecl:
+				return this->list(b, i, declaration);
+			case NodeKind::FuncCall:
+				return this->list(b, i, is_expression);
+			case NodeKind::Assignment:
+				return this->claim(b, i, is_expression);
+			case NodeKind::AugmentedAssignment:
+				return op <= static_cast<uint8_t>(AugmentedAssignOps::SlashEq) && this->claim(b, i, is_expression);
+			case NodeKind::If:
+			case NodeKind::While:
+				return this->claim(a, i, is_expression) && this->claim(b, i, is_statement);
+			case NodeKind::For:
+			{
+				// always all four, with noNode for the ones that aren't there
+				const std::vector<uint32_t>& lists = this->flat.lists;
+				if (a >= lists.size() || lists[a] != 4 || lists.size() - a - 1 < 4)
+				{
+					return false;
+				}
+				const NodeIndex* part = this->flat.list_begin(a);
+				return this->maybe(part[0], i, is_statement) && this->maybe(part[1], i, is_expression) &&
+					this->maybe(part[2], i, is_statement) && this->claim(part[3], i, is_statement);
+			}
+			case NodeKind::Unary:
+				return op <= static_cast<uint8_t>(UnaryOps::Not) && this->claim(a, i, is_expression);
+			case NodeKind::Ternary:
+				return this->claim(a, i, is_expression) && this->claim(b, i, is_expression) &&
+					this->claim(c, i, is_expression);
+			case NodeKind::CastExpression:
+				return op <= static_cast<uint8_t>(TypeName::tLong) && this->claim(a, i, is_expression);
+			case NodeKind::Return:
+				return this->maybe(a, i, is_expression);
+			case NodeKind::ExpressionStatement:
+				return this->claim(a, i, is_expression);
+		}
+		return false;	// a kind that doesn't exist
+	}
+
+public:
+	explicit TreeCheck(const FlatAst& flat) : flat(flat), parents(flat.size(), noNode) {}
+
+	bool tree()
+	{
+		for (NodeIndex i = 0; i < this->flat.size(); i++)
+		{
+			if (this->flat.firsts[i] > i || static_cast<uint32_t>(this->flat.types[i]) > static_cast<uint32_t>(TypeName::tLong) ||
+				(this->flat.kinds[i] == NodeKind::Root) != (i == this->flat.root()) || !this->node(i))
+			{
+				return false;
+			}
+		}
+		// and everything but the root hangs off something
+		for (NodeIndex i = 0; i < this->flat.root(); i++)
+		{
+			if (this->parents[i] == noNode)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool operands()
+	{
+		// only once tree() has passed. Codegen indexes its frame with slots and
+		// its functions with function ids, unchecked but for the -1 a variable
+		// verify_ast couldn't find gets
+		// function ids number the names of the functions declared from 0, and
+		// every declaration of and call to a name has to carry that name's id.
+		// Codegen takes the definition's params from the first declaration
+		std::unordered_map<uint32_t, uint32_t> ids;
+		for (NodeIndex i = 0; i < this->flat.size(); i++)
+		{
+			if (this->flat.kinds[i] == NodeKind::FuncDecl && ids.emplace(this->flat.a[i], this->flat.c[i]).first->second != this->flat.c[i])
+			{
+				return false;
+			}
+		}
+		std::vector<bool> numbered(ids.size(), false);
+		for (auto& id : ids)
+		{
+			if (id.second >= numbered.size() || numbered[id.second])
+			{
+				return false;
+			}
+			numbered[id.second] = true;
+		}
+		// the FuncDefn each node is in, or noNode. Parents come after their
+		// children, so going from the root down every parent's is known first
+		std::vector<NodeIndex> function(this->flat.size(), noNode);
+		for (NodeIndex i = this->flat.root(); i != noNode; i--)
+		{
+			NodeKind kind = this->flat.kinds[i];
+			if (kind == NodeKind::FuncDefn)
+			{
+				function[i] = i;
+			}
+			else if (i != this->flat.root())
+			{
+				function[i] = function[this->parents[i]];
+			}
+			// a prototype's params are never given a place in any frame
+			uint32_t frameSlots = function[i] == noNode ? 0 : this->flat.c[function[i]];
+			uint32_t slot;
+			switch (kind)
+			{
+				case NodeKind::FuncDefn:
+					// every slot belongs to a Declaration
+					if (this->flat.c[i] > this->flat.size())
+					{
+						return false;
+					}
+					break;
+				case NodeKind::FuncCall:
+				{
+					auto id = ids.find(this->flat.a[i]);
+					if (id == ids.end() || id->second != this->flat.c[i])
+					{
+						return false;
+					}
+					break;
+				}
+				case NodeKind::Declaration:
+					if (function[i] != noNode && this->flat.b[i] >= frameSlots)
+					{
+						return false;
+					}
+					break;
+				case NodeKind::Variable:
+				case NodeKind::Assignment:
+				case NodeKind::AugmentedAssignment:
+					slot = kind == NodeKind::Variable ? this->flat.b[i] : this->flat.c[i];
+					if (slot != static_cast<uint32_t>(-1) && slot >= frameSlots)
+					{
+						return false;
+					}
+					break;
+				default:
+					break;
+			}
+		}
+		return true;
+	}
+};
+
+}
+
+std::string save_ast(Node* root, bool optimized)
+{
+	TraceScope trace("save ast");
+	FlatAst flat = to_flat(root);
+
+	// number the names the tree uses from 0, in the order they turn up
+	std::unordered_map<uint32_t, uint32_t> numbers;
+	std::vector<uint32_t> nameLengths;
+	std::string nameBytes;
+	for (NodeIndex i = 0; i < flat.size(); i++)
+	{
+		if (!has_name(flat.kinds[i]))
+		{
+			continue;
+		}
+		auto added = numbers.emplace(flat.a[i], numbers.size());
+		if (added.second)
+		{
+			std::string_view name = symbol_name(Symbol {flat.a[i]});
+			nameLengths.push_back(name.size());
+			nameBytes.append(name);
+		}
+		flat.a[i] = added.first->second;
+	}
+
+	const ArenaVector<uint32_t>& starts = flat.lines->line_starts();
+	std::vector<uint32_t> lines(starts.begin(), starts.end());
+
+	AstFileHeader header {astMagic, astVersion, optimized ? optimizedFlag : 0, static_cast<uint32_t>(flat.size()),
+		static_cast<uint32_t>(flat.lists.size()), static_cast<uint32_t>(lines.size()),
+		static_cast<uint32_t>(nameLengths.size()), static_cast<uint32_t>(nameBytes.size())};
+	std::string out;
+	out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+	put(out, flat.types);
+	put(out, flat.locations);
+	put(out, flat.firsts);
+	put(out, flat.a);
+	put(out, flat.b);
+	put(out, flat.c);
+	put(out, flat.lists);
+	put(out, lines);
+	put(out, nameLengths);
+	put(out, flat.kinds);
+	put(out, flat.ops);
+	put(out, flat.flags);
+	out.append(nameBytes);
+	return out;
+}
+
+Node* load_ast(const char* data, size_t size, AstArena& arena, bool* optimized)
+{
+	TraceScope trace("load ast");
+	AstFileHeader header;
+	if (size < sizeof(header))
+	{
+		return nullptr;
+	}
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != astMagic || header.version != astVersion || header.nodes == 0 || header.lines == 0)
+	{
+		return nullptr;
+	}
+
+	FlatAst flat;
+	std::vector<uint32_t> lines;
+	std::vector<uint32_t> nameLengths;
+	Reader in(data + sizeof(header), size - sizeof(header));
+	bool complete = in.get(flat.types, header.nodes) && in.get(flat.locations, header.nodes) &&
+		in.get(flat.firsts, header.nodes) && in.get(flat.a, header.nodes) && in.get(flat.b, header.nodes) &&
+		in.get(flat.c, header.nodes) && in.get(flat.lists, header.lists) && in.get(lines, header.lines) &&
+		in.get(nameLengths, header.names) && in.get(flat.kinds, header.nodes) &&
+		in.get(flat.ops, header.nodes) && in.get(flat.flags, header.nodes);
+	const char* nameBytes = in.take(header.nameBytes);
+	if (!complete || nameBytes == nullptr || !in.finished())
+	{
+		return nullptr;
+	}
+
+	std::vector<Symbol> symbols;
+	symbols.reserve(header.names);
+	uint32_t used = 0;
+	for (uint32_t length : nameLengths)
+	{
+		if (length > header.nameBytes - used)
+		{
+			return nullptr;
+		}
+		symbols.push_back(intern(std::string_view(nameBytes + used, length)));
+		used += length;
+	}
+	for (NodeIndex i = 0; i < flat.size(); i++)
+	{
+		if (has_name(flat.kinds[i]))
+		{
+			if (flat.a[i] >= symbols.size())
+			{
+				return nullptr;
+			}
+			flat.a[i] = symbols[flat.a[i]].id;
+		}
+	}
+	TreeCheck check(flat);
+	if (!check.tree() || !check.operands())
+	{
+		return nullptr;
+	}
+	// the first line starts at 0, and every line after the one before it
+	if (lines[0] != 0)
+	{
+		return nullptr;
+	}
+	for (uint32_t i = 1; i < lines.size(); i++)
+	{
+		if (lines[i] <= lines[i - 1])
+		{
+			return nullptr;
+		}
+	}
+
+	SourceLines* sourceLines = arena.make<SourceLines>(arena);
+	for (uint32_t i = 1; i < lines.size(); i++)
+	{
+		sourceLines->add_line(lines[i]);	// the first line's start is always there
+	}
+	flat.lines = sourceLines;
+	if (optimized)
+	{
+		*optimized = header.flags & optimizedFlag;
+	}
+	return from_flat(flat, arena);
+}
+
+Node* load_ast_file(const std::string& path, AstArena& arena, bool* optimized)
+{
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return nullptr;
+	}
+	size_t len = static_cast<size_t>(st.st_size);
+	void* mapping = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);	// the mapping keeps the file alive
+	if (mapping == MAP_FAILED)
+	{
+		return nullptr;
+	}
+	// the tree is built in the arena, nothing points back into the file
+	Node* root = load_ast(static_cast<const char*>(mapping), len, arena, optimized);
+	munmap(mapping, len);
+	return root;
+}
@@ -0,0 +1,350 @@
+/*
+	cache.cpp
+	On-disk compilation cache.
+
+	Layout of the cache directory:
+		ab/cdef...		an entry, named by its 40 character hex key
+		ab/.tmp.*		an entry being written, renamed into place when done
+		stats			hit/miss/store/eviction counters and the total size,
+						updated under flock so processes don't trip over each other
+		evict.lock		held by whoever is evicting
+*/
+#include "headers/cache.hpp"
+#include "headers/consolecolors.hpp"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/SHA1.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static constexpr uint64_t defaultMaxBytes = 512ull * 1024 * 1024;
+
+// temp files older than this were left behind by a process that died mid-write
+static constexpr auto staleTempAge = std::chrono::hours(1);
+
+static uint64_t parse_size(const char* text)
+{
+	// a number of bytes with an optional K, M or G suffix
+	char* end;
+	unsigned long long n = strtoull(text, &end, 10);
+	switch (*end)
+	{
+		case 'k': case 'K':
+			return n << 10;
+		case 'm': case 'M':
+			return n << 20;
+		case 'g': case 'G':
+			return n << 30;
+		default:
+			return n;
+	}
+}
+
+CompilationCache::CompilationCache(std::string dir) : dir(std::move(dir)), maxBytes(defaultMaxBytes)
+{
+	const char* size = getenv("CCC_CACHE_SIZE");
+	if (size && *size)
+	{
+		this->maxBytes = parse_size(size);
+	}
+
+	// a rebuilt ccc may generate different code for the same source, so the
+	// key includes which binary this is as well as the version
+	this->compilerStamp = "ccc " CCC_VERSION;
+	struct stat st;
+	if (stat("/proc/self/exe", &st) == 0)
+	{
+		this->compilerStamp += " " + std::to_string(st.st_size) + " " + std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec);
+	}
+}
+
+CompilationCache* CompilationCache::get()
+{
+	static CompilationCache* cache = []() -> CompilationCache* {
+		const char* dir = getenv("CCC_CACHE_DIR");
+		if (!dir || !*dir)
+		{
+			return nullptr;
+		}
+		std::error_code ec;
+		fs::create_directories(dir, ec);
+		if (ec)
+		{
+			std::cout << "[" << YELLOW << "warning" << RESET << "] Can't create cache directory " << dir << ", caching is off\n";
+			return nullptr;
+		}
+		return new CompilationCache(dir);
+	}();
+	return cache;
+}
+
+std::string CompilationCache::key(const std::string& source, const cmd_line_args& cmds, const char* format)
+{
+	// everything that changes the output has to be in here. Each output format
+	// is an entry of its own
+	llvm::SHA1 hash;
+	hash.update(this->compilerStamp);
+	hash.update(llvm::StringRef("\0opt ", 5));
+	hash.update(std::to_string(cmds.optlevel) + " " + std::to_string(cmds.sizelevel) + " ");
+	hash.update(cmds.passes);
+	hash.update(llvm::StringRef("\0emit ", 6));
+	hash.update(format);
+	hash.update(llvm::StringRef("\0", 1));
+	hash.update(source);
+	return llvm::toHex(hash.final(), true);
+}
+
+std::string CompilationCache::ast_key(const std::string& source)
+{
+	llvm::SHA1 hash;
+	hash.update(this->compilerStamp);
+	hash.update(llvm::StringRef("\0ast\0", 5));
+	hash.update(source);
+	return llvm::toHex(hash.final(), true);
+}
+
+std::string CompilationCache::entry_path(const std::string& key)
+{
+	// fan out over 256 directories so none of them get huge
+	return this->dir + "/" + key.substr(0, 2) + "/" + key.substr(2);
+}
+
+bool CompilationCache::lookup(const std::string& key, std::string& data)
+{
+	std::string path = this->entry_path(key);
+	std::ifstream in(path, std::ios::binary);
+	if (!in.is_open())
+	{
+		this->update_stats(0, 1, 0, 0, 0);
+		return false;
+	}
+	std::ostringstream contents;
+	contents << in.rdbuf();
+	data = contents.str();
+	// bump the modification time, that's what the eviction order goes by
+	utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+	this->update_stats(1, 0, 0, 0, 0);
+	return true;
+}
+
+std::string CompilationCache::find(const std::string& key)
+{
+	std::string path = this->entry_path(key);
+	if (access(path.c_str(), R_OK) != 0)
+	{
+		this->update_stats(0, 1, 0, 0, 0);
+		return "";
+	}
+	utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+	this->update_stats(1, 0, 0, 0, 0);
+	return path;
+}
+
+void CompilationCache::discard(const std::string& key)
+{
+	std::string path = this->entry_path(key);
+	struct stat st;
+	if (stat(path.c_str(), &st) != 0 || unlink(path.c_str()) != 0)
+	{
+		this->update_stats(-1, 1, 0, 0, 0);
+		return;
+	}
+	this->update_stats(-1, 1, 0, 0, -static_cast<int64_t>(st.st_size));
+}
+
+void CompilationCache::store(const std::string& key, const std::string& data)
+{
+	static std::atomic<unsigned> tempCounter {0};
+	std::string path = this->entry_path(key);
+	std::string subdir = this->dir + "/" + key.substr(0, 2);
+	std::string temp = subdir + "/.tmp." + std::to_string(getpid()) + "." + std::to_string(tempCounter++);
+
+	std::error_code ec;
+	fs::create_directories(subdir, ec);
+	{
+		std::ofstream out(temp, std::ios::binary);
+		if (!out.is_open())
+		{
+			return;	// caching is best effort, the compile already succeeded
+		}
+		out.write(data.data(), data.size());
+		if (!out)
+		{
+			out.close();
+			unlink(temp.c_str());
+			return;
+		}
+	}
+	// readers only ever see a complete entry, and if two processes store the
+	// same key at once the last rename wins with identical contents
+	if (rename(temp.c_str(), path.c_str()) != 0)
+	{
+		unlink(temp.c_str());
+		return;
+	}
+	uint64_t total = this->update_stats(0, 0, 1, 0, data.size());
+	if (total > this->maxBytes)
+	{
+		this->evict();
+	}
+}
+
+uint64_t CompilationCache::update_stats(int64_t hits, int64_t misses, int64_t stores, int64_t evictions, int64_t bytes, bool setBytes)
+{
+	// read-modify-write of the stats file, under an exclusive lock. bytes is added
+	// to the total size unless setBytes says it is the recounted total.
+	// Returns the total size of the cache afterwards.
+	std::string path = this->dir + "/stats";
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		return 0;
+	}
+	flock(fd, LOCK_EX);
+
+	char buffer[512];
+	ssize_t n = pread(fd, buffer, sizeof(buffer) - 1, 0);
+	buffer[n > 0 ? n : 0] = '\0';
+	unsigned long long counts[5] = {0, 0, 0, 0, 0};
+	sscanf(buffer, "hits %llu\nmisses %llu\nstores %llu\nevictions %llu\nbytes %llu\n",
+		   &counts[0], &counts[1], &counts[2], &counts[3], &counts[4]);
+	counts[0] += hits;
+	counts[1] += misses;
+	counts[2] += stores;
+	counts[3] += evictions;
+	counts[4] = setBytes ? bytes : counts[4] + bytes;
+
+	int len = snprintf(buffer, sizeof(buffer), "hits %llu\nmisses %llu\nstores %llu\nevictions %llu\nbytes %llu\n",
+					   counts[0], counts[1], counts[2], counts[3], counts[4]);
+	if (pwrite(fd, buffer, len, 0) == len)
+	{
+		ftruncate(fd, len);
+	}
+
+	flock(fd, LOCK_UN);
+	close(fd);
+	return counts[4];
+}
+
+struct CacheEntry
+{
+	fs::path path;
+	fs::file_time_type used;
+	uint64_t size;
+};
+
+static std::vector<CacheEntry> list_entries(const std::string& dir)
+{
+	std::vector<CacheEntry> entries;
+	std::error_code ec;
+	auto now = fs::file_time_type::clock::now();
+	for (auto it = fs::recursive_directory_iterator(dir, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+	{
+		if (it.depth() != 1 || !it->is_regular_file(ec))
+		{
+			continue;
+		}
+		fs::file_time_type used = it->last_write_time(ec);
+		if (it->path().filename().string().rfind(".tmp.", 0) == 0)
+		{
+			if (now - used > staleTempAge)
+			{
+				fs::remove(it->path(), ec);
+			}
+			continue;
+		}
+		entries.push_back({it->path(), used, static_cast<uint64_t>(it->file_size(ec))});
+	}
+	return entries;
+}
+
+void CompilationCache::evict()
+{
+	// only one process needs to be doing this at a time
+	std::string lockPath = this->dir + "/evict.lock";
+	int fd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		return;
+	}
+	if (flock(fd, LOCK_EX | LOCK_NB) != 0)
+	{
+		close(fd);
+		return;
+	}
+
+	std::vector<CacheEntry> entries = list_entries(this->dir);
+	uint64_t total = 0;
+	for (auto& e : entries)
+	{
+		total += e.size;
+	}
+	// least recently used first. Go a bit under the cap so we aren't
+	// back in here on the very next store
+	std::sort(entries.begin(), entries.end(), [](const CacheEntry& a, const CacheEntry& b) { return a.used < b.used; });
+	uint64_t target = this->maxBytes - this->maxBytes / 10;
+	int64_t evicted = 0;
+	std::error_code ec;
+	for (auto& e : entries)
+	{
+		if (total <= target)
+		{
+			break;
+		}
+		if (fs::remove(e.path, ec))
+		{
+			total -= e.size;
+			evicted++;
+		}
+	}
+	this->update_stats(0, 0, 0, evicted, total, true);
+
+	flock(fd, LOCK_UN);
+	close(fd);
+}
+
+void CompilationCache::print_stats(std::ostream& out)
+{
+	std::vector<CacheEntry> entries = list_entries(this->dir);
+	uint64_t total = 0;
+	for (auto& e : entries)
+	{
+		total += e.size;
+	}
+	// fix up the recorded size while we're at it, then read the counters back
+	std::string path = this->dir + "/stats";
+	unsigned long long counts[5] = {0, 0, 0, 0, 0};
+	this->update_stats(0, 0, 0, 0, total, true);
+	std::ifstream in(path);
+	std::string name;
+	for (auto& c : counts)
+	{
+		in >> name >> c;
+	}
+
+	unsigned long long lookups = counts[0] + counts[1];
+	out << "cache directory: " << this->dir << "\n"
+		<< "entries: " << entries.size() << "\n"
+		<< "size: " << total << " bytes (limit " << this->maxBytes << ")\n"
+		<< "hits: " << counts[0] << "\n"
+		<< "misses: " << counts[1] << "\n"
+		<< "hit rate: " << (lookups ? 100.0 * counts[0] / lookups : 0.0) << "%\n"
+		<< "stores: " << counts[2] << "\n"
+		<< "evictions: " << counts[3] << "\n";
+}
@@ -0,0 +1,202 @@
+/*
+	client.cpp
+	Sends a command line to the compile server and writes out what comes back.
+
+	This doesn't link against LLVM or the rest of the compiler, so ccc-client
+	starts up quickly.
+*/
+#include "headers/client.hpp"
+#include "headers/protocol.hpp"
+#include "headers/consolecolors.hpp"
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <errno.h>
+#include <limits.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static int write_output(const std::string& path, const std::string& data, bool executable)
+{
+	std::ofstream out(path, std::ios::binary);
+	if (!out.is_open())
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Problem opening file for writing " << path << "\n";
+		return 1;
+	}
+	out.write(data.data(), data.size());
+	out.close();
+	if (executable)
+	{
+		chmod(path.c_str(), 0755);
+	}
+	return 0;
+}
+
+static int connect_to_server()
+{
+	std::string path = server_socket_path();
+	sockaddr_un addr {};
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Socket path too long: " << path << "\n";
+		return -1;
+	}
+	std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+	{
+		std::cout << "[" << RED << "error" << RESET << "] No compile server listening on " << path << " (start one with ccc --server)\n";
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+		return -1;
+	}
+	return fd;
+}
+
+static int client_stats(int fd)
+{
+	MessageWriter request;
+	request.put_u8(request_stats);
+	std::string payload;
+	if (!send_message(fd, request) || !receive_message(fd, payload))
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Lost connection to the compile server\n";
+		return 1;
+	}
+	MessageReader reply(payload);
+	if (reply.get_u8() != reply_stats)
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Unexpected reply from the compile server\n";
+		return 1;
+	}
+	std::cout << reply.get_str();
+	return 0;
+}
+
+int run_client(const cmd_line_args& cmds)
+{
+	signal(SIGPIPE, SIG_IGN);
+	int fd = connect_to_server();
+	if (fd < 0)
+	{
+		return 1;
+	}
+	if (cmds.server_stats)
+	{
+		int ret = client_stats(fd);
+		close(fd);
+		return ret;
+	}
+
+	char cwd[PATH_MAX];
+	if (!getcwd(cwd, sizeof(cwd)))
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Can't get current directory\n";
+		close(fd);
+		return 1;
+	}
+
+	// the server reads files itself, so it gets absolute paths. The names the
+	// user gave are what it uses in messages and for naming outputs, which
+	// we write relative to our own directory. "-" sends stdin inline, with a
+	// path in our directory to find the headers it includes from. Include
+	// directories are made absolute too
+	cmd_line_args flags = cmds;
+	for (auto& dir : flags.include_dirs)
+	{
+		if (dir[0] != '/')
+		{
+			dir = std::string(cwd) + "/" + dir;
+		}
+	}
+	MessageWriter request;
+	request.put_u8(request_compile);
+	put_flags(request, flags);
+	request.put_u32(static_cast<uint32_t>(cmds.filenames.size()));
+	for (auto& filename : cmds.filenames)
+	{
+		if (filename == "-")
+		{
+			std::string source(std::istreambuf_iterator<char>(std::cin), {});
+			request.put_str("stdin");
+			request.put_str(std::string(cwd) + "/stdin");
+			request.put_u8(1);
+			request.put_str(source);
+		}
+		else
+		{
+			request.put_str(filename);
+			request.put_str(filename[0] == '/' ? filename : std::string(cwd) + "/" + filename);
+			request.put_u8(0);
+		}
+	}
+	if (!send_message(fd, request))
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Lost connection to the compile server\n";
+		close(fd);
+		return 1;
+	}
+
+	int failed = -1;
+	int writeFailed = 0;
+	std::string payload;
+	while (failed < 0 && receive_message(fd, payload))
+	{
+		MessageReader reply(payload);
+		uint8_t kind = reply.get_u8();
+		if (kind == reply_file)
+		{
+			int status = reply.get_i32();
+			std::cout << reply.get_str();
+			uint32_t outputs = reply.get_u32();
+			for (uint32_t i = 0; i < outputs && reply.ok; i++)
+			{
+				std::string path = reply.get_str();
+				std::string data = reply.get_str();
+				bool executable = reply.get_u8() != 0;
+				if (status == 0 && write_output(path, data, executable) != 0)
+				{
+					writeFailed++;
+				}
+			}
+			std::cout.flush();
+		}
+		else if (kind == reply_done)
+		{
+			failed = reply.get_i32();
+		}
+		else
+		{
+			break;
+		}
+	}
+	close(fd);
+
+	if (failed < 0)
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Lost connection to the compile server\n";
+		return 1;
+	}
+	failed += writeFailed;
+	if (cmds.filenames.size() > 1)
+	{
+		if (failed)
+		{
+			std::cout << "[" << RED << "ERROR" << RESET << "] " << failed << " of " << cmds.filenames.size() << " files failed to compile\n";
+		}
+		else
+		{
+			std::cout << "[" << GREEN << "SUCCESS" << RESET << "] Compiled " << cmds.filenames.size() << " files\n";
+		}
+	}
+	return failed ? 1 : 0;
+}
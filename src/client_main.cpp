@@ -0,0 +1,23 @@
+/*
+	client_main.cpp
+	ccc-client, the same as ccc --client without the rest of the compiler
+	linked in, for build systems that start it once per file.
+*/
+
+#include "headers/argsparse.hpp"
+#include "headers/client.hpp"
+#include <iostream>
+
+int main(int argc, char** argv) {
+	cmd_line_args cmds;
+	if (parse_commands(argc, argv, &cmds) != 0)
+	{
+		return 1;
+	}
+	if (!cmds.server_stats && cmds.filenames.empty())
+	{
+		std::cout << "Must supply filename to compile\n";
+		return 1;
+	}
+	return run_client(cmds);
+}
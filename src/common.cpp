@@ -4,6 +4,27 @@
 #include "headers/common.hpp"
 #include <map>
 #include <string>
+#include <iostream>
+
+static thread_local std::ostream* diagStream = nullptr;
+
+std::ostream& diag()
+{
+	return diagStream ? *diagStream : std::cout;
+}
+
+std::ostream* set_diag(std::ostream* stream)
+{
+	// returns the previous stream so callers can put it back
+	std::ostream* previous = diagStream;
+	diagStream = stream;
+	return previous;
+}
+
+void fatal_error()
+{
+	throw CompileError();
+}
 
 std::string TypeNameString(TypeName t)
 {
@@ -1,12 +1,16 @@
 // Given
 #include "headers/compiler.hpp"
 #include "headers/lexer.hpp"
+#include "headers/pratt.hpp"
 #include "parser.hpp"	// This doesn't live in headers/ because it is auto generated
 
 // Common
 #include "headers/nodes.hpp"
+#include "headers/arena.hpp"
+#include "headers/srcloc.hpp"
 #include "headers/common.hpp"
 #include "headers/consolecolors.hpp"
+#include "headers/trace.hpp"
 
 // Visitors
 #include "headers/vprint.hpp"
@@ -17,39 +21,58 @@
 // Symbol & Function table
 #include "headers/symtable.hpp"
 
+#include "headers/tiered.hpp"
+
 // LLVM
 #include "llvm/IR/Verifier.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Passes/PassBuilder.h"
+#include "llvm/MC/TargetRegistry.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Target/TargetOptions.h"
 #include "llvm/Support/TargetSelect.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/raw_os_ostream.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
-// unused
-// #include "llvm/ExecutionEngine/Orc/LLJIT.h"
-// #include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/ADT/SmallPtrSet.h"
 
 // Standard Libraries.
 #include <iostream>
 #include <cassert>
 #include <cstring>
+#include <cstdio>
+#include <mutex>
 
-int lex(const std::string& path) 
-{
-	FILE* in = fopen(path.c_str(), "r");
-	if (in == nullptr) {
-		std::cout << "[" << RED << "error" << RESET << "] unable to open file " << path <<": " << std::strerror(errno) << "\n";
-		return 1;
-	}
-
-	yyscan_t lexer;
-	yylex_init_extra(1, &lexer);
+// how many of the functions reachable from main get compiled ahead of their first call
+static constexpr size_t speculateLimit = 64;
 
-	yyset_in(in, lexer);
+int lex(std::string& source, lexer_kind kind)
+{
+	TraceScope trace("lex");
+	AstArena arena;
+	SourceLines lines(arena);
+	Lexer lexer(source, &lines, kind);
 
+	int ret = 0;
 	while (true) {
 		yy::parser::symbol_type s;
-		int x = yylex(&s, nullptr, lexer);
-		assert(x == 1);
-		std::cout << "[" << GREEN << "output" << RESET << "] lexer got symbol: " << s.name() << " (" << s.location.begin.line << ", " << s.location.begin.column << ").\n";
+		try
+		{
+			yy::parser::symbol_type next = lexer.next();
+			s.move(next);
+		}
+		catch (const CompileError&)
+		{
+			ret = 1;
+			break;
+		}
+		diag() << "[" << GREEN << "output" << RESET << "] lexer got symbol: " << s.name() << " (" << lines.find(s.location.begin) << ").\n";
 		// TODO: figure out cleaner way to print lexer output
 		// printf ("%s ", s.name());
 		// if (s.kind() == yy::parser::symbol_kind_type::S_YYEMPTY)
@@ -62,36 +85,43 @@ int lex(const std::string& path)
 		}
 	}
 
-	yylex_destroy(lexer);
-	fclose(in);
-
-	return 0;
+	return ret;
 }
 
-int parse(const std::string& path, std::unique_ptr<Node>& root) 
+int parse(std::string& source, AstArena& arena, Node*& root, lexer_kind lexerKind, parser_kind parserKind)
 {
-	FILE* in = fopen(path.c_str(), "r");
-	if (in == nullptr) {
-		std::cout << "[" << RED << "error" << RESET << "] unable to open file: " << std::strerror(errno) << "\n";
-		return 1;
-	}
-
-	yyscan_t lexer;
-	yylex_init_extra(1, &lexer);
+	TraceScope trace("parse");
+	// the line table goes in the arena, so it lasts as long as the tree
+	// whose locations it decodes
+	Lexer lexer(source, arena.make<SourceLines>(arena), lexerKind);
 
-	yyset_in(in, lexer);
-
-	yy::parser p(lexer, root);
-	int x = p.parse();
-
-	yylex_destroy(lexer);
-	fclose(in);
+	int x;
+	try
+	{
+		if (parserKind == parser_pratt)
+		{
+			PrattParser p(lexer, arena);
+			root = p.parse();
+			x = 0;
+		}
+		else
+		{
+			yy::parser p(lexer, arena, root);
+			x = p.parse();
+		}
+	}
+	catch (const CompileError&)
+	{
+		// the lexer or the parser has already reported the error
+		x = 1;
+	}
 
 	return x;
 }
 
 bool verify_ast(Node* root) 
 {
+	TraceScope trace("verify_ast");
 	// Semantic check of our generated AST
 
 	// create our symbol table and function table
@@ -104,19 +134,28 @@ bool verify_ast(Node* root)
 	EvaluateVisitor evaluateVisitor;
 	evaluateVisitor.symbolTable = symbolTable;
 	evaluateVisitor.functionTable = functionTable;
-	root->accept(&evaluateVisitor);
-
-	// Make sure we got a main function and that it returns an int
-	FunctionTableEntry* mainf = evaluateVisitor.functionTable->GetFunction("main");
-	if (mainf == nullptr)
+	bool ok = true;
+	try
 	{
-		std::cout << "[" << RED << "error" << RESET << "] Error: No main function found\n";
-		exit(1);
+		evaluateVisitor.walk(root);
+
+		// Make sure we got a main function and that it returns an int
+		FunctionTableEntry* mainf = evaluateVisitor.functionTable->GetFunction(intern("main"));
+		if (mainf == nullptr)
+		{
+			diag() << "[" << RED << "error" << RESET << "] Error: No main function found\n";
+			ok = false;
+		}
+		else if (mainf->ReturnType != TypeName::tInt)	// this is already checked in evaluate?
+		{
+			diag() << "[" << RED << "error" << RESET << "] Error: Main function needs return type int\n";
+			ok = false;
+		}
 	}
-	if (mainf->ReturnType != TypeName::tInt)	// this is already checked in evaluate?
+	catch (const CompileError&)
 	{
-		std::cout << "[" << RED << "error" << RESET << "] Error: Main function needs return type int\n";
-		exit(1);
+		// the error has already been reported, we just need to clean up
+		ok = false;
 	}
 
 	// Clean up our symbol table and function table
@@ -125,18 +164,20 @@ bool verify_ast(Node* root)
 	delete(symbolTable);
 	delete(functionTable);
 
-	return true;	// if we get here, we haven't hit any semantic errors
+	return ok;	// if we get here without an error, we haven't hit any semantic errors
 }
 
-std::unique_ptr<Node> optimize(std::unique_ptr<Node> root) 
+Node* optimize(AstArena& arena, Node* root) 
 {
-	// Optimize our AST by performing some simplifications
-	OptimizeVisitor optimizeVisitor;
+	// Optimize our AST by performing some simplifications, any new nodes
+	// go in the same arena as the rest of the tree
+	OptimizeVisitor optimizeVisitor(arena);
 
 	do
 	{
+		TraceScope trace("optimize iteration");
 		optimizeVisitor.cleanTree = true;
-		root->accept(&optimizeVisitor);
+		optimizeVisitor.walk(root);
 	}
 	while (!optimizeVisitor.cleanTree);	// repeat until we iterate through the tree
 										// without making any changes to it
@@ -147,15 +188,23 @@ void print_ast(Node* root)
 {
 	// Use Visitor pattern to print our generated AST
 	PrintVisitor printVisitor;
-	root->accept(&printVisitor);
+	printVisitor.walk(root);
 	return;
 }
 
 std::unique_ptr<CompilationUnit> compile(Node* root) 
 {
 	// run the  compilation process
+	TraceScope trace("compile");
 	std::unique_ptr<CompilationUnit> unit = std::make_unique<CompilationUnit>();
-	if (!unit->process(root)) {
+	try
+	{
+		if (!unit->process(root)) {
+			return nullptr;
+		}
+	}
+	catch (const CompileError&)
+	{
 		return nullptr;
 	}
 	return unit;
@@ -163,13 +212,47 @@ std::unique_ptr<CompilationUnit> compile(Node* root)
 
 void CompilationUnit::initialize() 
 {
-	llvm::InitializeNativeTarget();
+	// only needed to generate machine code, and only once per process
+	static std::once_flag once;
+	std::call_once(once, [] {
+		llvm::InitializeNativeTarget();
+		llvm::InitializeNativeTargetAsmPrinter();
+	});
+}
+
+static std::unique_ptr<llvm::TargetMachine> create_target_machine()
+{
+	// code for the machine we're running on, but nothing fancier than its
+	// baseline CPU so the objects run on any machine of the same kind
+	CompilationUnit::initialize();
+	std::string triple = llvm::sys::getDefaultTargetTriple();
+	std::string error;
+	const llvm::Target* target = llvm::TargetRegistry::lookupTarget(triple, error);
+	if (target == nullptr)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't find target " << triple << ": " << error << "\n";
+		return nullptr;
+	}
+	llvm::TargetOptions options;
+	return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(triple, "generic", "", options, llvm::Reloc::PIC_));
+}
+
+static const std::string& host_data_layout()
+{
+	// the same for every module, so only work it out once
+	static const std::string layout = [] {
+		std::unique_ptr<llvm::TargetMachine> machine = create_target_machine();
+		return machine ? machine->createDataLayout().getStringRepresentation() : std::string();
+	}();
+	return layout;
 }
 
 CompilationUnit::CompilationUnit() : context(std::make_unique<llvm::LLVMContext>()), builder(*this->context) 
 {
 	// todo: make this module named after the filename
 	this->module = std::make_unique<llvm::Module>("ccc", *this->context);
+	this->module->setTargetTriple(llvm::sys::getDefaultTargetTriple());
+	this->module->setDataLayout(host_data_layout());
 }
 
 bool CompilationUnit::process(Node* root) 
@@ -177,21 +260,227 @@ bool CompilationUnit::process(Node* root)
 	// Generate our llvm IR code
 	CodegenVisitor codegenVisitor;
 	codegenVisitor.compilationUnit = this;
-	root->accept(&codegenVisitor);
+	codegenVisitor.walk(root);
 
-	llvm::verifyModule(*this->module, &llvm::errs());
+	TraceScope trace("verifyModule");
+	llvm::raw_os_ostream errs(diag());
+	llvm::verifyModule(*this->module, &errs);
 	return true;
 }
 
-std::error_code CompilationUnit::dump(std::string path, int print_ir) 
+void CompilationUnit::dump(llvm::raw_ostream& out)
 {
-	std::error_code ec;
-	llvm::raw_fd_ostream out(path, ec, llvm::sys::fs::OpenFlags::OF_None);
 	this->module->print(out, nullptr);
-	if (print_ir)
+}
+
+void CompilationUnit::dump_bitcode(llvm::raw_ostream& out)
+{
+	llvm::WriteBitcodeToFile(*this->module, out);
+}
+
+bool optimize_module(llvm::Module& module, llvm::TargetMachine* machine, llvm::OptimizationLevel level, const std::string& pipeline)
+{
+	// LLVM's own optimizations, either the standard pipeline for level or the
+	// one spelled out in pipeline. With the target machine attached the cost
+	// models know what this machine is good at
+	llvm::LoopAnalysisManager lam;
+	llvm::FunctionAnalysisManager fam;
+	llvm::CGSCCAnalysisManager cgam;
+	llvm::ModuleAnalysisManager mam;
+	llvm::PassBuilder passes(machine);
+	passes.registerModuleAnalyses(mam);
+	passes.registerCGSCCAnalyses(cgam);
+	passes.registerFunctionAnalyses(fam);
+	passes.registerLoopAnalyses(lam);
+	passes.crossRegisterProxies(lam, fam, cgam, mam);
+
+	llvm::ModulePassManager mpm;
+	if (pipeline.empty())
+	{
+		mpm = passes.buildPerModuleDefaultPipeline(level);
+	}
+	else if (llvm::Error err = passes.parsePassPipeline(mpm, pipeline))
+	{
+		diag() << "[" << RED << "error" << RESET << "] Bad pass pipeline: " << llvm::toString(std::move(err)) << "\n";
+		return false;
+	}
+	TraceScope trace("optimize IR");
+	mpm.run(module, mam);
+	return true;
+}
+
+bool CompilationUnit::optimize(int level, int sizeLevel, const std::string& pipeline)
+{
+	std::unique_ptr<llvm::TargetMachine> machine = create_target_machine();
+	if (machine == nullptr)
+	{
+		return false;
+	}
+	llvm::OptimizationLevel o = llvm::OptimizationLevel::O2;
+	if (sizeLevel == 1)
+	{
+		o = llvm::OptimizationLevel::Os;
+	}
+	else if (sizeLevel == 2)
+	{
+		o = llvm::OptimizationLevel::Oz;
+	}
+	else if (level >= 3)
+	{
+		o = llvm::OptimizationLevel::O3;
+	}
+	return optimize_module(*this->module, machine.get(), o, pipeline);
+}
+
+bool CompilationUnit::dump_native(llvm::raw_pwrite_stream& out, bool assembly)
+{
+	// run the code generator in process, to an object file or its assembly
+	std::unique_ptr<llvm::TargetMachine> machine = create_target_machine();
+	if (machine == nullptr)
+	{
+		return false;
+	}
+	llvm::legacy::PassManager passes;
+	if (machine->addPassesToEmitFile(passes, out, nullptr, assembly ? llvm::CGFT_AssemblyFile : llvm::CGFT_ObjectFile))
+	{
+		diag() << "[" << RED << "error" << RESET << "] Target " << this->module->getTargetTriple() << " can't write this kind of file\n";
+		return false;
+	}
+	TraceScope trace("codegen native");
+	passes.run(*this->module);
+	return true;
+}
+
+static std::vector<std::string> hot_functions(llvm::Function* mainf)
+{
+	// the functions main can reach through direct calls, nearest first. These
+	// are worth compiling before anyone asks for them
+	std::vector<std::string> names;
+	std::vector<llvm::Function*> queue {mainf};
+	llvm::SmallPtrSet<llvm::Function*, 32> seen {mainf};
+	for (size_t i = 0; i < queue.size() && names.size() < speculateLimit; i++)
+	{
+		for (auto& inst : llvm::instructions(*queue[i]))
+		{
+			auto* call = llvm::dyn_cast<llvm::CallInst>(&inst);
+			llvm::Function* callee = call ? call->getCalledFunction() : nullptr;
+			if (callee && !callee->isDeclaration() && seen.insert(callee).second)
+			{
+				queue.push_back(callee);
+				names.push_back(callee->getName().str());
+			}
+		}
+	}
+	if (names.size() > speculateLimit)
+	{
+		names.resize(speculateLimit);
+	}
+	return names;
+}
+
+int CompilationUnit::run(const std::vector<std::string>& args, unsigned compileThreads, bool tiered)
+{
+	// JIT our module in this process and call its main function. Functions are
+	// compiled lazily, the first time they are called, so a big program with
+	// lots of functions it never uses doesn't pay for them. The module and
+	// context are handed over to the JIT, so this unit is finished with afterwards.
+	CompilationUnit::initialize();
+	llvm::Function* mainf = this->module->getFunction("main");
+	// a main that is only declared would be looked up in ccc and find ours
+	if (mainf == nullptr || mainf->isDeclaration())
+	{
+		diag() << "[" << RED << "error" << RESET << "] Error: No main function found\n";
+		return 1;
+	}
+	// there are no pointers, so main can't be handed the arguments themselves.
+	// int main(int argc) gets how many there are, counting the program like C
+	// does, and main has to be called with exactly the parameters it takes
+	bool takesArgc = mainf->arg_size() == 1 && mainf->getArg(0)->getType()->isIntegerTy(32);
+	if (mainf->arg_size() != 0 && !takesArgc)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Error: main has to take no parameters or a single int to be run\n";
+		return 1;
+	}
+	if (!args.empty() && !takesArgc)
+	{
+		diag() << "[" << YELLOW << "warning" << RESET << "] main takes no parameters, ignoring " << args.size() << " program arguments\n";
+	}
+	int argc = takesArgc ? static_cast<int>(args.size()) + 1 : -1;
+	if (tiered)
+	{
+		TieredJIT tiers(compileThreads);
+		return tiers.run(std::move(this->context), std::move(this->module), argc);
+	}
+	std::vector<std::string> hot = hot_functions(mainf);
+
+	auto jit = llvm::orc::LLLazyJITBuilder().setNumCompileThreads(compileThreads).create();
+	if (!jit)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't create JIT: " << llvm::toString(jit.takeError()) << "\n";
+		return 1;
+	}
+	// anything the program calls but doesn't define (put_int, putascii, ...)
+	// is looked up in ccc itself, which has the runtime linked in
+	auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess((*jit)->getDataLayout().getGlobalPrefix());
+	if (!generator)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't search ccc for runtime symbols: " << llvm::toString(generator.takeError()) << "\n";
+		return 1;
+	}
+	llvm::orc::JITDylib& mainDylib = (*jit)->getMainJITDylib();
+	mainDylib.addGenerator(std::move(*generator));
+
+	this->module->setDataLayout((*jit)->getDataLayout());
+	llvm::orc::ThreadSafeModule tsm(std::move(this->module), std::move(this->context));
+	if (llvm::Error err = (*jit)->addLazyIRModule(std::move(tsm)))
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't add module to JIT: " << llvm::toString(std::move(err)) << "\n";
+		return 1;
+	}
+
+	// the main dylib only has call-through stubs, the function bodies sit in
+	// its .impl dylib until something looks them up. Looking up the hot ones
+	// there now gets them compiled on the background threads while main runs.
+	// Without background threads that would just be eager compilation, so don't
+	llvm::orc::ExecutionSession& session = (*jit)->getExecutionSession();
+	llvm::orc::JITDylib* implDylib = session.getJITDylibByName(mainDylib.getName() + ".impl");
+	if (compileThreads > 0 && implDylib != nullptr && !hot.empty())
+	{
+		llvm::orc::SymbolLookupSet symbols;
+		for (auto& name : hot)
+		{
+			symbols.add((*jit)->mangleAndIntern(name), llvm::orc::SymbolLookupFlags::WeaklyReferencedSymbol);
+		}
+		session.lookup(llvm::orc::LookupKind::Static, llvm::orc::makeJITDylibSearchOrder(implDylib), std::move(symbols),
+					   llvm::orc::SymbolState::Ready,
+					   [](llvm::Expected<llvm::orc::SymbolMap> result) {
+						   // best effort, main will compile anything that failed here itself
+						   llvm::consumeError(result.takeError());
+					   },
+					   llvm::orc::NoDependenciesToRegister);
+	}
+
+	auto mainSymbol = (*jit)->lookup("main");
+	if (!mainSymbol)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't compile main: " << llvm::toString(mainSymbol.takeError()) << "\n";
+		return 1;
+	}
+
+	// the program's output goes through printf, don't let it overtake ours
+	std::cout.flush();
+	// functions are compiled as they are first called, so this includes JIT time
+	TraceScope trace("run program");
+	int ret = call_main(mainSymbol->getAddress(), argc);
+	fflush(stdout);
+	return ret;
+}
+
+int call_main(uint64_t address, int argc)
+{
+	if (argc < 0)
 	{
-		// print our generated llvm to stdout
-		this->module->print(llvm::outs(), nullptr);
+		return reinterpret_cast<int (*)()>(address)();
 	}
-	return ec;
+	return reinterpret_cast<int (*)(int)>(address)(argc);
 }
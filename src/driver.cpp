@@ -0,0 +1,602 @@
+/*
+	driver.cpp
+	Drives one or many files through the compiler.
+*/
+#include "headers/driver.hpp"
+#include "headers/astfile.hpp"
+#include "headers/cache.hpp"
+#include "headers/compiler.hpp"
+#include "headers/nodes.hpp"
+#include "headers/common.hpp"
+#include "headers/preprocess.hpp"
+#include "headers/threadpool.hpp"
+#include "headers/consolecolors.hpp"
+#include "headers/intern.hpp"
+#include "headers/trace.hpp"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/raw_os_ostream.h"
+#include "llvm/ADT/SmallString.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <limits.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std::string_literals;
+
+// the formats --emit can generate, in the order they are written. An
+// executable isn't here, it is linked from the object afterwards. An .ast
+// comes from the tree, the rest from the module
+static const struct
+{
+	int kind;
+	const char* extension;
+	const char* phase;		// what --time-report calls writing it
+} emitFormats[] = {
+	{emit_ll, "ll", "dump ll"},
+	{emit_ast, "ast", "dump ast"},
+	{emit_bc, "bc", "dump bc"},
+	{emit_asm, "s", "dump asm"},
+	{emit_obj, "o", "dump obj"},
+};
+
+static std::string executable_path(const std::string& filename)
+{
+	// prog.c becomes prog, anything without an extension gets one so we
+	// don't write over the source
+	size_t dot = filename.rfind('.');
+	size_t slash = filename.rfind('/');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+	{
+		return filename + ".out";
+	}
+	return filename.substr(0, dot);
+}
+
+static std::string runtime_library()
+{
+	// libcccrt.a is built next to ccc, $CCC_RUNTIME can point somewhere else
+	const char* runtime = getenv("CCC_RUNTIME");
+	if (runtime && *runtime)
+	{
+		return runtime;
+	}
+	char self[PATH_MAX];
+	ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+	if (len <= 0)
+	{
+		return "libcccrt.a";
+	}
+	std::string dir(self, len);
+	return dir.substr(0, dir.rfind('/') + 1) + "libcccrt.a";
+}
+
+static int link_executable(const std::string& object, CompileOutput& exe)
+{
+	// LLVM doesn't come with a linker we can call in process, so the object
+	// goes through a temporary file to the system's C compiler ($CC, or cc),
+	// which knows where the C library and startup files are
+	TraceScope trace("link");
+	std::string runtime = runtime_library();
+	if (access(runtime.c_str(), R_OK) != 0)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't find the ccc runtime " << runtime << ", set CCC_RUNTIME to its location\n";
+		return 1;
+	}
+	const char* tmp = getenv("TMPDIR");
+	std::string base = std::string(tmp && *tmp ? tmp : "/tmp") + "/ccc-link-XXXXXX";
+	std::vector<char> objectPath(base.begin(), base.end());
+	objectPath.insert(objectPath.end(), {'.', 'o', '\0'});
+	int fd = mkstemps(objectPath.data(), 2);
+	if (fd < 0)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't create a temporary object file: " << strerror(errno) << "\n";
+		return 1;
+	}
+	bool written = write(fd, object.data(), object.size()) == static_cast<ssize_t>(object.size());
+	close(fd);
+	std::string exePath = std::string(objectPath.data()) + ".out";
+
+	const char* cc = getenv("CC");
+	std::string compiler = cc && *cc ? cc : "cc";
+	std::vector<std::string> args = {compiler, objectPath.data(), runtime, "-o", exePath};
+	std::vector<char*> argv;
+	for (auto& arg : args)
+	{
+		argv.push_back(&arg[0]);
+	}
+	argv.push_back(nullptr);
+
+	int status = 1;
+	pid_t pid;
+	if (!written)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't write the temporary object file " << objectPath.data() << "\n";
+	}
+	else if (posix_spawnp(&pid, compiler.c_str(), nullptr, nullptr, argv.data(), environ) != 0)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't run " << compiler << " to link " << exe.path << "\n";
+	}
+	else if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Linking " << exe.path << " failed\n";
+		status = 1;
+	}
+	else
+	{
+		std::ifstream in(exePath, std::ios::binary);
+		exe.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+		status = in ? 0 : 1;
+	}
+	unlink(objectPath.data());
+	unlink(exePath.c_str());
+	return status;
+}
+
+// Preprocess the job's source into source, which is scanned in place from then on
+static int preprocess_job(const cmd_line_args& cmds, CompileJob& job, std::string& source)
+{
+	const std::string& filename = job.filename;
+	TraceScope trace("preprocess");
+	diag() << "Preprocessing file " << filename << "\n";
+	preprocess pp(cmds.include_dirs);
+	int ret;
+	if (job.hasSource)
+	{
+		ret = pp.preprocess_buffer(job.source.data(), job.source.size(), source, job.path);
+	}
+	else
+	{
+		ret = pp.preprocess_file(job.path.empty() ? filename : job.path, source);
+	}
+	if (ret != 0)
+	{
+		return 1;
+	}
+	if (cmds.keep_pp)
+	{
+		diag() << "Writing preprocessed file " << filename << ".pp\n";
+		job.outputs.push_back({filename + ".pp"s, source});
+	}
+	return 0;
+}
+
+// Everything from the preprocessed source to the tree codegen starts from, in
+// arena. nullptr on error
+static Node* build_ast(const cmd_line_args& cmds, const std::string& filename, std::string& source, AstArena& arena)
+{
+	// show our lexing if we get the lexing flag
+	if (cmds.lexflag)
+	{
+		lex(source, static_cast<lexer_kind>(cmds.lexer));
+	}
+
+	// a source that's been parsed and checked before comes back out of the
+	// cache, whatever flags and formats it's being compiled with this time.
+	// Not when we've been asked to show the parse, or to do it with
+	// something other than the default lexer and parser, since the cache
+	// would skip exactly what that asks for
+	CompilationCache* cache = CompilationCache::get();
+	if (cmds.lexflag || cmds.printflag || cmds.lexer != lexer_flex || cmds.parser != parser_bison)
+	{
+		cache = nullptr;
+	}
+	std::string astKey;
+	Node* root = nullptr;
+	if (cache)
+	{
+		TraceScope lookupTrace("ast cache lookup");
+		astKey = cache->ast_key(source);
+		std::string path = cache->find(astKey);
+		if (!path.empty())
+		{
+			root = load_ast_file(path, arena);
+			if (root == nullptr)
+			{
+				// cut short or damaged, parse it again and store a good one
+				cache->discard(astKey);
+			}
+		}
+	}
+
+	if (root != nullptr)
+	{
+		diag() << "Using cached AST for " << filename << "\n";
+	}
+	else
+	{
+		// parsing
+		diag() << "Parsing file " << filename << "\n";
+		int ret = parse(source, arena, root, static_cast<lexer_kind>(cmds.lexer), static_cast<parser_kind>(cmds.parser));
+		if (ret != 0) {
+			return nullptr;
+		}
+
+		// semantic analysis
+		diag() << "Performing semantic analysis\n";
+		if (!verify_ast(root)) {
+			diag() << "Semantic analysis failed.\n";
+			return nullptr;
+		}
+		if (cache)
+		{
+			cache->store(astKey, save_ast(root, false));
+		}
+	}
+	if (cmds.printflag)
+	{
+		diag() << "Generated AST (pre-optimization):\n";
+		print_ast(root);
+	}
+
+	// optimization
+	if (cmds.optlevel >= 1)
+	{
+		diag() << "Optimizing AST\n";
+		root = optimize(arena, root);
+	}
+	if (cmds.printflag)
+	{
+		diag() << "Generated AST (post-optimization):\n";
+		print_ast(root);
+	}
+	return root;
+}
+
+// The tree from build_ast to an llvm module, nullptr on error
+static std::unique_ptr<CompilationUnit> build_unit(const cmd_line_args& cmds, Node* root)
+{
+	diag() << "Generating IR\n";
+	std::unique_ptr<CompilationUnit> u = compile(root);
+	if (u == nullptr)
+	{
+		diag() << "[" << RED << "ERROR" << RESET << "] Error generating llvm IR\n";
+		return nullptr;
+	}
+	if (cmds.optlevel >= 2 || !cmds.passes.empty())
+	{
+		diag() << "Optimizing IR\n";
+		if (!u->optimize(cmds.optlevel, cmds.sizelevel, cmds.passes))
+		{
+			return nullptr;
+		}
+	}
+	return u;
+}
+
+int compile_file(const cmd_line_args& cmds, CompileJob& job)
+{
+	const std::string& filename = job.filename;
+	TraceScope trace("compile file", "file", filename);
+	// the names this file interns go when it's done, a pool thread compiles many
+	InternScope names;
+
+	// the preprocessed source stays in memory and is scanned from there.
+	// Each thread keeps its buffer around so a busy thread isn't reallocating it every file
+	static thread_local std::string source;
+	if (preprocess_job(cmds, job, source) != 0)
+	{
+		return 1;
+	}
+
+	// an executable is linked from the object, so that is what we generate and cache for it
+	int formats = cmds.emit | ((cmds.emit & emit_exe) ? emit_obj : 0);
+	std::vector<CompileOutput> outputs;
+	for (auto& format : emitFormats)
+	{
+		if (formats & format.kind)
+		{
+			outputs.push_back({filename + "." + format.extension, ""});
+		}
+	}
+
+	// the cache skips everything from here on, unless we've been asked to show
+	// what happens along the way. Every format has to be there, otherwise we
+	// compile and store them all
+	CompilationCache* cache = CompilationCache::get();
+	std::vector<std::string> cacheKeys;
+	bool cachePrintsIR = !cmds.printir || (formats & emit_ll);
+	bool cached = false;
+	if (cache && !cmds.lexflag && !cmds.printflag && cachePrintsIR)
+	{
+		for (auto& format : emitFormats)
+		{
+			if (formats & format.kind)
+			{
+				cacheKeys.push_back(cache->key(source, cmds, format.extension));
+			}
+		}
+		TraceScope lookupTrace("cache lookup");
+		cached = true;
+		for (size_t i = 0; i < outputs.size() && cached; i++)
+		{
+			cached = cache->lookup(cacheKeys[i], outputs[i].data);
+		}
+	}
+
+	if (cached)
+	{
+		diag() << "Using cached output for " << filename << "\n";
+		if (cmds.printir)
+		{
+			diag() << outputs[0].data;	// .ll comes first
+		}
+	}
+	else
+	{
+		// the tree lives in here, and goes away with it all at once
+		AstArena arena;
+		Node* root = build_ast(cmds, filename, source, arena);
+		if (root == nullptr)
+		{
+			return 1;
+		}
+		// there's no need to generate any code for an .ast on its own
+		std::unique_ptr<CompilationUnit> u;
+		if ((formats & ~emit_ast) || cmds.printir)
+		{
+			u = build_unit(cmds, root);
+			if (u == nullptr)
+			{
+				return 1;
+			}
+		}
+		if (cmds.printir)
+		{
+			// print our generated llvm along with the rest of this file's output
+			llvm::raw_os_ostream outs(diag());
+			u->dump(outs);
+		}
+		// every format comes out of the same module, there is only one codegen pass
+		size_t index = 0;
+		for (auto& format : emitFormats)
+		{
+			if (!(formats & format.kind))
+			{
+				continue;
+			}
+			CompileOutput& output = outputs[index];
+			TraceScope dumpTrace(format.phase);
+			if (format.kind == emit_ast)
+			{
+				output.data = save_ast(root, cmds.optlevel >= 1);
+			}
+			else if (format.kind == emit_asm || format.kind == emit_obj)
+			{
+				llvm::SmallString<0> buffer;
+				llvm::raw_svector_ostream stream(buffer);
+				if (!u->dump_native(stream, format.kind == emit_asm))
+				{
+					return 1;
+				}
+				output.data.assign(buffer.begin(), buffer.end());
+			}
+			else
+			{
+				llvm::raw_string_ostream stream(output.data);
+				if (format.kind == emit_bc)
+				{
+					u->dump_bitcode(stream);
+				}
+				else
+				{
+					u->dump(stream);
+				}
+				stream.flush();
+			}
+			if (index < cacheKeys.size())
+			{
+				cache->store(cacheKeys[index], output.data);
+			}
+			index++;
+		}
+	}
+
+	if (cmds.emit & emit_exe)
+	{
+		// the object is the last thing we generated
+		CompileOutput exe { executable_path(filename), "", true };
+		if (link_executable(outputs.back().data, exe) != 0)
+		{
+			return 1;
+		}
+		if (!(cmds.emit & emit_obj))
+		{
+			outputs.pop_back();
+		}
+		outputs.push_back(std::move(exe));
+	}
+	for (auto& output : outputs)
+	{
+		job.outputs.push_back(std::move(output));
+	}
+
+	diag() << "[" << GREEN << "SUCCESS" << RESET << "] All done!\n";
+	return 0;
+}
+
+int run_file(const cmd_line_args& cmds)
+{
+	// compile the first file and run it, the rest of the command line is its arguments
+	InternScope names;
+	CompileJob job;
+	job.filename = cmds.filenames[0];
+	std::string source;
+	std::unique_ptr<CompilationUnit> u;
+	try
+	{
+		if (preprocess_job(cmds, job, source) != 0 || write_outputs(job) != 0)
+		{
+			return 1;
+		}
+		AstArena arena;
+		Node* root = build_ast(cmds, job.filename, source, arena);
+		if (root == nullptr)
+		{
+			return 1;
+		}
+		u = build_unit(cmds, root);
+	}
+	catch (const CompileError&)
+	{
+		return 1;
+	}
+	if (u == nullptr)
+	{
+		return 1;
+	}
+	if (cmds.printir)
+	{
+		llvm::raw_os_ostream outs(diag());
+		u->module->print(outs, nullptr);
+	}
+	// -j picks how many threads compile functions in the background while it runs
+	unsigned compileThreads = cmds.jobs > 0 ? cmds.jobs : std::max(1u, std::thread::hardware_concurrency());
+	std::vector<std::string> args(cmds.filenames.begin() + 1, cmds.filenames.end());
+	return u->run(args, compileThreads, cmds.tiered);
+}
+
+int write_outputs(const CompileJob& job)
+{
+	for (auto& output : job.outputs)
+	{
+		std::ofstream out(output.path, std::ios::binary);
+		if (!out.is_open())
+		{
+			diag() << "[" << RED << "error" << RESET << "] Problem opening file for writing " << output.path << "\n";
+			return 1;
+		}
+		out.write(output.data.data(), output.data.size());
+		out.close();
+		if (output.executable)
+		{
+			chmod(output.path.c_str(), 0755);
+		}
+	}
+	return 0;
+}
+
+static int run_job(const cmd_line_args& cmds, CompileJob& job, bool writeOutputs)
+{
+	// point diag() at this job's log for as long as we are working on it
+	auto start = std::chrono::steady_clock::now();
+	std::ostream* previous = set_diag(&job.log);
+	int status;
+	try
+	{
+		status = compile_file(cmds, job);
+		if (status == 0 && writeOutputs)
+		{
+			status = write_outputs(job);
+		}
+	}
+	catch (const CompileError&)
+	{
+		status = 1;
+	}
+	catch (const std::exception& e)
+	{
+		job.log << "[" << RED << "error" << RESET << "] " << e.what() << "\n";
+		status = 1;
+	}
+	set_diag(previous);
+	job.micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	return status;
+}
+
+int run_jobs(ThreadPool& pool, const cmd_line_args& cmds, std::vector<std::unique_ptr<CompileJob>>& jobs,
+			 bool writeOutputs, const std::function<void(CompileJob&)>& finished)
+{
+	std::mutex lock;
+	std::condition_variable done;
+	for (auto& job : jobs)
+	{
+		CompileJob* j = job.get();
+		pool.submit([&cmds, &lock, &done, j, writeOutputs] {
+			int status = run_job(cmds, *j, writeOutputs);
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				j->status = status;
+				j->done = true;
+			}
+			done.notify_all();
+		});
+	}
+
+	// hand back each job in order as soon as it and everything before it is done
+	int failed = 0;
+	for (auto& job : jobs)
+	{
+		{
+			std::unique_lock<std::mutex> guard(lock);
+			done.wait(guard, [&job] { return job->done; });
+		}
+		if (job->status != 0)
+		{
+			failed++;
+		}
+		finished(*job);
+	}
+	return failed;
+}
+
+int compile_files(const cmd_line_args& cmds)
+{
+	size_t count = cmds.filenames.size();
+	if (count == 1 && cmds.jobs == 1)
+	{
+		// nothing to run in parallel, let the output stream straight through
+		CompileJob job;
+		job.filename = cmds.filenames[0];
+		try
+		{
+			if (compile_file(cmds, job) != 0)
+			{
+				return 1;
+			}
+			return write_outputs(job);
+		}
+		catch (const CompileError&)
+		{
+			return 1;
+		}
+	}
+
+	std::vector<std::unique_ptr<CompileJob>> jobs;
+	for (auto& filename : cmds.filenames)
+	{
+		jobs.push_back(std::make_unique<CompileJob>());
+		jobs.back()->filename = filename;
+	}
+
+	ThreadPool pool(cmds.jobs);
+	int failed = run_jobs(pool, cmds, jobs, true, [](CompileJob& job) {
+		std::cout << job.log.str();
+		std::cout.flush();
+		// we're done with it, give the memory back
+		job.log.str(std::string());
+		job.outputs.clear();
+	});
+
+	if (failed)
+	{
+		std::cout << "[" << RED << "ERROR" << RESET << "] " << failed << " of " << count << " files failed to compile\n";
+		return 1;
+	}
+	std::cout << "[" << GREEN << "SUCCESS" << RESET << "] Compiled " << count << " files\n";
+	return 0;
+}
@@ -0,0 +1,440 @@
+/*
+	flatast.cpp
+*/
+#include "headers/flatast.hpp"
+#include "headers/walker.hpp"
+#include <cstring>
+
+bool is_expression(NodeKind kind)
+{
+	switch (kind)
+	{
+		case NodeKind::Variable:
+		case NodeKind::BinaryOp:
+		case NodeKind::RelationalOp:
+		case NodeKind::LogicalOp:
+		case NodeKind::FuncCall:
+		case NodeKind::ConstantBool:
+		case NodeKind::ConstantInt:
+		case NodeKind::ConstantFloat:
+		case NodeKind::ConstantChar:
+		case NodeKind::ConstantDouble:
+		case NodeKind::Unary:
+		case NodeKind::Ternary:
+		case NodeKind::CastExpression:
+			return true;
+		default:
+			return false;
+	}
+}
+
+namespace
+{
+
+class Flattener final : public TreeWalker<Flattener>
+{
+private:
+	// what each finished child flattened to, in order, until its parent takes
+	// them. Empty slots get a noNode so every parent finds as many as it has
+	std::vector<NodeIndex> done;
+	std::vector<NodeIndex> starts;	// where the subtree of each node we're in starts
+
+	// the flattened children of n, still on top of done
+	const NodeIndex* children(Node* n) const
+	{
+		return this->done.data() + this->done.size() - node_child_count(n);
+	}
+
+	NodeIndex emit(Node* n, uint8_t op, TypeName type, uint8_t flags, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0)
+	{
+		NodeIndex at = this->flat.kinds.size();
+		this->flat.kinds.push_back(n->kind);
+		this->flat.ops.push_back(op);
+		this->flat.types.push_back(type);
+		this->flat.flags.push_back(flags);
+		this->flat.locations.push_back(n->location);
+		this->flat.firsts.push_back(this->starts.back());
+		this->flat.a.push_back(a);
+		this->flat.b.push_back(b);
+		this->flat.c.push_back(c);
+		// n takes the place of its children for its own parent
+		this->starts.pop_back();
+		this->done.resize(this->done.size() - node_child_count(n));
+		this->done.push_back(at);
+		return at;
+	}
+
+	NodeIndex emit_expr(ExpressionNode* n, uint8_t op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0)
+	{
+		return this->emit(n, op, n->evaluatedType, n->isConstant ? FlatAst::constant : 0, a, b, c);
+	}
+
+	uint32_t list(Node* n)
+	{
+		// the children are all flattened by the time their parent is, so
+		// none of their own lists can land in the middle of this one
+		const NodeIndex* items = this->children(n);
+		uint32_t count = node_child_count(n);
+		uint32_t at = this->flat.lists.size();
+		this->flat.lists.push_back(count);
+		this->flat.lists.insert(this->flat.lists.end(), items, items + count);
+		return at;
+	}
+
+public:
+	FlatAst flat;
+
+	bool enter(Node* n)
+	{
+		this->starts.push_back(this->flat.kinds.size());
+		return true;
+	}
+
+	bool before_child(Node* n, uint32_t slot)
+	{
+		if (node_child(n, slot) == nullptr)
+		{
+			this->done.push_back(noNode);
+		}
+		return true;
+	}
+
+	void leave(VariableNode* n)
+	{
+		this->emit_expr(n, 0, n->name.id, n->slot);
+	}
+
+	void leave(DeclarationNode* n)
+	{
+		this->emit(n, 0, n->t, n->isConstant ? FlatAst::constant : 0, n->name.id, n->slot);
+	}
+
+	void leave(DeclAndAssignNode* n)
+	{
+		const NodeIndex* kids = this->children(n);
+		this->emit(n, 0, TypeName::tVoid, 0, kids[0], kids[1]);
+	}
+
+	void leave(BinaryOpNode* n)
+	{
+		const NodeIndex* kids = this->children(n);
+		this->emit_expr(n, static_cast<uint8_t>(n->op), kids[0], kids[1]);
+	}
+
+	void leave(RelationalOpNode* n)
+	{
+		const NodeIndex* kids = this->children(n);
+		this->emit_expr(n, static_cast<uint8_t>(n->op), kids[0], kids[1]);
+	}
+
+	void leave(LogicalOpNode* n)
+	{
+		const NodeIndex* kids = this->children(n);
+		this->emit_expr(n, static_cast<uint8_t>(n->op), kids[0], kids[1]);
+	}
+
+	void leave(RootNode* n)
+	{
+		this->emit(n, 0, TypeName::tVoid, 0, this->list(n));
+	}
+
+	void leave(BlockNode* n)
+	{
+		this->emit(n, 0, TypeName::tVoid, 0, this->list(n));
+	}
+
+	void leave(FuncDefnNode* n)
+	{
+		const NodeIndex* kids = this->children(n);
+		this->emit(n, 0, TypeName::tVoid, 0, kids[0], kids[1], n->frameSlots);
+	}
+
+	void leave(FuncDeclNode* n)
+	{
+		this->emit(n, 0, n->t, 0, n->name.id, this->list(n), n->funcId);
+	}
+
+	void leave(FuncCallNode* n)
+	{
+		this->emit_expr(n, 0, n->name.id, this->list(n), n->funcId);
+	}
+
+	void leave(AssignmentNode* n)
+	{
+		this->emit(n, 0, TypeName::tVoid, 0, n->name.id, this->children(n)[0], n->slot);
+	}
+
+	void leave(AugmentedAssignmentNode* n)
+	{
+		this->emit(n, static_cast<uint8_t>(n->op), TypeName::tVoid, 0, n->name.id, this->children(n)[0], n->slot);
+	}
+
+	void leave(ConstantBoolNode* n)
+	{
+		this->emit_expr(n, 0, n->boolValue);
+	}
+
+	void leave(ConstantIntNode* n)
+	{
+		this->emit_expr(n, 0, static_cast<uint32_t>(n->intValue));
+	}
+
+	void leave(ConstantFloatNode* n)
+	{
+		uint32_t bits;
+		memcpy(&bits, &n->floatValue, sizeof(bits));
+		this->emit_expr(n, 0, bits);
+	}
+
+	void leave(ConstantCharNode* n)
+	{
+		this->emit_expr(n, 0, static_cast<unsigned char>(n->charValue));
+	}
+
+	void leave(ConstantDoubleNode* n)
+	{
+		uint64_t bits;
+		memcpy(&bits, &n->doubleValue, sizeof(bits));
+		this->emit_expr(n, 0, static_cast<uint32_t>(bits), static_cast<uint32_t>(bits >> 32));
+	}
+
+	void leave(IfNode* n)
+	{
+		const NodeIndex* kids = this->children(n);
+		this->emit(n, 0, TypeName::tVoid, 0, kids[0], kids[1]);
+	}
+
+	void leave(ForNode* n)
+	{
+		// a list of all four, whether they're there or not
+		this->emit(n, 0, TypeName::tVoid, 0, this->list(n));
+	}
+
+	void leave(WhileNode* n)
+	{
+		const NodeIndex* kids = this->children(n);
+		this->emit(n, 0, TypeName::tVoid, 0, kids[0], kids[1]);
+	}
+
+	void leave(UnaryNode* n)
+	{
+		this->emit_expr(n, static_cast<uint8_t>(n->op), this->children(n)[0]);
+	}
+
+	void leave(TernaryNode* n)
+	{
+		const NodeIndex* kids = this->children(n);
+		this->emit_expr(n, 0, kids[0], kids[1], kids[2]);
+	}
+
+	void leave(CastExpressionNode* n)
+	{
+		this->emit_expr(n, static_cast<uint8_t>(n->t), this->children(n)[0]);
+	}
+
+	void leave(ReturnNode* n)
+	{
+		this->emit(n, 0, TypeName::tVoid, 0, this->children(n)[0]);
+	}
+
+	void leave(BreakNode* n)
+	{
+		this->emit(n, 0, TypeName::tVoid, 0);
+	}
+
+	void leave(ContinueNode* n)
+	{
+		this->emit(n, 0, TypeName::tVoid, 0);
+	}
+
+	void leave(ExpressionStatementNode* n)
+	{
+		this->emit(n, 0, TypeName::tVoid, 0, this->children(n)[0]);
+	}
+};
+
+}
+
+FlatAst to_flat(Node* root)
+{
+	Flattener flattener;
+	flattener.walk(root);
+	flattener.flat.lines = cast<RootNode>(root)->lines;
+	return std::move(flattener.flat);
+}
+
+Node* from_flat(const FlatAst& flat, AstArena& arena)
+{
+	// post-order means every child is built before its parent needs it, so
+	// this is one pass front to back with no recursion
+	std::vector<Node*> built(flat.size());
+	auto child = [&](NodeIndex i) -> Node* { return i == noNode ? nullptr : built[i]; };
+	auto expr = [&](NodeIndex i) { return static_cast<ExpressionNode*>(child(i)); };
+	auto list = [&](auto& into, uint32_t at) {
+		typedef typename std::remove_reference<decltype(into[0])>::type Item;
+		for (const NodeIndex* i = flat.list_begin(at); i != flat.list_end(at); ++i)
+		{
+			into.push_back(static_cast<Item>(built[*i]));
+		}
+	};
+
+	for (NodeIndex i = 0; i < flat.size(); i++)
+	{
+		uint32_t a = flat.a[i];
+		uint32_t b = flat.b[i];
+		uint32_t c = flat.c[i];
+		bool constant = flat.flags[i] & FlatAst::constant;
+		Node* n = nullptr;
+		switch (flat.kinds[i])
+		{
+			case NodeKind::Variable:
+			{
+				VariableNode* v = arena.make<VariableNode>(Symbol {a});
+				v->slot = b;
+				n = v;
+				break;
+			}
+			case NodeKind::Declaration:
+			{
+				DeclarationNode* d = arena.make<DeclarationNode>(flat.types[i], Symbol {a}, constant);
+				d->slot = b;
+				n = d;
+				break;
+			}
+			case NodeKind::DeclAndAssign:
+				n = arena.make<DeclAndAssignNode>(cast<DeclarationNode>(built[a]), expr(b));
+				break;
+			case NodeKind::BinaryOp:
+				n = arena.make<BinaryOpNode>(static_cast<BinaryOps>(flat.ops[i]), expr(a), expr(b));
+				break;
+			case NodeKind::RelationalOp:
+				n = arena.make<RelationalOpNode>(static_cast<RelationalOps>(flat.ops[i]), expr(a), expr(b));
+				break;
+			case NodeKind::LogicalOp:
+				n = arena.make<LogicalOpNode>(static_cast<BinaryOps>(flat.ops[i]), expr(a), expr(b));
+				break;
+			case NodeKind::Root:
+			{
+				ArenaVector<Node*> funcs(arena);
+				list(funcs, a);
+				RootNode* r = arena.make<RootNode>(funcs);
+				r->lines = flat.lines;
+				n = r;
+				break;
+			}
+			case NodeKind::Block:
+			{
+				ArenaVector<Node*> stmts(arena);
+				list(stmts, a);
+				n = arena.make<BlockNode>(stmts);
+				break;
+			}
+			case NodeKind::FuncDefn:
+			{
+				FuncDefnNode* f = arena.make<FuncDefnNode>(cast<FuncDeclNode>(built[a]), built[b]);
+				f->frameSlots = c;
+				n = f;
+				break;
+			}
+			case NodeKind::FuncDecl:
+			{
+				ArenaVector<DeclarationNode*> params(arena);
+				list(params, b);
+				FuncDeclNode* f = arena.make<FuncDeclNode>(flat.types[i], Symbol {a}, params);
+				f->funcId = c;
+				n = f;
+				break;
+			}
+			case NodeKind::FuncCall:
+			{
+				ArenaVector<ExpressionNode*> args(arena);
+				list(args, b);
+				FuncCallNode* f = arena.make<FuncCallNode>(Symbol {a}, args);
+				f->funcId = c;
+				n = f;
+				break;
+			}
+			case NodeKind::Assignment:
+			{
+				AssignmentNode* s = arena.make<AssignmentNode>(Symbol {a}, expr(b));
+				s->slot = c;
+				n = s;
+				break;
+			}
+			case NodeKind::AugmentedAssignment:
+			{
+				AugmentedAssignmentNode* s = arena.make<AugmentedAssignmentNode>(
+					static_cast<AugmentedAssignOps>(flat.ops[i]), Symbol {a}, expr(b));
+				s->slot = c;
+				n = s;
+				break;
+			}
+			case NodeKind::ConstantBool:
+				n = arena.make<ConstantBoolNode>(a != 0);
+				break;
+			case NodeKind::ConstantInt:
+				n = arena.make<ConstantIntNode>(static_cast<int>(a));
+				break;
+			case NodeKind::ConstantFloat:
+			{
+				float value;
+				memcpy(&value, &a, sizeof(value));
+				n = arena.make<ConstantFloatNode>(value);
+				break;
+			}
+			case NodeKind::ConstantChar:
+				n = arena.make<ConstantCharNode>(static_cast<char>(a));
+				break;
+			case NodeKind::ConstantDouble:
+			{
+				uint64_t bits = (static_cast<uint64_t>(b) << 32) | a;
+				double value;
+				memcpy(&value, &bits, sizeof(value));
+				n = arena.make<ConstantDoubleNode>(value);
+				break;
+			}
+			case NodeKind::If:
+				n = arena.make<IfNode>(expr(a), built[b]);
+				break;
+			case NodeKind::For:
+			{
+				const NodeIndex* parts = flat.list_begin(a);
+				n = arena.make<ForNode>(child(parts[0]), expr(parts[1]), child(parts[2]), child(parts[3]));
+				break;
+			}
+			case NodeKind::While:
+				n = arena.make<WhileNode>(expr(a), built[b]);
+				break;
+			case NodeKind::Unary:
+				n = arena.make<UnaryNode>(static_cast<UnaryOps>(flat.ops[i]), expr(a));
+				break;
+			case NodeKind::Ternary:
+				n = arena.make<TernaryNode>(expr(a), expr(b), expr(c));
+				break;
+			case NodeKind::CastExpression:
+				n = arena.make<CastExpressionNode>(static_cast<TypeName>(flat.ops[i]), expr(a));
+				break;
+			case NodeKind::Return:
+				n = arena.make<ReturnNode>(expr(a));
+				break;
+			case NodeKind::Break:
+				n = arena.make<BreakNode>();
+				break;
+			case NodeKind::Continue:
+				n = arena.make<ContinueNode>();
+				break;
+			case NodeKind::ExpressionStatement:
+				n = arena.make<ExpressionStatementNode>(expr(a));
+				break;
+		}
+		n->location = flat.locations[i];
+		if (is_expression(flat.kinds[i]))
+		{
+			ExpressionNode* e = static_cast<ExpressionNode*>(n);
+			e->evaluatedType = flat.types[i];
+			e->isConstant = constant;
+		}
+		built[i] = n;
+	}
+	return built.empty() ? nullptr : built.back();
+}
@@ -0,0 +1,127 @@
+/*
+	arena.hpp
+	Bump pointer allocation for the AST.
+
+	Every node of one compilation is placement constructed into a few large
+	chunks that the arena owns, and the whole tree goes away with them in
+	one free per chunk. Nothing in the arena has its destructor run, so
+	only trivially destructible types can go in it: child lists are
+	ArenaVectors and names are interned Symbols.
+*/
+
+#ifndef CCC_ARENA_HPP_INCLUDED
+#define CCC_ARENA_HPP_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+class AstArena
+{
+private:
+	std::vector<char*> chunks;
+	char* next = nullptr;
+	char* end = nullptr;
+	size_t reserved = 0;
+
+	void* grow(size_t size, size_t align);
+
+public:
+	AstArena() = default;
+	~AstArena();
+
+	AstArena(const AstArena&) = delete;
+	AstArena& operator=(const AstArena&) = delete;
+
+	void* allocate(size_t size, size_t align)
+	{
+		// the common case, inlined everywhere a node gets made
+		uintptr_t at = (reinterpret_cast<uintptr_t>(this->next) + align - 1) & ~(uintptr_t)(align - 1);
+		if (at + size > reinterpret_cast<uintptr_t>(this->end))
+		{
+			return this->grow(size, align);
+		}
+		this->next = reinterpret_cast<char*>(at + size);
+		return reinterpret_cast<void*>(at);
+	}
+
+	template <typename T, typename... Args> T* make(Args&&... args)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "the arena never runs destructors");
+		return new (this->allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+	}
+
+	size_t chunk_count() const { return this->chunks.size(); }
+	size_t bytes_reserved() const { return this->reserved; }
+};
+
+template <typename T> class ArenaVector
+{
+	// a vector whose elements live in an arena. It doesn't own them, so
+	// copying one copies the handle; when it grows the old elements are
+	// left behind in the arena, which at most doubles what the list takes
+	static_assert(std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+		"ArenaVector moves its elements with memcpy and never destroys them");
+
+private:
+	AstArena* arena = nullptr;
+	T* items = nullptr;
+	uint32_t count = 0;
+	uint32_t capacity = 0;
+
+	void reserve_more(uint32_t wanted)
+	{
+		uint32_t grown = this->capacity ? this->capacity * 2 : 4;
+		while (grown < wanted)
+		{
+			grown *= 2;
+		}
+		T* moved = static_cast<T*>(this->arena->allocate(sizeof(T) * grown, alignof(T)));
+		if (this->count)
+		{
+			memcpy(moved, this->items, sizeof(T) * this->count);
+		}
+		this->items = moved;
+		this->capacity = grown;
+	}
+
+public:
+	ArenaVector() = default;
+	explicit ArenaVector(AstArena& arena) : arena(&arena) {}
+
+	void push_back(T item)
+	{
+		if (this->count == this->capacity)
+		{
+			this->reserve_more(this->count + 1);
+		}
+		this->items[this->count++] = item;
+	}
+
+	// replaces everything with the elements of [first, last), which can be
+	// any other list as long as it doesn't overlap this one
+	template <typename It> void assign(It first, It last)
+	{
+		this->count = 0;
+		for (; first != last; ++first)
+		{
+			this->push_back(*first);
+		}
+	}
+
+	void clear() { this->count = 0; }
+	size_t size() const { return this->count; }
+	bool empty() const { return this->count == 0; }
+	T& operator[](size_t i) { return this->items[i]; }
+	const T& operator[](size_t i) const { return this->items[i]; }
+	T* begin() { return this->items; }
+	T* end() { return this->items + this->count; }
+	const T* begin() const { return this->items; }
+	const T* end() const { return this->items + this->count; }
+};
+
+#endif // CCC_ARENA_HPP_INCLUDED
@@ -1,14 +1,59 @@
 #ifndef CCC_ARGPARSE_HPP_INCLUDED
 #define CCC_ARGPARSE_HPP_INCLUDED
 
+#include <string>
+#include <vector>
+
+#define CCC_VERSION "0.1"
+
+// output formats for --emit, any combination of them can be asked for
+enum emit_kind
+{
+	emit_ll = 1,					// textual IR, filename.ll
+	emit_bc = 2,					// bitcode, filename.bc
+	emit_asm = 4,					// native assembly, filename.s
+	emit_obj = 8,					// native object, filename.o
+	emit_exe = 16,					// executable linked with the runtime, filename without its extension
+	emit_ast = 32,					// the checked (and at -o1 optimized) tree, filename.ast
+};
+
+// which scanner turns the source into tokens, for --lexer
+enum lexer_kind
+{
+	lexer_flex,						// flex's, generated from lexer.l
+	lexer_dfa,						// the hand-written one in scanner.cpp
+};
+
+// which parser builds the tree, for --parser
+enum parser_kind
+{
+	parser_bison,					// bison's, generated from parser.y
+	parser_pratt,					// the hand-written one in pratt.cpp
+};
+
 struct cmd_line_args
 {
 	int printflag = 0;
 	int lexflag = 0;
+	int lexer = lexer_flex;
+	int parser = parser_bison;
 	int printir = 0;
-	int optlevel = 1;
+	int optlevel = 1;				// 0 nothing, 1 AST folding, 2 and 3 also run LLVM's pipeline
+	int sizelevel = 0;				// 1 for -Os and 2 for -Oz, which optimize for size at level 2
+	std::string passes;				// a custom LLVM pass pipeline, run instead of the default one
 	int keep_pp = 0;
-	char* filename = nullptr;
+	std::vector<std::string> include_dirs;	// where #include looks for headers, from -I
+	int jobs = 1;					// 0 means one per hardware thread
+	int server = 0;					// run as a compile server
+	int client = 0;					// send this compile to a running server
+	int server_stats = 0;			// ask a running server for its statistics
+	int cache_stats = 0;			// show what's in the compilation cache
+	int run = 0;					// JIT the first file and run it, the other "filenames" are its arguments
+	int emit = emit_ll;
+	int tiered = 0;					// with run, start unoptimized and recompile hot functions at -O3
+	int time_report = 0;			// print how long each phase took
+	std::string trace_file;			// write a Chrome trace of the phases here
+	std::vector<std::string> filenames;
 };
 
 int parse_commands(int, char**, cmd_line_args*);
@@ -0,0 +1,31 @@
+/*
+	astfile.hpp
+	Checked trees saved to disk, for --emit=ast-bin and the compilation cache.
+
+	An .ast file is a FlatAst written out array by array behind a small
+	header. Nodes only refer to each other by index, so the file means the
+	same wherever it's mapped, and loading it is a memcpy per array and one
+	pass of from_flat, with no lexing, parsing or verify_ast. Names are kept
+	as strings, since Symbols are only good on the thread that interned them,
+	and the line table comes along so diagnostics still have line numbers.
+*/
+
+#ifndef CCC_ASTFILE_HPP_INCLUDED
+#define CCC_ASTFILE_HPP_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include "nodes.hpp"
+
+// the bytes of an .ast file for a tree verify_ast accepted. optimized
+// records whether optimize has been over it as well
+std::string save_ast(Node* root, bool optimized);
+// builds the tree in an .ast file back up in arena, nullptr if data isn't
+// a whole file from this version of ccc or doesn't hold a tree. Every
+// child, list, name and line index is checked, and every frame slot and
+// function id, so nothing in the file can send codegen out of bounds
+Node* load_ast(const char* data, size_t size, AstArena& arena, bool* optimized = nullptr);
+// maps the file at path and loads it
+Node* load_ast_file(const std::string& path, AstArena& arena, bool* optimized = nullptr);
+
+#endif // CCC_ASTFILE_HPP_INCLUDED
@@ -0,0 +1,51 @@
+/*
+	cache.hpp
+	On-disk compilation cache.
+
+	Entries are keyed by a hash of the preprocessed source, the flags that
+	change the generated code and the compiler build, so an unchanged file
+	skips everything after preprocessing. The checked AST of each source is
+	kept as well, so a file compiled again with other flags or formats
+	still skips parsing and verify_ast. The cache lives in $CCC_CACHE_DIR
+	and is off when that isn't set. Any number of ccc processes can share it.
+*/
+
+#ifndef CCC_CACHE_HPP_INCLUDED
+#define CCC_CACHE_HPP_INCLUDED
+
+#include "argsparse.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+class CompilationCache
+{
+private:
+	std::string dir;
+	uint64_t maxBytes;			// evict least recently used entries past this ($CCC_CACHE_SIZE)
+	std::string compilerStamp;	// changes whenever ccc itself does
+
+	CompilationCache(std::string dir);
+	std::string entry_path(const std::string& key);
+	uint64_t update_stats(int64_t hits, int64_t misses, int64_t stores, int64_t evictions, int64_t bytes, bool setBytes = false);
+	void evict();
+
+public:
+	// The process wide cache, or nullptr if caching is off
+	static CompilationCache* get();
+
+	std::string key(const std::string& source, const cmd_line_args& cmds, const char* format);
+	// the checked tree doesn't depend on any flags, only on the source
+	std::string ast_key(const std::string& source);
+	bool lookup(const std::string& key, std::string& data);
+	// like lookup, but hands back where the entry is for the caller to map.
+	// Empty if there isn't one
+	std::string find(const std::string& key);
+	// an entry find handed out that turned out to be no good. It goes, and
+	// counts as a miss rather than a hit
+	void discard(const std::string& key);
+	void store(const std::string& key, const std::string& data);
+	void print_stats(std::ostream& out);
+};
+
+#endif // CCC_CACHE_HPP_INCLUDED
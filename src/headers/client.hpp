@@ -0,0 +1,15 @@
+/*
+	client.hpp
+	Talks to a running compile server (see server.hpp).
+*/
+
+#ifndef CCC_CLIENT_HPP_INCLUDED
+#define CCC_CLIENT_HPP_INCLUDED
+
+#include "argsparse.hpp"
+
+// Forward this command line to a running server, print the diagnostics it
+// sends back and write out the files it produced. Returns the exit code for ccc.
+int run_client(const cmd_line_args& cmds);
+
+#endif // CCC_CLIENT_HPP_INCLUDED
@@ -8,6 +8,8 @@
 
 #include <memory>
 #include <string>
+#include <ostream>
+#include <exception>
 
 
 // templated helper functions for optimization of AST
@@ -155,5 +157,21 @@ enum class AugmentedAssignOps
 };
 std::string AugmentedAssignOpsString(AugmentedAssignOps a);
 
+// Everything a compilation prints (errors, AST dumps, lexer output, ...)
+// goes through diag(). This is std::cout unless the current thread has
+// redirected it, which is how files compiled in parallel keep their
+// output apart.
+std::ostream& diag();
+std::ostream* set_diag(std::ostream* stream);
+
+// Thrown by fatal_error() to abandon the current compilation. The driver
+// catches it and reports the file as failed instead of exiting.
+class CompileError : public std::exception
+{
+public:
+	const char* what() const noexcept override { return "compilation failed"; }
+};
+[[noreturn]] void fatal_error();
+
 #endif // CCC_COMMON_HPP_INCLUDED
 
@@ -1,26 +1,41 @@
 #ifndef CCC_COMPILER_HPP_INCLUDED
 #define CCC_COMPILER_HPP_INCLUDED
 
+#include "argsparse.hpp"
 #include "llvm/Support/Error.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Passes/OptimizationLevel.h"
+#include "llvm/Support/raw_ostream.h"
+#include <cstdint>
 #include <string>
+#include <vector>
 #include <memory>
 #include <optional>
 #include <functional>
 #include <system_error>
 #include <string>
 
+namespace llvm { class TargetMachine; }
+
 class Node;
+class AstArena;
 class CompilationUnit;
 
-int lex(const std::string&);
-int parse(const std::string&, std::unique_ptr<Node>&);
+int lex(std::string&, lexer_kind = lexer_flex);
+// the tree belongs to the arena, and is only good for as long as it is
+int parse(std::string&, AstArena&, Node*&, lexer_kind = lexer_flex, parser_kind = parser_bison);
 bool verify_ast(Node*);
-std::unique_ptr<Node> optimize(std::unique_ptr<Node>);
+Node* optimize(AstArena&, Node*);
 void print_ast(Node*);
+// needs a tree that verify_ast has accepted, which is what resolves every
+// variable to a frame slot and every call to a function
 std::unique_ptr<CompilationUnit> compile(Node*);
+bool optimize_module(llvm::Module&, llvm::TargetMachine*, llvm::OptimizationLevel, const std::string& pipeline = "");
+// call a JIT compiled main at address. argc is what an int main(int argc)
+// gets, or -1 for a main that takes nothing
+int call_main(uint64_t address, int argc);
 
 class CompilationUnit {
 public:
@@ -28,7 +43,11 @@ public:
 
 	CompilationUnit();
 	bool process(Node*);
-	std::error_code dump(std::string, int);
+	bool optimize(int level, int sizeLevel, const std::string& pipeline);
+	void dump(llvm::raw_ostream&);
+	void dump_bitcode(llvm::raw_ostream&);
+	bool dump_native(llvm::raw_pwrite_stream&, bool assembly);
+	int run(const std::vector<std::string>&, unsigned compileThreads, bool tiered);
 
 	std::unique_ptr<llvm::LLVMContext> context;
 	llvm::IRBuilder<> builder;
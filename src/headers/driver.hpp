@@ -0,0 +1,67 @@
+/*
+	driver.hpp
+	Runs the compilation pipeline over the files given on the command line.
+*/
+
+#ifndef CCC_DRIVER_HPP_INCLUDED
+#define CCC_DRIVER_HPP_INCLUDED
+
+#include "argsparse.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// A file the compiler produced, kept in memory until someone writes it out
+struct CompileOutput
+{
+	std::string path;
+	std::string data;
+	bool executable = false;	// written with the execute bits set
+};
+
+// Everything about compiling one file
+struct CompileJob
+{
+	std::string filename;		// name used in messages and for naming outputs
+	std::string path;			// where to read the source from, if it isn't inline
+	std::string source;			// inline source, used when hasSource is set
+	bool hasSource = false;
+
+	std::ostringstream log;		// everything diag() printed while compiling
+	std::vector<CompileOutput> outputs;
+	int status = 0;
+	bool done = false;
+	uint64_t micros = 0;		// how long compiling took, when run through run_jobs
+};
+
+// Preprocess, parse, verify, optimize and generate IR for a single job.
+// Output files are collected in job.outputs rather than written. Everything
+// printed goes through diag(). Returns 0 on success.
+int compile_file(const cmd_line_args& cmds, CompileJob& job);
+
+// Compile the first file in cmds.filenames and run its main function in
+// process with the JIT. Everything after the file name is passed on to it.
+// Returns main's return value.
+int run_file(const cmd_line_args& cmds);
+
+// Write out everything a job produced, reporting problems through diag()
+int write_outputs(const CompileJob& job);
+
+// Run every job on the pool with diag() pointed at the job's log.
+// finished(job) is called on this thread for each job in order, as soon as it
+// and everything before it is done, so results come out in a fixed order no
+// matter how the work was scheduled. Returns the number of failed jobs.
+int run_jobs(ThreadPool& pool, const cmd_line_args& cmds, std::vector<std::unique_ptr<CompileJob>>& jobs,
+			 bool writeOutputs, const std::function<void(CompileJob&)>& finished);
+
+// Compile every file in cmds.filenames using up to cmds.jobs threads. Each
+// file's output is printed in command line order. Returns 0 if every file
+// compiled.
+int compile_files(const cmd_line_args& cmds);
+
+#endif // CCC_DRIVER_HPP_INCLUDED
@@ -0,0 +1,87 @@
+/*
+	flatast.hpp
+	The AST as a structure of arrays.
+
+	A FlatAst keeps every node as an index into a few parallel arrays, with
+	children referred to by 32 bit index instead of by pointer, so a node
+	costs 20 bytes spread over arrays that each stay dense in the cache, and
+	a pass that only looks at kinds or types only ever touches those.
+
+	Nodes are laid out in post-order, children before their parent, so the
+	subtree of node i is exactly the run of indices [first[i], i]. A pass
+	that only needs every operand seen before its operator (type checking,
+	constant folding) can be a plain loop over that run, or over the whole
+	array, rather than a walk down pointers.
+
+	to_flat and from_flat convert between this and the tree in nodes.hpp,
+	so passes can move over one at a time.
+*/
+
+#ifndef CCC_FLATAST_HPP_INCLUDED
+#define CCC_FLATAST_HPP_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include "nodes.hpp"
+
+typedef uint32_t NodeIndex;
+constexpr NodeIndex noNode = UINT32_MAX;	// a For without an init, a Return without a value
+
+// What a, b and c hold for each kind. "list" is an offset into lists, where
+// a child list is stored as its length followed by that many indices
+//	Variable, Declaration		a name, b slot
+//	DeclAndAssign				a declaration, b expression
+//	BinaryOp, RelationalOp,
+//	LogicalOp					a left, b right
+//	Root						a list of functions
+//	Block						a list of statements
+//	FuncDefn					a declaration, b body, c frame slots
+//	FuncDecl					a name, b list of params, c function id
+//	FuncCall					a name, b list of args, c function id
+//	Assignment,
+//	AugmentedAssignment			a name, b expression, c slot
+//	ConstantBool, ConstantInt,
+//	ConstantFloat, ConstantChar	a the value's bits
+//	ConstantDouble				a the low and b the high half of the value's bits
+//	If, While					a condition, b body
+//	For							a list of init, condition, update and body
+//	Unary, CastExpression,
+//	Return, ExpressionStatement	a expression
+//	Ternary						a condition, b if true, c if false
+//	Break, Continue				nothing
+// op holds the BinaryOps, RelationalOps, UnaryOps or AugmentedAssignOps of
+// the kinds that have one, or the TypeName a CastExpression converts to.
+// type is an expression's evaluated type, or the one a Declaration or
+// FuncDecl names
+struct FlatAst
+{
+	static constexpr uint8_t constant = 1;	// in flags, an expression or declaration that's constant
+
+	std::vector<NodeKind> kinds;
+	std::vector<uint8_t> ops;
+	std::vector<TypeName> types;
+	std::vector<uint8_t> flags;
+	std::vector<uint32_t> locations;
+	std::vector<NodeIndex> firsts;		// where each node's subtree starts
+	std::vector<uint32_t> a, b, c;
+	std::vector<uint32_t> lists;
+	const SourceLines* lines = nullptr;	// still the tree's, in the arena it was parsed into
+
+	size_t size() const { return this->kinds.size(); }
+	NodeIndex root() const { return this->kinds.size() - 1; }	// post-order puts it last
+
+	uint32_t list_size(uint32_t list) const { return this->lists[list]; }
+	const NodeIndex* list_begin(uint32_t list) const { return this->lists.data() + list + 1; }
+	const NodeIndex* list_end(uint32_t list) const { return this->list_begin(list) + this->lists[list]; }
+};
+
+// the kinds that make an ExpressionNode
+bool is_expression(NodeKind kind);
+
+// flattens a tree, keeping the slots, function ids and types verify_ast
+// filled in, so either side of a conversion can go on to the next stage
+FlatAst to_flat(Node* root);
+// builds the tree back up in arena. The root shares flat's SourceLines
+Node* from_flat(const FlatAst& flat, AstArena& arena);
+
+#endif // CCC_FLATAST_HPP_INCLUDED
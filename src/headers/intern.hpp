@@ -0,0 +1,59 @@
+/*
+	intern.hpp
+	Identifiers, interned.
+
+	The lexer turns every identifier into a Symbol, a 32 bit id that is the
+	same for every occurrence of the same name, so from there on the AST and
+	the symbol and function tables compare and hash names as integers. Each
+	thread has an interner of its own, like it has its own diag(), since a
+	whole compilation always happens on one thread. A compilation holds an
+	InternScope for as long as it runs and its names are dropped when that
+	goes, so a compile server thread doesn't pile up the names of every
+	request it ever served.
+*/
+
+#ifndef CCC_INTERN_HPP_INCLUDED
+#define CCC_INTERN_HPP_INCLUDED
+
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string_view>
+
+struct Symbol
+{
+	uint32_t id = 0;	// 0 is the empty name
+
+	bool operator==(Symbol other) const { return this->id == other.id; }
+	bool operator!=(Symbol other) const { return this->id != other.id; }
+};
+
+namespace std
+{
+	template <> struct hash<Symbol>
+	{
+		size_t operator()(Symbol s) const { return s.id; }
+	};
+}
+
+// the symbol for name, the same one every time on this thread
+Symbol intern(std::string_view name);
+// the name a symbol was interned from
+std::string_view symbol_name(Symbol s);
+
+std::ostream& operator<<(std::ostream& out, Symbol s);
+
+// Everything interned on this thread while one of these is alive is
+// forgotten when it goes, no Symbol from inside it is any good after. They
+// can nest, only the outermost one forgets anything
+class InternScope
+{
+public:
+	InternScope();
+	~InternScope();
+
+	InternScope(const InternScope&) = delete;
+	InternScope& operator=(const InternScope&) = delete;
+};
+
+#endif // CCC_INTERN_HPP_INCLUDED
@@ -1,7 +1,40 @@
+/*
+	lexer.hpp
+	Where the parser gets its tokens from.
+
+	There are two scanners for the same tokens: the one flex generates from
+	lexer.l, and the hand-written one in scanner.hpp, which --lexer=dfa picks.
+	Lexer runs whichever was asked for over a source, so the parser and -l
+	don't have to care which.
+*/
+
 #ifndef CCC_LEXER_HPP_INCLUDED
 #define CCC_LEXER_HPP_INCLUDED
 
+#include "argsparse.hpp"
 #include "bridge.hpp"
 #include "lexer.h"
+#include "scanner.hpp"
+#include <string>
+
+class Lexer
+{
+private:
+	std::string& source;
+	SourceLines* sourceLines;
+	yyscan_t flex = nullptr;	// when it's flex's scanner
+	Scanner scanner;
+
+public:
+	// both scanners work on source in place, so it has to stay put until
+	// the Lexer is gone. lines is filled in as the tokens go by
+	Lexer(std::string& source, SourceLines* lines, lexer_kind kind);
+	~Lexer();
+	Lexer(const Lexer&) = delete;
+	Lexer& operator=(const Lexer&) = delete;
+
+	YYSTYPE next();
+	SourceLines* lines() const { return this->sourceLines; }
+};
 
 #endif // CCC_LEXER_HPP_INCLUDED
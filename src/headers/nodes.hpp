@@ -1,11 +1,12 @@
 #ifndef CCC_NODE_HPP_INCLUDED
 #define CCC_NODE_HPP_INCLUDED
 
-#include "location.hh"
 #include "common.hpp"
-#include <memory>
-#include <map>
-#include <vector>
+#include "arena.hpp"
+#include "intern.hpp"
+#include "srcloc.hpp"
+#include <cassert>
+#include <cstdint>
 
 /*
 	TODO:
@@ -17,16 +18,51 @@
 // Forward declare NodeVisitor
 class NodeVisitor;
 
+// One for each concrete node class, so we can tell what a node is without RTTI
+enum class NodeKind : uint8_t
+{
+	Variable,
+	Declaration,
+	DeclAndAssign,
+	BinaryOp,
+	RelationalOp,
+	LogicalOp,
+	Root,
+	Block,
+	FuncDefn,
+	FuncDecl,
+	FuncCall,
+	Assignment,
+	AugmentedAssignment,
+	ConstantBool,
+	ConstantInt,
+	ConstantFloat,
+	ConstantChar,
+	ConstantDouble,
+	If,
+	For,
+	While,
+	Unary,
+	Ternary,
+	CastExpression,
+	Return,
+	Break,
+	Continue,
+	ExpressionStatement,
+};
+
 // Base Node class
+// Nodes live in the AstArena of their compilation and are never deleted one
+// at a time, the arena frees the whole tree at once. So a node only points
+// at its children, and everything in one has to be trivially destructible
 class Node 
 {
 public:
-	yy::location location;		// if there is an error, we want to display our location, location->begin.line, location->begin.column
-								// JUST REPORT THE FIRST ERROR YOU FIND!
+	uint32_t location;			// where in the source we start, if there is an error we want to display it. The root's
+								// SourceLines turn it into a line and column. JUST REPORT THE FIRST ERROR YOU FIND!
+	NodeKind kind;				// fits in beside location, so it costs nothing
 
-	virtual ~Node() = 0;	// we'll call our children's destructors!
-							// = 0 means it's undefined, so we can't allocate a class of type Node directly!
-							// = 0 means a child class MUST implement it!
+	explicit Node(NodeKind kind) : kind(kind) {}
 	virtual void accept(NodeVisitor*) = 0;	// visitor?? the = 0 means a child MUST implement it
 };
 
@@ -38,8 +74,10 @@ class ExpressionNode : public Node
 	// Expressions EVALUATE to something
 	// For now, we just care about the TYPE and if this node is CONSTANT
 public:
-	TypeName evaluatedType;
-	bool isConstant;
+	TypeName evaluatedType = TypeName::tVoid;
+	bool isConstant = false;
+
+	explicit ExpressionNode(NodeKind kind) : Node(kind) {}
 };
 
 class ConstantNode
@@ -61,148 +99,172 @@ class StatementNode : public Node
 {
 	// this will be the parent of all our statement nodes
 	// Statements DO NOT EVALUATE to anything, they just E X I S T
+public:
+	explicit StatementNode(NodeKind kind) : Node(kind) {}
 };
 
 class ExpressionStatementNode : public StatementNode
 {
 public:
-	std::unique_ptr<ExpressionNode> expr;	
-	ExpressionStatementNode(std::unique_ptr<ExpressionNode> expr);
+	static constexpr NodeKind Kind = NodeKind::ExpressionStatement;
+	ExpressionNode* expr;	
+	ExpressionStatementNode(ExpressionNode* expr);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class VariableNode : public ExpressionNode
 {
 public:
-	std::string name;
-	bool isConstant;
-	VariableNode(std::string in);
+	static constexpr NodeKind Kind = NodeKind::Variable;
+	Symbol name;
+	int32_t slot = -1;	// which of its function's variables it is, filled in by verify_ast
+	VariableNode(Symbol in);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class DeclarationNode : public StatementNode
 {
 public:
-	std::string name;
+	static constexpr NodeKind Kind = NodeKind::Declaration;
+	Symbol name;
 	TypeName t;
 	bool isConstant;
-	DeclarationNode(TypeName t, std::string name, bool isConstant);
+	int32_t slot = -1;	// the frame slot this declares, filled in by verify_ast
+	DeclarationNode(TypeName t, Symbol name, bool isConstant);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class DeclAndAssignNode : public StatementNode
 {
 public:	
-	std::unique_ptr<DeclarationNode> decl;
-	std::unique_ptr<ExpressionNode> expr;
-	DeclAndAssignNode(std::unique_ptr<DeclarationNode> decl, std::unique_ptr<ExpressionNode> expr);
+	static constexpr NodeKind Kind = NodeKind::DeclAndAssign;
+	DeclarationNode* decl;
+	ExpressionNode* expr;
+	DeclAndAssignNode(DeclarationNode* decl, ExpressionNode* expr);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class BinaryOpNode : public ExpressionNode 
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::BinaryOp;
 	BinaryOps op;
-	std::unique_ptr<ExpressionNode> left;
-	std::unique_ptr<ExpressionNode> right;
+	ExpressionNode* left;
+	ExpressionNode* right;
 	BinaryOpNode(BinaryOps operation, 
-		std::unique_ptr<ExpressionNode> left, 
-		std::unique_ptr<ExpressionNode> right);
+		ExpressionNode* left, 
+		ExpressionNode* right);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class RelationalOpNode : public ExpressionNode 
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::RelationalOp;
 	RelationalOps op;
-	std::unique_ptr<ExpressionNode> left;
-	std::unique_ptr<ExpressionNode> right;
+	ExpressionNode* left;
+	ExpressionNode* right;
 	RelationalOpNode(RelationalOps operation, 
-		std::unique_ptr<ExpressionNode> left, 
-		std::unique_ptr<ExpressionNode> right);
+		ExpressionNode* left, 
+		ExpressionNode* right);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class LogicalOpNode : public ExpressionNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::LogicalOp;
 	BinaryOps op;
-	std::unique_ptr<ExpressionNode> left;
-	std::unique_ptr<ExpressionNode> right;
+	ExpressionNode* left;
+	ExpressionNode* right;
 	LogicalOpNode(BinaryOps operation, 
-		std::unique_ptr<ExpressionNode> left, 
-		std::unique_ptr<ExpressionNode> right);
+		ExpressionNode* left, 
+		ExpressionNode* right);
 	virtual void accept(NodeVisitor* v) override;	
 };
 
 class RootNode : public Node
 {
 public:	
-	std::vector<std::unique_ptr<Node>> funcs;
-	RootNode(std::vector<std::unique_ptr<Node>> funcs);
+	static constexpr NodeKind Kind = NodeKind::Root;
+	ArenaVector<Node*> funcs;
+	const SourceLines* lines = nullptr;	// for making sense of every location in the tree
+	RootNode(ArenaVector<Node*> funcs);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class BlockNode : public Node
 {
 public:
-	std::vector<std::unique_ptr<Node>> stmts;
-	BlockNode(std::vector<std::unique_ptr<Node>> stmts);
+	static constexpr NodeKind Kind = NodeKind::Block;
+	ArenaVector<Node*> stmts;
+	BlockNode(ArenaVector<Node*> stmts);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class FuncDefnNode : public Node
 {
 public:
-	std::unique_ptr<FuncDeclNode> funcDecl;
-	std::unique_ptr<Node> funcBody;
-	FuncDefnNode(std::unique_ptr<FuncDeclNode> funcDecl, std::unique_ptr<Node> funcBody);
+	static constexpr NodeKind Kind = NodeKind::FuncDefn;
+	FuncDeclNode* funcDecl;
+	Node* funcBody;
+	int32_t frameSlots = 0;	// how many variables the function declares, params included
+	FuncDefnNode(FuncDeclNode* funcDecl, Node* funcBody);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class FuncDeclNode : public Node 
 {
 public:
-	std::string name;
+	static constexpr NodeKind Kind = NodeKind::FuncDecl;
+	Symbol name;
 	TypeName t;
-	std::vector<std::unique_ptr<DeclarationNode>> params;
-	FuncDeclNode(TypeName t, std::string name, std::vector<std::unique_ptr<DeclarationNode>> params);
+	ArenaVector<DeclarationNode*> params;
+	int32_t funcId = -1;	// the same for every declaration of a function
+	FuncDeclNode(TypeName t, Symbol name, ArenaVector<DeclarationNode*> params);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class FuncCallNode : public ExpressionNode
 {
 public:
-	std::string name;
-	std::vector<std::unique_ptr<ExpressionNode>> funcArgs;
-	FuncCallNode(std::string name, std::vector<std::unique_ptr<ExpressionNode>> funcArgs);
+	static constexpr NodeKind Kind = NodeKind::FuncCall;
+	Symbol name;
+	ArenaVector<ExpressionNode*> funcArgs;
+	int32_t funcId = -1;	// the function being called
+	FuncCallNode(Symbol name, ArenaVector<ExpressionNode*> funcArgs);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class AssignmentNode : public StatementNode
 {
 public:
-	std::string name;	// can be name or declaration
-	std::unique_ptr<ExpressionNode> expr;	// the expression we are going to assign to name
-	AssignmentNode(std::string name, std::unique_ptr<ExpressionNode> expr);
+	static constexpr NodeKind Kind = NodeKind::Assignment;
+	Symbol name;	// can be name or declaration
+	ExpressionNode* expr;	// the expression we are going to assign to name
+	int32_t slot = -1;
+	AssignmentNode(Symbol name, ExpressionNode* expr);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class AugmentedAssignmentNode : public StatementNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::AugmentedAssignment;
 	AugmentedAssignOps op;
-	std::string name;
-	std::unique_ptr<ExpressionNode> expr;	// the expression we are going to assign to name
+	Symbol name;
+	ExpressionNode* expr;	// the expression we are going to assign to name
+	int32_t slot = -1;
 	AugmentedAssignmentNode(AugmentedAssignOps op, 
-		std::string name, 
-		std::unique_ptr<ExpressionNode> expr);
+		Symbol name, 
+		ExpressionNode* expr);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class ConstantBoolNode : public ExpressionNode, public ConstantNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::ConstantBool;
 	//bool value;
 	ConstantBoolNode(bool in);
 	virtual void accept(NodeVisitor* v) override;
@@ -211,6 +273,7 @@ public:
 class ConstantIntNode : public ExpressionNode, public ConstantNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::ConstantInt;
 	//int value;
 	ConstantIntNode(int in);
 	virtual void accept(NodeVisitor* v) override;
@@ -219,6 +282,7 @@ public:
 class ConstantFloatNode : public ExpressionNode, public ConstantNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::ConstantFloat;
 	//float value;
 	ConstantFloatNode(float in);
 	virtual void accept(NodeVisitor* v) override;
@@ -227,6 +291,7 @@ public:
 class ConstantCharNode : public ExpressionNode, public ConstantNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::ConstantChar;
 	ConstantCharNode(char in);
 	virtual void accept(NodeVisitor* v) override;
 };
@@ -234,6 +299,7 @@ public:
 class ConstantDoubleNode : public ExpressionNode, public ConstantNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::ConstantDouble;
 	ConstantDoubleNode(double in);
 	virtual void accept(NodeVisitor* v) override;
 };
@@ -241,77 +307,85 @@ public:
 class IfNode : public StatementNode
 {
 public:
-	std::unique_ptr<ExpressionNode> ifExpr;
-	std::unique_ptr<Node> ifBody;
-	IfNode(std::unique_ptr<ExpressionNode> ifExpr, std::unique_ptr<Node> ifBody);
+	static constexpr NodeKind Kind = NodeKind::If;
+	ExpressionNode* ifExpr;
+	Node* ifBody;
+	IfNode(ExpressionNode* ifExpr, Node* ifBody);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class ForNode : public StatementNode
 {
 public:
-	std::unique_ptr<Node> initStmt;
-	std::unique_ptr<ExpressionNode> loopCondExpr;
-	std::unique_ptr<Node> updateStmt;
-	std::unique_ptr<Node> loopBody; 
-	ForNode(std::unique_ptr<Node> initStmt, 
-		std::unique_ptr<ExpressionNode> midExpr, 
-		std::unique_ptr<Node> loopCondStmt, 
-		std::unique_ptr<Node> loopBody);
+	static constexpr NodeKind Kind = NodeKind::For;
+	Node* initStmt;
+	ExpressionNode* loopCondExpr;
+	Node* updateStmt;
+	Node* loopBody; 
+	ForNode(Node* initStmt, 
+		ExpressionNode* midExpr, 
+		Node* loopCondStmt, 
+		Node* loopBody);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class WhileNode : public StatementNode
 {
 public:
-	std::unique_ptr<ExpressionNode> whileExpr;
-	std::unique_ptr<Node> loopBody;
-	WhileNode(std::unique_ptr<ExpressionNode> whileExpr, 
-		std::unique_ptr<Node> loopBody);
+	static constexpr NodeKind Kind = NodeKind::While;
+	ExpressionNode* whileExpr;
+	Node* loopBody;
+	WhileNode(ExpressionNode* whileExpr, 
+		Node* loopBody);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class UnaryNode : public ExpressionNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::Unary;
 	UnaryOps op;
-	std::unique_ptr<ExpressionNode> expr;
-	UnaryNode(UnaryOps op, std::unique_ptr<ExpressionNode> expr);
+	ExpressionNode* expr;
+	UnaryNode(UnaryOps op, ExpressionNode* expr);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class TernaryNode : public ExpressionNode
 {
 public:
-	std::unique_ptr<ExpressionNode> condExpr;
-	std::unique_ptr<ExpressionNode> trueExpr;
-	std::unique_ptr<ExpressionNode> falseExpr;
-	TernaryNode(std::unique_ptr<ExpressionNode> condExpr, 
-		std::unique_ptr<ExpressionNode> trueExpr, 
-		std::unique_ptr<ExpressionNode> falseExpr);
+	static constexpr NodeKind Kind = NodeKind::Ternary;
+	ExpressionNode* condExpr;
+	ExpressionNode* trueExpr;
+	ExpressionNode* falseExpr;
+	TernaryNode(ExpressionNode* condExpr, 
+		ExpressionNode* trueExpr, 
+		ExpressionNode* falseExpr);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class CastExpressionNode : public ExpressionNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::CastExpression;
 	TypeName t;
-	std::unique_ptr<ExpressionNode> expr;
-	CastExpressionNode(TypeName t, std::unique_ptr<ExpressionNode> expr);
+	ExpressionNode* expr;
+	CastExpressionNode(TypeName t, ExpressionNode* expr);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class ReturnNode : public StatementNode
 {
 public:
-	std::unique_ptr<ExpressionNode> expr;
-	ReturnNode(std::unique_ptr<ExpressionNode> expr);
+	static constexpr NodeKind Kind = NodeKind::Return;
+	ExpressionNode* expr;
+	ReturnNode(ExpressionNode* expr);
 	virtual void accept(NodeVisitor* v) override;
 };
 
 class BreakNode : public StatementNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::Break;
 	BreakNode();
 	virtual void accept(NodeVisitor* v) override;
 };
@@ -319,9 +393,28 @@ public:
 class ContinueNode : public StatementNode
 {
 public:
+	static constexpr NodeKind Kind = NodeKind::Continue;
 	ContinueNode();
 	virtual void accept(NodeVisitor* v) override;
 };
 
+// isa<T>(n) for whether n is a T, cast<T>(n) when it had better be one,
+// and dyn_cast<T>(n) for a T or nullptr. Just a compare of the kind
+template <typename T> inline bool isa(const Node* n)
+{
+	return n->kind == T::Kind;
+}
+
+template <typename T> inline T* cast(Node* n)
+{
+	assert(isa<T>(n));
+	return static_cast<T*>(n);
+}
+
+template <typename T> inline T* dyn_cast(Node* n)
+{
+	return n && isa<T>(n) ? static_cast<T*>(n) : nullptr;
+}
+
 #endif // CCC_NODE_HPP_INCLUDED
 													
\ No newline at end of file
@@ -0,0 +1,91 @@
+/*
+	pratt.hpp
+	A hand-written parser for the grammar in parser.y, picked with --parser=pratt.
+
+	Functions and statements are parsed top down, a function per rule, and
+	expressions by precedence climbing over the operator precedences parser.y
+	declares, resolving every conflict the way bison does. It builds the same
+	tree with the same locations, and fails with the same message at the same
+	token, so either parser can stand in for the other. The one difference
+	is nesting: bison's stack is on the heap and this one's isn't, so
+	expressions and blocks nested deeper than maxNesting are turned down
+	with an error of their own instead of running out of stack.
+*/
+
+#ifndef CCC_PRATT_HPP_INCLUDED
+#define CCC_PRATT_HPP_INCLUDED
+
+#include "lexer.hpp"
+#include "nodes.hpp"
+#include "arena.hpp"
+
+class PrattParser
+{
+private:
+	// the lookahead, out of the symbol_type the Lexer hands back
+	struct Token
+	{
+		yy::parser::symbol_kind_type kind;
+		SourceRange location;
+		// whichever of these the kind of token carries
+		Symbol name;
+		TypeName type;
+		int intValue;
+		float floatValue;
+		double doubleValue;
+		char charValue;
+	};
+
+	// an expression, and where the symbol bison would have for it starts.
+	// They differ for one in parentheses, where the node is the one inside
+	struct Operand
+	{
+		ExpressionNode* node;
+		uint32_t start;
+	};
+
+	// one more level of expression or block nesting, for as long as it's around
+	struct Nesting
+	{
+		PrattParser& parser;
+
+		explicit Nesting(PrattParser& parser);
+		~Nesting() { this->parser.depth--; }
+	};
+
+	Lexer& lexer;
+	AstArena& arena;
+	Token token;
+	unsigned depth = 0;
+
+	void advance();
+	bool at(yy::parser::symbol_kind_type kind) const { return this->token.kind == kind; }
+	void expect(yy::parser::symbol_kind_type kind);
+	[[noreturn]] void syntax_error(const char* message = "syntax error");
+	template <typename T, typename... Args> T* make(uint32_t location, Args&&... args);
+
+	Node* function();
+	FuncDeclNode* function_decl();
+	DeclarationNode* declaration();
+	Node* block();
+	StatementNode* statement();
+	StatementNode* single_statement();
+	StatementNode* compound_statement();
+	ExpressionNode* expression(int precedence = 0);
+	Operand prefix();
+	Operand call_or_variable(Symbol name, uint32_t start);
+	Operand infix(Operand left, int precedence);
+
+public:
+	// how deep expressions and blocks can nest. Each level is a few frames,
+	// this keeps the deepest parse well inside a thread's stack
+	static constexpr unsigned maxNesting = 10000;
+
+	PrattParser(Lexer& lexer, AstArena& arena);
+
+	// the tree for the whole source. Reports a syntax error and throws
+	// CompileError if there is one
+	Node* parse();
+};
+
+#endif // CCC_PRATT_HPP_INCLUDED
@@ -1,9 +1,40 @@
+/*
+	preprocess.hpp
+	Source cleanup and #include, the parts of the C preprocessor we have so far.
+*/
+
+#ifndef CCC_PREPROCESS_HPP_INCLUDED
+#define CCC_PREPROCESS_HPP_INCLUDED
+
 #include <string>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
 
 class preprocess
 {
 public:
-	int preprocess_file(const std::string, const std::string);
-	int clean_preprocess_file(const std::string infile);
+	// #include "file" is looked for next to the file that includes it and then
+	// in includeDirs, #include <file> only in includeDirs
+	explicit preprocess(std::vector<std::string> includeDirs = {});
+
+	int preprocess_file(const std::string infile, std::string& out);
+	// path is where the buffer came from, only used to find the headers it includes
+	int preprocess_buffer(const char* data, size_t len, std::string& out, const std::string& path = "");
+
+private:
+	std::vector<std::string> includeDirs;
 };
 
+// Headers are read once per process and shared by every file compiled in it,
+// until they change on disk or enough others have been included since. These
+// count how often that saved us the work
+struct HeaderCacheStats
+{
+	uint64_t reads;		// headers read and split up
+	uint64_t reuses;	// includes served from what an earlier read left
+};
+
+HeaderCacheStats header_cache_stats();
+
+#endif // CCC_PREPROCESS_HPP_INCLUDED
@@ -0,0 +1,122 @@
+/*
+	protocol.hpp
+	What the compile server and its clients say to each other.
+
+	Every message on the socket is a 32 bit length followed by that many bytes
+	of payload. The payload starts with a one byte message kind, then the
+	fields for that kind. Integers are 32 bit, strings are a 32 bit length
+	followed by their bytes.
+
+	client -> server
+		request_compile	flags, file count, then for each file its name, the
+						path to read it from (or to find the headers of an inline
+						source from) and optionally its source inline
+		request_stats	nothing else
+	server -> client
+		reply_file		one per file, in command line order: status, log,
+						then the files it produced as (path, data, executable)
+		reply_done		number of files that failed
+		reply_stats		the statistics as printable text
+*/
+
+#ifndef CCC_PROTOCOL_HPP_INCLUDED
+#define CCC_PROTOCOL_HPP_INCLUDED
+
+#include "argsparse.hpp"
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+enum message_kind : uint8_t
+{
+	request_compile = 1,
+	request_stats,
+	reply_file,
+	reply_done,
+	reply_stats,
+};
+
+// don't let a confused or malicious client make us allocate without limit
+static constexpr uint32_t maxMessageSize = 1u << 30;
+
+// Building and taking apart message payloads
+class MessageWriter
+{
+public:
+	std::string buffer;
+
+	void put_u8(uint8_t v) { this->buffer.push_back(static_cast<char>(v)); }
+	void put_u32(uint32_t v)
+	{
+		char bytes[4];
+		std::memcpy(bytes, &v, sizeof(v));
+		this->buffer.append(bytes, sizeof(bytes));
+	}
+	void put_i32(int32_t v) { this->put_u32(static_cast<uint32_t>(v)); }
+	void put_str(const std::string& s)
+	{
+		this->put_u32(static_cast<uint32_t>(s.size()));
+		this->buffer.append(s);
+	}
+	void clear() { this->buffer.clear(); }	// keeps the capacity for the next message
+};
+
+class MessageReader
+{
+private:
+	const char* p;
+	const char* end;
+
+public:
+	bool ok = true;		// goes false on the first read past the end, and stays false
+
+	MessageReader(const std::string& payload) : p(payload.data()), end(payload.data() + payload.size()) {}
+
+	uint8_t get_u8()
+	{
+		if (this->end - this->p < 1)
+		{
+			this->ok = false;
+			return 0;
+		}
+		return static_cast<uint8_t>(*this->p++);
+	}
+	uint32_t get_u32()
+	{
+		uint32_t v = 0;
+		if (this->end - this->p < 4)
+		{
+			this->ok = false;
+			return 0;
+		}
+		std::memcpy(&v, this->p, sizeof(v));
+		this->p += sizeof(v);
+		return v;
+	}
+	int32_t get_i32() { return static_cast<int32_t>(this->get_u32()); }
+	std::string get_str()
+	{
+		uint32_t len = this->get_u32();
+		if (!this->ok || static_cast<size_t>(this->end - this->p) < len)
+		{
+			this->ok = false;
+			return std::string();
+		}
+		std::string s(this->p, len);
+		this->p += len;
+		return s;
+	}
+};
+
+// $CCC_SOCKET, or /tmp/ccc-<uid>.sock
+std::string server_socket_path();
+
+// Send or receive one whole message, false if the connection went away
+bool send_message(int fd, const MessageWriter& message);
+bool receive_message(int fd, std::string& payload);
+
+// The parts of the command line that change how a file gets compiled
+void put_flags(MessageWriter& message, const cmd_line_args& cmds);
+void get_flags(MessageReader& message, cmd_line_args& cmds);
+
+#endif // CCC_PROTOCOL_HPP_INCLUDED
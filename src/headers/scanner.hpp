@@ -0,0 +1,45 @@
+/*
+	scanner.hpp
+	A hand-written scanner for the tokens in lexer.l, picked with --lexer=dfa.
+
+	It's the same DFA flex builds, only written out: a switch on the first
+	byte of a token picks the state, and the loops over identifiers, digits
+	and whitespace test a 256 entry table of character classes. Keywords are
+	found with a perfect hash worked out at compile time, so telling one from
+	an identifier is a table probe and a compare, and numbers are converted
+	with std::from_chars, which doesn't allocate or look at the locale.
+*/
+
+#ifndef CCC_SCANNER_HPP_INCLUDED
+#define CCC_SCANNER_HPP_INCLUDED
+
+#include "bridge.hpp"
+#include "srcloc.hpp"
+
+class Scanner
+{
+private:
+	const char* begin = nullptr;
+	const char* p = nullptr;
+	const char* end = nullptr;
+	SourceLines* lines = nullptr;
+
+	yy::parser::symbol_type word(const char* start);
+	yy::parser::symbol_type number(const char* start);
+	yy::parser::symbol_type character(const char* start);
+	yy::parser::symbol_type invalid(const char* start);
+	SourceRange range(const char* start) const;
+
+public:
+	Scanner() = default;
+	// scans [begin, end) in place, noting where lines start in lines. *end
+	// has to be readable and can't carry on a token, so a std::string's
+	// contents with the '\0' it always keeps after them will do
+	Scanner(const char* begin, const char* end, SourceLines* lines);
+
+	// the next token, YYEOF at the end. Reports and returns YYUNDEF for
+	// anything that isn't a token, like flex's scanner does
+	yy::parser::symbol_type next();
+};
+
+#endif // CCC_SCANNER_HPP_INCLUDED
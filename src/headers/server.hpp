@@ -0,0 +1,39 @@
+/*
+	server.hpp
+	A long running compile server.
+
+	The server listens on a Unix domain socket ($CCC_SOCKET, or
+	/tmp/ccc-<uid>.sock) and keeps its worker threads and LLVM initialized
+	between requests, so lots of small compiles don't each pay for starting
+	up a new process.
+*/
+
+#ifndef CCC_SERVER_HPP_INCLUDED
+#define CCC_SERVER_HPP_INCLUDED
+
+#include "argsparse.hpp"
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Counts latencies into power of two buckets of microseconds. Safe to record
+// into from any number of threads at once.
+class LatencyHistogram
+{
+private:
+	static constexpr int bucketCount = 40;
+	std::atomic<uint64_t> buckets[bucketCount] = {};
+	std::atomic<uint64_t> count {0};
+	std::atomic<uint64_t> totalMicros {0};
+	std::atomic<uint64_t> maxMicros {0};
+
+public:
+	void record(uint64_t micros);
+	void print(std::ostream& out, const std::string& name) const;
+};
+
+// Serve compile requests until interrupted. Returns the exit code for ccc.
+int run_server(const cmd_line_args& cmds);
+
+#endif // CCC_SERVER_HPP_INCLUDED
@@ -0,0 +1,51 @@
+/*
+	srcloc.hpp
+	Where in the source a node came from, kept small.
+
+	The parser's locations are pairs of byte offsets into the preprocessed
+	source, which bison carries through the grammar like it would its own,
+	and a node keeps just the offset it begins at: 4 bytes where a
+	yy::location took 32. The lexer notes where each line starts as it goes
+	past, and an offset is only turned into a line and column when there's
+	a diagnostic to print.
+*/
+
+#ifndef CCC_SRCLOC_HPP_INCLUDED
+#define CCC_SRCLOC_HPP_INCLUDED
+
+#include <cstdint>
+#include <ostream>
+#include "arena.hpp"
+
+struct SourceRange
+{
+	uint32_t begin = 0;	// first byte
+	uint32_t end = 0;	// one past the last
+};
+
+struct LineColumn
+{
+	uint32_t line;		// both count from 1
+	uint32_t column;
+};
+
+class SourceLines
+{
+	// lives in the arena with the tree whose offsets it decodes
+private:
+	ArenaVector<uint32_t> starts;	// offset of the first byte of each line
+
+public:
+	explicit SourceLines(AstArena& arena);
+
+	void add_line(uint32_t start) { this->starts.push_back(start); }
+	LineColumn find(uint32_t offset) const;
+	const ArenaVector<uint32_t>& line_starts() const { return this->starts; }
+};
+
+// "line, column", the way the error messages have always shown it
+std::ostream& operator<<(std::ostream& out, LineColumn at);
+// the raw offsets, for bison's parse trace
+std::ostream& operator<<(std::ostream& out, SourceRange range);
+
+#endif // CCC_SRCLOC_HPP_INCLUDED
@@ -6,52 +6,74 @@
 #ifndef CCC_SYMTABLE_HPP_INCLUDED
 #define CCC_SYMTABLE_HPP_INCLUDED
 
+#include <cstdint>
 #include <string>
-#include <map>
+#include <unordered_map>
 #include <vector>
-#include <list>		// used as stack, maybe change to vector?
 #include "common.hpp"
-#include "bridge.hpp"
-#include "llvm/IR/ValueHandle.h"
-#include "llvm/IR/Instructions.h"
+#include "intern.hpp"
 
 typedef struct 
 {
-	std::string Name;				// name of symbol
+	Symbol Name;					// name of symbol
 	TypeName Type;					// type of symbol
 	bool isConstant;				// is this a constant?
-	YYLTYPE declarationLocation;	// location where symbol was defined
+	uint32_t declarationLocation;	// location where symbol was defined
+	int32_t slot;					// where in its function's frame it lives
 	// Additional attributes would go here, CONST, etc.
-	llvm::AllocaInst* val;				// use this to hold llvm specific info, usually a pointer to a memory location
 } SymbolTableEntry;
 
 typedef struct 
 {
-	std::string Name;				// name of function
+	Symbol Name;					// name of function
 	TypeName ReturnType;			// return type of function
 	std::vector<TypeName> ParamTypes;	// types of parameters of function
 	bool hasDefinition;				// we can declare a function then define it later. It is not an error
-	YYLTYPE definitionLocation;		// where did we see the function defined
+	uint32_t definitionLocation;	// where did we see the function defined
+	int32_t id;						// numbered in the order they're first declared
 } FunctionTableEntry;
 
 // Make our life easy with some typedefs
-// A symbol table is a map of string to SymbolTableEntry*
-typedef std::map<std::string, SymbolTableEntry*> SymbolTableType;
-// A function table is a map of string to FunctionTableEntry*
-typedef std::map<std::string, FunctionTableEntry*> FunctionTableType;
+// A function table is a map of interned name to FunctionTableEntry*
+typedef std::unordered_map<Symbol, FunctionTableEntry*> FunctionTableType;
 
 class SymbolTable
 {
+	// One hash table for every scope at once. Each name in it points at its
+	// innermost binding, and each binding at the one it shadows, so a lookup
+	// is one probe however deeply the scopes nest. The bindings sit in one
+	// array in the order they were declared, which is also the undo log:
+	// popping a scope walks its bindings off the end and puts back what they
+	// shadowed. Once the arrays have grown, pushing and popping allocate
+	// nothing.
 private:
-	std::list<SymbolTableType*> SymbolTableStack;	// our list of symbol tables
-	SymbolTableType* CurrentSymbolTable;			// To keep track of current symbol table
-	
+	struct Binding
+	{
+		SymbolTableEntry entry;
+		int32_t shadowed;			// same name further out, or -1
+	};
+	struct Slot
+	{
+		uint32_t key;				// symbol id + 1, 0 while the slot is empty
+		int32_t innermost;			// binding in scope right now, or -1
+	};
+
+	std::vector<Binding> bindings;
+	std::vector<uint32_t> scopeStarts;	// index of each open scope's first binding
+	std::vector<Slot> slots;			// open addressing, a power of two long
+	uint32_t slotShift;					// 32 - log2 of slots.size()
+	uint32_t usedSlots = 0;				// names never leave, just go out of scope
+
+	Slot* find_slot(Symbol name);
+	Slot& claim_slot(Symbol name);
+	void grow_slots();
+	SymbolTableEntry* bind(Symbol name);
+
 public:
 	SymbolTable();
-	SymbolTableEntry* GetSymbol(std::string Symbol);
-	llvm::AllocaInst* GetLLVMValue(std::string Symbol);
-	bool AddSymbol(std::string Name, TypeName Type, bool isConstant, YYLTYPE loc);
-	bool AddLLVMSymbol(std::string Name, llvm::AllocaInst* val);
+	// the entry stays good until the next symbol is added or scope is popped
+	SymbolTableEntry* GetSymbol(Symbol name);
+	bool AddSymbol(Symbol Name, TypeName Type, bool isConstant, uint32_t loc, int32_t slot);
 
 	void PushScope();
 	void PopScope();
@@ -70,13 +92,13 @@ private:
 public:
 	FunctionTable();
 	FunctionTableEntry* GetCurrentFunction();
-	FunctionTableEntry* GetFunction(std::string Name);
-	bool AddFunction(std::string Name, TypeName ReturnType, std::vector<TypeName> ParamTypes);
-	void DefineFunction(std::string Name, YYLTYPE loc);
+	FunctionTableEntry* GetFunction(Symbol Name);
+	bool AddFunction(Symbol Name, TypeName ReturnType, std::vector<TypeName> ParamTypes);
+	void DefineFunction(Symbol Name, uint32_t loc);
 	bool IsInFunctionDefinition();
-	bool IsFunctionDefined(std::string Name);
+	bool IsFunctionDefined(Symbol Name);
 
-	void EnterFunctionDefinition(std::string Name);
+	void EnterFunctionDefinition(Symbol Name);
 	void ExitFunctionDefinition();
 
 	void PrintFunctionTable();
@@ -0,0 +1,40 @@
+/*
+	threadpool.hpp
+	A fixed size pool of worker threads that run queued tasks in order of submission.
+*/
+
+#ifndef CCC_THREADPOOL_HPP_INCLUDED
+#define CCC_THREADPOOL_HPP_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex lock;
+	std::condition_variable wake;
+	bool stopping = false;
+
+	void work();
+
+public:
+	// threads == 0 means one thread per hardware thread
+	explicit ThreadPool(unsigned threads);
+	// finishes everything already queued before joining the workers
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> task);
+	unsigned size() const;
+};
+
+#endif // CCC_THREADPOOL_HPP_INCLUDED
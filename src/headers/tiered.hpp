@@ -0,0 +1,62 @@
+/*
+	tiered.hpp
+	Tiered JIT for --run --tiered.
+
+	Tier 1 is the module straight out of CodegenVisitor, compiled without any
+	optimization so the program starts quickly. Every function gets a counter
+	that goes up on each call and each trip around a loop, and callers reach it
+	through a stub. When a counter hits the threshold ($CCC_TIER_THRESHOLD,
+	default 1000) the function is recompiled at -O3 on a background thread and
+	its stub is pointed at the new version.
+*/
+
+#ifndef CCC_TIERED_HPP_INCLUDED
+#define CCC_TIERED_HPP_INCLUDED
+
+#include "llvm/ExecutionEngine/Orc/LLJIT.h"
+#include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+class TieredJIT
+{
+public:
+	TieredJIT(unsigned compileThreads);
+	~TieredJIT();
+	// takes over the module and runs its main, with argc as call_main takes it
+	int run(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module, int argc);
+	// called from tier 1 code when function id gets hot
+	void tier_up(uint32_t id);
+
+private:
+	void instrument(llvm::Module& module);
+	void promote(uint32_t id);
+
+	struct Promotion
+	{
+		std::string name;
+		uint64_t micros;
+	};
+
+	unsigned compileThreads;
+	uint64_t threshold;
+	std::unique_ptr<llvm::orc::LLJIT> jit;
+	std::unique_ptr<llvm::orc::IndirectStubsManager> stubs;
+	std::string bitcode;					// the unoptimized module, tier 2 starts from this
+	std::vector<std::string> names;			// function names by counter id
+	std::unique_ptr<std::atomic<bool>[]> hot;
+	std::atomic<bool> stopping;
+	std::mutex promotionsLock;
+	std::vector<Promotion> promotions;
+	std::unique_ptr<ThreadPool> pool;		// last, so it is drained before the rest goes away
+};
+
+#endif // CCC_TIERED_HPP_INCLUDED
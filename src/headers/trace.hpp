@@ -0,0 +1,51 @@
+/*
+	trace.hpp
+	Phase timing for --time-report and --trace.
+
+	A TraceScope records how long the code between its construction and its
+	destruction took, in wall and CPU time, along with the peak RSS when it
+	finished. Nothing is recorded until trace_start is called, so the scopes
+	can stay in the code for good. Scopes nest, and the trace written by
+	--trace is in Chrome's trace event format, which Perfetto and
+	chrome://tracing both load.
+*/
+
+#ifndef CCC_TRACE_HPP_INCLUDED
+#define CCC_TRACE_HPP_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+extern std::atomic<bool> traceEnabled;
+
+void trace_start();
+// write the trace to path (if it isn't empty) and print the time report (if asked to)
+bool trace_finish(const std::string& path, bool timeReport, std::ostream& report);
+
+class TraceScope
+{
+private:
+	bool active;
+	const char* name;
+	const char* category;
+	std::string detail;
+	uint64_t start;
+	uint64_t cpuStart;
+
+public:
+	// name and category have to outlive the trace, string literals are best
+	TraceScope(const char* name, const char* category = "phase");
+	// detail is shown with the span, eg which function or file it was for
+	TraceScope(const char* name, const char* category, std::string_view detail);
+	~TraceScope();
+	// record the span now rather than when the scope ends
+	void finish();
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#endif // CCC_TRACE_HPP_INCLUDED
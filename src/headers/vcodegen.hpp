@@ -7,25 +7,38 @@
 #include <memory>
 #include <cstdio>
 #include <map>
+#include <optional>
 #include <vector>
 #include "common.hpp"
 #include "nodes.hpp"
 #include "compiler.hpp"
-#include "symtable.hpp"
+#include "trace.hpp"
+#include "walker.hpp"
 
 #include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/IR/ValueHandle.h"
 
 
-class CodegenVisitor : public NodeVisitor
+class CodegenVisitor final : public TreeWalker<CodegenVisitor>
 {
 private:
-	llvm::Value* retValue;
+	// the values of expressions we've generated code for that haven't been used yet.
+	// An operator takes its operands' off the top and puts its own back
+	std::vector<llvm::Value*> values;
+	// the blocks an if, loop or ternary still has to branch to or fill in,
+	// from when it makes them until it's done
+	std::vector<llvm::BasicBlock*> blocks;
 	bool returnFlag;
+	std::optional<TraceScope> generatingFunction;	// open from entering a definition until leaving it
 
-	SymbolTable* symTable;
+	// the current function's variables, indexed by the slots verify_ast gave them
+	std::vector<llvm::AllocaInst*> frame;
+	// every function declared so far, indexed by function ID
+	std::vector<llvm::Function*> functions;
 
-	llvm::Value* consumeRetValue();
+	llvm::Value* popValue();
 	std::vector<llvm::BasicBlock*> loopHeaders;
 	std::vector<llvm::BasicBlock*> loopFooters;
 	std::vector<llvm::BasicBlock*> loopExits;
@@ -46,36 +59,55 @@ public:
 	// Includes necessary to build IR
 	// will this live here and get init'ed somewhere else
 	CodegenVisitor();
-	~CodegenVisitor();
-	void setRetValue(llvm::Value* v);
-	void visit(VariableNode* n) override;
-	void visit(DeclarationNode* n) override;
-	void visit(DeclAndAssignNode* n) override;
-	void visit(BinaryOpNode* n) override;
-	void visit(LogicalOpNode* n) override;
-	void visit(RelationalOpNode* n) override;
-	void visit(RootNode* n) override;
-	void visit(BlockNode* n) override;
-	void visit(FuncDefnNode* n) override;
-	void visit(FuncDeclNode* n) override;
-	void visit(FuncCallNode* n) override;
-	void visit(AssignmentNode* n) override;
-	void visit(AugmentedAssignmentNode* n) override;
-	void visit(ReturnNode* n) override;
-	void visit(ConstantBoolNode* n) override;
-	void visit(ConstantCharNode* n) override;
-	void visit(ConstantDoubleNode* n) override;
-	void visit(ConstantFloatNode* n) override;
-	void visit(ConstantIntNode* n) override;
-	void visit(IfNode* n) override;
-	void visit(ForNode* n) override;
-	void visit(WhileNode* n) override;
-	void visit(UnaryNode* n) override;
-	void visit(TernaryNode* n) override;
-	void visit(CastExpressionNode* n) override;
-	void visit(BreakNode* n) override;
-	void visit(ContinueNode* n) override;	
-	void visit(ExpressionStatementNode*) override;
+
+	using TreeWalker<CodegenVisitor>::enter;
+	using TreeWalker<CodegenVisitor>::before_child;
+	using TreeWalker<CodegenVisitor>::after_child;
+	using TreeWalker<CodegenVisitor>::leave;
+	using TreeWalker<CodegenVisitor>::child_slot;
+
+	bool enter(DeclarationNode* n);
+	bool enter(DeclAndAssignNode* n);
+	bool enter(BlockNode* n);
+	bool enter(FuncDefnNode* n);
+	bool enter(FuncDeclNode* n);
+	bool enter(FuncCallNode* n);
+	bool enter(AssignmentNode* n);
+	bool enter(AugmentedAssignmentNode* n);
+	bool enter(ReturnNode* n);
+	bool enter(WhileNode* n);
+	bool enter(BreakNode* n);
+	bool enter(ContinueNode* n);
+	uint32_t child_slot(ForNode* n, uint32_t k);
+	bool before_child(DeclAndAssignNode* n, uint32_t slot);
+	bool before_child(FuncDefnNode* n, uint32_t slot);
+	bool before_child(IfNode* n, uint32_t slot);
+	bool before_child(ForNode* n, uint32_t slot);
+	bool before_child(WhileNode* n, uint32_t slot);
+	bool before_child(TernaryNode* n, uint32_t slot);
+	bool after_child(BlockNode* n, uint32_t slot);
+	void leave(VariableNode* n);
+	void leave(DeclAndAssignNode* n);
+	void leave(BinaryOpNode* n);
+	void leave(LogicalOpNode* n);
+	void leave(RelationalOpNode* n);
+	void leave(FuncDefnNode* n);
+	void leave(FuncCallNode* n);
+	void leave(AssignmentNode* n);
+	void leave(AugmentedAssignmentNode* n);
+	void leave(ReturnNode* n);
+	void leave(ConstantBoolNode* n);
+	void leave(ConstantCharNode* n);
+	void leave(ConstantDoubleNode* n);
+	void leave(ConstantFloatNode* n);
+	void leave(ConstantIntNode* n);
+	void leave(IfNode* n);
+	void leave(ForNode* n);
+	void leave(WhileNode* n);
+	void leave(UnaryNode* n);
+	void leave(TernaryNode* n);
+	void leave(CastExpressionNode* n);
+	void leave(ExpressionStatementNode* n);
 };
 
 #endif // CCC_CODEGEN_HPP_INCLUDED
@@ -6,16 +6,21 @@
 
 #include <memory>
 #include <cstdio>
+#include <optional>
 #include "common.hpp"
 #include "nodes.hpp"
 #include "symtable.hpp"
+#include "trace.hpp"
+#include "walker.hpp"
 
 /*
 Visit nodes and fill in some information about the AST to use in the semantic analysis phase.
 Namely, we begin filling in the symbol table, function table, and evaluating expressions.
+Every variable reference is resolved to a slot in its function's frame, and every call to
+a function ID, so code generation never has to look a name up again.
 */
 
-class EvaluateVisitor : public NodeVisitor
+class EvaluateVisitor final : public TreeWalker<EvaluateVisitor>
 {
 public:
 	SymbolTable* symbolTable;
@@ -23,35 +28,54 @@ public:
 	bool needReturn;
 	bool hasReturn;
 	bool inFuncDef = false;
+	int32_t frameSlots = 0;		// slots handed out so far in the current function
+	const SourceLines* lines = nullptr;	// the root's, to turn locations into lines and columns
+	std::optional<TraceScope> checkingFunction;	// open from entering a definition until leaving it
 
-	void visit(VariableNode* n) override;
-	void visit(DeclarationNode* n) override;
-	void visit(DeclAndAssignNode* n) override;
-	void visit(BinaryOpNode* n) override;
-	void visit(LogicalOpNode* n) override;
-	void visit(RelationalOpNode* n) override;
-	void visit(RootNode* n) override;
-	void visit(BlockNode* n) override;
-	void visit(FuncDefnNode* n) override;
-	void visit(FuncDeclNode* n) override;
-	void visit(FuncCallNode* n) override;
-	void visit(AssignmentNode* n) override;
-	void visit(AugmentedAssignmentNode* n) override;
-	void visit(ReturnNode* n) override;
-	void visit(ConstantBoolNode* n) override;
-	void visit(ConstantCharNode* n) override;
-	void visit(ConstantDoubleNode* n) override;
-	void visit(ConstantFloatNode* n) override;
-	void visit(ConstantIntNode* n) override;
-	void visit(IfNode* n) override;
-	void visit(ForNode* n) override;
-	void visit(WhileNode* n) override;
-	void visit(UnaryNode* n) override;
-	void visit(TernaryNode* n) override;
-	void visit(CastExpressionNode* n) override;
-	void visit(BreakNode* n) override;
-	void visit(ContinueNode* n) override;	
-	void visit(ExpressionStatementNode*) override;
+	LineColumn at(Node* n) const;
+
+	using TreeWalker<EvaluateVisitor>::enter;
+	using TreeWalker<EvaluateVisitor>::before_child;
+	using TreeWalker<EvaluateVisitor>::after_child;
+	using TreeWalker<EvaluateVisitor>::leave;
+
+	bool enter(RootNode* n);
+	bool enter(BlockNode* n);
+	bool enter(FuncDefnNode* n);
+	bool enter(FuncDeclNode* n);
+	bool enter(FuncCallNode* n);
+	bool enter(ReturnNode* n);
+	bool enter(ForNode* n);
+	bool enter(CastExpressionNode* n);
+	bool before_child(DeclAndAssignNode* n, uint32_t slot);
+	bool after_child(BlockNode* n, uint32_t slot);
+	bool after_child(FuncDefnNode* n, uint32_t slot);
+	bool after_child(IfNode* n, uint32_t slot);
+	bool after_child(ForNode* n, uint32_t slot);
+	bool after_child(WhileNode* n, uint32_t slot);
+	bool after_child(TernaryNode* n, uint32_t slot);
+	void leave(VariableNode* n);
+	void leave(DeclarationNode* n);
+	void leave(DeclAndAssignNode* n);
+	void leave(BinaryOpNode* n);
+	void leave(LogicalOpNode* n);
+	void leave(RelationalOpNode* n);
+	void leave(BlockNode* n);
+	void leave(FuncDefnNode* n);
+	void leave(FuncDeclNode* n);
+	void leave(FuncCallNode* n);
+	void leave(AssignmentNode* n);
+	void leave(AugmentedAssignmentNode* n);
+	void leave(ReturnNode* n);
+	void leave(ConstantBoolNode* n);
+	void leave(ConstantCharNode* n);
+	void leave(ConstantDoubleNode* n);
+	void leave(ConstantFloatNode* n);
+	void leave(ConstantIntNode* n);
+	void leave(ForNode* n);
+	void leave(UnaryNode* n);
+	void leave(TernaryNode* n);
+	void leave(CastExpressionNode* n);
 };
 
 #endif // CCC_PRINTER_HPP_INCLUDED
@@ -6,50 +6,49 @@
 
 #include <memory>
 #include <cstdio>
+#include <vector>
 #include "common.hpp"
 #include "nodes.hpp"
+#include "walker.hpp"
 
-class OptimizeVisitor : public NodeVisitor
+class OptimizeVisitor final : public TreeWalker<OptimizeVisitor>
 {
 public:
-	OptimizeVisitor();
+	OptimizeVisitor(AstArena& arena);
+	AstArena& arena;						// where the nodes we make go, with the rest of the tree
 	bool cleanTree;							// once we've looped through the tree without changing anything, we're done
-	std::unique_ptr<Node> replacement_node;	// if we're going to replace a node, hold it here
-	std::unique_ptr<ExpressionNode> repl_expr_node;
-	std::vector<std::unique_ptr<Node>> node_list;	// holds our if statement 
+	Node* replacement_node;					// if we're going to replace a node, hold it here
+	ExpressionNode* repl_expr_node;
+	ArenaVector<Node*> node_list;			// holds our if statement 
+	std::vector<Node*> blockScratch;		// the statements of the blocks we're in, as they're rebuilt
+	std::vector<size_t> blockBases;			// where in blockScratch each of those blocks starts
 	bool insertNodeVector;							// do we wanna insert our if body
 	bool hasReplacement;					// flag for if we have a replacement node or not
 	bool removeNode;						// marks a node for removal
 
-	void visit(VariableNode* n) override;
-	void visit(DeclarationNode* n) override;
-	void visit(DeclAndAssignNode* n) override;
-	void visit(BinaryOpNode* n) override;
-	void visit(LogicalOpNode* n) override;
-	void visit(RelationalOpNode* n) override;
-	void visit(RootNode* n) override;
-	void visit(BlockNode* n) override;
-	void visit(FuncDefnNode* n) override;
-	void visit(FuncDeclNode* n) override;
-	void visit(FuncCallNode* n) override;
-	void visit(AssignmentNode* n) override;
-	void visit(AugmentedAssignmentNode* n) override;
-	void visit(ReturnNode* n) override;
-	void visit(ConstantBoolNode* n) override;
-	void visit(ConstantCharNode* n) override;
-	void visit(ConstantDoubleNode* n) override;
-	void visit(ConstantFloatNode* n) override;
-	void visit(ConstantIntNode* n) override;
-	void visit(IfNode* n) override;
-	void visit(ForNode* n) override;
-	void visit(WhileNode* n) override;
-	void visit(UnaryNode* n) override;
-	void visit(TernaryNode* n) override;
-	void visit(CastExpressionNode* n) override;
-	void visit(BreakNode* n) override;
-	void visit(ContinueNode* n) override;	
-	void visit(ExpressionStatementNode*) override;
+	using TreeWalker<OptimizeVisitor>::enter;
+	using TreeWalker<OptimizeVisitor>::before_child;
+	using TreeWalker<OptimizeVisitor>::leave;
 
+	bool enter(BinaryOpNode* n);
+	bool enter(LogicalOpNode* n);
+	bool enter(BlockNode* n);
+	bool enter(FuncDeclNode* n);
+	bool before_child(ForNode* n, uint32_t slot);
+	bool after_child(Node* n, uint32_t slot);
+	bool after_child(BlockNode* n, uint32_t slot);
+	bool after_child(IfNode* n, uint32_t slot);
+	bool after_child(WhileNode* n, uint32_t slot);
+	void leave(BinaryOpNode* n);
+	void leave(LogicalOpNode* n);
+	void leave(RelationalOpNode* n);
+	void leave(BlockNode* n);
+	void leave(UnaryNode* n);
+	void leave(TernaryNode* n);
+	void leave(CastExpressionNode* n);
+
+private:
+	void take_replacement(Node* n, uint32_t slot);
 };
 
 #endif // CCC_PRINTER_HPP_INCLUDED
@@ -8,40 +8,72 @@
 #include <cstdio>
 #include "common.hpp"
 #include "nodes.hpp"
+#include "walker.hpp"
 
-class PrintVisitor : public NodeVisitor
+class PrintVisitor final : public TreeWalker<PrintVisitor>
 {
 public:
 	int indent_level = 0;
-	void visit(VariableNode* n) override;
-	void visit(DeclarationNode* n) override;
-	void visit(DeclAndAssignNode* n) override;
-	void visit(BinaryOpNode* n) override;
-	void visit(LogicalOpNode* n) override;
-	void visit(RelationalOpNode* n) override;
-	void visit(RootNode* n) override;
-	void visit(BlockNode* n) override;
-	void visit(FuncDefnNode* n) override;
-	void visit(FuncDeclNode* n) override;
-	void visit(FuncCallNode* n) override;
-	void visit(AssignmentNode* n) override;
-	void visit(AugmentedAssignmentNode* n) override;
-	void visit(ReturnNode* n) override;
-	void visit(ConstantBoolNode* n) override;
-	void visit(ConstantCharNode* n) override;
-	void visit(ConstantDoubleNode* n) override;
-	void visit(ConstantFloatNode* n) override;
-	void visit(ConstantIntNode* n) override;
-	void visit(IfNode* n) override;
-	void visit(ForNode* n) override;
-	void visit(WhileNode* n) override;
-	void visit(UnaryNode* n) override;
-	void visit(TernaryNode* n) override;
-	void visit(CastExpressionNode* n) override;
-	void visit(BreakNode* n) override;
-	void visit(ContinueNode* n) override;	
-	void visit(ExpressionStatementNode*) override;
+	const SourceLines* lines = nullptr;	// the root's, to turn locations into lines and columns
+
+	using TreeWalker<PrintVisitor>::enter;
+	using TreeWalker<PrintVisitor>::before_child;
+	using TreeWalker<PrintVisitor>::leave;
+
+	bool enter(VariableNode* n);
+	bool enter(DeclarationNode* n);
+	bool enter(DeclAndAssignNode* n);
+	bool enter(BinaryOpNode* n);
+	bool enter(LogicalOpNode* n);
+	bool enter(RelationalOpNode* n);
+	bool enter(RootNode* n);
+	bool enter(BlockNode* n);
+	bool enter(FuncDefnNode* n);
+	bool enter(FuncDeclNode* n);
+	bool enter(FuncCallNode* n);
+	bool enter(AssignmentNode* n);
+	bool enter(AugmentedAssignmentNode* n);
+	bool enter(ReturnNode* n);
+	bool enter(ConstantBoolNode* n);
+	bool enter(ConstantCharNode* n);
+	bool enter(ConstantDoubleNode* n);
+	bool enter(ConstantFloatNode* n);
+	bool enter(ConstantIntNode* n);
+	bool enter(IfNode* n);
+	bool enter(ForNode* n);
+	bool enter(WhileNode* n);
+	bool enter(UnaryNode* n);
+	bool enter(TernaryNode* n);
+	bool enter(CastExpressionNode* n);
+	bool enter(BreakNode* n);
+	bool enter(ContinueNode* n);
+	bool before_child(DeclAndAssignNode* n, uint32_t slot);
+	bool before_child(BinaryOpNode* n, uint32_t slot);
+	bool before_child(LogicalOpNode* n, uint32_t slot);
+	bool before_child(RelationalOpNode* n, uint32_t slot);
+	bool before_child(ForNode* n, uint32_t slot);
+	bool before_child(TernaryNode* n, uint32_t slot);
+	void leave(DeclAndAssignNode* n);
+	void leave(BinaryOpNode* n);
+	void leave(LogicalOpNode* n);
+	void leave(RelationalOpNode* n);
+	void leave(RootNode* n);
+	void leave(BlockNode* n);
+	void leave(FuncDefnNode* n);
+	void leave(FuncDeclNode* n);
+	void leave(FuncCallNode* n);
+	void leave(AssignmentNode* n);
+	void leave(AugmentedAssignmentNode* n);
+	void leave(ReturnNode* n);
+	void leave(IfNode* n);
+	void leave(ForNode* n);
+	void leave(WhileNode* n);
+	void leave(UnaryNode* n);
+	void leave(TernaryNode* n);
+	void leave(CastExpressionNode* n);
 	void indent();
+	void close();
+	LineColumn at(Node* n) const;
 };
 
 #endif // CCC_PRINTER_HPP_INCLUDED
@@ -0,0 +1,367 @@
+/*
+	walker.hpp
+	Walking the AST with an explicit stack instead of recursion.
+
+	A visitor that dispatches to its own children takes a native stack frame
+	or two for every level of the tree, so a long enough chain of
+	a + a + a + ... or enough nested blocks runs the thread out of stack.
+	TreeWalker keeps the nodes it's partway through in a vector instead, so
+	how deep a tree can go only depends on the heap.
+
+	The walker calls whichever of these hooks Derived has, with n cast to its
+	own class:
+		bool enter(T* n)						before n's children. false skips
+												them, leave is still called
+		bool before_child(T* n, uint32_t slot)	before each child, empty slots
+												included (a For with no init).
+												false skips that child
+		bool after_child(T* n, uint32_t slot)	after each child that was walked.
+												false skips the rest of them
+		void leave(T* n)						after n's children
+		uint32_t child_slot(T* n, uint32_t k)	the slot to walk kth, for a walker
+												that has to take them out of order
+	T can be any node class, or Node for a hook that's the same for all of
+	them. Like any other overloads, a walker that declares some of a hook
+	has to bring the defaults back in with using for the rest.
+*/
+
+#ifndef CCC_WALKER_HPP_INCLUDED
+#define CCC_WALKER_HPP_INCLUDED
+
+#include <cstdint>
+#include <vector>
+#include "nodes.hpp"
+
+// calls f with n cast to its own class. A switch on the kind rather than a
+// virtual call, so when f is a hook of a final walker it can be inlined
+template <typename F> inline decltype(auto) with_kind(Node* n, F&& f)
+{
+	switch (n->kind)
+	{
+		case NodeKind::Variable: return f(static_cast<VariableNode*>(n));
+		case NodeKind::Declaration: return f(static_cast<DeclarationNode*>(n));
+		case NodeKind::DeclAndAssign: return f(static_cast<DeclAndAssignNode*>(n));
+		case NodeKind::BinaryOp: return f(static_cast<BinaryOpNode*>(n));
+		case NodeKind::RelationalOp: return f(static_cast<RelationalOpNode*>(n));
+		case NodeKind::LogicalOp: return f(static_cast<LogicalOpNode*>(n));
+		case NodeKind::Root: return f(static_cast<RootNode*>(n));
+		case NodeKind::Block: return f(static_cast<BlockNode*>(n));
+		case NodeKind::FuncDefn: return f(static_cast<FuncDefnNode*>(n));
+		case NodeKind::FuncDecl: return f(static_cast<FuncDeclNode*>(n));
+		case NodeKind::FuncCall: return f(static_cast<FuncCallNode*>(n));
+		case NodeKind::Assignment: return f(static_cast<AssignmentNode*>(n));
+		case NodeKind::AugmentedAssignment: return f(static_cast<AugmentedAssignmentNode*>(n));
+		case NodeKind::ConstantBool: return f(static_cast<ConstantBoolNode*>(n));
+		case NodeKind::ConstantInt: return f(static_cast<ConstantIntNode*>(n));
+		case NodeKind::ConstantFloat: return f(static_cast<ConstantFloatNode*>(n));
+		case NodeKind::ConstantChar: return f(static_cast<ConstantCharNode*>(n));
+		case NodeKind::ConstantDouble: return f(static_cast<ConstantDoubleNode*>(n));
+		case NodeKind::If: return f(static_cast<IfNode*>(n));
+		case NodeKind::For: return f(static_cast<ForNode*>(n));
+		case NodeKind::While: return f(static_cast<WhileNode*>(n));
+		case NodeKind::Unary: return f(static_cast<UnaryNode*>(n));
+		case NodeKind::Ternary: return f(static_cast<TernaryNode*>(n));
+		case NodeKind::CastExpression: return f(static_cast<CastExpressionNode*>(n));
+		case NodeKind::Return: return f(static_cast<ReturnNode*>(n));
+		case NodeKind::Break: return f(static_cast<BreakNode*>(n));
+		case NodeKind::Continue: return f(static_cast<ContinueNode*>(n));
+		case NodeKind::ExpressionStatement: return f(static_cast<ExpressionStatementNode*>(n));
+	}
+	__builtin_unreachable();
+}
+
+// Every node's children numbered from 0, in source order. A For always has
+// its four slots (init, condition, update, body) and a Return its one, even
+// when they're empty
+inline uint32_t node_child_count(Node* n)
+{
+	switch (n->kind)
+	{
+		case NodeKind::Root:
+			return static_cast<RootNode*>(n)->funcs.size();
+		case NodeKind::Block:
+			return static_cast<BlockNode*>(n)->stmts.size();
+		case NodeKind::FuncDecl:
+			return static_cast<FuncDeclNode*>(n)->params.size();
+		case NodeKind::FuncCall:
+			return static_cast<FuncCallNode*>(n)->funcArgs.size();
+		case NodeKind::For:
+			return 4;
+		case NodeKind::Ternary:
+			return 3;
+		case NodeKind::DeclAndAssign:
+		case NodeKind::BinaryOp:
+		case NodeKind::RelationalOp:
+		case NodeKind::LogicalOp:
+		case NodeKind::FuncDefn:
+		case NodeKind::If:
+		case NodeKind::While:
+			return 2;
+		case NodeKind::Assignment:
+		case NodeKind::AugmentedAssignment:
+		case NodeKind::Unary:
+		case NodeKind::CastExpression:
+		case NodeKind::Return:
+		case NodeKind::ExpressionStatement:
+			return 1;
+		default:
+			return 0;
+	}
+}
+
+inline Node* node_child(Node* n, uint32_t slot)
+{
+	switch (n->kind)
+	{
+		case NodeKind::Root:
+			return static_cast<RootNode*>(n)->funcs[slot];
+		case NodeKind::Block:
+			return static_cast<BlockNode*>(n)->stmts[slot];
+		case NodeKind::FuncDecl:
+			return static_cast<FuncDeclNode*>(n)->params[slot];
+		case NodeKind::FuncCall:
+			return static_cast<FuncCallNode*>(n)->funcArgs[slot];
+		case NodeKind::DeclAndAssign:
+		{
+			DeclAndAssignNode* d = static_cast<DeclAndAssignNode*>(n);
+			return slot == 0 ? static_cast<Node*>(d->decl) : d->expr;
+		}
+		case NodeKind::BinaryOp:
+		{
+			BinaryOpNode* b = static_cast<BinaryOpNode*>(n);
+			return slot == 0 ? b->left : b->right;
+		}
+		case NodeKind::RelationalOp:
+		{
+			RelationalOpNode* r = static_cast<RelationalOpNode*>(n);
+			return slot == 0 ? r->left : r->right;
+		}
+		case NodeKind::LogicalOp:
+		{
+			LogicalOpNode* l = static_cast<LogicalOpNode*>(n);
+			return slot == 0 ? l->left : l->right;
+		}
+		case NodeKind::FuncDefn:
+		{
+			FuncDefnNode* f = static_cast<FuncDefnNode*>(n);
+			return slot == 0 ? f->funcDecl : f->funcBody;
+		}
+		case NodeKind::If:
+		{
+			IfNode* i = static_cast<IfNode*>(n);
+			return slot == 0 ? i->ifExpr : i->ifBody;
+		}
+		case NodeKind::While:
+		{
+			WhileNode* w = static_cast<WhileNode*>(n);
+			return slot == 0 ? w->whileExpr : w->loopBody;
+		}
+		case NodeKind::For:
+		{
+			ForNode* f = static_cast<ForNode*>(n);
+			Node* parts[] = {f->initStmt, f->loopCondExpr, f->updateStmt, f->loopBody};
+			return parts[slot];
+		}
+		case NodeKind::Ternary:
+		{
+			TernaryNode* t = static_cast<TernaryNode*>(n);
+			return slot == 0 ? t->condExpr : slot == 1 ? t->trueExpr : t->falseExpr;
+		}
+		case NodeKind::Assignment:
+			return static_cast<AssignmentNode*>(n)->expr;
+		case NodeKind::AugmentedAssignment:
+			return static_cast<AugmentedAssignmentNode*>(n)->expr;
+		case NodeKind::Unary:
+			return static_cast<UnaryNode*>(n)->expr;
+		case NodeKind::CastExpression:
+			return static_cast<CastExpressionNode*>(n)->expr;
+		case NodeKind::Return:
+			return static_cast<ReturnNode*>(n)->expr;
+		case NodeKind::ExpressionStatement:
+			return static_cast<ExpressionStatementNode*>(n)->expr;
+		default:
+			return nullptr;
+	}
+}
+
+// puts child in the slot. It has to be the kind of node the slot holds, an
+// expression where node_child would give back an expression
+inline void set_node_child(Node* n, uint32_t slot, Node* child)
+{
+	ExpressionNode* expr = static_cast<ExpressionNode*>(child);
+	switch (n->kind)
+	{
+		case NodeKind::Root:
+			static_cast<RootNode*>(n)->funcs[slot] = child;
+			break;
+		case NodeKind::Block:
+			static_cast<BlockNode*>(n)->stmts[slot] = child;
+			break;
+		case NodeKind::FuncDecl:
+			static_cast<FuncDeclNode*>(n)->params[slot] = cast<DeclarationNode>(child);
+			break;
+		case NodeKind::FuncCall:
+			static_cast<FuncCallNode*>(n)->funcArgs[slot] = expr;
+			break;
+		case NodeKind::DeclAndAssign:
+		{
+			DeclAndAssignNode* d = static_cast<DeclAndAssignNode*>(n);
+			if (slot == 0)
+				d->decl = cast<DeclarationNode>(child);
+			else
+				d->expr = expr;
+			break;
+		}
+		case NodeKind::BinaryOp:
+		{
+			BinaryOpNode* b = static_cast<BinaryOpNode*>(n);
+			(slot == 0 ? b->left : b->right) = expr;
+			break;
+		}
+		case NodeKind::RelationalOp:
+		{
+			RelationalOpNode* r = static_cast<RelationalOpNode*>(n);
+			(slot == 0 ? r->left : r->right) = expr;
+			break;
+		}
+		case NodeKind::LogicalOp:
+		{
+			LogicalOpNode* l = static_cast<LogicalOpNode*>(n);
+			(slot == 0 ? l->left : l->right) = expr;
+			break;
+		}
+		case NodeKind::FuncDefn:
+		{
+			FuncDefnNode* f = static_cast<FuncDefnNode*>(n);
+			if (slot == 0)
+				f->funcDecl = cast<FuncDeclNode>(child);
+			else
+				f->funcBody = child;
+			break;
+		}
+		case NodeKind::If:
+		{
+			IfNode* i = static_cast<IfNode*>(n);
+			if (slot == 0)
+				i->ifExpr = expr;
+			else
+				i->ifBody = child;
+			break;
+		}
+		case NodeKind::While:
+		{
+			WhileNode* w = static_cast<WhileNode*>(n);
+			if (slot == 0)
+				w->whileExpr = expr;
+			else
+				w->loopBody = child;
+			break;
+		}
+		case NodeKind::For:
+		{
+			ForNode* f = static_cast<ForNode*>(n);
+			switch (slot)
+			{
+				case 0: f->initStmt = child; break;
+				case 1: f->loopCondExpr = expr; break;
+				case 2: f->updateStmt = child; break;
+				default: f->loopBody = child; break;
+			}
+			break;
+		}
+		case NodeKind::Ternary:
+		{
+			TernaryNode* t = static_cast<TernaryNode*>(n);
+			(slot == 0 ? t->condExpr : slot == 1 ? t->trueExpr : t->falseExpr) = expr;
+			break;
+		}
+		case NodeKind::Assignment:
+			static_cast<AssignmentNode*>(n)->expr = expr;
+			break;
+		case NodeKind::AugmentedAssignment:
+			static_cast<AugmentedAssignmentNode*>(n)->expr = expr;
+			break;
+		case NodeKind::Unary:
+			static_cast<UnaryNode*>(n)->expr = expr;
+			break;
+		case NodeKind::CastExpression:
+			static_cast<CastExpressionNode*>(n)->expr = expr;
+			break;
+		case NodeKind::Return:
+			static_cast<ReturnNode*>(n)->expr = expr;
+			break;
+		case NodeKind::ExpressionStatement:
+			static_cast<ExpressionStatementNode*>(n)->expr = expr;
+			break;
+		default:
+			break;
+	}
+}
+
+template <typename Derived> class TreeWalker
+{
+private:
+	struct Frame
+	{
+		Node* n;
+		uint32_t next;	// how many of n's children we've got to
+		uint32_t count;	// how many there are to get to
+		uint32_t slot;	// the one being walked right now
+	};
+	std::vector<Frame> stack;
+
+	Derived* self() { return static_cast<Derived*>(this); }
+
+	void push(Node* n)
+	{
+		bool descend = with_kind(n, [this](auto* m) { return this->self()->enter(m); });
+		this->stack.push_back(Frame {n, 0, descend ? node_child_count(n) : 0, 0});
+	}
+
+public:
+	bool enter(Node*) { return true; }
+	bool before_child(Node*, uint32_t) { return true; }
+	bool after_child(Node*, uint32_t) { return true; }
+	void leave(Node*) {}
+	uint32_t child_slot(Node*, uint32_t k) { return k; }
+
+	void walk(Node* root)
+	{
+		// a hook can start a walk of its own, that one just finishes above us
+		size_t base = this->stack.size();
+		this->push(root);
+		while (this->stack.size() > base)
+		{
+			Frame& top = this->stack.back();
+			Node* n = top.n;
+			if (top.next < top.count)
+			{
+				uint32_t k = top.next++;
+				uint32_t slot = with_kind(n, [this, k](auto* m) { return this->self()->child_slot(m, k); });
+				top.slot = slot;
+				// top can move once a hook has run, it's only the stack's from here on
+				Node* child = node_child(n, slot);
+				bool walkChild = with_kind(n, [this, slot](auto* m) { return this->self()->before_child(m, slot); });
+				if (child && walkChild)
+				{
+					this->push(child);
+				}
+				continue;
+			}
+
+			this->stack.pop_back();
+			with_kind(n, [this](auto* m) { this->self()->leave(m); });
+			if (this->stack.size() > base)
+			{
+				Node* parent = this->stack.back().n;
+				uint32_t slot = this->stack.back().slot;
+				if (!with_kind(parent, [this, slot](auto* m) { return this->self()->after_child(m, slot); }))
+				{
+					this->stack.back().next = this->stack.back().count;
+				}
+			}
+		}
+	}
+};
+
+#endif // CCC_WALKER_HPP_INCLUDED
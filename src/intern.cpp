@@ -0,0 +1,89 @@
+/*
+	intern.cpp
+*/
+#include "headers/intern.hpp"
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+
+class Interner
+{
+public:
+	Interner()
+	{
+		this->intern("");
+	}
+
+	Symbol intern(std::string_view name)
+	{
+		auto found = this->ids.find(name);
+		if (found != this->ids.end())
+		{
+			return Symbol {found->second};
+		}
+		// a deque never moves what it already holds, so the views of its
+		// strings the map and the names use stay good
+		const std::string& kept = this->storage.emplace_back(name);
+		uint32_t id = this->names.size();
+		this->names.push_back(kept);
+		this->ids.emplace(kept, id);
+		return Symbol {id};
+	}
+
+	std::string_view name(Symbol s) const
+	{
+		return this->names[s.id];
+	}
+
+	void clear()
+	{
+		// swapping with empty ones gives the memory back, clear() would keep
+		// the map's buckets and the vector's capacity around
+		std::deque<std::string>().swap(this->storage);
+		std::vector<std::string_view>().swap(this->names);
+		std::unordered_map<std::string_view, uint32_t>().swap(this->ids);
+		this->intern("");
+	}
+
+private:
+	std::deque<std::string> storage;
+	std::vector<std::string_view> names;
+	std::unordered_map<std::string_view, uint32_t> ids;
+};
+
+thread_local Interner interner;
+thread_local unsigned openScopes = 0;
+
+}
+
+Symbol intern(std::string_view name)
+{
+	return interner.intern(name);
+}
+
+std::string_view symbol_name(Symbol s)
+{
+	return interner.name(s);
+}
+
+std::ostream& operator<<(std::ostream& out, Symbol s)
+{
+	return out << interner.name(s);
+}
+
+InternScope::InternScope()
+{
+	openScopes++;
+}
+
+InternScope::~InternScope()
+{
+	if (--openScopes == 0)
+	{
+		interner.clear();
+	}
+}
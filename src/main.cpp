@@ -4,14 +4,15 @@
  * testing suites written by Stephen Keith
  */
 
-#include "headers/compiler.hpp"
-#include "headers/nodes.hpp"
-#include "headers/preprocess.hpp"
+#include "headers/driver.hpp"
+#include "headers/server.hpp"
+#include "headers/client.hpp"
+#include "headers/cache.hpp"
+#include "headers/common.hpp"
+#include "headers/trace.hpp"
 #include "headers/main.hpp"
 #include "headers/argsparse.hpp"
-#include "headers/consolecolors.hpp"
-#include <string>
-#include <unistd.h>
+#include <iostream>
 
 /* TODO:
 Don't need or implement later:
@@ -79,76 +80,60 @@ What other operators are there?
 */
 
 
-using namespace std::string_literals;
-
 int main(int argc, char** argv) {
-	std::cout << "cimple c compiler - ccc - Tyler Weston - 2020/2021\n";
- 	cmd_line_args cmds;
-	parse_commands(argc, argv, &cmds);
-	// make sure we got a file
-	if (!cmds.filename)
+	cmd_line_args cmds;
+	if (parse_commands(argc, argv, &cmds) != 0)
 	{
-		std::cout << "Must supply filename to compile\n";
 		return 1;
 	}
-
-	// preprocessing
-	std::cout << "Preprocessing file. " << cmds.filename << " -> " << cmds.filename << ".pp\n";
-	preprocess* pp = new preprocess();
-	pp->preprocess_file(cmds.filename, cmds.filename + ".pp"s);
-
-	// show our lexing if we get the lexing flag
-	if (cmds.lexflag)
+	if (cmds.run)
 	{
-		lex(cmds.filename + ".pp"s);
-	}
-
-
-	// parsing
-	std::cout << "Parsing file " << cmds.filename << ".pp\n";
-	std::unique_ptr<Node> root;
-	int ret = parse(cmds.filename + ".pp"s, root);
-	if (ret != 0) {
-		return 1;
+		// keep stdout for the program we're running, the compiler talks on stderr
+		set_diag(&std::cerr);
 	}
-
-	// semantic analysis
-	std::cout << "Performing semantic analysis\n";
-	if (!verify_ast(root.get())) {
-		std::cout << "Semantic analysis failed.\n";
-		return 1;
+	else
+	{
+		std::cout << "cimple c compiler - ccc - Tyler Weston - 2020/2021\n";
 	}
-	if (cmds.printflag)
+	if (cmds.server)
 	{
-		std::cout << "Generated AST (pre-optimization):\n";
-		print_ast(root.get());
+		return run_server(cmds);
 	}
-
-	// optimization
-	if (cmds.optlevel == 1)
+	if (cmds.server_stats)
 	{
-		std::cout << "Optimizing AST\n";
-		root = optimize(std::move(root));
+		return run_client(cmds);
 	}
-	if (cmds.printflag)
+	if (cmds.cache_stats)
 	{
-		std::cout << "Generated AST (post-optimization):\n";
-		print_ast(root.get());
+		CompilationCache* cache = CompilationCache::get();
+		if (!cache)
+		{
+			std::cout << "The compilation cache is off, set CCC_CACHE_DIR to turn it on\n";
+			return 1;
+		}
+		cache->print_stats(std::cout);
+		return 0;
 	}
-
-	std::cout << "Generating IR\n";
-	std::unique_ptr<CompilationUnit> u = compile(root.get());
-	if (u == nullptr)
+	// make sure we got a file
+	if (cmds.filenames.empty())
 	{
-		std::cout << "[" << RED << "ERROR" << RESET << "] Error generating llvm IR\n";
+		std::cout << "Must supply filename to compile\n";
 		return 1;
 	}
-	u->dump(cmds.filename + ".ll"s, cmds.printir);	// this will be the generated code
-
-	// any cleanup happens here
-	if (!cmds.keep_pp)
-		pp->clean_preprocess_file(cmds.filename + ".pp"s);
 
-	std::cout << "[" << GREEN << "SUCCESS" << RESET << "] All done!\n";
-	return 0;
+	if (cmds.client && !cmds.run)
+	{
+		return run_client(cmds);
+	}
+	bool tracing = cmds.time_report || !cmds.trace_file.empty();
+	if (tracing)
+	{
+		trace_start();
+	}
+	int ret = cmds.run ? run_file(cmds) : compile_files(cmds);
+	if (tracing && !trace_finish(cmds.trace_file, cmds.time_report, diag()))
+	{
+		ret = 1;
+	}
+	return ret;
 }
@@ -1,11 +1,9 @@
 #include "headers/nodes.hpp"
 
-Node::~Node() = default;
-
-RootNode::RootNode(std::vector<std::unique_ptr<Node>> funcs) { this->funcs = std::move(funcs); }
+RootNode::RootNode(ArenaVector<Node*> funcs) : Node(Kind) { this->funcs = funcs; }
 void RootNode::accept(NodeVisitor* v) { v->visit(this); }
 
-ConstantIntNode::ConstantIntNode(int in) 
+ConstantIntNode::ConstantIntNode(int in) : ExpressionNode(Kind) 
 { 
 	this->intValue = in; 
 	this->isConstant = true; 
@@ -13,7 +11,7 @@ ConstantIntNode::ConstantIntNode(int in)
 } 
 void ConstantIntNode::accept(NodeVisitor* v) { v->visit(this); }
 
-ConstantFloatNode::ConstantFloatNode(float in) 
+ConstantFloatNode::ConstantFloatNode(float in) : ExpressionNode(Kind) 
 { 
 	this->floatValue = in; 
 	this->isConstant = true; 
@@ -21,7 +19,7 @@ ConstantFloatNode::ConstantFloatNode(float in)
 }
 void ConstantFloatNode::accept(NodeVisitor* v) { v->visit(this); }
 
-ConstantBoolNode::ConstantBoolNode(bool in) 
+ConstantBoolNode::ConstantBoolNode(bool in) : ExpressionNode(Kind) 
 { 
 	this->boolValue = in; 
 	this->isConstant = true; 
@@ -29,7 +27,7 @@ ConstantBoolNode::ConstantBoolNode(bool in)
 }
 void ConstantBoolNode::accept(NodeVisitor* v) { v->visit(this); }
 
-ConstantCharNode::ConstantCharNode(char in)
+ConstantCharNode::ConstantCharNode(char in) : ExpressionNode(Kind)
 {
 	this->charValue = in;
 	this->isConstant = true;
@@ -37,7 +35,7 @@ ConstantCharNode::ConstantCharNode(char in)
 }
 void ConstantCharNode::accept(NodeVisitor* v) { v->visit(this); }
 
-ConstantDoubleNode::ConstantDoubleNode(double in)
+ConstantDoubleNode::ConstantDoubleNode(double in) : ExpressionNode(Kind)
 {
 	this->doubleValue = in;
 	this->isConstant = true;
@@ -45,154 +43,154 @@ ConstantDoubleNode::ConstantDoubleNode(double in)
 }
 void ConstantDoubleNode::accept(NodeVisitor* v) { v->visit(this); }
 
-VariableNode::VariableNode(std::string in): name(in) {
+VariableNode::VariableNode(Symbol in): ExpressionNode(Kind), name(in) {
 	this->isConstant = false;
 }
 void VariableNode::accept(NodeVisitor* v) { v->visit(this); }
 
-BreakNode::BreakNode() {;}
+BreakNode::BreakNode() : StatementNode(Kind) {;}
 void BreakNode::accept(NodeVisitor* v) { v->visit(this); }
 
-ContinueNode::ContinueNode() {;}
+ContinueNode::ContinueNode() : StatementNode(Kind) {;}
 void ContinueNode::accept(NodeVisitor* v) { v->visit(this); }
 
 
-ReturnNode::ReturnNode(std::unique_ptr<ExpressionNode> expr) 
+ReturnNode::ReturnNode(ExpressionNode* expr) : StatementNode(Kind) 
 { 
-	this->expr = std::move(expr); 
+	this->expr = expr; 
 }
 void ReturnNode::accept(NodeVisitor* v) { v->visit(this); }
 
-FuncDeclNode::FuncDeclNode(TypeName t, std::string name, std::vector<std::unique_ptr<DeclarationNode>> params)
+FuncDeclNode::FuncDeclNode(TypeName t, Symbol name, ArenaVector<DeclarationNode*> params) : Node(Kind)
 {
   this->t = t;
-  this->name = std::move(name); 
-  this->params = std::move(params);
+  this->name = name; 
+  this->params = params;
 }
 void FuncDeclNode::accept(NodeVisitor* v) { v->visit(this); }
 
-FuncDefnNode::FuncDefnNode(std::unique_ptr<FuncDeclNode> funcDecl, std::unique_ptr<Node> funcBody)
+FuncDefnNode::FuncDefnNode(FuncDeclNode* funcDecl, Node* funcBody) : Node(Kind)
 {
-	this->funcDecl = std::move(funcDecl);
-	this->funcBody = std::move(funcBody);
+	this->funcDecl = funcDecl;
+	this->funcBody = funcBody;
 }
 void FuncDefnNode::accept(NodeVisitor* v) { v->visit(this); }
 
-FuncCallNode::FuncCallNode(std::string name, std::vector<std::unique_ptr<ExpressionNode>> funcArgs)
+FuncCallNode::FuncCallNode(Symbol name, ArenaVector<ExpressionNode*> funcArgs) : ExpressionNode(Kind)
 {
-	this->name = std::move(name);
-	this->funcArgs = std::move(funcArgs);
+	this->name = name;
+	this->funcArgs = funcArgs;
 }
 void FuncCallNode::accept(NodeVisitor* v) { v->visit(this); }
 
-DeclarationNode::DeclarationNode(TypeName t, std::string name, bool isConstant)
+DeclarationNode::DeclarationNode(TypeName t, Symbol name, bool isConstant) : StatementNode(Kind)
 {
   this->t = t;
-  this->name = std::move(name); 
+  this->name = name; 
   this->isConstant = isConstant;
 }
 void DeclarationNode::accept(NodeVisitor* v) { v->visit(this); }
 
-DeclAndAssignNode::DeclAndAssignNode(std::unique_ptr<DeclarationNode> decl, std::unique_ptr<ExpressionNode> expr)
+DeclAndAssignNode::DeclAndAssignNode(DeclarationNode* decl, ExpressionNode* expr) : StatementNode(Kind)
 {
-  this->decl = std::move(decl);
-  this->expr = std::move(expr);	
+  this->decl = decl;
+  this->expr = expr;	
 }
 void DeclAndAssignNode::accept(NodeVisitor* v) { v->visit(this); }
 
-BinaryOpNode::BinaryOpNode(BinaryOps op, std::unique_ptr<ExpressionNode> left, std::unique_ptr<ExpressionNode> right)
+BinaryOpNode::BinaryOpNode(BinaryOps op, ExpressionNode* left, ExpressionNode* right) : ExpressionNode(Kind)
 {
 	this->op = op;
-	this->left = std::move(left); 	// might be able to add this to parser.y so $1 -> std::move($1)
-	this->right = std::move(right);
+	this->left = left; 
+	this->right = right;
 }
 void BinaryOpNode::accept(NodeVisitor* v) { v->visit(this); }
 
-RelationalOpNode::RelationalOpNode(RelationalOps op, std::unique_ptr<ExpressionNode> left, std::unique_ptr<ExpressionNode> right)
+RelationalOpNode::RelationalOpNode(RelationalOps op, ExpressionNode* left, ExpressionNode* right) : ExpressionNode(Kind)
 {
 	this->op = op;
-	this->left = std::move(left);
-	this->right = std::move(right);
+	this->left = left;
+	this->right = right;
 }
 void RelationalOpNode::accept(NodeVisitor* v) { v->visit(this); }
 
-LogicalOpNode::LogicalOpNode(BinaryOps op, std::unique_ptr<ExpressionNode> left, std::unique_ptr<ExpressionNode> right)
+LogicalOpNode::LogicalOpNode(BinaryOps op, ExpressionNode* left, ExpressionNode* right) : ExpressionNode(Kind)
 {
 	this->op = op;
-	this->left = std::move(left); 	// might be able to add this to parser.y so $1 -> std::move($1)
-	this->right = std::move(right);
+	this->left = left; 
+	this->right = right;
 }
 void LogicalOpNode::accept(NodeVisitor* v) { v->visit(this); }
 
-AssignmentNode::AssignmentNode(std::string name, std::unique_ptr<ExpressionNode> expr)
+AssignmentNode::AssignmentNode(Symbol name, ExpressionNode* expr) : StatementNode(Kind)
 {
-	this->name = std::move(name);
-	this->expr = std::move(expr);
+	this->name = name;
+	this->expr = expr;
 }
 void AssignmentNode::accept(NodeVisitor* v) { v->visit(this); }
 
-AugmentedAssignmentNode::AugmentedAssignmentNode(AugmentedAssignOps op, std::string name, std::unique_ptr<ExpressionNode> expr)
+AugmentedAssignmentNode::AugmentedAssignmentNode(AugmentedAssignOps op, Symbol name, ExpressionNode* expr) : StatementNode(Kind)
 {
 	this->op = op;
-	this->name = std::move(name);
-	this->expr = std::move(expr);
+	this->name = name;
+	this->expr = expr;
 }
 void AugmentedAssignmentNode::accept(NodeVisitor* v) { v->visit(this); }
 
-IfNode::IfNode(std::unique_ptr<ExpressionNode> ifExpr, std::unique_ptr<Node> ifBody)
+IfNode::IfNode(ExpressionNode* ifExpr, Node* ifBody) : StatementNode(Kind)
 {
-	this->ifExpr = std::move(ifExpr);
-	this->ifBody = std::move(ifBody);
+	this->ifExpr = ifExpr;
+	this->ifBody = ifBody;
 }
 void IfNode::accept(NodeVisitor* v) { v->visit(this); }
 
-ForNode::ForNode(std::unique_ptr<Node> initStmt, std::unique_ptr<ExpressionNode> loopCondExpr, std::unique_ptr<Node> updateStmt, std::unique_ptr<Node> loopBody)
+ForNode::ForNode(Node* initStmt, ExpressionNode* loopCondExpr, Node* updateStmt, Node* loopBody) : StatementNode(Kind)
 {
-	this->initStmt = std::move(initStmt);
-	this->loopCondExpr = std::move(loopCondExpr);
-	this->updateStmt = std::move(updateStmt);
+	this->initStmt = initStmt;
+	this->loopCondExpr = loopCondExpr;
+	this->updateStmt = updateStmt;
 
-	this->loopBody = std::move(loopBody);
+	this->loopBody = loopBody;
 }
 void ForNode::accept(NodeVisitor* v) { v->visit(this); }
 
-WhileNode::WhileNode(std::unique_ptr<ExpressionNode> whileExpr, std::unique_ptr<Node> loopBody)
+WhileNode::WhileNode(ExpressionNode* whileExpr, Node* loopBody) : StatementNode(Kind)
 {
-	this->whileExpr = std::move(whileExpr);
-	this->loopBody = std::move(loopBody);
+	this->whileExpr = whileExpr;
+	this->loopBody = loopBody;
 }
 void WhileNode::accept(NodeVisitor* v) { v->visit(this); }
 
-TernaryNode::TernaryNode(std::unique_ptr<ExpressionNode> condExpr, std::unique_ptr<ExpressionNode> trueExpr, std::unique_ptr<ExpressionNode> falseExpr)
+TernaryNode::TernaryNode(ExpressionNode* condExpr, ExpressionNode* trueExpr, ExpressionNode* falseExpr) : ExpressionNode(Kind)
 {
-	this->condExpr = std::move(condExpr);
-	this->trueExpr = std::move(trueExpr);
-	this->falseExpr = std::move(falseExpr);
+	this->condExpr = condExpr;
+	this->trueExpr = trueExpr;
+	this->falseExpr = falseExpr;
 }
 void TernaryNode::accept(NodeVisitor* v) { v->visit(this); }
 
-UnaryNode::UnaryNode(UnaryOps op, std::unique_ptr<ExpressionNode> expr)
+UnaryNode::UnaryNode(UnaryOps op, ExpressionNode* expr) : ExpressionNode(Kind)
 {
-	this->expr = std::move(expr);
+	this->expr = expr;
 	this->op = op;
 }
 void UnaryNode::accept(NodeVisitor* v) { v->visit(this); }
 
-BlockNode::BlockNode(std::vector<std::unique_ptr<Node>> stmts)
+BlockNode::BlockNode(ArenaVector<Node*> stmts) : Node(Kind)
 {
-	this->stmts = std::move(stmts);
+	this->stmts = stmts;
 }
 void BlockNode::accept(NodeVisitor* v) { v->visit(this); }
 
-CastExpressionNode::CastExpressionNode(TypeName t, std::unique_ptr<ExpressionNode> expr)
+CastExpressionNode::CastExpressionNode(TypeName t, ExpressionNode* expr) : ExpressionNode(Kind)
 {
 	this->t = t;
-	this->expr = std::move(expr);
+	this->expr = expr;
 }
 void CastExpressionNode::accept(NodeVisitor* v) { v->visit(this); }
 
-ExpressionStatementNode::ExpressionStatementNode(std::unique_ptr<ExpressionNode> expr)
+ExpressionStatementNode::ExpressionStatementNode(ExpressionNode* expr) : StatementNode(Kind)
 {
-	this->expr = std::move(expr);
+	this->expr = expr;
 }
 void ExpressionStatementNode::accept(NodeVisitor* v) { v->visit(this); }
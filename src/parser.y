@@ -2,16 +2,12 @@
 
 // this will be added to your parser.hpp file
 
-#ifndef YY_TYPEDEF_YY_SCANNER_T
-#define YY_TYPEDEF_YY_SCANNER_T
-typedef void* yyscan_t;
-#endif
-
 #include "headers/nodes.hpp"
 #include "headers/common.hpp"
-#include <memory>
+#include "headers/arena.hpp"
 
 class Node;
+class Lexer;
 
 }
 
@@ -21,9 +17,9 @@ class Node;
 
 #include "headers/lexer.hpp"
 
-static yy::parser::symbol_type yylex(yyscan_t);
+static yy::parser::symbol_type yylex(Lexer&);
 
-template <typename T, typename... Args> static std::unique_ptr<T> make_node(yy::parser::location_type const&, Args&&...);
+template <typename T, typename... Args> static T* make_node(AstArena&, yy::parser::location_type const&, Args&&...);
 
 }
 
@@ -32,8 +28,10 @@ template <typename T, typename... Args> static std::unique_ptr<T> make_node(yy::
 %require "3.6"
 %language "c++"
 %locations
-%param { yyscan_t lexer }
-%parse-param { std::unique_ptr<Node>& root }
+%define api.location.type {SourceRange}
+%param { Lexer& lexer }
+%parse-param { AstArena& arena }
+%parse-param { Node*& root }
 %verbose
 %define api.value.type variant
 %define api.token.constructor
@@ -44,7 +42,7 @@ template <typename T, typename... Args> static std::unique_ptr<T> make_node(yy::
 /* Define our tokens here */
 
 // value holding tokens
-%token <std::string> TOK_IDENTIFIER
+%token <Symbol> TOK_IDENTIFIER
 %token <char> TOK_CHAR
 %token <int> TOK_INTEGER
 %token <float> TOK_FLOAT
@@ -100,47 +98,47 @@ template <typename T, typename... Args> static std::unique_ptr<T> make_node(yy::
 
 // Easier way to do this?
 
-%type <std::unique_ptr<Node>> root
+%type <Node*> root
 
-%type <std::vector<std::unique_ptr<Node>>> function_list
-%type <std::unique_ptr<Node>> function
-%type <std::unique_ptr<FuncDeclNode>> function_decl
-%type <std::unique_ptr<Node>> function_defn
+%type <ArenaVector<Node*>> function_list
+%type <Node*> function
+%type <FuncDeclNode*> function_decl
+%type <Node*> function_defn
 
-%type <std::vector<std::unique_ptr<DeclarationNode>>> parameter_list
-%type <std::vector<std::unique_ptr<DeclarationNode>>> non_empty_parameter_list
+%type <ArenaVector<DeclarationNode*>> parameter_list
+%type <ArenaVector<DeclarationNode*>> non_empty_parameter_list
 
-%type <std::unique_ptr<Node>> block
-%type <std::vector<std::unique_ptr<Node>>> suite
+%type <Node*> block
+%type <ArenaVector<Node*>> suite
 
-%type <std::unique_ptr<DeclarationNode>> declaration
-%type <std::unique_ptr<StatementNode>> statement
-%type <std::unique_ptr<StatementNode>> single_statement
-%type <std::unique_ptr<ExpressionNode>> maybe_expression
-%type <std::unique_ptr<ExpressionNode>> expression
-%type <std::unique_ptr<StatementNode>> compound_statement
-%type <std::unique_ptr<Node>> maybe_single_statement
-%type <std::unique_ptr<ExpressionNode>> ternary_expression
-%type <std::unique_ptr<ExpressionNode>> unary_expression
-%type <std::unique_ptr<ExpressionNode>> binary_expression
+%type <DeclarationNode*> declaration
+%type <StatementNode*> statement
+%type <StatementNode*> single_statement
+%type <ExpressionNode*> maybe_expression
+%type <ExpressionNode*> expression
+%type <StatementNode*> compound_statement
+%type <Node*> maybe_single_statement
+%type <ExpressionNode*> ternary_expression
+%type <ExpressionNode*> unary_expression
+%type <ExpressionNode*> binary_expression
 
-// %type <std::unique_ptr<ExpressionNode>> logical_expression
+// %type <ExpressionNode*> logical_expression
 
-%type <std::unique_ptr<ExpressionNode>> relational_expression
+%type <ExpressionNode*> relational_expression
 
-/* %type <std::unique_ptr<Node>> unary_op */	// we remove this since we only have a single unary operator
+/* %type <Node*> unary_op */	// we remove this since we only have a single unary operator
 
-%type <std::unique_ptr<ExpressionNode>> cast_expression
-%type <std::unique_ptr<ExpressionNode>> function_call
+%type <ExpressionNode*> cast_expression
+%type <ExpressionNode*> function_call
 
-%type <std::vector<std::unique_ptr<ExpressionNode>>> func_args
-%type <std::vector<std::unique_ptr<ExpressionNode>>> non_empty_func_args
+%type <ArenaVector<ExpressionNode*>> func_args
+%type <ArenaVector<ExpressionNode*>> non_empty_func_args
 
 %type <AugmentedAssignOps> augmented_assign
 // %type <BinaryOps> binary_op
 // %type <RelationalOps> relational_op
 %type <TypeName> type
-%type <std::string> name
+%type <Symbol> name
 
 
 %start root
@@ -153,14 +151,18 @@ template <typename T, typename... Args> static std::unique_ptr<T> make_node(yy::
 
 root
 	: function_list	
-		{ this->root = make_node<RootNode>(@$, $1); }
+		{
+			RootNode* r = make_node<RootNode>(arena, @$, $1);
+			r->lines = lexer.lines();
+			this->root = r;
+		}
 	;
 
 /* A function list is one or more functions */
 function_list
 	: function 						
 		{ 		
-			$$ = std::vector<std::unique_ptr<Node>>{}; 
+			$$ = ArenaVector<Node*>(arena); 
 			$$.push_back($1);
 		}
 	| function_list function 		
@@ -179,12 +181,12 @@ function
 
 function_decl
 	: type name TOK_LPAREN parameter_list TOK_RPAREN	
-		{ $$ = make_node<FuncDeclNode>(@$, $1, $2, $4); }
+		{ $$ = make_node<FuncDeclNode>(arena, @$, $1, $2, $4); }
 	;
 
 function_defn
 	: function_decl block 
-		{ $$ = make_node<FuncDefnNode>(@$, $1, $2); }
+		{ $$ = make_node<FuncDefnNode>(arena, @$, $1, $2); }
 	;
 
 type
@@ -202,7 +204,7 @@ name
 parameter_list
 	: %empty 
 		{ 
-			$$ = std::vector<std::unique_ptr<DeclarationNode>>{}; 
+			$$ = ArenaVector<DeclarationNode*>(arena); 
 		}
 	| non_empty_parameter_list 
 		{ 
@@ -213,7 +215,7 @@ parameter_list
 non_empty_parameter_list
 	: declaration
 		{ 	
-			$$ = std::vector<std::unique_ptr<DeclarationNode>>{}; 
+			$$ = ArenaVector<DeclarationNode*>(arena); 
 			$$.push_back($1);
 		}
 	| non_empty_parameter_list TOK_COMMA declaration
@@ -224,12 +226,12 @@ non_empty_parameter_list
 
 block
 	: TOK_LBRACE suite TOK_RBRACE 
-		{ $$ = make_node<BlockNode>(@$, $2); }
+		{ $$ = make_node<BlockNode>(arena, @$, $2); }
 	;
 
 suite								
 	: %empty 
-		{ $$ = std::vector<std::unique_ptr<Node>>{}; }
+		{ $$ = ArenaVector<Node*>(arena); }
 	| suite statement 				
 		{ 
 			$$ = $1; 
@@ -239,9 +241,9 @@ suite
 
 declaration
 	: type name 
-		{ $$ = make_node<DeclarationNode>(@$, $1, $2, false); }
+		{ $$ = make_node<DeclarationNode>(arena, @$, $1, $2, false); }
 	| TOK_CONST type name
-		{ $$ = make_node<DeclarationNode>(@$, $2, $3, true); }
+		{ $$ = make_node<DeclarationNode>(arena, @$, $2, $3, true); }
 	;
 
 statement
@@ -253,38 +255,38 @@ statement
 
 single_statement
 	: declaration TOK_ASSIGN expression 
-		{ $$ = make_node<DeclAndAssignNode>(@$, $1, $3); }
+		{ $$ = make_node<DeclAndAssignNode>(arena, @$, $1, $3); }
 	| name TOK_ASSIGN expression 
-		{ $$ = make_node<AssignmentNode>(@$, $1, $3); }
+		{ $$ = make_node<AssignmentNode>(arena, @$, $1, $3); }
 	| name augmented_assign expression 
-		{ $$ = make_node<AugmentedAssignmentNode>(@$, $2, $1, $3); }
+		{ $$ = make_node<AugmentedAssignmentNode>(arena, @$, $2, $1, $3); }
 	| TOK_DOUBLE 
-		{ $$ = make_node<BreakNode>(@$); }
+		{ $$ = make_node<BreakNode>(arena, @$); }
 	| TOK_CONTINUE 
-		{ $$ = make_node<ContinueNode>(@$); }
+		{ $$ = make_node<ContinueNode>(arena, @$); }
 	| TOK_RETURN 
-		{ $$ = make_node<ReturnNode>(@$, nullptr); }
+		{ $$ = make_node<ReturnNode>(arena, @$, nullptr); }
 	| TOK_RETURN expression 
-		{ $$ = make_node<ReturnNode>(@$, $2); }
+		{ $$ = make_node<ReturnNode>(arena, @$, $2); }
 	| expression 
-		{ $$ = make_node<ExpressionStatementNode>(@$, $1); }
+		{ $$ = make_node<ExpressionStatementNode>(arena, @$, $1); }
 	;
 
 expression
 	: TOK_TRUE 
-		{ $$ = make_node<ConstantBoolNode>(@$, true); }
+		{ $$ = make_node<ConstantBoolNode>(arena, @$, true); }
 	| TOK_FALSE 
-		{ $$ = make_node<ConstantBoolNode>(@$, false); }
+		{ $$ = make_node<ConstantBoolNode>(arena, @$, false); }
 	| TOK_INTEGER 							
-		{ $$ = make_node<ConstantIntNode>(@$, $1); }
+		{ $$ = make_node<ConstantIntNode>(arena, @$, $1); }
 	| TOK_FLOAT 							
-		{ $$ = make_node<ConstantFloatNode>(@$, $1); }
+		{ $$ = make_node<ConstantFloatNode>(arena, @$, $1); }
 	| TOK_CHAR
-		{ $$ = make_node<ConstantCharNode>(@$, $1); }
+		{ $$ = make_node<ConstantCharNode>(arena, @$, $1); }
 	| TOK_DOUBLE
-		{ $$ = make_node<ConstantDoubleNode>(@$, $1); }
+		{ $$ = make_node<ConstantDoubleNode>(arena, @$, $1); }
 	| name									
-		{ $$ = make_node<VariableNode>(@$, $1); }
+		{ $$ = make_node<VariableNode>(arena, @$, $1); }
 	| ternary_expression
 		{ $$ = $1; }
 	| binary_expression
@@ -303,11 +305,11 @@ expression
 
 compound_statement
 	: TOK_IF TOK_LPAREN expression TOK_RPAREN block 	
-		{ $$ = make_node<IfNode>(@$, $3, $5); }
+		{ $$ = make_node<IfNode>(arena, @$, $3, $5); }
 	| TOK_FOR TOK_LPAREN maybe_single_statement TOK_SEMICOLON maybe_expression TOK_SEMICOLON maybe_single_statement TOK_RPAREN block 
-		{ $$ = make_node<ForNode>(@$, $3, $5, $7, $9); }
+		{ $$ = make_node<ForNode>(arena, @$, $3, $5, $7, $9); }
 	| TOK_WHILE TOK_LPAREN expression TOK_RPAREN block 	
-		{ $$ = make_node<WhileNode>(@$, $3, $5); }
+		{ $$ = make_node<WhileNode>(arena, @$, $3, $5); }
 	; 
 
 maybe_single_statement
@@ -326,48 +328,48 @@ maybe_expression
 
 unary_expression
 	: TOK_MINUS expression %prec HI_PREC 		
-		{ $$ = make_node<UnaryNode>(@$, UnaryOps::Minus, $2); }	
+		{ $$ = make_node<UnaryNode>(arena, @$, UnaryOps::Minus, $2); }	
 	| TOK_BIT_NOT expression %prec HI_PREC 		
-		{ $$ = make_node<UnaryNode>(@$, UnaryOps::Not, $2); }
+		{ $$ = make_node<UnaryNode>(arena, @$, UnaryOps::Not, $2); }
 	;
 
 binary_expression
-	: expression TOK_PLUS expression 	{ $$ = make_node<BinaryOpNode>(@$, BinaryOps::Plus, $1, $3); }
-	| expression TOK_MINUS expression 	{ $$ = make_node<BinaryOpNode>(@$, BinaryOps::Minus, $1, $3); }
-	| expression TOK_STAR expression 	{ $$ = make_node<BinaryOpNode>(@$, BinaryOps::Star, $1, $3); }
-	| expression TOK_SLASH expression 	{ $$ = make_node<BinaryOpNode>(@$, BinaryOps::Slash, $1, $3); }
-	| expression TOK_LOG_AND expression { $$ = make_node<LogicalOpNode>(@$, BinaryOps::LogAnd, $1, $3); }
-	| expression TOK_LOG_OR expression 	{ $$ = make_node<LogicalOpNode>(@$, BinaryOps::LogOr, $1, $3); }
-	| expression TOK_MOD expression		{ $$ = make_node<BinaryOpNode>(@$, BinaryOps::Mod, $1, $3); }
-	| expression TOK_BIT_AND expression { $$ = make_node<BinaryOpNode>(@$, BinaryOps::BitAnd, $1, $3); }
-	| expression TOK_BIT_OR expression 	{ $$ = make_node<BinaryOpNode>(@$, BinaryOps::BitOr, $1, $3); }
-	| expression TOK_BIT_XOR expression { $$ = make_node<BinaryOpNode>(@$, BinaryOps::BitXor, $1, $3); }
-	| expression TOK_LEFT_SHIFT expression { $$ = make_node<BinaryOpNode>(@$, BinaryOps::LeftShift, $1, $3); }
-	| expression TOK_RIGHT_SHIFT expression { $$ = make_node<BinaryOpNode>(@$, BinaryOps::RightShift, $1, $3); }
+	: expression TOK_PLUS expression 	{ $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::Plus, $1, $3); }
+	| expression TOK_MINUS expression 	{ $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::Minus, $1, $3); }
+	| expression TOK_STAR expression 	{ $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::Star, $1, $3); }
+	| expression TOK_SLASH expression 	{ $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::Slash, $1, $3); }
+	| expression TOK_LOG_AND expression { $$ = make_node<LogicalOpNode>(arena, @$, BinaryOps::LogAnd, $1, $3); }
+	| expression TOK_LOG_OR expression 	{ $$ = make_node<LogicalOpNode>(arena, @$, BinaryOps::LogOr, $1, $3); }
+	| expression TOK_MOD expression		{ $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::Mod, $1, $3); }
+	| expression TOK_BIT_AND expression { $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::BitAnd, $1, $3); }
+	| expression TOK_BIT_OR expression 	{ $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::BitOr, $1, $3); }
+	| expression TOK_BIT_XOR expression { $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::BitXor, $1, $3); }
+	| expression TOK_LEFT_SHIFT expression { $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::LeftShift, $1, $3); }
+	| expression TOK_RIGHT_SHIFT expression { $$ = make_node<BinaryOpNode>(arena, @$, BinaryOps::RightShift, $1, $3); }
 	;
 
 relational_expression
-	: expression TOK_EQ expression 		{ $$ = make_node<RelationalOpNode>(@$, RelationalOps::Eq, $1, $3); }
-	| expression TOK_NE expression 		{ $$ = make_node<RelationalOpNode>(@$, RelationalOps::Ne, $1, $3); }
-	| expression TOK_LT expression 		{ $$ = make_node<RelationalOpNode>(@$, RelationalOps::Lt, $1, $3); }
-	| expression TOK_GT expression 		{ $$ = make_node<RelationalOpNode>(@$, RelationalOps::Gt, $1, $3); }
-	| expression TOK_LE expression 		{ $$ = make_node<RelationalOpNode>(@$, RelationalOps::Le, $1, $3); }
-	| expression TOK_GE expression 		{ $$ = make_node<RelationalOpNode>(@$, RelationalOps::Ge, $1, $3); }
+	: expression TOK_EQ expression 		{ $$ = make_node<RelationalOpNode>(arena, @$, RelationalOps::Eq, $1, $3); }
+	| expression TOK_NE expression 		{ $$ = make_node<RelationalOpNode>(arena, @$, RelationalOps::Ne, $1, $3); }
+	| expression TOK_LT expression 		{ $$ = make_node<RelationalOpNode>(arena, @$, RelationalOps::Lt, $1, $3); }
+	| expression TOK_GT expression 		{ $$ = make_node<RelationalOpNode>(arena, @$, RelationalOps::Gt, $1, $3); }
+	| expression TOK_LE expression 		{ $$ = make_node<RelationalOpNode>(arena, @$, RelationalOps::Le, $1, $3); }
+	| expression TOK_GE expression 		{ $$ = make_node<RelationalOpNode>(arena, @$, RelationalOps::Ge, $1, $3); }
 	;
 
 ternary_expression
 	: expression TOK_QUESTION_MARK expression TOK_COLON expression
-		{ $$ = make_node<TernaryNode>(@$, $1, $3, $5); }
+		{ $$ = make_node<TernaryNode>(arena, @$, $1, $3, $5); }
 	;
 
 cast_expression
 	: TOK_LPAREN type TOK_RPAREN expression %prec HI_PREC
-		{ $$ = make_node<CastExpressionNode>(@$, $2, $4); }
+		{ $$ = make_node<CastExpressionNode>(arena, @$, $2, $4); }
 	;
 
 function_call
 	: name TOK_LPAREN func_args TOK_RPAREN 	
-		{ $$ = make_node<FuncCallNode>(@$, $1, $3); }
+		{ $$ = make_node<FuncCallNode>(arena, @$, $1, $3); }
 	;
 
 /* To handle one or more comma delimited lists, we need to add an extra rule */
@@ -375,7 +377,7 @@ function_call
 func_args
 	: %empty 
 		{ 
-			$$ = std::vector<std::unique_ptr<ExpressionNode>>{}; 
+			$$ = ArenaVector<ExpressionNode*>(arena); 
 		}
 	| non_empty_func_args 
 		{ 
@@ -386,7 +388,7 @@ func_args
 non_empty_func_args
 	: expression
 		{ 	
-			$$ = std::vector<std::unique_ptr<ExpressionNode>>{}; 
+			$$ = ArenaVector<ExpressionNode*>(arena); 
 			$$.push_back($1);
 		}
 	| non_empty_func_args TOK_COMMA expression 
@@ -403,19 +405,17 @@ augmented_assign
 
 %%
 
-yy::parser::symbol_type yylex(yyscan_t lexer) {
-	yy::parser::symbol_type s;
-	int x = yylex(&s, nullptr, lexer);
-	assert(x == 1);
-	return s;
+yy::parser::symbol_type yylex(Lexer& lexer) {
+	return lexer.next();
 }
 
 void yy::parser::error(location_type const& loc, std::string const& msg) {
-	std::cout << "[error] parser error at " << loc << ": " << msg << ".\n";
+	LineColumn at = lexer.lines()->find(loc.begin);
+	diag() << "[error] parser error at " << at.line << "." << at.column << ": " << msg << ".\n";
 }
 
-template <typename T, typename... Args> static std::unique_ptr<T> make_node(yy::parser::location_type const& loc, Args&&... args) {
-	std::unique_ptr<T> n = std::make_unique<T>(std::forward<Args>(args)...);
-	n->location = loc;
+template <typename T, typename... Args> static T* make_node(AstArena& arena, yy::parser::location_type const& loc, Args&&... args) {
+	T* n = arena.make<T>(std::forward<Args>(args)...);
+	n->location = loc.begin;
 	return n;
 }
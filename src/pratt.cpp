@@ -0,0 +1,478 @@
+/*
+	pratt.cpp
+	How bison settles parser.y's conflicts, and so what this has to match:
+	after "left op right" with another operator next, it shifts when the
+	next one has the higher precedence (or the same, and is %right) and
+	reduces otherwise. infix() climbs on exactly that test. A rule's
+	precedence is its last token's, so a ternary's third operand binds like
+	":" does, and - ~ and casts are %prec HI_PREC, above everything.
+*/
+#include "headers/pratt.hpp"
+#include "headers/common.hpp"
+#include <utility>
+
+using sk = yy::parser::symbol_kind;
+
+namespace
+{
+
+// parser.y's precedence levels, lowest first
+enum precedence
+{
+	prec_ternary = 1,		// ? and :, %right
+	prec_log_or,
+	prec_log_and,
+	prec_bitwise,			// ^ & and | all share one
+	prec_bit_not,			// only ever a prefix, so never climbed on
+	prec_shift,
+	prec_equality,
+	prec_relational,
+	prec_additive,
+	prec_multiplicative,
+	prec_mod,
+	prec_prefix = 15,		// HI_PREC, past the assignment operators'
+};
+
+struct InfixOperator
+{
+	int precedence;		// 0 for a token that can't follow an expression
+	NodeKind kind;		// Ternary, or the node a binary operator makes
+	int op;				// its BinaryOps or RelationalOps
+};
+
+InfixOperator infix_operator(yy::parser::symbol_kind_type kind)
+{
+	switch (kind)
+	{
+		case sk::S_TOK_QUESTION_MARK: return {prec_ternary, NodeKind::Ternary, 0};
+		case sk::S_TOK_LOG_OR: return {prec_log_or, NodeKind::LogicalOp, static_cast<int>(BinaryOps::LogOr)};
+		case sk::S_TOK_LOG_AND: return {prec_log_and, NodeKind::LogicalOp, static_cast<int>(BinaryOps::LogAnd)};
+		case sk::S_TOK_BIT_XOR: return {prec_bitwise, NodeKind::BinaryOp, static_cast<int>(BinaryOps::BitXor)};
+		case sk::S_TOK_BIT_AND: return {prec_bitwise, NodeKind::BinaryOp, static_cast<int>(BinaryOps::BitAnd)};
+		case sk::S_TOK_BIT_OR: return {prec_bitwise, NodeKind::BinaryOp, static_cast<int>(BinaryOps::BitOr)};
+		case sk::S_TOK_LEFT_SHIFT: return {prec_shift, NodeKind::BinaryOp, static_cast<int>(BinaryOps::LeftShift)};
+		case sk::S_TOK_RIGHT_SHIFT: return {prec_shift, NodeKind::BinaryOp, static_cast<int>(BinaryOps::RightShift)};
+		case sk::S_TOK_EQ: return {prec_equality, NodeKind::RelationalOp, static_cast<int>(RelationalOps::Eq)};
+		case sk::S_TOK_NE: return {prec_equality, NodeKind::RelationalOp, static_cast<int>(RelationalOps::Ne)};
+		case sk::S_TOK_LT: return {prec_relational, NodeKind::RelationalOp, static_cast<int>(RelationalOps::Lt)};
+		case sk::S_TOK_GT: return {prec_relational, NodeKind::RelationalOp, static_cast<int>(RelationalOps::Gt)};
+		case sk::S_TOK_LE: return {prec_relational, NodeKind::RelationalOp, static_cast<int>(RelationalOps::Le)};
+		case sk::S_TOK_GE: return {prec_relational, NodeKind::RelationalOp, static_cast<int>(RelationalOps::Ge)};
+		case sk::S_TOK_PLUS: return {prec_additive, NodeKind::BinaryOp, static_cast<int>(BinaryOps::Plus)};
+		case sk::S_TOK_MINUS: return {prec_additive, NodeKind::BinaryOp, static_cast<int>(BinaryOps::Minus)};
+		case sk::S_TOK_STAR: return {prec_multiplicative, NodeKind::BinaryOp, static_cast<int>(BinaryOps::Star)};
+		case sk::S_TOK_SLASH: return {prec_multiplicative, NodeKind::BinaryOp, static_cast<int>(BinaryOps::Slash)};
+		case sk::S_TOK_MOD: return {prec_mod, NodeKind::BinaryOp, static_cast<int>(BinaryOps::Mod)};
+		default: return {0, NodeKind::BinaryOp, 0};
+	}
+}
+
+bool starts_expression(yy::parser::symbol_kind_type kind)
+{
+	switch (kind)
+	{
+		case sk::S_TOK_TRUE:
+		case sk::S_TOK_FALSE:
+		case sk::S_TOK_INTEGER:
+		case sk::S_TOK_FLOAT:
+		case sk::S_TOK_CHAR:
+		case sk::S_TOK_DOUBLE:
+		case sk::S_TOK_IDENTIFIER:
+		case sk::S_TOK_LPAREN:
+		case sk::S_TOK_MINUS:
+		case sk::S_TOK_BIT_NOT:
+			return true;
+		default:
+			return false;
+	}
+}
+
+}
+
+PrattParser::PrattParser(Lexer& lexer, AstArena& arena) : lexer(lexer), arena(arena)
+{
+}
+
+PrattParser::Nesting::Nesting(PrattParser& parser) : parser(parser)
+{
+	if (++this->parser.depth > maxNesting)
+	{
+		this->parser.syntax_error("nested too deeply");
+	}
+}
+
+template <typename T, typename... Args> T* PrattParser::make(uint32_t location, Args&&... args)
+{
+	T* n = this->arena.make<T>(std::forward<Args>(args)...);
+	n->location = location;
+	return n;
+}
+
+void PrattParser::advance()
+{
+	yy::parser::symbol_type s = this->lexer.next();
+	Token& t = this->token;
+	t.kind = s.kind();
+	t.location = s.location;
+	switch (t.kind)
+	{
+		case sk::S_TOK_IDENTIFIER:
+			t.name = s.value.as<Symbol>();
+			break;
+		case sk::S_TOK_TYPE:
+			t.type = s.value.as<TypeName>();
+			break;
+		case sk::S_TOK_INTEGER:
+			t.intValue = s.value.as<int>();
+			break;
+		case sk::S_TOK_FLOAT:
+			t.floatValue = s.value.as<float>();
+			break;
+		case sk::S_TOK_DOUBLE:
+			t.doubleValue = s.value.as<double>();
+			break;
+		case sk::S_TOK_CHAR:
+			t.charValue = s.value.as<char>();
+			break;
+		default:
+			break;
+	}
+}
+
+void PrattParser::expect(yy::parser::symbol_kind_type kind)
+{
+	if (!this->at(kind))
+	{
+		this->syntax_error();
+	}
+	this->advance();
+}
+
+void PrattParser::syntax_error(const char* message)
+{
+	// word for word what yy::parser::error says
+	LineColumn at = this->lexer.lines()->find(this->token.location.begin);
+	diag() << "[error] parser error at " << at.line << "." << at.column << ": " << message << ".\n";
+	fatal_error();
+}
+
+Node* PrattParser::parse()
+{
+	this->advance();
+	uint32_t start = this->token.location.begin;
+	ArenaVector<Node*> functions(this->arena);
+	do
+	{
+		functions.push_back(this->function());
+	} while (!this->at(sk::S_YYEOF));
+	RootNode* root = this->make<RootNode>(start, std::move(functions));
+	root->lines = this->lexer.lines();
+	return root;
+}
+
+Node* PrattParser::function()
+{
+	FuncDeclNode* decl = this->function_decl();
+	if (this->at(sk::S_TOK_SEMICOLON))
+	{
+		this->advance();
+		return decl;
+	}
+	Node* body = this->block();
+	return this->make<FuncDefnNode>(decl->location, decl, body);
+}
+
+FuncDeclNode* PrattParser::function_decl()
+{
+	uint32_t start = this->token.location.begin;
+	if (!this->at(sk::S_TOK_TYPE))
+	{
+		this->syntax_error();
+	}
+	TypeName type = this->token.type;
+	this->advance();
+	if (!this->at(sk::S_TOK_IDENTIFIER))
+	{
+		this->syntax_error();
+	}
+	Symbol name = this->token.name;
+	this->advance();
+	this->expect(sk::S_TOK_LPAREN);
+	ArenaVector<DeclarationNode*> params(this->arena);
+	if (!this->at(sk::S_TOK_RPAREN))
+	{
+		params.push_back(this->declaration());
+		while (this->at(sk::S_TOK_COMMA))
+		{
+			this->advance();
+			params.push_back(this->declaration());
+		}
+	}
+	this->expect(sk::S_TOK_RPAREN);
+	return this->make<FuncDeclNode>(start, type, name, std::move(params));
+}
+
+DeclarationNode* PrattParser::declaration()
+{
+	uint32_t start = this->token.location.begin;
+	bool isConstant = this->at(sk::S_TOK_CONST);
+	if (isConstant)
+	{
+		this->advance();
+	}
+	if (!this->at(sk::S_TOK_TYPE))
+	{
+		this->syntax_error();
+	}
+	TypeName type = this->token.type;
+	this->advance();
+	if (!this->at(sk::S_TOK_IDENTIFIER))
+	{
+		this->syntax_error();
+	}
+	Symbol name = this->token.name;
+	this->advance();
+	return this->make<DeclarationNode>(start, type, name, isConstant);
+}
+
+Node* PrattParser::block()
+{
+	Nesting nesting(*this);
+	uint32_t start = this->token.location.begin;
+	this->expect(sk::S_TOK_LBRACE);
+	ArenaVector<Node*> statements(this->arena);
+	while (!this->at(sk::S_TOK_RBRACE))
+	{
+		statements.push_back(this->statement());
+	}
+	this->advance();
+	return this->make<BlockNode>(start, std::move(statements));
+}
+
+StatementNode* PrattParser::statement()
+{
+	if (this->at(sk::S_TOK_IF) || this->at(sk::S_TOK_FOR) || this->at(sk::S_TOK_WHILE))
+	{
+		return this->compound_statement();
+	}
+	StatementNode* s = this->single_statement();
+	this->expect(sk::S_TOK_SEMICOLON);
+	return s;
+}
+
+StatementNode* PrattParser::single_statement()
+{
+	// parser.y's break rule is written against TOK_DOUBLE, which neither
+	// scanner produces, so there's no way to write a break. It isn't
+	// repeated here
+	uint32_t start = this->token.location.begin;
+	switch (this->token.kind)
+	{
+		case sk::S_TOK_TYPE:
+		case sk::S_TOK_CONST:
+		{
+			DeclarationNode* decl = this->declaration();
+			this->expect(sk::S_TOK_ASSIGN);
+			ExpressionNode* value = this->expression();
+			return this->make<DeclAndAssignNode>(start, decl, value);
+		}
+		case sk::S_TOK_IDENTIFIER:
+		{
+			// an assignment, or the start of an expression
+			Symbol name = this->token.name;
+			this->advance();
+			AugmentedAssignOps op;
+			switch (this->token.kind)
+			{
+				case sk::S_TOK_ASSIGN:
+				{
+					this->advance();
+					ExpressionNode* value = this->expression();
+					return this->make<AssignmentNode>(start, name, value);
+				}
+				case sk::S_TOK_PLUS_ASSIGN: op = AugmentedAssignOps::PlusEq; break;
+				case sk::S_TOK_MINUS_ASSIGN: op = AugmentedAssignOps::MinusEq; break;
+				case sk::S_TOK_STAR_ASSIGN: op = AugmentedAssignOps::StarEq; break;
+				case sk::S_TOK_SLASH_ASSIGN: op = AugmentedAssignOps::SlashEq; break;
+				default:
+				{
+					Operand e = this->infix(this->call_or_variable(name, start), 0);
+					return this->make<ExpressionStatementNode>(start, e.node);
+				}
+			}
+			this->advance();
+			ExpressionNode* value = this->expression();
+			return this->make<AugmentedAssignmentNode>(start, op, name, value);
+		}
+		case sk::S_TOK_CONTINUE:
+			this->advance();
+			return this->make<ContinueNode>(start);
+		case sk::S_TOK_RETURN:
+			this->advance();
+			if (starts_expression(this->token.kind))
+			{
+				ExpressionNode* value = this->expression();
+				return this->make<ReturnNode>(start, value);
+			}
+			return this->make<ReturnNode>(start, nullptr);
+		default:
+		{
+			ExpressionNode* e = this->expression();
+			return this->make<ExpressionStatementNode>(start, e);
+		}
+	}
+}
+
+StatementNode* PrattParser::compound_statement()
+{
+	uint32_t start = this->token.location.begin;
+	yy::parser::symbol_kind_type kind = this->token.kind;
+	this->advance();
+	this->expect(sk::S_TOK_LPAREN);
+	if (kind == sk::S_TOK_FOR)
+	{
+		Node* init = this->at(sk::S_TOK_SEMICOLON) ? nullptr : this->single_statement();
+		this->expect(sk::S_TOK_SEMICOLON);
+		ExpressionNode* cond = this->at(sk::S_TOK_SEMICOLON) ? nullptr : this->expression();
+		this->expect(sk::S_TOK_SEMICOLON);
+		Node* update = this->at(sk::S_TOK_RPAREN) ? nullptr : this->single_statement();
+		this->expect(sk::S_TOK_RPAREN);
+		Node* body = this->block();
+		return this->make<ForNode>(start, init, cond, update, body);
+	}
+	ExpressionNode* cond = this->expression();
+	this->expect(sk::S_TOK_RPAREN);
+	Node* body = this->block();
+	if (kind == sk::S_TOK_IF)
+	{
+		return this->make<IfNode>(start, cond, body);
+	}
+	return this->make<WhileNode>(start, cond, body);
+}
+
+ExpressionNode* PrattParser::expression(int precedence)
+{
+	// an expression in a rule of the given precedence, which only takes in
+	// the operators after it that bison would shift
+	Nesting nesting(*this);
+	return this->infix(this->prefix(), precedence).node;
+}
+
+PrattParser::Operand PrattParser::prefix()
+{
+	uint32_t start = this->token.location.begin;
+	Token t = this->token;
+	switch (t.kind)
+	{
+		case sk::S_TOK_TRUE:
+		case sk::S_TOK_FALSE:
+			this->advance();
+			return {this->make<ConstantBoolNode>(start, t.kind == sk::S_TOK_TRUE), start};
+		case sk::S_TOK_INTEGER:
+			this->advance();
+			return {this->make<ConstantIntNode>(start, t.intValue), start};
+		case sk::S_TOK_FLOAT:
+			this->advance();
+			return {this->make<ConstantFloatNode>(start, t.floatValue), start};
+		case sk::S_TOK_CHAR:
+			this->advance();
+			return {this->make<ConstantCharNode>(start, t.charValue), start};
+		case sk::S_TOK_DOUBLE:
+			this->advance();
+			return {this->make<ConstantDoubleNode>(start, t.doubleValue), start};
+		case sk::S_TOK_IDENTIFIER:
+			this->advance();
+			return this->call_or_variable(t.name, start);
+		case sk::S_TOK_MINUS:
+		case sk::S_TOK_BIT_NOT:
+		{
+			this->advance();
+			ExpressionNode* e = this->expression(prec_prefix);
+			UnaryOps op = t.kind == sk::S_TOK_MINUS ? UnaryOps::Minus : UnaryOps::Not;
+			return {this->make<UnaryNode>(start, op, e), start};
+		}
+		case sk::S_TOK_LPAREN:
+		{
+			this->advance();
+			if (this->at(sk::S_TOK_TYPE))
+			{
+				TypeName type = this->token.type;
+				this->advance();
+				this->expect(sk::S_TOK_RPAREN);
+				ExpressionNode* e = this->expression(prec_prefix);
+				return {this->make<CastExpressionNode>(start, type, e), start};
+			}
+			ExpressionNode* e = this->expression();
+			this->expect(sk::S_TOK_RPAREN);
+			return {e, start};
+		}
+		default:
+			this->syntax_error();
+	}
+}
+
+PrattParser::Operand PrattParser::call_or_variable(Symbol name, uint32_t start)
+{
+	// the name has been read already
+	if (!this->at(sk::S_TOK_LPAREN))
+	{
+		return {this->make<VariableNode>(start, name), start};
+	}
+	this->advance();
+	ArenaVector<ExpressionNode*> args(this->arena);
+	if (!this->at(sk::S_TOK_RPAREN))
+	{
+		args.push_back(this->expression());
+		while (this->at(sk::S_TOK_COMMA))
+		{
+			this->advance();
+			args.push_back(this->expression());
+		}
+	}
+	this->expect(sk::S_TOK_RPAREN);
+	return {this->make<FuncCallNode>(start, name, std::move(args)), start};
+}
+
+PrattParser::Operand PrattParser::infix(Operand left, int precedence)
+{
+	while (true)
+	{
+		InfixOperator op = infix_operator(this->token.kind);
+		// all the binary operators are %left, only ?: is %right
+		bool shift = op.precedence > precedence || (op.precedence == prec_ternary && precedence == prec_ternary);
+		if (op.precedence == 0 || !shift)
+		{
+			return left;
+		}
+		this->advance();
+		switch (op.kind)
+		{
+			case NodeKind::Ternary:
+			{
+				ExpressionNode* ifTrue = this->expression();
+				this->expect(sk::S_TOK_COLON);
+				ExpressionNode* ifFalse = this->expression(prec_ternary);
+				left.node = this->make<TernaryNode>(left.start, left.node, ifTrue, ifFalse);
+				break;
+			}
+			case NodeKind::LogicalOp:
+			{
+				ExpressionNode* right = this->expression(op.precedence);
+				left.node = this->make<LogicalOpNode>(left.start, static_cast<BinaryOps>(op.op), left.node, right);
+				break;
+			}
+			case NodeKind::RelationalOp:
+			{
+				ExpressionNode* right = this->expression(op.precedence);
+				left.node = this->make<RelationalOpNode>(left.start, static_cast<RelationalOps>(op.op), left.node, right);
+				break;
+			}
+			default:
+			{
+				ExpressionNode* right = this->expression(op.precedence);
+				left.node = this->make<BinaryOpNode>(left.start, static_cast<BinaryOps>(op.op), left.node, right);
+				break;
+			}
+		}
+	}
+}
@@ -1,18 +1,34 @@
 #include "headers/preprocess.hpp"
 #include "headers/consolecolors.hpp"
+#include "headers/common.hpp"
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <array>
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
 
 // private preprocessing functions
-int clean_comments(std::ifstream& readfile, std::ofstream& writefile);
-int check_valid_character(char c);
-int check_all_valid_characters(std::ifstream& readfile);
-int replace_simple_macros(std::ifstream& readfile, std::ofstream& writefile);
-int import_header_files(std::ifstream& readfile, std::ofstream& writefile);
-int replace_predefined_macros(std::ifstream& readfile, std::ofstream& writefile);
-
-int replace_predefined_macros(std::ifstream& readfile, std::ofstream& writefile) 
+int clean_source(const char* begin, const char* end, std::string& out, const char* file = nullptr);
+int replace_simple_macros(const char* begin, const char* end, std::string& out);
+int import_header_files(const std::string& path, std::string& out, const std::vector<std::string>& includeDirs);
+int replace_predefined_macros(const char* begin, const char* end, std::string& out);
+
+int replace_predefined_macros(const char* begin, const char* end, std::string& out) 
 {
 
 // 	__FILE__
@@ -62,220 +78,751 @@ int replace_predefined_macros(std::ifstream& readfile, std::ofstream& writefile)
 	return 0;
 }
 
-int import_header_files(std::ifstream& readfile, std::ofstream& writefile)
-{
-	// find all #include statements and do a textual replacement
-	return 0;
-}
-
-int replace_simple_macros(std::ifstream& readfile, std::ofstream& writefile)
+int replace_simple_macros(const char* begin, const char* end, std::string& out)
 {
 	// find all object macros (ie. #define OBJECT_NAME value) and do a textual replacement
 	return 0;
 }
 
-int preprocess::clean_preprocess_file(const std::string infile)
+// A whole file mapped into memory, so we don't pay for a copy through an ifstream
+struct MappedFile
 {
-	// remove infile and return whether it was successful
-	return std::remove(infile.c_str());
-}
+	const char* data = "";
+	size_t len = 0;
+	struct stat st;
+	void* mapping = MAP_FAILED;
 
-int preprocess::preprocess_file(const std::string infile, const std::string outfile)
-{
-	// try to open read file
-	std::ifstream readfile(infile);
-	if (!readfile.is_open())
+	~MappedFile()
 	{
-		std::cout << "[" << RED << "error" << RESET << "] Problem reading file " << infile << "\n";
-		return 1;
+		if (this->mapping != MAP_FAILED)
+		{
+			munmap(this->mapping, this->len);
+		}
 	}
 
-	// try to open write file
-	std::ofstream writefile;
-	writefile.open(outfile);
-	if (!writefile.is_open())
+	int open(const std::string& path)
+	{
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			diag() << "[" << RED << "error" << RESET << "] Problem reading file " << path << "\n";
+			return 1;
+		}
+		if (fstat(fd, &this->st) != 0)
+		{
+			diag() << "[" << RED << "error" << RESET << "] Problem reading file " << path << "\n";
+			close(fd);
+			return 1;
+		}
+		this->len = static_cast<size_t>(this->st.st_size);
+		if (this->len > 0)
+		{
+			// mmap won't map an empty file, but an empty file is just an empty buffer anyways
+			this->mapping = mmap(nullptr, this->len, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (this->mapping == MAP_FAILED)
+			{
+				diag() << "[" << RED << "error" << RESET << "] Problem mapping file " << path << ": " << std::strerror(errno) << "\n";
+				close(fd);
+				return 1;
+			}
+			this->data = static_cast<const char*>(this->mapping);
+		}
+		close(fd);	// the mapping keeps the file alive
+		return 0;
+	}
+};
+
+preprocess::preprocess(std::vector<std::string> includeDirs)
+	: includeDirs(std::move(includeDirs))
+{
+}
+
+int preprocess::preprocess_file(const std::string infile, std::string& out)
+{
+	MappedFile file;
+	if (file.open(infile) != 0)
 	{
-		std::cout << "[" << RED << "error" << RESET << "] Problem opening file for writing " << outfile << "\n";
 		return 1;
 	}
+	return this->preprocess_buffer(file.data, file.len, out, infile);
+}
 
+int preprocess::preprocess_buffer(const char* data, size_t len, std::string& out, const std::string& path)
+{
 	// here that each transform the file a little bit.
-	// check for valid characters
-	// Remove comments
-	// Remove newlines
+	// check for valid characters and remove comments (one pass, see clean_source)
 	// predefined macros
 	// Include header files ie. #include <system headers> or #include "local headers"
 	// user defined macros
-	check_all_valid_characters(readfile);
-	readfile.clear();                 // clear fail and eof bits
-	readfile.seekg(0, std::ios::beg); // back to the start!
-	clean_comments(readfile, writefile);
-	return 0;
+	out.clear();
+	out.reserve(len + 2);	// +2 so the scanner can terminate the buffer without reallocating
+	if (clean_source(data, data + len, out) != 0)
+	{
+		return 1;
+	}
+	// most files don't have a single directive, and don't need another pass
+	if (std::memchr(out.data(), '#', out.size()) == nullptr)
+	{
+		return 0;
+	}
+	return import_header_files(path, out, this->includeDirs);
 }
 
-int check_valid_character(char c)
+// Every byte of input falls into one of these classes. Plain bytes are copied
+// straight through to the output, anything else needs a closer look.
+enum char_class : unsigned char
+{
+	cc_invalid = 0,
+	cc_plain,
+	cc_slash,	// might start a comment
+	cc_quote,	// starts a string literal, comments inside of it are not comments!
+	cc_tick,	// starts a character literal, and '"' doesn't start a string
+};
+
+static constexpr std::array<unsigned char, 256> make_char_class_table()
 {
-	// check if the character is valid
 	// valid characters are:
-	// a-z, A-Z, 0-9, _, $, #, @, %, ^, &, *, (, ), -, +, =, [, ], {, }, <, >, ., ;, :, ?, !, ', ", \, /
-	// and space
-	if (c == ' ' || c == '\n' || c == '\t' || 
-		c == '\r' || c == '\v' || c == '\f')
+	// a-z, A-Z, 0-9, _, $, #, @, %, ^, &, *, (, ), -, +, =, [, ], {, }, <, >, ., ;, :, ?, !, ', ", \, /, ~, |, ,
+	// and whitespace. Everything else (including anything non-ascii) is invalid.
+	std::array<unsigned char, 256> table {};
+	for (int c = 'a'; c <= 'z'; c++)
+		table[c] = cc_plain;
+	for (int c = 'A'; c <= 'Z'; c++)
+		table[c] = cc_plain;
+	for (int c = '0'; c <= '9'; c++)
+		table[c] = cc_plain;
+	for (const char* c = " \n\t\r\v\f,_$#@%^&*()-+=[]{}<>.;:?!|\\~"; *c; c++)
+		table[static_cast<unsigned char>(*c)] = cc_plain;
+	table['/'] = cc_slash;
+	table['\"'] = cc_quote;
+	table['\''] = cc_tick;
+	return table;
+}
+
+static constexpr std::array<unsigned char, 256> char_class_table = make_char_class_table();
+
+static const char* skip_plain(const char* p, const char* end)
+{
+	// return the first byte in [p, end) that isn't plain code. This is where
+	// the preprocessor spends nearly all of its time, so check 16 or 32 bytes
+	// at a time when we can. A byte is plain when it is printable ascii other than
+	// / " ' or `, or whitespace (\t \n \v \f \r, which are 0x09 - 0x0d). This has to
+	// agree with char_class_table!
+#if defined(__AVX2__)
+	const __m256i slash32 = _mm256_set1_epi8('/');
+	const __m256i quote32 = _mm256_set1_epi8('"');
+	const __m256i apos32 = _mm256_set1_epi8('\'');
+	const __m256i tick32 = _mm256_set1_epi8('`');
+	const __m256i del32 = _mm256_set1_epi8(0x7f);
+	const __m256i space32 = _mm256_set1_epi8(0x20);
+	const __m256i wslo32 = _mm256_set1_epi8(0x08);
+	const __m256i wshi32 = _mm256_set1_epi8(0x0e);
+	while (end - p >= 32)
 	{
-		return 1;
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		// signed compare, so bytes >= 0x80 are negative and count as control characters too
+		__m256i ctrl = _mm256_cmpgt_epi8(space32, v);
+		__m256i ws = _mm256_and_si256(_mm256_cmpgt_epi8(v, wslo32), _mm256_cmpgt_epi8(wshi32, v));
+		__m256i special = _mm256_or_si256(
+			_mm256_andnot_si256(ws, ctrl),
+			_mm256_or_si256(
+				_mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, slash32), _mm256_cmpeq_epi8(v, quote32)),
+					_mm256_cmpeq_epi8(v, apos32)),
+				_mm256_or_si256(_mm256_cmpeq_epi8(v, tick32), _mm256_cmpeq_epi8(v, del32))));
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(special));
+		if (mask != 0)
+		{
+			return p + __builtin_ctz(mask);
+		}
+		p += 32;
 	}
-	if (c >= 'a' && c <= 'z')
+#endif
+#if defined(__SSE2__)
+	const __m128i slash = _mm_set1_epi8('/');
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i apos = _mm_set1_epi8('\'');
+	const __m128i tick = _mm_set1_epi8('`');
+	const __m128i del = _mm_set1_epi8(0x7f);
+	const __m128i space = _mm_set1_epi8(0x20);
+	const __m128i wslo = _mm_set1_epi8(0x08);
+	const __m128i wshi = _mm_set1_epi8(0x0e);
+	while (end - p >= 16)
 	{
-		return 1;
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		__m128i ctrl = _mm_cmplt_epi8(v, space);
+		__m128i ws = _mm_and_si128(_mm_cmpgt_epi8(v, wslo), _mm_cmplt_epi8(v, wshi));
+		__m128i special = _mm_or_si128(
+			_mm_andnot_si128(ws, ctrl),
+			_mm_or_si128(
+				_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, slash), _mm_cmpeq_epi8(v, quote)), _mm_cmpeq_epi8(v, apos)),
+				_mm_or_si128(_mm_cmpeq_epi8(v, tick), _mm_cmpeq_epi8(v, del))));
+		int mask = _mm_movemask_epi8(special);
+		if (mask != 0)
+		{
+			return p + __builtin_ctz(mask);
+		}
+		p += 16;
 	}
-	if (c >= 'A' && c <= 'Z')
+#endif
+	while (p != end && char_class_table[static_cast<unsigned char>(*p)] == cc_plain)
 	{
-		return 1;
+		p++;
 	}
-	if (c >= '0' && c <= '9')
+	return p;
+}
+
+static const char* literal_end(const char* p, const char* end, char quote)
+{
+	// the quote that closes the literal opened at p, stepping over escapes so
+	// \" and \' don't close it. nullptr if there isn't one before end
+	for (p++; p != end; p++)
 	{
-		return 1;
+		if (*p == quote)
+		{
+			return p;
+		}
+		if (*p == '\\' && p + 1 != end)
+		{
+			p++;
+		}
 	}
-	if (c == ',' || c == '_' || c == '$' || c == '#' || 
-		c == '@' || c == '%' || c == '^' || c == '&' || 
-		c == '*' || c == '(' || c == ')' || c == '-' || 
-		c == '+' || c == '=' || c == '[' || c == ']' || 
-		c == '{' || c == '}' || c == '<' || c == '>' || 
-		c == '.' || c == ';' || c == ':' || c == '?' || 
-		c == '!' || c == '|' || c == '\'' || c == '\"' || 
-		c == '\\' || c == '/')
+	return nullptr;
+}
+
+static void print_source_error(const char* begin, const char* at, const char* msg, const char* file = nullptr)
+{
+	// only called when something has gone wrong, so it's fine to count lines here
+	// instead of keeping track of them the whole way through
+	long line = 1 + std::count(begin, at, '\n');
+	const char* lineStart = at;
+	while (lineStart != begin && *(lineStart - 1) != '\n')
 	{
-		return 1;
+		lineStart--;
 	}
-	// // TODO: This should print a location or something since we probably won't actually be able to print this character!
-	// std::cout << "[" << RED << "error" << RESET << "] Invalid character: " << c << "\n";
-	return 0;
+	// the file is only named for headers, everything else is about the file being compiled
+	diag() << "[" << RED << "error" << RESET << "] ";
+	if (file != nullptr)
+	{
+		diag() << file << " ";
+	}
+	diag() << "(" << line << ", " << (at - lineStart + 1) << "): " << msg << "\n";
 }
 
-int check_all_valid_characters(std::ifstream& readfile)
+int clean_source(const char* begin, const char* end, std::string& out, const char* file)
 {
-	// check if all characters are valid
-	char c;
-	while (readfile.get(c))
+	// Check every character is valid and remove single and multiline comments, in a
+	// single pass over the buffer. Runs of plain code are copied over in bulk, and we
+	// only drop down to looking at single characters around comments, string and
+	// character literals, and invalid characters. Comments are removed but any
+	// newlines inside them are kept so that line numbers still line up with the
+	// original source for error messages.
+	const char* p = begin;
+	while (p != end)
 	{
-		if (!check_valid_character(c))
+		const char* run = p;
+		p = skip_plain(p, end);
+		out.append(run, p);
+		if (p == end)
 		{
-			std::cout << "[" << RED << "error" << RESET << "] Invalid character in source\n";
-			return 0;
+			break;
+		}
+
+		switch (char_class_table[static_cast<unsigned char>(*p)])
+		{
+			case cc_slash:
+				if (p + 1 != end && p[1] == '/')
+				{
+					// line comment, skip to (but not past) the newline
+					const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+					p = nl ? nl : end;
+				}
+				else if (p + 1 != end && p[1] == '*')
+				{
+					// block comment, find the closing */
+					const char* close = p + 2;
+					while (true)
+					{
+						close = static_cast<const char*>(std::memchr(close, '*', end - close));
+						if (close == nullptr || close + 1 == end)
+						{
+							print_source_error(begin, p, "Unterminated comment", file);
+							return 1;
+						}
+						if (close[1] == '/')
+						{
+							break;
+						}
+						close++;
+					}
+					out.append(std::count(p, close, '\n'), '\n');
+					p = close + 2;
+				}
+				else
+				{
+					// just a plain old slash
+					out.push_back(*p++);
+				}
+				break;
+
+			case cc_quote:
+			{
+				// copy string literals over untouched
+				const char* close = literal_end(p, end, '"');
+				if (close == nullptr)
+				{
+					print_source_error(begin, p, "Unterminated string literal", file);
+					return 1;
+				}
+				out.append(p, close + 1);
+				p = close + 1;
+				break;
+			}
+
+			case cc_tick:
+			{
+				// and character literals, which end on the line they start on
+				const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+				const char* close = literal_end(p, nl ? nl : end, '\'');
+				if (close == nullptr)
+				{
+					print_source_error(begin, p, "Unterminated character literal", file);
+					return 1;
+				}
+				out.append(p, close + 1);
+				p = close + 1;
+				break;
+			}
+
+			default:
+				print_source_error(begin, p, "Invalid character in source", file);
+				return 1;
 		}
 	}
-	return 1;
+	return 0;
+}
+
+// A line holding a directive. The line goes away, and an #include is replaced
+// by what it includes. Offsets are into the text of the file it's in
+struct Directive
+{
+	uint32_t begin;			// the #
+	uint32_t end;			// the newline at the end of the line, which stays
+	std::string header;		// what an #include includes, empty for any other directive
+	bool angled;			// #include <header> rather than #include "header"
+};
+
+// A file with its comments gone and its directives picked out
+struct SourceFile
+{
+	std::string text;
+	std::vector<Directive> directives;
+	std::string guard;		// the macro its include guard defines, if it has one
+	bool once = false;		// it has #pragma once
+};
+
+static bool is_blank(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f' || c == '\n';
 }
 
-int clean_comments(std::ifstream& readfile, std::ofstream& writefile)
+static bool is_blank(const char* begin, const char* end)
 {
-	// Remove single and multiline comments from a file
-	
-	std::string inputLine;
-	std::string outputLine;
-
-	// simple state machine to track the comment state
-	// TODO: We need to ignore comments if we are inside a string literal!
-	// ie. std::cout << "Something like /*this*/\n"; is not a comment!
-	enum class preprocess_state
+	return std::all_of(begin, end, [](char c) { return is_blank(c); });
+}
+
+static bool is_word_char(char c)
+{
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static int find_directives(SourceFile& file, const char* name)
+{
+	// a directive is a line starting with a #, give or take some blanks. The
+	// comments are gone by now, so none can hide a # or trail after a directive.
+	// Only #include, #pragma once and include guards are understood, we don't
+	// have macros yet
+	struct Line
 	{
-		normal = 0,
-		normal_seen_slash,
-		in_block_comment,
-		in_block_comment_seen_star,
-		in_string_literal,
+		uint32_t begin;
+		uint32_t end;
+		std::string word;	// include, pragma, ...
+		std::string rest;	// everything after the word, without the blanks around it
 	};
-	preprocess_state cur_state = preprocess_state::normal;
-	bool breakCommentFlag = false;
+	std::vector<Line> lines;
+	const char* begin = file.text.data();
+	const char* end = begin + file.text.size();
+	const char* p = begin;
+	while ((p = static_cast<const char*>(std::memchr(p, '#', end - p))) != nullptr)
+	{
+		const char* lineStart = p;
+		while (lineStart != begin && lineStart[-1] != '\n')
+		{
+			lineStart--;
+		}
+		const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+		const char* lineEnd = nl ? nl : end;
+		if (!is_blank(lineStart, p))
+		{
+			// a # in the middle of a line is for the scanner to complain about
+			p = lineEnd;
+			continue;
+		}
+		const char* word = p + 1;
+		while (word != lineEnd && is_blank(*word))
+		{
+			word++;
+		}
+		const char* wordEnd = word;
+		while (wordEnd != lineEnd && is_word_char(*wordEnd))
+		{
+			wordEnd++;
+		}
+		const char* rest = wordEnd;
+		while (rest != lineEnd && is_blank(*rest))
+		{
+			rest++;
+		}
+		const char* restEnd = lineEnd;
+		while (restEnd != rest && is_blank(restEnd[-1]))
+		{
+			restEnd--;
+		}
+		lines.push_back({static_cast<uint32_t>(p - begin), static_cast<uint32_t>(lineEnd - begin),
+						 std::string(word, wordEnd), std::string(rest, restEnd)});
+		p = lineEnd;
+	}
+
+	// #ifndef X, #define X around everything else in the file, and #endif
+	// at the very end, is an include guard
+	bool guarded = lines.size() >= 3
+		&& lines[0].word == "ifndef" && !lines[0].rest.empty()
+		&& std::all_of(lines[0].rest.begin(), lines[0].rest.end(), is_word_char)
+		&& lines[1].word == "define" && lines[1].rest == lines[0].rest
+		&& lines.back().word == "endif"
+		&& is_blank(begin, begin + lines[0].begin)
+		&& is_blank(begin + lines[0].end, begin + lines[1].begin)
+		&& is_blank(begin + lines.back().end, end);
+	if (guarded)
+	{
+		file.guard = lines[0].rest;
+	}
 
-	// read entire input file
-	while (getline(readfile, inputLine))
+	for (size_t i = 0; i < lines.size(); i++)
 	{
-		outputLine.clear();
-		for (char const &c: inputLine)
+		const Line& line = lines[i];
+		Directive directive {line.begin, line.end, "", false};
+		if (guarded && (i < 2 || i == lines.size() - 1))
+		{
+			// the guard itself
+		}
+		else if (line.word == "include")
 		{
-			// comment checking state machine
-			switch (cur_state)
+			const std::string& rest = line.rest;
+			if (rest.size() < 3 || !((rest.front() == '"' && rest.back() == '"') || (rest.front() == '<' && rest.back() == '>')))
 			{
-				case preprocess_state::in_string_literal:
-					if (c == '\"')
-					{
-						cur_state = preprocess_state::normal;
-					}
-					break;
-				case preprocess_state::normal:
-					if (c == '\"')
-					{
-						cur_state = preprocess_state::in_string_literal;
-					}
-					if (c == '/')
-					{
-						cur_state = preprocess_state::normal_seen_slash;
-					}
-					else
-					{
-						outputLine.push_back(c);
-					}
-					break;
+				print_source_error(begin, begin + line.begin, "Expected \"header\" or <header> after #include", name);
+				return 1;
+			}
+			directive.header = rest.substr(1, rest.size() - 2);
+			directive.angled = rest.front() == '<';
+		}
+		else if (line.word == "pragma")
+		{
+			// pragmas we don't know are ignored, like everywhere else
+			if (line.rest == "once")
+			{
+				file.once = true;
+			}
+		}
+		else if (!line.word.empty() || !line.rest.empty())
+		{
+			// a # on its own does nothing
+			std::string msg = "Unsupported preprocessor directive #" + line.word;
+			print_source_error(begin, begin + line.begin, msg.c_str(), name);
+			return 1;
+		}
+		file.directives.push_back(std::move(directive));
+	}
+	return 0;
+}
 
-				case preprocess_state::normal_seen_slash:
-					if (c == '*')
-					{
-						cur_state = preprocess_state::in_block_comment;
-					}
-					else if (c == '/')
-					{
-						cur_state = preprocess_state::normal;
-						breakCommentFlag = true;
-					}
-					else
-					{
-						cur_state = preprocess_state::normal;
-						outputLine.push_back('/');
-						outputLine.push_back(c);
-					}
-					break;
+// A header, as it was on disk when we read it
+struct Header
+{
+	SourceFile file;
+	struct timespec mtime;
+	off_t size;
+	dev_t device;
+	ino_t inode;
+};
 
-				case preprocess_state::in_block_comment:
-					if (c == '*')
-					{
-						cur_state = preprocess_state::in_block_comment_seen_star;
-					}
-					break;
+// Every header read in this process, by path. Headers are shared between all
+// the files compiled in it, in batch and server mode, so a header of
+// prototypes that everything includes is read once rather than once a file.
+// The least recently included ones go once they add up to more than
+// maxHeaderBytes, so a server that sees many projects doesn't keep them all
+class HeaderCache
+{
+private:
+	static constexpr size_t maxHeaderBytes = 64 * 1024 * 1024;
 
-				case preprocess_state::in_block_comment_seen_star:
-					if (c == '/')
-					{
-						cur_state = preprocess_state::normal;
-					}
-					else
-					{
-						cur_state = preprocess_state::in_block_comment;
-					}
-					break;
-			}
+	// one path's header. Only whoever holds reading reads the file or
+	// looks at header, the rest is the cache's and goes under its lock
+	struct Slot
+	{
+		std::mutex reading;
+		std::shared_ptr<const Header> header;
+		std::list<std::string>::iterator recent;
+		size_t bytes = 0;
+		bool cached = true;	// still in headers, it isn't once evicted
+	};
+
+	std::mutex lock;
+	std::unordered_map<std::string, std::shared_ptr<Slot>> headers;
+	std::list<std::string> recent;	// the paths in headers, most recently included first
+	size_t bytes = 0;
+	HeaderCacheStats counts {0, 0};
+
+	std::shared_ptr<Slot> slot(const std::string& path)
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		std::shared_ptr<Slot>& slot = this->headers[path];
+		if (slot == nullptr)
+		{
+			slot = std::make_shared<Slot>();
+			this->recent.push_front(path);
+			slot->recent = this->recent.begin();
+		}
+		else
+		{
+			this->recent.splice(this->recent.begin(), this->recent, slot->recent);
+		}
+		return slot;
+	}
+
+	void evict()
+	{
+		// never the one just read, it's at the front
+		while (this->bytes > maxHeaderBytes && this->recent.size() > 1)
+		{
+			auto it = this->headers.find(this->recent.back());
+			this->bytes -= it->second->bytes;
+			it->second->cached = false;
+			this->headers.erase(it);
+			this->recent.pop_back();
+		}
+	}
 
-			if (breakCommentFlag)
+public:
+	// The header at path, which stat says is st. It's read the first time it
+	// is asked for and again only once it changes. nullptr, after reporting
+	// why, if it can't be read or has errors
+	std::shared_ptr<const Header> load(const std::string& path, const struct stat& st)
+	{
+		// files compiled in parallel that include the same new header wait
+		// for the one read of it, but the cache's lock isn't held while it
+		// happens, so headers at other paths are read at the same time
+		std::shared_ptr<Slot> slot = this->slot(path);
+		std::lock_guard<std::mutex> reading(slot->reading);
+		if (slot->header != nullptr)
+		{
+			const Header& header = *slot->header;
+			if (header.mtime.tv_sec == st.st_mtim.tv_sec && header.mtime.tv_nsec == st.st_mtim.tv_nsec
+				&& header.size == st.st_size && header.device == st.st_dev && header.inode == st.st_ino)
 			{
-				breakCommentFlag = false;
-				break;
+				std::lock_guard<std::mutex> guard(this->lock);
+				this->counts.reuses++;
+				return slot->header;
 			}
 		}
-		// write output to our file
-		writefile << outputLine << "\n";
+		// a file that can't be read leaves the slot as it was, and whoever
+		// is waiting on it tries again and reports the error to their own diag()
+		MappedFile mapped;
+		if (mapped.open(path) != 0)
+		{
+			return nullptr;
+		}
+		auto header = std::make_shared<Header>();
+		header->file.text.reserve(mapped.len);
+		if (clean_source(mapped.data, mapped.data + mapped.len, header->file.text, path.c_str()) != 0
+			|| find_directives(header->file, path.c_str()) != 0)
+		{
+			return nullptr;
+		}
+		// what we read is what the mapping saw, which might be newer than st
+		header->mtime = mapped.st.st_mtim;
+		header->size = mapped.st.st_size;
+		header->device = mapped.st.st_dev;
+		header->inode = mapped.st.st_ino;
+		slot->header = header;
+
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->counts.reads++;
+		if (slot->cached)
+		{
+			this->bytes += header->file.text.size() - slot->bytes;
+			slot->bytes = header->file.text.size();
+			this->evict();
+		}
+		return header;
 	}
-	// TODO: Error check, what if we don't end a comment before end of file?
-	if (cur_state == preprocess_state::in_string_literal)
+
+	HeaderCacheStats stats()
 	{
-		std::cout << "[" << RED << "error" << RESET << "] Unterminated string literal\n";
-		return 0;
+		std::lock_guard<std::mutex> guard(this->lock);
+		return this->counts;
 	}
-	if (cur_state != preprocess_state::normal)
+};
+
+static HeaderCache headerCache;
+
+HeaderCacheStats header_cache_stats()
+{
+	return headerCache.stats();
+}
+
+// what one file being compiled has included so far
+struct IncludeState
+{
+	const std::vector<std::string>& includeDirs;
+	std::set<std::pair<dev_t, ino_t>> finished;	// headers that can't add anything more, their guard or #pragma once says so
+	std::unordered_set<std::string> guards;		// the include guards defined so far
+	int depth = 0;
+};
+
+// as deep as gcc lets includes nest, which is only ever hit by a header including itself
+static constexpr int maxIncludeDepth = 200;
+
+static std::string directory_of(const std::string& path)
+{
+	// with the slash, so a header's name can go right after it
+	size_t slash = path.rfind('/');
+	return slash == std::string::npos ? "" : path.substr(0, slash + 1);
+}
+
+static bool find_header(const Directive& directive, const std::string& dir, const IncludeState& state, std::string& path, struct stat& st)
+{
+	auto found = [&path, &st](std::string candidate) {
+		if (stat(candidate.c_str(), &st) != 0 || !S_ISREG(st.st_mode))
+		{
+			return false;
+		}
+		path = std::move(candidate);
+		return true;
+	};
+	if (directive.header[0] == '/')
 	{
-		std::cout << "[" << RED << "error" << RESET << "] Unterminated comment\n";
-		return 0;
+		return found(directive.header);
+	}
+	if (!directive.angled && found(dir + directive.header))
+	{
+		return true;
+	}
+	for (auto& includeDir : state.includeDirs)
+	{
+		if (found(includeDir + "/" + directive.header))
+		{
+			return true;
+		}
 	}
-	readfile.close();
-	writefile.close();
+	return false;
+}
+
+static void append(std::string& out, const char* begin, const char* end, bool flatten)
+{
+	size_t start = out.size();
+	out.append(begin, end);
+	if (flatten)
+	{
+		std::replace(out.begin() + start, out.end(), '\n', ' ');
+	}
+}
+
+static int expand(const SourceFile& file, const char* name, const std::string& dir, IncludeState& state, std::string& out)
+{
+	// Copy the file to out with every #include replaced by what it includes.
+	// A header goes on the line its #include was on, its newlines made spaces,
+	// so the lines after it keep their numbers. That makes anything wrong in
+	// a header's code come up on the #include's line
+	const char* text = file.text.data();
+	bool flatten = state.depth > 0;
+	uint32_t copied = 0;
+	for (auto& directive : file.directives)
+	{
+		append(out, text + copied, text + directive.begin, flatten);
+		copied = directive.end;
+		if (directive.header.empty())
+		{
+			continue;
+		}
+
+		std::string path;
+		struct stat st;
+		if (!find_header(directive, dir, state, path, st))
+		{
+			std::string msg = "Can't find header " + directive.header;
+			print_source_error(text, text + directive.begin, msg.c_str(), name);
+			return 1;
+		}
+		// a header that's been fully guarded isn't looked at again
+		std::pair<dev_t, ino_t> id {st.st_dev, st.st_ino};
+		if (state.finished.count(id))
+		{
+			continue;
+		}
+		std::shared_ptr<const Header> header = headerCache.load(path, st);
+		if (header == nullptr)
+		{
+			return 1;
+		}
+		const SourceFile& included = header->file;
+		if (!included.guard.empty() && !state.guards.insert(included.guard).second)
+		{
+			// something else with the same guard got here first
+			continue;
+		}
+		if (included.once || !included.guard.empty())
+		{
+			state.finished.insert(id);
+		}
+		if (state.depth == maxIncludeDepth)
+		{
+			print_source_error(text, text + directive.begin, "#include nested too deeply", name);
+			return 1;
+		}
+		state.depth++;
+		int ret = expand(included, path.c_str(), directory_of(path), state, out);
+		state.depth--;
+		if (ret != 0)
+		{
+			return 1;
+		}
+	}
+	append(out, text + copied, text + file.text.size(), flatten);
 	return 0;
-}
\ No newline at end of file
+}
+
+int import_header_files(const std::string& path, std::string& out, const std::vector<std::string>& includeDirs)
+{
+	// out has the cleaned source, and gets it back with every #include
+	// replaced by what it includes. The file's own buffers are kept around
+	// for the next file, like out is
+	static thread_local SourceFile file;
+	file.text.swap(out);
+	file.directives.clear();
+	file.guard.clear();
+	file.once = false;
+	int ret = find_directives(file, nullptr);
+	if (ret == 0)
+	{
+		IncludeState state {includeDirs, {}, {}, 0};
+		if (!file.guard.empty())
+		{
+			state.guards.insert(file.guard);
+		}
+		out.clear();
+		out.reserve(file.text.size() + 2);
+		ret = expand(file, nullptr, directory_of(path), state, out);
+	}
+	return ret;
+}
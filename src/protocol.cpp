@@ -0,0 +1,122 @@
+/*
+	protocol.cpp
+*/
+#include "headers/protocol.hpp"
+#include <cstdlib>
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+std::string server_socket_path()
+{
+	const char* env = getenv("CCC_SOCKET");
+	if (env && *env)
+	{
+		return env;
+	}
+	return "/tmp/ccc-" + std::to_string(getuid()) + ".sock";
+}
+
+// Socket helpers, these retry on short reads and writes and on signals
+
+static bool write_all(int fd, const char* data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+static bool read_all(int fd, char* data, size_t len)
+{
+	while (len > 0)
+	{
+		ssize_t n = read(fd, data, len);
+		if (n < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (n <= 0)
+		{
+			return false;
+		}
+		data += n;
+		len -= n;
+	}
+	return true;
+}
+
+bool send_message(int fd, const MessageWriter& message)
+{
+	uint32_t len = static_cast<uint32_t>(message.buffer.size());
+	char header[4];
+	std::memcpy(header, &len, sizeof(len));
+	return write_all(fd, header, sizeof(header)) && write_all(fd, message.buffer.data(), message.buffer.size());
+}
+
+bool receive_message(int fd, std::string& payload)
+{
+	// payload is reused between messages so we don't reallocate for each one
+	char header[4];
+	if (!read_all(fd, header, sizeof(header)))
+	{
+		return false;
+	}
+	uint32_t len;
+	std::memcpy(&len, header, sizeof(len));
+	if (len > maxMessageSize)
+	{
+		return false;
+	}
+	payload.resize(len);
+	return read_all(fd, &payload[0], len);
+}
+
+void put_flags(MessageWriter& message, const cmd_line_args& cmds)
+{
+	message.put_i32(cmds.printflag);
+	message.put_i32(cmds.lexflag);
+	message.put_i32(cmds.lexer);
+	message.put_i32(cmds.parser);
+	message.put_i32(cmds.printir);
+	message.put_i32(cmds.optlevel);
+	message.put_i32(cmds.sizelevel);
+	message.put_str(cmds.passes);
+	message.put_i32(cmds.keep_pp);
+	message.put_u32(static_cast<uint32_t>(cmds.include_dirs.size()));
+	for (auto& dir : cmds.include_dirs)
+	{
+		message.put_str(dir);
+	}
+	message.put_i32(cmds.emit);
+}
+
+void get_flags(MessageReader& message, cmd_line_args& cmds)
+{
+	cmds.printflag = message.get_i32();
+	cmds.lexflag = message.get_i32();
+	cmds.lexer = message.get_i32();
+	cmds.parser = message.get_i32();
+	cmds.printir = message.get_i32();
+	cmds.optlevel = message.get_i32();
+	cmds.sizelevel = message.get_i32();
+	cmds.passes = message.get_str();
+	cmds.keep_pp = message.get_i32();
+	uint32_t includeDirs = message.get_u32();
+	for (uint32_t i = 0; i < includeDirs && message.ok; i++)
+	{
+		cmds.include_dirs.push_back(message.get_str());
+	}
+	cmds.emit = message.get_i32();
+}
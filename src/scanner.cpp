@@ -0,0 +1,443 @@
+/*
+	scanner.cpp
+	The hand-written scanner, and Lexer, which hands the parser tokens from
+	it or from flex's.
+*/
+#include "headers/scanner.hpp"
+#include "headers/lexer.hpp"
+#include "headers/common.hpp"
+#include <array>
+#include <cassert>
+#include <charconv>
+#include <string_view>
+
+using token = yy::parser::token;
+using symbol_type = yy::parser::symbol_type;
+
+namespace
+{
+
+enum char_class : unsigned char
+{
+	cc_space = 1,		// ' ', '\t' and '\r', lexer.l's WS. '\n' is handled on its own
+	cc_word = 2,		// can carry on an identifier
+	cc_digit = 4,
+};
+
+constexpr std::array<unsigned char, 256> make_char_class_table()
+{
+	std::array<unsigned char, 256> table {};
+	table[' '] = table['\t'] = table['\r'] = cc_space;
+	for (int c = 'a'; c <= 'z'; c++)
+		table[c] = cc_word;
+	for (int c = 'A'; c <= 'Z'; c++)
+		table[c] = cc_word;
+	for (int c = '0'; c <= '9'; c++)
+		table[c] = cc_word | cc_digit;
+	table['_'] = cc_word;
+	return table;
+}
+
+constexpr std::array<unsigned char, 256> char_class_table = make_char_class_table();
+
+inline bool is(char c, unsigned char cls)
+{
+	return char_class_table[static_cast<unsigned char>(c)] & cls;
+}
+
+struct Keyword
+{
+	std::string_view text;
+	token::token_kind_type kind;
+	TypeName type;		// which one, for TOK_TYPE
+};
+
+constexpr Keyword keywords[] = {
+	{"if", token::TOK_IF, TypeName::tVoid},
+	{"while", token::TOK_WHILE, TypeName::tVoid},
+	{"for", token::TOK_FOR, TypeName::tVoid},
+	{"break", token::TOK_BREAK, TypeName::tVoid},
+	{"continue", token::TOK_CONTINUE, TypeName::tVoid},
+	{"return", token::TOK_RETURN, TypeName::tVoid},
+	{"const", token::TOK_CONST, TypeName::tVoid},
+	{"true", token::TOK_TRUE, TypeName::tVoid},
+	{"false", token::TOK_FALSE, TypeName::tVoid},
+	{"int", token::TOK_TYPE, TypeName::tInt},
+	{"float", token::TOK_TYPE, TypeName::tFloat},
+	{"bool", token::TOK_TYPE, TypeName::tBool},
+	{"void", token::TOK_TYPE, TypeName::tVoid},
+	{"char", token::TOK_TYPE, TypeName::tChar},
+	{"double", token::TOK_TYPE, TypeName::tDouble},
+	{"short", token::TOK_TYPE, TypeName::tShort},
+	{"long", token::TOK_TYPE, TypeName::tLong},
+};
+
+constexpr size_t maxKeywordLength = 8;
+constexpr size_t keywordSlots = 32;
+
+constexpr size_t keyword_hash(std::string_view word)
+{
+	// the first and last letters and the length are enough to tell every
+	// keyword apart. The multipliers were found by trying them in turn,
+	// the static_assert below says when a new keyword needs others
+	return (static_cast<unsigned char>(word.front()) * 9 + static_cast<unsigned char>(word.back()) * 17 + word.size()) % keywordSlots;
+}
+
+constexpr std::array<signed char, keywordSlots> make_keyword_table()
+{
+	// the index into keywords of the one that hashes to each slot, or -1
+	std::array<signed char, keywordSlots> table {};
+	for (auto& slot : table)
+	{
+		slot = -1;
+	}
+	for (size_t i = 0; i < std::size(keywords); i++)
+	{
+		table[keyword_hash(keywords[i].text)] = static_cast<signed char>(i);
+	}
+	return table;
+}
+
+constexpr std::array<signed char, keywordSlots> keyword_table = make_keyword_table();
+
+constexpr bool keyword_hash_is_perfect()
+{
+	for (size_t i = 0; i < std::size(keywords); i++)
+	{
+		if (keyword_table[keyword_hash(keywords[i].text)] != static_cast<signed char>(i) ||
+			keywords[i].text.size() > maxKeywordLength)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static_assert(keyword_hash_is_perfect(), "two keywords share a slot, keyword_hash needs new multipliers");
+
+}
+
+Scanner::Scanner(const char* begin, const char* end, SourceLines* lines)
+	: begin(begin), p(begin), end(end), lines(lines)
+{
+}
+
+SourceRange Scanner::range(const char* start) const
+{
+	return SourceRange {static_cast<uint32_t>(start - this->begin), static_cast<uint32_t>(this->p - this->begin)};
+}
+
+symbol_type Scanner::next()
+{
+	const char* p = this->p;
+	while (true)
+	{
+		while (is(*p, cc_space))
+		{
+			p++;
+		}
+		if (*p != '\n')
+		{
+			break;
+		}
+		p++;
+		this->lines->add_line(p - this->begin);
+	}
+
+	const char* start = p;
+	if (p == this->end)
+	{
+		this->p = p;
+		return yy::parser::make_YYEOF(this->range(start));
+	}
+
+	// the tokens that are a byte or two of punctuation go back from here,
+	// the others have a function of their own
+	token::token_kind_type kind;
+	switch (*p)
+	{
+		case 'a': case 'b': case 'c': case 'd': case 'e': case 'f': case 'g': case 'h': case 'i':
+		case 'j': case 'k': case 'l': case 'm': case 'n': case 'o': case 'p': case 'q': case 'r':
+		case 's': case 't': case 'u': case 'v': case 'w': case 'x': case 'y': case 'z':
+		case 'A': case 'B': case 'C': case 'D': case 'E': case 'F': case 'G': case 'H': case 'I':
+		case 'J': case 'K': case 'L': case 'M': case 'N': case 'O': case 'P': case 'Q': case 'R':
+		case 'S': case 'T': case 'U': case 'V': case 'W': case 'X': case 'Y': case 'Z':
+		case '_':
+			return this->word(start);
+		case '0': case '1': case '2': case '3': case '4':
+		case '5': case '6': case '7': case '8': case '9':
+			return this->number(start);
+		case '.':
+			if (!is(p[1], cc_digit))
+			{
+				return this->invalid(start);
+			}
+			return this->number(start);
+		case '\'':
+			return this->character(start);
+		case '(': kind = token::TOK_LPAREN; break;
+		case ')': kind = token::TOK_RPAREN; break;
+		case '{': kind = token::TOK_LBRACE; break;
+		case '}': kind = token::TOK_RBRACE; break;
+		case ',': kind = token::TOK_COMMA; break;
+		case ';': kind = token::TOK_SEMICOLON; break;
+		case ':': kind = token::TOK_COLON; break;
+		case '?': kind = token::TOK_QUESTION_MARK; break;
+		case '%': kind = token::TOK_MOD; break;
+		case '^': kind = token::TOK_BIT_XOR; break;
+		case '~': kind = token::TOK_BIT_NOT; break;
+		case '!':
+			if (p[1] != '=')
+			{
+				return this->invalid(start);
+			}
+			kind = token::TOK_NE;
+			p++;
+			break;
+		case '=':
+			kind = token::TOK_ASSIGN;
+			if (p[1] == '=')
+			{
+				kind = token::TOK_EQ;
+				p++;
+			}
+			break;
+		case '<':
+			kind = token::TOK_LT;
+			if (p[1] == '=' || p[1] == '<')
+			{
+				kind = p[1] == '=' ? token::TOK_LE : token::TOK_LEFT_SHIFT;
+				p++;
+			}
+			break;
+		case '>':
+			kind = token::TOK_GT;
+			if (p[1] == '=' || p[1] == '>')
+			{
+				kind = p[1] == '=' ? token::TOK_GE : token::TOK_RIGHT_SHIFT;
+				p++;
+			}
+			break;
+		case '+':
+			kind = token::TOK_PLUS;
+			if (p[1] == '=')
+			{
+				kind = token::TOK_PLUS_ASSIGN;
+				p++;
+			}
+			break;
+		case '-':
+			kind = token::TOK_MINUS;
+			if (p[1] == '=')
+			{
+				kind = token::TOK_MINUS_ASSIGN;
+				p++;
+			}
+			break;
+		case '*':
+			kind = token::TOK_STAR;
+			if (p[1] == '=')
+			{
+				kind = token::TOK_STAR_ASSIGN;
+				p++;
+			}
+			break;
+		case '/':
+			kind = token::TOK_SLASH;
+			if (p[1] == '=')
+			{
+				kind = token::TOK_SLASH_ASSIGN;
+				p++;
+			}
+			break;
+		case '&':
+			kind = token::TOK_BIT_AND;
+			if (p[1] == '&')
+			{
+				kind = token::TOK_LOG_AND;
+				p++;
+			}
+			break;
+		case '|':
+			kind = token::TOK_BIT_OR;
+			if (p[1] == '|')
+			{
+				kind = token::TOK_LOG_OR;
+				p++;
+			}
+			break;
+		default:
+			return this->invalid(start);
+	}
+	this->p = p + 1;
+	return symbol_type(kind, this->range(start));
+}
+
+symbol_type Scanner::word(const char* start)
+{
+	const char* p = start + 1;
+	while (is(*p, cc_word))
+	{
+		p++;
+	}
+	this->p = p;
+	std::string_view text(start, p - start);
+	if (text.size() <= maxKeywordLength)
+	{
+		signed char k = keyword_table[keyword_hash(text)];
+		if (k >= 0 && keywords[k].text == text)
+		{
+			if (keywords[k].kind == token::TOK_TYPE)
+			{
+				return yy::parser::make_TOK_TYPE(keywords[k].type, this->range(start));
+			}
+			return symbol_type(keywords[k].kind, this->range(start));
+		}
+	}
+	return yy::parser::make_TOK_IDENTIFIER(intern(text), this->range(start));
+}
+
+symbol_type Scanner::number(const char* start)
+{
+	// [0-9]+ is an int. A '.' or a complete exponent after it, or a '.'
+	// and a digit on their own, make it one of lexer.l's float forms
+	const char* p = start;
+	bool isFloat = false;
+	while (is(*p, cc_digit))
+	{
+		p++;
+	}
+	if (*p == '.')
+	{
+		isFloat = true;
+		p++;
+		while (is(*p, cc_digit))
+		{
+			p++;
+		}
+	}
+	if (*p == 'e' || *p == 'E' || *p == 'p' || *p == 'P')
+	{
+		const char* exponent = p + 1;
+		if (*exponent == '+' || *exponent == '-')
+		{
+			exponent++;
+		}
+		if (is(*exponent, cc_digit))
+		{
+			isFloat = true;
+			p = exponent + 1;
+			while (is(*p, cc_digit))
+			{
+				p++;
+			}
+		}
+	}
+	this->p = p;
+
+	// from_chars stops where a decimal float does, so a p exponent is
+	// scanned but left out of the value, the same as std::stof did
+	std::from_chars_result converted;
+	if (isFloat)
+	{
+		float value = 0;
+		converted = std::from_chars(start, p, value);
+		if (converted.ec == std::errc())
+		{
+			return yy::parser::make_TOK_FLOAT(value, this->range(start));
+		}
+	}
+	else
+	{
+		int value = 0;
+		converted = std::from_chars(start, p, value);
+		if (converted.ec == std::errc())
+		{
+			return yy::parser::make_TOK_INTEGER(value, this->range(start));
+		}
+	}
+	diag() << "[error] constant " << std::string_view(start, p - start) << " is out of range.\n";
+	return yy::parser::make_YYUNDEF(this->range(start));
+}
+
+symbol_type Scanner::character(const char* start)
+{
+	// '\x' for the escapes lexer.l knows, or 'x' for a letter or digit
+	const char* p = start + 1;
+	char value;
+	if (*p == '\\')
+	{
+		switch (p[1])
+		{
+			case 'a': value = '\a'; break;
+			case 'b': value = '\b'; break;
+			case 'f': value = '\f'; break;
+			case 'n': value = '\n'; break;
+			case 'r': value = '\r'; break;
+			case 't': value = '\t'; break;
+			case 'v': value = '\v'; break;
+			case '0': value = '\0'; break;
+			case '\\': case '\'': case '"': case '?': value = p[1]; break;
+			default: return this->invalid(start);
+		}
+		p += 2;
+	}
+	else if (is(*p, cc_word) && *p != '_')
+	{
+		value = *p++;
+	}
+	else
+	{
+		return this->invalid(start);
+	}
+	if (*p != '\'')
+	{
+		return this->invalid(start);
+	}
+	this->p = p + 1;
+	return yy::parser::make_TOK_CHAR(value, this->range(start));
+}
+
+symbol_type Scanner::invalid(const char* start)
+{
+	// one byte at a time, like flex's catch-all rule
+	this->p = start + 1;
+	diag() << "[error] invalid token.\n";
+	return yy::parser::make_YYUNDEF(this->range(start));
+}
+
+Lexer::Lexer(std::string& source, SourceLines* lines, lexer_kind kind) : source(source), sourceLines(lines)
+{
+	if (kind == lexer_dfa)
+	{
+		this->scanner = Scanner(source.data(), source.data() + source.size(), lines);
+		return;
+	}
+	// flex scans the buffer in place too, all it needs is two end of
+	// buffer characters tacked onto the end
+	yylex_init_extra(lines, &this->flex);
+	source.append(2, YY_END_OF_BUFFER_CHAR);
+	yy_scan_buffer(&source[0], source.size(), this->flex);
+}
+
+Lexer::~Lexer()
+{
+	if (this->flex != nullptr)
+	{
+		yylex_destroy(this->flex);
+		// strip the end of buffer characters again so the source is untouched
+		this->source.resize(this->source.size() - 2);
+	}
+}
+
+symbol_type Lexer::next()
+{
+	if (this->flex == nullptr)
+	{
+		return this->scanner.next();
+	}
+	symbol_type s;
+	int x = yylex(&s, nullptr, this->flex);
+	assert(x == 1);
+	return s;
+}
@@ -0,0 +1,326 @@
+/*
+	server.cpp
+	Compile server, see protocol.hpp for what goes over the socket.
+*/
+#include "headers/server.hpp"
+#include "headers/protocol.hpp"
+#include "headers/driver.hpp"
+#include "headers/preprocess.hpp"
+#include "headers/common.hpp"
+#include "headers/threadpool.hpp"
+#include "headers/consolecolors.hpp"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// how many clients we'll talk to at once, the rest wait in the listen queue
+static constexpr unsigned connectionThreads = 16;
+
+void LatencyHistogram::record(uint64_t micros)
+{
+	int bucket = 0;
+	while (bucket < bucketCount - 1 && (micros >> bucket) > 1)
+	{
+		bucket++;
+	}
+	this->buckets[bucket]++;
+	this->count++;
+	this->totalMicros += micros;
+	uint64_t seen = this->maxMicros;
+	while (micros > seen && !this->maxMicros.compare_exchange_weak(seen, micros))
+	{
+	}
+}
+
+void LatencyHistogram::print(std::ostream& out, const std::string& name) const
+{
+	uint64_t n = this->count;
+	out << name << ": " << n << " samples";
+	if (n == 0)
+	{
+		out << "\n";
+		return;
+	}
+	out << ", mean " << this->totalMicros / n << "us, max " << this->maxMicros << "us\n";
+	uint64_t largest = 0;
+	for (auto& b : this->buckets)
+	{
+		largest = std::max<uint64_t>(largest, b);
+	}
+	for (int i = 0; i < bucketCount; i++)
+	{
+		uint64_t c = this->buckets[i];
+		if (c == 0)
+		{
+			continue;
+		}
+		// bucket i holds [2^i, 2^(i+1)) microseconds, except bucket 0 which also has 0
+		uint64_t low = i == 0 ? 0 : (1ull << i);
+		out << "  " << std::string(12 - std::min<size_t>(12, std::to_string(low).size()), ' ') << low
+			<< "us+ " << std::string(10 - std::min<size_t>(10, std::to_string(c).size()), ' ') << c
+			<< " " << std::string(static_cast<size_t>(40 * c / largest), '#') << "\n";
+	}
+}
+
+struct ServerStats
+{
+	LatencyHistogram requestLatency;	// from reading a request to sending its last reply
+	LatencyHistogram fileLatency;		// compiling a single file
+	std::atomic<uint64_t> requests {0};
+	std::atomic<uint64_t> files {0};
+	std::atomic<uint64_t> failures {0};
+};
+
+static volatile sig_atomic_t serverStopping = 0;
+
+static void stop_server(int)
+{
+	serverStopping = 1;
+}
+
+static void print_header_stats(std::ostream& out)
+{
+	HeaderCacheStats headers = header_cache_stats();
+	out << "headers read: " << headers.reads << ", reused: " << headers.reuses << "\n";
+}
+
+static uint64_t micros_since(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+static bool serve_compile(int fd, MessageReader& request, ThreadPool& pool, ServerStats& stats, MessageWriter& reply)
+{
+	auto start = std::chrono::steady_clock::now();
+	cmd_line_args cmds;
+	get_flags(request, cmds);
+	uint32_t count = request.get_u32();
+	std::vector<std::unique_ptr<CompileJob>> jobs;
+	for (uint32_t i = 0; i < count && request.ok; i++)
+	{
+		auto job = std::make_unique<CompileJob>();
+		job->filename = request.get_str();
+		job->path = request.get_str();
+		job->hasSource = request.get_u8() != 0;
+		if (job->hasSource)
+		{
+			job->source = request.get_str();
+		}
+		jobs.push_back(std::move(job));
+	}
+	if (!request.ok)
+	{
+		return false;
+	}
+
+	// replies go out in order as files finish, the client writes the outputs
+	bool connected = true;
+	int failed = run_jobs(pool, cmds, jobs, false, [&](CompileJob& job) {
+		stats.files++;
+		stats.fileLatency.record(job.micros);
+		if (job.status != 0)
+		{
+			stats.failures++;
+		}
+		if (!connected)
+		{
+			return;	// the client went away, just let the rest of the work drain
+		}
+		reply.clear();
+		reply.put_u8(reply_file);
+		reply.put_i32(job.status);
+		reply.put_str(job.log.str());
+		reply.put_u32(static_cast<uint32_t>(job.outputs.size()));
+		for (auto& output : job.outputs)
+		{
+			reply.put_str(output.path);
+			reply.put_str(output.data);
+			reply.put_u8(output.executable);
+		}
+		connected = send_message(fd, reply);
+		job.log.str(std::string());
+		job.outputs.clear();
+	});
+
+	reply.clear();
+	reply.put_u8(reply_done);
+	reply.put_i32(failed);
+	connected = connected && send_message(fd, reply);
+	stats.requests++;
+	stats.requestLatency.record(micros_since(start));
+	return connected;
+}
+
+// The client sockets that are open. Stopping the server stops reading from
+// them, so a client that's connected but idle can't keep us from exiting,
+// while one that's waiting on a compile still gets its replies
+class OpenConnections
+{
+private:
+	std::mutex lock;
+	std::set<int> fds;
+	bool stopping = false;
+
+public:
+	void add(int fd)
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->fds.insert(fd);
+		if (this->stopping)
+		{
+			shutdown(fd, SHUT_RD);
+		}
+	}
+
+	void close(int fd)
+	{
+		// under the lock, so stop() never sees the number after it's reused
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->fds.erase(fd);
+		::close(fd);
+	}
+
+	void stop()
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->stopping = true;
+		for (int fd : this->fds)
+		{
+			// wakes up whoever is waiting in receive_message, which sees the end of the stream
+			shutdown(fd, SHUT_RD);
+		}
+	}
+};
+
+static void serve_connection(int fd, ThreadPool& pool, ServerStats& stats, OpenConnections& connections)
+{
+	// each connection thread keeps its buffers between requests
+	static thread_local std::string payload;
+	static thread_local MessageWriter reply;
+	while (receive_message(fd, payload))
+	{
+		MessageReader request(payload);
+		uint8_t kind = request.get_u8();
+		bool ok;
+		if (kind == request_compile)
+		{
+			ok = serve_compile(fd, request, pool, stats, reply);
+		}
+		else if (kind == request_stats)
+		{
+			std::ostringstream text;
+			text << "requests: " << stats.requests << ", files: " << stats.files << ", failed files: " << stats.failures << "\n";
+			stats.requestLatency.print(text, "request latency");
+			stats.fileLatency.print(text, "file latency");
+			print_header_stats(text);
+			reply.clear();
+			reply.put_u8(reply_stats);
+			reply.put_str(text.str());
+			ok = send_message(fd, reply);
+		}
+		else
+		{
+			ok = false;
+		}
+		if (!ok)
+		{
+			break;
+		}
+	}
+	connections.close(fd);
+}
+
+int run_server(const cmd_line_args& cmds)
+{
+	std::string path = server_socket_path();
+	sockaddr_un addr {};
+	addr.sun_family = AF_UNIX;
+	if (path.size() >= sizeof(addr.sun_path))
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Socket path too long: " << path << "\n";
+		return 1;
+	}
+	std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+	int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (listener < 0)
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Can't create socket: " << std::strerror(errno) << "\n";
+		return 1;
+	}
+	unlink(path.c_str());	// a stale socket from a server that didn't shut down cleanly
+	if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 128) != 0)
+	{
+		std::cout << "[" << RED << "error" << RESET << "] Can't listen on " << path << ": " << std::strerror(errno) << "\n";
+		close(listener);
+		return 1;
+	}
+
+	// no SA_RESTART, so a signal knocks us out of accept and we can shut down
+	struct sigaction action {};
+	action.sa_handler = stop_server;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, nullptr);
+	sigaction(SIGTERM, &action, nullptr);
+	signal(SIGPIPE, SIG_IGN);
+
+	// the pool threads inherit a mask that blocks our stop signals, so they are
+	// always delivered to this thread and interrupt accept
+	sigset_t stopSignals;
+	sigemptyset(&stopSignals);
+	sigaddset(&stopSignals, SIGINT);
+	sigaddset(&stopSignals, SIGTERM);
+	pthread_sigmask(SIG_BLOCK, &stopSignals, nullptr);
+
+	ServerStats stats;
+	OpenConnections connections;
+	{
+		ThreadPool compilePool(cmds.jobs);
+		ThreadPool connectionPool(connectionThreads);
+		pthread_sigmask(SIG_UNBLOCK, &stopSignals, nullptr);
+		std::cout << "Listening on " << path << " with " << compilePool.size() << " compile threads\n";
+		std::cout.flush();
+
+		while (!serverStopping)
+		{
+			int fd = accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+			if (fd < 0)
+			{
+				if (errno == EINTR || errno == ECONNABORTED)
+				{
+					continue;
+				}
+				std::cout << "[" << RED << "error" << RESET << "] accept failed: " << std::strerror(errno) << "\n";
+				break;
+			}
+			// added here rather than when a thread picks it up, so one still
+			// waiting for a thread is hung up on as well
+			connections.add(fd);
+			connectionPool.submit([fd, &compilePool, &stats, &connections] { serve_connection(fd, compilePool, stats, connections); });
+		}
+		close(listener);
+		unlink(path.c_str());
+		connections.stop();
+		// the pools finish whatever is in flight before they go away
+	}
+
+	std::cout << "Server stopped\n";
+	std::cout << "requests: " << stats.requests << ", files: " << stats.files << ", failed files: " << stats.failures << "\n";
+	stats.requestLatency.print(std::cout, "request latency");
+	stats.fileLatency.print(std::cout, "file latency");
+	print_header_stats(std::cout);
+	return 0;
+}
@@ -0,0 +1,28 @@
+/*
+	srcloc.cpp
+*/
+#include "headers/srcloc.hpp"
+#include <algorithm>
+
+SourceLines::SourceLines(AstArena& arena) : starts(arena)
+{
+	this->starts.push_back(0);
+}
+
+LineColumn SourceLines::find(uint32_t offset) const
+{
+	// the last line that starts at or before offset
+	const uint32_t* after = std::upper_bound(this->starts.begin(), this->starts.end(), offset);
+	uint32_t line = after - this->starts.begin();
+	return LineColumn {line, offset - this->starts[line - 1] + 1};
+}
+
+std::ostream& operator<<(std::ostream& out, LineColumn at)
+{
+	return out << at.line << ", " << at.column;
+}
+
+std::ostream& operator<<(std::ostream& out, SourceRange range)
+{
+	return out << range.begin << "-" << range.end;
+}
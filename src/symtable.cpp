@@ -6,107 +6,152 @@
 
 #include "headers/symtable.hpp"
 #include <vector>
-#include <list>
+
+// the table starts with this many slots, and doubles whenever it gets half full
+static constexpr uint32_t firstSlotBits = 6;
 
 SymbolTable::SymbolTable()
 {
-	// init our list and tables here
-	SymbolTableStack = std::list<SymbolTableType*>();
+	this->slots.assign(size_t(1) << firstSlotBits, Slot {0, -1});
+	this->slotShift = 32 - firstSlotBits;
 	PushScope();	// start our main scope
 }
 
-bool SymbolTable::AddSymbol(std::string name, TypeName type, bool isConstant, YYLTYPE loc)
+SymbolTable::Slot* SymbolTable::find_slot(Symbol name)
 {
-	// add this symbol to the currently in scope symbol table
-	// return true if it succeeded or false if this symbol already 
-	// exists in this scope
-	if (CurrentSymbolTable->find(name) != CurrentSymbolTable->end())
+	// Fibonacci hashing spreads the consecutive ids the interner hands out
+	// across the whole table, then probe linearly from there
+	uint32_t key = name.id + 1;
+	uint32_t mask = this->slots.size() - 1;
+	for (uint32_t i = (key * 2654435769u) >> this->slotShift; ; i = (i + 1) & mask)
 	{
-		return false;	// already declared in this scope
+		Slot& slot = this->slots[i];
+		if (slot.key == key)
+		{
+			return &slot;
+		}
+		if (slot.key == 0)
+		{
+			return nullptr;
+		}
 	}
-	// make our new symbol table entry
-	SymbolTableEntry* symbolTableEntry = new SymbolTableEntry();
-	symbolTableEntry->Name = name;
-	symbolTableEntry->Type = type;
-	symbolTableEntry->isConstant = isConstant;
-	symbolTableEntry->declarationLocation = loc;
-	// add it to the current active symbol table
-	CurrentSymbolTable->insert(std::pair<std::string, SymbolTableEntry*>(name, symbolTableEntry));
-	return true;
 }
 
-bool SymbolTable::AddLLVMSymbol(std::string name, llvm::AllocaInst* val)
+SymbolTable::Slot& SymbolTable::claim_slot(Symbol name)
+{
+	// the slot for name, taking an empty one if it's never been declared
+	if (Slot* slot = this->find_slot(name))
+	{
+		return *slot;
+	}
+	if ((this->usedSlots + 1) * 2 > this->slots.size())
+	{
+		this->grow_slots();
+	}
+	uint32_t key = name.id + 1;
+	uint32_t mask = this->slots.size() - 1;
+	uint32_t i = (key * 2654435769u) >> this->slotShift;
+	while (this->slots[i].key != 0)
+	{
+		i = (i + 1) & mask;
+	}
+	this->usedSlots++;
+	this->slots[i] = Slot {key, -1};
+	return this->slots[i];
+}
+
+void SymbolTable::grow_slots()
+{
+	std::vector<Slot> old;
+	old.swap(this->slots);
+	this->slots.assign(old.size() * 2, Slot {0, -1});
+	this->slotShift--;
+	uint32_t mask = this->slots.size() - 1;
+	for (auto& slot : old)
+	{
+		if (slot.key == 0)
+		{
+			continue;
+		}
+		uint32_t i = (slot.key * 2654435769u) >> this->slotShift;
+		while (this->slots[i].key != 0)
+		{
+			i = (i + 1) & mask;
+		}
+		this->slots[i] = slot;
+	}
+}
+
+SymbolTableEntry* SymbolTable::bind(Symbol name)
+{
+	// a new binding for name in the current scope, or nullptr if
+	// the scope already has one
+	Slot& slot = this->claim_slot(name);
+	if (slot.innermost >= 0 && uint32_t(slot.innermost) >= this->scopeStarts.back())
+	{
+		return nullptr;	// already declared in this scope
+	}
+	this->bindings.push_back(Binding {SymbolTableEntry(), slot.innermost});
+	slot.innermost = this->bindings.size() - 1;
+	SymbolTableEntry* entry = &this->bindings.back().entry;
+	entry->Name = name;
+	return entry;
+}
+
+bool SymbolTable::AddSymbol(Symbol name, TypeName type, bool isConstant, uint32_t loc, int32_t slot)
 {
 	// add this symbol to the currently in scope symbol table
 	// return true if it succeeded or false if this symbol already 
-	// exists in this scope. This is for use in the llvm IR generation
-	// phase so the only thing we need is the llvm::Value*
-	if (CurrentSymbolTable->find(name) != CurrentSymbolTable->end())
+	// exists in this scope
+	SymbolTableEntry* symbolTableEntry = this->bind(name);
+	if (!symbolTableEntry)
 	{
-		return false;	// already declared in this scope
+		return false;
 	}
-	// make our new symbol table entry
-	SymbolTableEntry* symbolTableEntry = new SymbolTableEntry();
-	symbolTableEntry->Name = name;
-	symbolTableEntry->val = val;
-	// add it to the current active symbol table
-	CurrentSymbolTable->insert(std::pair<std::string, SymbolTableEntry*>(name, symbolTableEntry));
+	symbolTableEntry->Type = type;
+	symbolTableEntry->isConstant = isConstant;
+	symbolTableEntry->declarationLocation = loc;
+	symbolTableEntry->slot = slot;
 	return true;
 }
 
 void SymbolTable::PushScope()
 {								
 	// enter a new scope
-	SymbolTableType* NewSymbolTable = new SymbolTableType();
-	this->SymbolTableStack.push_back(NewSymbolTable);
-	CurrentSymbolTable = this->SymbolTableStack.back();
+	this->scopeStarts.push_back(this->bindings.size());
 }
 
 void SymbolTable::PopScope()
 {
 	// exit from our current scope
-	if (this->SymbolTableStack.size() == 0)
+	if (this->scopeStarts.empty())
 	{
 		// we're attempting to pop on an empty symbol stack, something's gone wrong!
 		// TODO: show an error message or throw an error or something?? Handle this somewhere?
 		return;
 	}
-	SymbolTableType* del = this->SymbolTableStack.back();
-	this->SymbolTableStack.pop_back();							// Remove and clean up symbol table when we're
-	for (auto& st: *del)
+	// unwind this scope's bindings, newest first, so each name gets back
+	// whatever it shadowed
+	uint32_t start = this->scopeStarts.back();
+	this->scopeStarts.pop_back();
+	for (size_t i = this->bindings.size(); i > start; i--)
 	{
-		delete(st.second);
+		Binding& binding = this->bindings[i - 1];
+		this->find_slot(binding.entry.Name)->innermost = binding.shadowed;
 	}
-	delete(del);												// finished with it
-	CurrentSymbolTable = this->SymbolTableStack.back();
+	this->bindings.resize(start);
 }
 
-SymbolTableEntry* SymbolTable::GetSymbol(std::string Symbol)
+SymbolTableEntry* SymbolTable::GetSymbol(Symbol name)
 {
-	// return the Symbol from the topmost scoped symbol table
-	// if none, return NULL or NULLPTR or 0 or something?
-	// TODO: Test this? Not sure if this even really works?
-	// since it wasn'a a priority for this Lab
-	for (auto iter = SymbolTableStack.rbegin();
-		iter != SymbolTableStack.rend();
-		iter++)
+	// return the innermost binding of name that's in scope, or
+	// nullptr if there isn't one
+	Slot* slot = this->find_slot(name);
+	if (!slot || slot->innermost < 0)
 	{
-		auto found = (*iter)->find(Symbol);	
-		if (found == (*iter)->end())
-		{
-			continue;
-		}
-		return found->second;
+		return nullptr;
 	}
-	return nullptr;
-}
-
-llvm::AllocaInst* SymbolTable::GetLLVMValue(std::string Symbol)
-{
-	SymbolTableEntry* s = this->GetSymbol(Symbol);
-	if (s)
-		return s->val;
-	return nullptr;
+	return &this->bindings[slot->innermost].entry;
 }
 
 void SymbolTable::PrintSymbolTable()
@@ -117,15 +162,12 @@ void SymbolTable::PrintSymbolTable()
 
 void SymbolTable::CleanUpSymbolTable()
 {
-	// free memory up
-	for (auto& s : SymbolTableStack)
-	{
-		for (auto& st: *s)
-		{
-			delete(st.second);
-		}
-		delete(s);
-	}
+	// the entries live in our own arrays, nothing is left to free
+	// but their memory
+	this->bindings = std::vector<Binding>();
+	this->scopeStarts = std::vector<uint32_t>();
+	this->slots = std::vector<Slot>();
+	this->usedSlots = 0;
 }
 
 // Function table stuff goes here
@@ -137,7 +179,7 @@ FunctionTable::FunctionTable()
 
 }
 
-bool FunctionTable::AddFunction(std::string Name, TypeName ReturnType, std::vector<TypeName> ParamTypes)
+bool FunctionTable::AddFunction(Symbol Name, TypeName ReturnType, std::vector<TypeName> ParamTypes)
 {
 	// Add a function table entry
 	FunctionTableEntry* funcTableEntry = new FunctionTableEntry();
@@ -145,7 +187,11 @@ bool FunctionTable::AddFunction(std::string Name, TypeName ReturnType, std::vect
 	funcTableEntry->ReturnType = ReturnType;
 	funcTableEntry->ParamTypes = std::move(ParamTypes);
 	funcTableEntry->hasDefinition = false;
-	funcTable->insert(std::pair<std::string, FunctionTableEntry*>(Name, funcTableEntry));
+	funcTableEntry->id = funcTable->size();
+	if (!funcTable->insert(std::pair<Symbol, FunctionTableEntry*>(Name, funcTableEntry)).second)
+	{
+		delete(funcTableEntry);	// redeclaration, the first entry stays
+	}
 	return true;
 }
 void FunctionTable::PrintFunctionTable()
@@ -154,7 +200,7 @@ void FunctionTable::PrintFunctionTable()
 	// TODO: For now, debug with GDB like a pro!
 }
 
-bool FunctionTable::IsFunctionDefined(std::string Name)
+bool FunctionTable::IsFunctionDefined(Symbol Name)
 {
 	// Check the function table to see if we have a definition for
 	// a function or just a declaration
@@ -166,7 +212,7 @@ bool FunctionTable::IsFunctionDefined(std::string Name)
 	return ffunc->hasDefinition;
 }
 
-void FunctionTable::EnterFunctionDefinition(std::string Name)
+void FunctionTable::EnterFunctionDefinition(Symbol Name)
 {
 	// Helper for evaluator to keep track of function declaration / definition
 	this->currentFunction = this->GetFunction(Name);
@@ -178,7 +224,7 @@ void FunctionTable::ExitFunctionDefinition()
 	this->currentFunction = nullptr;
 }
 
-void FunctionTable::DefineFunction(std::string Name, YYLTYPE loc)
+void FunctionTable::DefineFunction(Symbol Name, uint32_t loc)
 {
 	// Once we get a function definition (as opposed to a declaration),
 	// we store some extra info in our function table
@@ -204,7 +250,7 @@ FunctionTableEntry* FunctionTable::GetCurrentFunction()
 	return this->currentFunction;
 }
 
-FunctionTableEntry* FunctionTable::GetFunction(std::string Name)
+FunctionTableEntry* FunctionTable::GetFunction(Symbol Name)
 {
 	// Return the function table entry associated with name
 	auto found = funcTable->find(Name);
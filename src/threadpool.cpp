@@ -0,0 +1,66 @@
+/*
+	threadpool.cpp
+*/
+#include "headers/threadpool.hpp"
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+	if (threads == 0)
+	{
+		threads = std::thread::hardware_concurrency();
+	}
+	if (threads == 0)
+	{
+		threads = 1;	// hardware_concurrency is allowed to not know
+	}
+	for (unsigned i = 0; i < threads; i++)
+	{
+		this->workers.emplace_back(&ThreadPool::work, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->stopping = true;
+	}
+	this->wake.notify_all();
+	for (auto& worker : this->workers)
+	{
+		worker.join();
+	}
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> guard(this->lock);
+		this->tasks.push_back(std::move(task));
+	}
+	this->wake.notify_one();
+}
+
+unsigned ThreadPool::size() const
+{
+	return this->workers.size();
+}
+
+void ThreadPool::work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> guard(this->lock);
+			this->wake.wait(guard, [this] { return this->stopping || !this->tasks.empty(); });
+			if (this->tasks.empty())
+			{
+				return;	// only stop once the queue has drained
+			}
+			task = std::move(this->tasks.front());
+			this->tasks.pop_front();
+		}
+		task();
+	}
+}
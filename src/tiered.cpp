@@ -0,0 +1,322 @@
+/*
+	tiered.cpp
+	Tiered JIT, see tiered.hpp.
+*/
+#include "headers/tiered.hpp"
+#include "headers/compiler.hpp"
+#include "headers/common.hpp"
+#include "headers/threadpool.hpp"
+#include "headers/consolecolors.hpp"
+#include "headers/trace.hpp"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/ExecutionEngine/Orc/CompileUtils.h"
+#include "llvm/ExecutionEngine/Orc/ExecutionUtils.h"
+#include "llvm/ExecutionEngine/Orc/ThreadSafeModule.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+
+static constexpr uint64_t defaultThreshold = 1000;
+
+// what tier 1 calls when a function gets hot, and the names the two versions of a function go by
+static const char* tierUpHook = "ccc.tier_up";
+static const char* tier1Suffix = ".t1";
+static const char* tier2Suffix = ".t2";
+static const char* tier2Prefix = "tier2 ";
+
+static void tier_up_hook(TieredJIT* tiers, uint32_t id)
+{
+	tiers->tier_up(id);
+}
+
+class TierCompiler : public llvm::orc::IRCompileLayer::IRCompiler
+{
+	// machine code for tier 1 comes out of the fastest code generator settings,
+	// tier 2 gets the full treatment. A fresh target machine per module means
+	// any number of threads can be compiling at once
+	llvm::orc::JITTargetMachineBuilder machine;
+
+public:
+	TierCompiler(llvm::orc::JITTargetMachineBuilder machine)
+		: IRCompiler(llvm::orc::irManglingOptionsFromTargetOptions(machine.getOptions())), machine(std::move(machine))
+	{
+	}
+
+	llvm::Expected<std::unique_ptr<llvm::MemoryBuffer>> operator()(llvm::Module& module) override
+	{
+		llvm::orc::JITTargetMachineBuilder builder = this->machine;
+		bool tier2 = llvm::StringRef(module.getModuleIdentifier()).startswith(tier2Prefix);
+		builder.setCodeGenOptLevel(tier2 ? llvm::CodeGenOpt::Aggressive : llvm::CodeGenOpt::None);
+		auto tm = builder.createTargetMachine();
+		if (!tm)
+		{
+			return tm.takeError();
+		}
+		return llvm::orc::SimpleCompiler(**tm)(module);
+	}
+};
+
+TieredJIT::TieredJIT(unsigned compileThreads) : compileThreads(compileThreads), threshold(defaultThreshold), stopping(false)
+{
+	const char* threshold = getenv("CCC_TIER_THRESHOLD");
+	if (threshold && *threshold)
+	{
+		this->threshold = std::max(1ull, strtoull(threshold, nullptr, 10));
+	}
+}
+
+TieredJIT::~TieredJIT()
+{
+	// nothing may be promoted into a JIT that is on its way out
+	this->stopping = true;
+	this->pool.reset();
+}
+
+void TieredJIT::instrument(llvm::Module& module)
+{
+	llvm::LLVMContext& c = module.getContext();
+	llvm::Type* i64 = llvm::Type::getInt64Ty(c);
+	llvm::PointerType* bytePtr = llvm::Type::getInt8PtrTy(c);
+	llvm::FunctionCallee hook = module.getOrInsertFunction(tierUpHook,
+		llvm::FunctionType::get(llvm::Type::getVoidTy(c), {bytePtr, llvm::Type::getInt32Ty(c)}, false));
+	llvm::Constant* self = llvm::ConstantExpr::getIntToPtr(llvm::ConstantInt::get(i64, reinterpret_cast<uintptr_t>(this)), bytePtr);
+
+	// main only runs once, there is nothing to gain from promoting it
+	std::vector<llvm::Function*> functions;
+	for (auto& f : module)
+	{
+		if (!f.isDeclaration() && f.getName() != "main")
+		{
+			functions.push_back(&f);
+		}
+	}
+	for (llvm::Function* f : functions)
+	{
+		uint32_t id = this->names.size();
+		std::string name = f->getName().str();
+		this->names.push_back(name);
+		auto* counter = new llvm::GlobalVariable(module, i64, false, llvm::GlobalValue::InternalLinkage,
+												 llvm::ConstantInt::get(i64, 0), "ccc.tier." + name);
+
+		// count calls at the end of the entry block, and loop iterations at the
+		// end of every block that jumps back to a block dominating it
+		llvm::DominatorTree dominators(*f);
+		std::vector<llvm::BasicBlock*> blocks {&f->getEntryBlock()};
+		for (auto& bb : *f)
+		{
+			for (llvm::BasicBlock* succ : llvm::successors(&bb))
+			{
+				if (dominators.dominates(succ, &bb))
+				{
+					blocks.push_back(&bb);
+					break;
+				}
+			}
+		}
+		for (llvm::BasicBlock* bb : blocks)
+		{
+			llvm::IRBuilder<> builder(bb->getTerminator());
+			llvm::Value* count = builder.CreateAdd(builder.CreateLoad(i64, counter), builder.getInt64(1));
+			builder.CreateStore(count, counter);
+			llvm::Value* isHot = builder.CreateICmpEQ(count, builder.getInt64(this->threshold));
+			llvm::Instruction* then = llvm::SplitBlockAndInsertIfThen(isHot, bb->getTerminator(), false);
+			llvm::IRBuilder<>(then).CreateCall(hook, {self, builder.getInt32(id)});
+		}
+
+		// callers, including f itself, go through a stub named after it from now on
+		f->setName(name + tier1Suffix);
+		llvm::Function* stub = llvm::Function::Create(f->getFunctionType(), llvm::GlobalValue::ExternalLinkage, name, module);
+		f->replaceAllUsesWith(stub);
+	}
+	this->hot.reset(new std::atomic<bool>[this->names.size()]);
+	for (size_t i = 0; i < this->names.size(); i++)
+	{
+		this->hot[i] = false;
+	}
+}
+
+void TieredJIT::tier_up(uint32_t id)
+{
+	if (this->hot[id].exchange(true) || this->stopping)
+	{
+		return;
+	}
+	this->pool->submit([this, id] { this->promote(id); });
+}
+
+void TieredJIT::promote(uint32_t id)
+{
+	// every promotion starts over from the unoptimized module in its own
+	// context, so promotions don't have to take turns
+	if (this->stopping)
+	{
+		return;
+	}
+	auto start = std::chrono::steady_clock::now();
+	const std::string& name = this->names[id];
+	TraceScope trace("tier up", "function", name);
+	auto context = std::make_unique<llvm::LLVMContext>();
+	auto parsed = llvm::parseBitcodeFile(llvm::MemoryBufferRef(this->bitcode, "tier2"), *context);
+	if (!parsed)
+	{
+		llvm::consumeError(parsed.takeError());
+		return;
+	}
+	std::unique_ptr<llvm::Module> module = std::move(*parsed);
+	module->setModuleIdentifier(tier2Prefix + name);
+
+	// the rest of the functions are only there to be inlined, calls that
+	// don't get inlined go to their stubs
+	llvm::Function* f = module->getFunction(name);
+	for (auto& other : *module)
+	{
+		if (&other != f && !other.isDeclaration())
+		{
+			other.setLinkage(llvm::GlobalValue::AvailableExternallyLinkage);
+		}
+	}
+	f->setName(name + tier2Suffix);
+
+	llvm::orc::JITTargetMachineBuilder machine(this->jit->getTargetTriple());
+	machine.setCodeGenOptLevel(llvm::CodeGenOpt::Aggressive);
+	auto tm = machine.createTargetMachine();
+	if (!tm)
+	{
+		llvm::consumeError(tm.takeError());
+		return;
+	}
+	optimize_module(*module, tm->get(), llvm::OptimizationLevel::O3);
+
+	if (llvm::Error err = this->jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context))))
+	{
+		llvm::consumeError(std::move(err));
+		return;
+	}
+	auto optimized = this->jit->lookup(name + tier2Suffix);
+	if (!optimized)
+	{
+		llvm::consumeError(optimized.takeError());
+		return;
+	}
+	// a single pointer sized store, calls already on their way through the
+	// stub see either the old version or the new one
+	if (llvm::Error err = this->stubs->updatePointer(this->jit->mangle(name), optimized->getAddress()))
+	{
+		llvm::consumeError(std::move(err));
+		return;
+	}
+	auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+	std::lock_guard<std::mutex> guard(this->promotionsLock);
+	this->promotions.push_back({name, static_cast<uint64_t>(micros)});
+}
+
+int TieredJIT::run(std::unique_ptr<llvm::LLVMContext> context, std::unique_ptr<llvm::Module> module, int argc)
+{
+	auto jit = llvm::orc::LLJITBuilder()
+		.setCompileFunctionCreator([](llvm::orc::JITTargetMachineBuilder machine)
+			-> llvm::Expected<std::unique_ptr<llvm::orc::IRCompileLayer::IRCompiler>> {
+			return std::make_unique<TierCompiler>(std::move(machine));
+		})
+		.create();
+	if (!jit)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't create JIT: " << llvm::toString(jit.takeError()) << "\n";
+		return 1;
+	}
+	this->jit = std::move(*jit);
+	llvm::orc::ExecutionSession& session = this->jit->getExecutionSession();
+	llvm::orc::JITDylib& mainDylib = this->jit->getMainJITDylib();
+
+	// anything the program calls but doesn't define (put_int, putascii, ...)
+	// is looked up in ccc itself, which has the runtime linked in
+	auto generator = llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(this->jit->getDataLayout().getGlobalPrefix());
+	if (!generator)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't search ccc for runtime symbols: " << llvm::toString(generator.takeError()) << "\n";
+		return 1;
+	}
+	mainDylib.addGenerator(std::move(*generator));
+
+	// keep a clean copy for tier 2 before the counters go in
+	module->setDataLayout(this->jit->getDataLayout());
+	{
+		llvm::raw_string_ostream out(this->bitcode);
+		llvm::WriteBitcodeToFile(*module, out);
+	}
+	this->instrument(*module);
+
+	// the stubs start out pointing nowhere, they need to exist before tier 1
+	// can be linked against them and tier 1 needs to exist before they can
+	// point at it
+	auto stubsBuilder = llvm::orc::createLocalIndirectStubsManagerBuilder(this->jit->getTargetTriple());
+	if (!stubsBuilder)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Tiered compilation isn't supported on " << this->jit->getTargetTriple().str() << "\n";
+		return 1;
+	}
+	this->stubs = stubsBuilder();
+	llvm::orc::IndirectStubsManager::StubInitsMap inits;
+	for (auto& name : this->names)
+	{
+		inits[this->jit->mangle(name)] = {0, llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable};
+	}
+	llvm::orc::SymbolMap symbols;
+	symbols[this->jit->mangleAndIntern(tierUpHook)] = llvm::JITEvaluatedSymbol(
+		llvm::pointerToJITTargetAddress(&tier_up_hook), llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+	llvm::Error err = this->stubs->createStubs(inits);
+	for (auto& name : this->names)
+	{
+		std::string mangled = this->jit->mangle(name);
+		symbols[session.intern(mangled)] = this->stubs->findStub(mangled, true);
+	}
+	if (!err)
+	{
+		err = mainDylib.define(llvm::orc::absoluteSymbols(std::move(symbols)));
+	}
+	TraceScope tier1Trace("jit tier 1");
+	if (!err)
+	{
+		err = this->jit->addIRModule(llvm::orc::ThreadSafeModule(std::move(module), std::move(context)));
+	}
+	for (size_t i = 0; i < this->names.size() && !err; i++)
+	{
+		auto tier1 = this->jit->lookup(this->names[i] + tier1Suffix);
+		err = tier1 ? this->stubs->updatePointer(this->jit->mangle(this->names[i]), tier1->getAddress()) : tier1.takeError();
+	}
+	tier1Trace.finish();
+	if (err)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't compile program: " << llvm::toString(std::move(err)) << "\n";
+		return 1;
+	}
+	auto mainSymbol = this->jit->lookup("main");
+	if (!mainSymbol)
+	{
+		diag() << "[" << RED << "error" << RESET << "] Can't compile main: " << llvm::toString(mainSymbol.takeError()) << "\n";
+		return 1;
+	}
+
+	this->pool = std::make_unique<ThreadPool>(this->compileThreads);
+	std::cout.flush();
+	TraceScope runTrace("run program");
+	int ret = call_main(mainSymbol->getAddress(), argc);
+	fflush(stdout);
+	runTrace.finish();
+
+	// promotions that haven't started yet aren't worth waiting for
+	this->stopping = true;
+	this->pool.reset();
+	for (auto& p : this->promotions)
+	{
+		diag() << "Recompiled " << p.name << " at -O3 in " << p.micros / 1000.0 << "ms\n";
+	}
+	return ret;
+}
@@ -0,0 +1,203 @@
+/*
+	trace.cpp
+	Phase timing, see trace.hpp.
+*/
+#include "headers/trace.hpp"
+#include "headers/consolecolors.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+std::atomic<bool> traceEnabled {false};
+
+struct TraceEvent
+{
+	const char* name;
+	const char* category;
+	std::string detail;
+	uint32_t thread;
+	uint64_t start;		// microseconds since trace_start
+	uint64_t wall;
+	uint64_t cpu;
+	long peakRssKb;
+};
+
+static std::mutex traceLock;
+static std::vector<TraceEvent> traceEvents;
+static std::chrono::steady_clock::time_point traceEpoch;
+
+static uint64_t now_micros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - traceEpoch).count();
+}
+
+static uint64_t thread_cpu_micros()
+{
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+static uint32_t thread_number()
+{
+	// small numbers read better in a trace viewer than pthread ids
+	static std::atomic<uint32_t> next {1};
+	static thread_local uint32_t number = next++;
+	return number;
+}
+
+void trace_start()
+{
+	traceEpoch = std::chrono::steady_clock::now();
+	traceEnabled = true;
+}
+
+TraceScope::TraceScope(const char* name, const char* category)
+	: active(traceEnabled), name(name), category(category), start(0), cpuStart(0)
+{
+	if (this->active)
+	{
+		this->start = now_micros();
+		this->cpuStart = thread_cpu_micros();
+	}
+}
+
+TraceScope::TraceScope(const char* name, const char* category, std::string_view detail)
+	: TraceScope(name, category)
+{
+	if (this->active)
+	{
+		this->detail = detail;
+	}
+}
+
+TraceScope::~TraceScope()
+{
+	this->finish();
+}
+
+void TraceScope::finish()
+{
+	if (!this->active)
+	{
+		return;
+	}
+	this->active = false;
+	uint64_t wall = now_micros() - this->start;
+	uint64_t cpu = thread_cpu_micros() - this->cpuStart;
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	std::lock_guard<std::mutex> guard(traceLock);
+	traceEvents.push_back({this->name, this->category, std::move(this->detail), thread_number(), this->start, wall, cpu, usage.ru_maxrss});
+}
+
+static void write_json_string(std::ostream& out, const std::string& text)
+{
+	out << '"';
+	for (unsigned char c : text)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out << '\\' << c;
+		}
+		else if (c < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out << escaped;
+		}
+		else
+		{
+			out << c;
+		}
+	}
+	out << '"';
+}
+
+static bool write_trace(const std::string& path)
+{
+	std::ofstream out(path);
+	if (!out.is_open())
+	{
+		return false;
+	}
+	// complete ("X") events, one per span, with the CPU time and RSS as arguments
+	int pid = getpid();
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	for (size_t i = 0; i < traceEvents.size(); i++)
+	{
+		const TraceEvent& e = traceEvents[i];
+		out << "{\"name\":";
+		write_json_string(out, e.detail.empty() ? std::string(e.name) : std::string(e.name) + " " + e.detail);
+		out << ",\"cat\":\"" << e.category << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << e.thread
+			<< ",\"ts\":" << e.start << ",\"dur\":" << e.wall
+			<< ",\"args\":{\"cpu_us\":" << e.cpu << ",\"peak_rss_kb\":" << e.peakRssKb << "}}"
+			<< (i + 1 < traceEvents.size() ? ",\n" : "\n");
+	}
+	out << "]}\n";
+	return static_cast<bool>(out);
+}
+
+static void print_report(std::ostream& report)
+{
+	// add up the spans by name, in the order each name first finished
+	struct Total
+	{
+		const char* name;
+		uint64_t calls = 0;
+		uint64_t wall = 0;
+		uint64_t cpu = 0;
+		long peakRssKb = 0;
+	};
+	std::vector<Total> totals;
+	for (auto& e : traceEvents)
+	{
+		auto it = std::find_if(totals.begin(), totals.end(), [&](const Total& t) { return std::string(t.name) == e.name; });
+		if (it == totals.end())
+		{
+			totals.push_back({e.name});
+			it = totals.end() - 1;
+		}
+		it->calls++;
+		it->wall += e.wall;
+		it->cpu += e.cpu;
+		it->peakRssKb = std::max(it->peakRssKb, e.peakRssKb);
+	}
+
+	report << "[" << CYAN << "time report" << RESET << "]\n"
+		   << std::left << std::setw(24) << "phase" << std::right << std::setw(8) << "calls"
+		   << std::setw(12) << "wall ms" << std::setw(12) << "cpu ms" << std::setw(14) << "peak RSS MB" << "\n";
+	report << std::fixed;
+	for (auto& t : totals)
+	{
+		report << std::left << std::setw(24) << t.name << std::right << std::setw(8) << t.calls
+			   << std::setw(12) << std::setprecision(3) << t.wall / 1000.0
+			   << std::setw(12) << std::setprecision(3) << t.cpu / 1000.0
+			   << std::setw(14) << std::setprecision(1) << t.peakRssKb / 1024.0 << "\n";
+	}
+	report << std::defaultfloat;
+}
+
+bool trace_finish(const std::string& path, bool timeReport, std::ostream& report)
+{
+	traceEnabled = false;
+	std::lock_guard<std::mutex> guard(traceLock);
+	bool ok = true;
+	if (!path.empty() && !write_trace(path))
+	{
+		report << "[" << RED << "error" << RESET << "] Problem writing trace to " << path << "\n";
+		ok = false;
+	}
+	if (timeReport)
+	{
+		print_report(report);
+	}
+	return ok;
+}
@@ -1,7 +1,7 @@
 #include "headers/vcodegen.hpp"
 #include "headers/nodes.hpp"
 #include "headers/common.hpp"
-#include "headers/symtable.hpp"
+#include "headers/trace.hpp"
 #include <memory>
 #include <iostream>
 #include <string>
@@ -20,116 +20,107 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/IR/ValueHandle.h"
 
-CodegenVisitor::CodegenVisitor()
+CodegenVisitor::CodegenVisitor() : returnFlag(false)
 {
-	// Create a new symbol table
-	symTable = new SymbolTable();
 }
 
-CodegenVisitor::~CodegenVisitor()
+llvm::Value* CodegenVisitor::popValue()
 {
-	// Clean up symbol table
-	symTable->CleanUpSymbolTable();
-	delete(symTable);
+	// This is the equivalent of returning a value from a function,
+	// the last expression we generated code for hands it to whoever uses it
+	llvm::Value* v = this->values.back();
+	this->values.pop_back();
+	return v;
 }
 
-llvm::Value* CodegenVisitor::consumeRetValue()
+void CodegenVisitor::leave(VariableNode* n) 
 {
-	// This is the equivalent of returning a value from a function
-	// consuming it is to use that return value
-	llvm::Value* retval = this->retValue;
-	this->retValue = nullptr;
-	return retval;
-}
-
-void CodegenVisitor::setRetValue(llvm::Value* v)
-{
-	// set the return value to be consumed later
-	this->retValue = v;
-}
-
-void CodegenVisitor::visit(VariableNode* n) 
-{
-	// Lookup a variable in the symbol table and grab it's location
-	llvm::AllocaInst* val = this->symTable->GetLLVMValue(n->name);
+	// Grab the variable's location from its slot in this function's frame
+	llvm::AllocaInst* val = n->slot >= 0 ? this->frame[n->slot] : nullptr;
 	if (!val)
 	{
-		std::cout << "Error: Variable " << n->name << " not found.\n";
-		exit(1);
+		diag() << "Error: Variable " << n->name << " not found.\n";
+		fatal_error();
 	}
 	// Load the value expected from that location and return int
-	llvm::Value* r = this->compilationUnit->builder.CreateLoad(val, n->name);
-	this->setRetValue(r);
+	llvm::Value* r = this->compilationUnit->builder.CreateLoad(val->getAllocatedType(), val, symbol_name(n->name));
+	this->values.push_back(r);
 }
 
-void CodegenVisitor::visit(DeclarationNode* n) 
+bool CodegenVisitor::enter(DeclarationNode* n) 
 {
 
 	// Allocate space for a variable of the specified name and type
-	// and add it to the symbol table
+	// and put it in its slot
 	llvm::AllocaInst* Alloca = this->compilationUnit->builder.CreateAlloca(
-			this->GetLLVMType(n->t), 0, n->name
+			this->GetLLVMType(n->t), 0, symbol_name(n->name)
 		);
-	this->symTable->AddLLVMSymbol(n->name, Alloca);
+	this->frame[n->slot] = Alloca;
+	return false;
 }
 
-void CodegenVisitor::visit(DeclAndAssignNode* n) 
+bool CodegenVisitor::enter(DeclAndAssignNode* n) 
 {
-	// Allocate space for a variable and set it's value
+	// Allocate space for a variable, before the code for the value we set it to
 	llvm::AllocaInst* Alloca = this->compilationUnit->builder.CreateAlloca(
-			this->GetLLVMType(n->decl->t), 0, n->decl->name
+			this->GetLLVMType(n->decl->t), 0, symbol_name(n->decl->name)
 		);
-	this->symTable->AddLLVMSymbol(n->decl->name, Alloca);
-	n->expr->accept(this);
-	this->compilationUnit->builder.CreateStore(this->consumeRetValue(), Alloca);
+	this->frame[n->decl->slot] = Alloca;
+	return true;
+}
+
+bool CodegenVisitor::before_child(DeclAndAssignNode* n, uint32_t slot)
+{
+	// we've already made the declaration's alloca, only the expression is left
+	return slot != 0;
+}
+
+void CodegenVisitor::leave(DeclAndAssignNode* n)
+{
+	// and set it's value
+	this->compilationUnit->builder.CreateStore(this->popValue(), this->frame[n->decl->slot]);
 }
 
-void CodegenVisitor::visit(BinaryOpNode* n) 
+void CodegenVisitor::leave(BinaryOpNode* n) 
 {
 	// Generate code to evaluate binary operations
 
-	// Evaluate our two operands
-	n->left->accept(this);
-	llvm::Value* lval = this->consumeRetValue();
-	n->right->accept(this);
-	llvm::Value* rval = this->consumeRetValue();
+	// Our two operands have been evaluated
+	llvm::Value* rval = this->popValue();
+	llvm::Value* lval = this->popValue();
 
 	// need to implement this for char and double
 
 	// Either perform floating point or int math depending on the type of this node
 	if (n->evaluatedType == TypeName::tFloat)
 	{
-		this->setRetValue(GetLLVMBinaryOpFP(n->op, lval, rval));
+		this->values.push_back(GetLLVMBinaryOpFP(n->op, lval, rval));
 	} 
 	else
 	{
-		this->setRetValue(GetLLVMBinaryOpInt(n->op, lval, rval));
+		this->values.push_back(GetLLVMBinaryOpInt(n->op, lval, rval));
 	}
 }
 
-void CodegenVisitor::visit(LogicalOpNode* n) 
+void CodegenVisitor::leave(LogicalOpNode* n) 
 {
 	// Generate code to evaluate logical operations
 
-	// Evaluate our two operands
-	n->left->accept(this);
-	llvm::Value* lval = this->consumeRetValue();
-	n->right->accept(this);
-	llvm::Value* rval = this->consumeRetValue();
+	// Our two operands have been evaluated
+	llvm::Value* rval = this->popValue();
+	llvm::Value* lval = this->popValue();
 
 	// Perform our logical operation
-	this->setRetValue(GetLLVMBinaryOpInt(n->op, lval, rval));
+	this->values.push_back(GetLLVMBinaryOpInt(n->op, lval, rval));
 }
 
-void CodegenVisitor::visit(RelationalOpNode* n) 
+void CodegenVisitor::leave(RelationalOpNode* n) 
 {	
 	// Generate code to handle relational operations
 
-	// Evaluate our two operands
-	n->left->accept(this);
-	llvm::Value* lval = this->consumeRetValue();
-	n->right->accept(this);
-	llvm::Value* rval = this->consumeRetValue();
+	// Our two operands have been evaluated
+	llvm::Value* rval = this->popValue();
+	llvm::Value* lval = this->popValue();
 
 	// todo: need to implement this for char and double!
 
@@ -138,42 +129,31 @@ void CodegenVisitor::visit(RelationalOpNode* n)
 	if (n->left->evaluatedType == TypeName::tFloat)
 	{
 		// Floating point comparison
-		this->setRetValue(GetLLVMRelationalOpFP(n->op, lval, rval));
+		this->values.push_back(GetLLVMRelationalOpFP(n->op, lval, rval));
 	}
 	else
 	{
 		// Integer comparison
-		this->setRetValue(GetLLVMRelationalOpInt(n->op, lval, rval));
+		this->values.push_back(GetLLVMRelationalOpInt(n->op, lval, rval));
 	}
 }
 
-void CodegenVisitor::visit(RootNode* n) 
+bool CodegenVisitor::enter(BlockNode* n) 
 {
-	// For a root, we just visit every function in our function list
-	for (auto& func : n->funcs)
-	{
-		func->accept(this);
-	}
+	// Scopes were all sorted out by verify_ast, every variable
+	// already knows its slot
+	// set return flag false
+	this->returnFlag = false;
+	return true;
 }
 
-void CodegenVisitor::visit(BlockNode* n) 
+bool CodegenVisitor::after_child(BlockNode* n, uint32_t slot)
 {
-	// A block means we have to generate a new scope!
-	this->symTable->PushScope();
-	this->returnFlag = false;
-	// set return flag false
-	for (auto& stmt : n->stmts)
-	{
-		stmt->accept(this);
-		if (this->returnFlag)
-		{
-		     break;
-		}
-	}
-	this->symTable->PopScope();
+	// nothing after a return, break or continue can be reached
+	return !this->returnFlag;
 }
 
-void CodegenVisitor::visit(FuncDefnNode* n) 
+bool CodegenVisitor::enter(FuncDefnNode* n) 
 {
 	// What should we do if we have an external function foo and a defined function foo?
 	// We need to ensure that a function is empty before we starting filling out its body.
@@ -181,27 +161,40 @@ void CodegenVisitor::visit(FuncDefnNode* n)
 	// For now we'll assume the function has not been externally defined before reaching this
 	// definition
 
-	// Do codegen on the function declaration, then get the function object from the module
-	n->funcDecl->accept(this);
-	llvm::Function* f = this->compilationUnit->module->getFunction(n->funcDecl->name);
+	// Do codegen on the function declaration first, then get the function object from the module
+	this->generatingFunction.emplace("codegen function", "function", symbol_name(n->funcDecl->name));
+	return true;
+}
+
+bool CodegenVisitor::before_child(FuncDefnNode* n, uint32_t slot)
+{
+	if (slot == 0)
+	{
+		return true;
+	}
+	llvm::Function* f = this->functions[n->funcDecl->funcId];
 
 	// Create a new basic block to start insertion into.
 	llvm::BasicBlock *BB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "entry", f);
 	this->compilationUnit->builder.SetInsertPoint(BB);
 
-	// Add parameters to our symbol table and reserve room on our stack for them. Note that each function
-	// is also it's own scope, so we push scope here and pop scope when this function is finished.
-	this->symTable->PushScope();
+	// Every function gets a fresh frame. Reserve room on our stack for the parameters
+	// and put them in their slots
+	this->frame.assign(n->frameSlots, nullptr);
+	unsigned int i = 0;
 	for (auto &Arg : f->args())
 	{
 		llvm::AllocaInst *Alloca = this->CreateEntryBlockAlloca(f, Arg.getName().str(), Arg.getType());
 		this->compilationUnit->builder.CreateStore(&Arg, Alloca);
-		this->symTable->AddLLVMSymbol(Arg.getName().str(), Alloca);
+		this->frame[n->funcDecl->params[i++]->slot] = Alloca;
 	}
 
 	// Evaluate the body of this function
-	n->funcBody->accept(this);
+	return true;
+}
 
+void CodegenVisitor::leave(FuncDefnNode* n)
+{
 	// make sure we have our returns setup properly
 	if (this->compilationUnit->builder.GetInsertBlock()->getTerminator() == nullptr)
 	{
@@ -209,11 +202,10 @@ void CodegenVisitor::visit(FuncDefnNode* n)
 		// function and it doesn't have a final return value
 		this->compilationUnit->builder.CreateRet(nullptr);
 	}
-	// Pop the scope for this function, discarding the values
-	this->symTable->PopScope();
+	this->generatingFunction.reset();
 }
 
-void CodegenVisitor::visit(FuncDeclNode* n) 
+bool CodegenVisitor::enter(FuncDeclNode* n) 
 {
 	// Generate our parameter LLVM types from our AST parameter types
 	std::vector<llvm::Type*> parameters;
@@ -235,145 +227,158 @@ void CodegenVisitor::visit(FuncDeclNode* n)
 	llvm::Function* f = llvm::Function::Create(
 		signature,
 		llvm::Function::ExternalLinkage,
-		n->name,
+		symbol_name(n->name),
 		this->compilationUnit->module.get()
 	);
 
 	// Name our function parameters
 	unsigned int i = 0;
 	for (llvm::Argument& a : f->args()) {
-		a.setName(n->params[i++]->name);
+		a.setName(symbol_name(n->params[i++]->name));
+	}
+
+	// Calls and the definition find the function by ID. If it's declared again
+	// LLVM renames the new one, so like a lookup by name, the first one stays
+	if ((size_t) n->funcId >= this->functions.size())
+	{
+		this->functions.resize(n->funcId + 1, nullptr);
+	}
+	if (!this->functions[n->funcId])
+	{
+		this->functions[n->funcId] = f;
 	}
+	// the params are only allocas once there's a definition, and that does them itself
+	return false;
 }
 
-void CodegenVisitor::visit(FuncCallNode* n) 
+bool CodegenVisitor::enter(FuncCallNode* n) 
 {
 	// Call a function
-	llvm::Function* CalleeF = this->compilationUnit->module->getFunction(n->name);
+	llvm::Function* CalleeF = (size_t) n->funcId < this->functions.size() ? this->functions[n->funcId] : nullptr;
 	if (!CalleeF)
 	{
-		std::cout << "Error: Can't find function named " << n->name<< "\n";
-		exit(1);
-	}
-
-	std::vector<llvm::Value *> ArgsV;
-	for (unsigned i = 0, e = n->funcArgs.size(); i != e; ++i)
-	{
-		n->funcArgs[i]->accept(this);
-		ArgsV.push_back(this->consumeRetValue());
-		if (!ArgsV.back())
-		{
-			std::cout << "Error: Problem with parameter number " << i << " in function " << n->name << "\n";
-			exit(1);
-		}
+		diag() << "Error: Can't find function named " << n->name<< "\n";
+		fatal_error();
 	}
-	this->setRetValue(this->compilationUnit->builder.CreateCall(CalleeF, ArgsV));
+	return true;
 }
 
-void CodegenVisitor::visit(ConstantIntNode* n) 
+void CodegenVisitor::leave(FuncCallNode* n)
 {
-	// Set return value to be a constant integer node
-	this->setRetValue(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*(this->compilationUnit->context.get())), n->intValue, true));
+	// the args are the last values generated, in order
+	std::vector<llvm::Value *> ArgsV(this->values.end() - n->funcArgs.size(), this->values.end());
+	this->values.resize(this->values.size() - n->funcArgs.size());
+	this->values.push_back(this->compilationUnit->builder.CreateCall(this->functions[n->funcId], ArgsV));
 }
 
-void CodegenVisitor::visit(AssignmentNode* n) 
+bool CodegenVisitor::enter(AssignmentNode* n) 
 {
-	// get a pointer to a symbol from the namedvalues and assign a value to it
-	llvm::AllocaInst* lloc = this->symTable->GetLLVMValue(n->name);
+	// get a pointer to the variable from its slot before we assign a value to it
+	llvm::AllocaInst* lloc = n->slot >= 0 ? this->frame[n->slot] : nullptr;
 	if (!lloc)
 	{
-		std::cout << "Error: Can't find variable named " << n->name << "\n";
-		exit(1);
+		diag() << "Error: Can't find variable named " << n->name << "\n";
+		fatal_error();
 	}
-	n->expr->accept(this);
-	this->compilationUnit->builder.CreateStore(this->consumeRetValue(), lloc);
+	return true;
+}
+
+void CodegenVisitor::leave(AssignmentNode* n)
+{
+	this->compilationUnit->builder.CreateStore(this->popValue(), this->frame[n->slot]);
 }
 
-void CodegenVisitor::visit(AugmentedAssignmentNode* n) 
+bool CodegenVisitor::enter(AugmentedAssignmentNode* n) 
 {
 
 	// First, we'll grab the variable
-	llvm::AllocaInst* lloc = this->symTable->GetLLVMValue(n->name);
+	llvm::AllocaInst* lloc = n->slot >= 0 ? this->frame[n->slot] : nullptr;
 	if (!lloc)
 	{
-		std::cout << "Error: Can't find variable named " << n->name << "\n";
-		exit(1);
+		diag() << "Error: Can't find variable named " << n->name << "\n";
+		fatal_error();
 	}
 
-	llvm::Value* lval = this->compilationUnit->builder.CreateLoad(lloc, n->name);
-
+	// its value goes under the rhs's
+	this->values.push_back(this->compilationUnit->builder.CreateLoad(lloc->getAllocatedType(), lloc, symbol_name(n->name)));
 
 	// then evalute the rhs
-	n->expr->accept(this);
-	llvm::Value* rval = this->consumeRetValue();
+	return true;
+}
+
+void CodegenVisitor::leave(AugmentedAssignmentNode* n)
+{
+	llvm::Value* rval = this->popValue();
+	llvm::Value* lval = this->popValue();
 	// apply this operation to the variable
 	// Either perform floating point or int math depending on the type of this node
+	llvm::Value* result;
 	if (n->expr->evaluatedType == TypeName::tInt)
 	{
-		this->setRetValue(GetLLVMAugmentedAssignOpsInt(n->op, lval, rval));
+		result = GetLLVMAugmentedAssignOpsInt(n->op, lval, rval);
 	} 
 	else
 	{
-		this->setRetValue(GetLLVMAugmentedAssignOpsFP(n->op, lval, rval));
+		result = GetLLVMAugmentedAssignOpsFP(n->op, lval, rval);
 	}
 
 	// then store it back where it used to be
-	this->compilationUnit->builder.CreateStore(this->consumeRetValue(), lloc);
+	this->compilationUnit->builder.CreateStore(result, this->frame[n->slot]);
 }
 
-void CodegenVisitor::visit(ConstantBoolNode* n) 
+void CodegenVisitor::leave(ConstantIntNode* n) 
+{
+	// Set return value to be a constant integer node
+	this->values.push_back(llvm::ConstantInt::get(llvm::Type::getInt32Ty(*(this->compilationUnit->context.get())), n->intValue, true));
+}
+
+void CodegenVisitor::leave(ConstantBoolNode* n) 
 {
 	// Generate a constant boolean value, represented as a 1 bit integer in llvm
 	const unsigned int v = n->boolValue ? 1 : 0;
-	this->setRetValue(llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), v));
+	this->values.push_back(llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), v));
 }
 
-void CodegenVisitor::visit(ConstantCharNode* n)
+void CodegenVisitor::leave(ConstantCharNode* n)
 {
-	this->setRetValue(llvm::ConstantInt::get(llvm::Type::getInt8Ty(*(this->compilationUnit->context.get())), n->charValue));
+	this->values.push_back(llvm::ConstantInt::get(llvm::Type::getInt8Ty(*(this->compilationUnit->context.get())), n->charValue));
 }
 
-void CodegenVisitor::visit(ReturnNode* n) 
+bool CodegenVisitor::enter(ReturnNode* n) 
 {
-	// insert ret into our basic block here but first we need to evaluate the expression to 
-	// figure out what it's value and type are. If there is no expression, it is a void return
-	// so we just return a nullptr
+	// insert ret into our basic block once we've evaluated the expression to 
+	// figure out what it's value and type are
 	this->returnFlag = true;
-	if (n->expr)
-	{
-		n->expr->accept(this);
-		this->compilationUnit->builder.CreateRet(this->consumeRetValue());
-	}
-	else
-	{
-		this->compilationUnit->builder.CreateRet(nullptr);
-	}
+	return true;
+}
+
+void CodegenVisitor::leave(ReturnNode* n)
+{
+	// If there is no expression, it is a void return so we just return a nullptr
+	this->compilationUnit->builder.CreateRet(n->expr ? this->popValue() : nullptr);
 }
 
-void CodegenVisitor::visit(ConstantFloatNode* n) 
+void CodegenVisitor::leave(ConstantFloatNode* n) 
 {
 	// Set retValue to be a constant floating point number
-	this->setRetValue(llvm::ConstantFP::get(llvm::Type::getFloatTy(*(this->compilationUnit->context.get())), n->floatValue));// do we need true/false here?
+	this->values.push_back(llvm::ConstantFP::get(llvm::Type::getFloatTy(*(this->compilationUnit->context.get())), n->floatValue));// do we need true/false here?
 }
 
-void CodegenVisitor::visit(ConstantDoubleNode* n)
+void CodegenVisitor::leave(ConstantDoubleNode* n)
 {
-	this->setRetValue(llvm::ConstantFP::get(llvm::Type::getDoubleTy(*(this->compilationUnit->context.get())), n->doubleValue));// do we need true/false here?
+	this->values.push_back(llvm::ConstantFP::get(llvm::Type::getDoubleTy(*(this->compilationUnit->context.get())), n->doubleValue));// do we need true/false here?
 }
 
-void CodegenVisitor::visit(IfNode* n) 
+bool CodegenVisitor::before_child(IfNode* n, uint32_t slot) 
 {
 	// first we evaluate the if condition
-	n->ifExpr->accept(this);
-	llvm::Value* condV = this->consumeRetValue();
-	if (!condV)
+	if (slot == 0)
 	{
-		std::cout << "Error: Can't evaluate condition of if statement\n";
-		exit(1);
+		return true;
 	}
 	// now, we turn this condition into an bool (int1) by neq'ing it with 0
-	condV = this->compilationUnit->builder.CreateICmpNE(
-		condV, 
+	llvm::Value* condV = this->compilationUnit->builder.CreateICmpNE(
+		this->popValue(), 
 		llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), 0), 
 		"ifcond"
 	);
@@ -384,13 +389,20 @@ void CodegenVisitor::visit(IfNode* n)
 	// Since we don't support else, we only have two blocks, IF TRUE and IF CONTINUTE (ie, false)
 	llvm::BasicBlock *iftrueBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "iftrue", theFunction);
 	llvm::BasicBlock *ifcontBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "ifcont");
+	this->blocks.push_back(ifcontBB);
 
 	// conditionally jump to iftrue or ifcont 
 	this->compilationUnit->builder.CreateCondBr(condV, iftrueBB, ifcontBB);
 
 	// generate code for if body
 	this->compilationUnit->builder.SetInsertPoint(iftrueBB);
-	n->ifBody->accept(this);
+	return true;
+}
+
+void CodegenVisitor::leave(IfNode* n)
+{
+	llvm::BasicBlock *ifcontBB = this->blocks.back();
+	this->blocks.pop_back();
 	//if (this->compilationUnit->builder.GetInsertBlock()->getTerminator() == nullptr)
 	if (!this->returnFlag)
 	{
@@ -399,115 +411,129 @@ void CodegenVisitor::visit(IfNode* n)
 	}
 	this->returnFlag = false;
 	// push if continue block and make that our new insert point to continue code generation
-	theFunction->getBasicBlockList().push_back(ifcontBB);
+	this->compilationUnit->builder.GetInsertBlock()->getParent()->getBasicBlockList().push_back(ifcontBB);
 	this->compilationUnit->builder.SetInsertPoint(ifcontBB);
 }
 
-void CodegenVisitor::visit(ForNode* n) 
+uint32_t CodegenVisitor::child_slot(ForNode* n, uint32_t k)
+{
+	// the update's code comes before the condition's, see before_child
+	static const uint32_t order[] = {0, 2, 1, 3};
+	return order[k];
+}
+
+bool CodegenVisitor::before_child(ForNode* n, uint32_t slot) 
 {
 
-	// We push scope before we start the loop, then once in the body, to allow variable shadowing
-	// in our init statements; so something like
+	// verify_ast gave the loop its own scope, then the body another, to allow variable
+	// shadowing in our init statements; so something like
 	// int i = 0;
 	// for (int i = 0;;)
 	// { int i = 0; }
-	// is legal
-	this->symTable->PushScope();
+	// is legal, and each of those i's has a slot of its own
 	llvm::Function* theFunction = this->compilationUnit->builder.GetInsertBlock()->getParent();
-
-	// evaluate initialization statement
-	if (n->initStmt)
+	// blocks has the checkcond block on it from the update on, then the loop body from the condition on
+	switch (slot)
 	{
-		n->initStmt->accept(this);
-	}
-
-	// loop condition check bb
-	llvm::BasicBlock* checkConditionBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "checkcond", theFunction); 
-	// first thing a for loop does after initialization is check its condition
-	this->compilationUnit->builder.CreateBr(checkConditionBB);
-
+		case 0:
+		{
+			// evaluate initialization statement
+			break;
+		}
+		case 2:
+		{
+			// loop condition check bb
+			llvm::BasicBlock* checkConditionBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "checkcond", theFunction); 
+			this->blocks.push_back(checkConditionBB);
+			// first thing a for loop does after initialization is check its condition
+			this->compilationUnit->builder.CreateBr(checkConditionBB);
 
-	// update
-	llvm::BasicBlock* updateBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "update", theFunction);
-	this->compilationUnit->builder.SetInsertPoint(updateBB);
-	// when we continue, we want to jump here
-	this->loopHeaders.push_back(updateBB);
-	// evaluate the update condition 
-	if (n->updateStmt)
-	{
-		n->updateStmt->accept(this);
-	}
-	// after we update our var, check our condition to see if we continue our for loop
-	this->compilationUnit->builder.CreateBr(checkConditionBB);
+			// update
+			llvm::BasicBlock* updateBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "update", theFunction);
+			this->compilationUnit->builder.SetInsertPoint(updateBB);
+			// when we continue, we want to jump here
+			this->loopHeaders.push_back(updateBB);
+			// evaluate the update condition 
+			break;
+		}
+		case 1:
+		{
+			// after we update our var, check our condition to see if we continue our for loop
+			llvm::BasicBlock* checkConditionBB = this->blocks.back();
+			this->compilationUnit->builder.CreateBr(checkConditionBB);
 
-	// create exit block
-	llvm::BasicBlock* exitLoopBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "forexit", theFunction);
-	// this is where a break would go to, so mark out exit
-	this->loopExits.push_back(exitLoopBB);
+			// create exit block
+			llvm::BasicBlock* exitLoopBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "forexit", theFunction);
+			// this is where a break would go to, so mark out exit
+			this->loopExits.push_back(exitLoopBB);
 
-	// create loop body basic block, since we need to reference it now
-	llvm::BasicBlock* loopBodyBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "forbody", theFunction);
+			// create loop body basic block, since we need to reference it now
+			llvm::BasicBlock* loopBodyBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "forbody", theFunction);
+			this->blocks.push_back(loopBodyBB);
 
-	// if we have a condition, evaluate it
-	this->compilationUnit->builder.SetInsertPoint(checkConditionBB);
-	if (n->loopCondExpr)
-	{
-		// evaluate loop condition
-		n->loopCondExpr->accept(this);
-		llvm::Value* endcondV = this->consumeRetValue();
-		if (!endcondV)
+			// if we have a condition, evaluate it
+			this->compilationUnit->builder.SetInsertPoint(checkConditionBB);
+			break;
+		}
+		default:
 		{
-			std::cout << "Error: Cannot evaluate loop condition\n";
-			exit(1);
+			llvm::BasicBlock* loopBodyBB = this->blocks.back();
+			if (n->loopCondExpr)
+			{
+				// the loop condition has been evaluated
+				llvm::Value* endcondV = this->compilationUnit->builder.CreateICmpNE(
+					this->popValue(), 
+					llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), 0), 
+					"forcond"
+				);
+
+				this->compilationUnit->builder.CreateCondBr(endcondV, loopBodyBB, this->loopExits.back());
+			}
+			else
+			{
+				// otherwise, we are just like for(...;...;)
+				// so we just loop anyways!
+				this->compilationUnit->builder.CreateBr(loopBodyBB);
+			}
+
+			// loop body
+			this->compilationUnit->builder.SetInsertPoint(loopBodyBB);
+			break;
 		}
-		endcondV = this->compilationUnit->builder.CreateICmpNE(
-			endcondV, 
-			llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), 0), 
-			"forcond"
-		);
-
-		this->compilationUnit->builder.CreateCondBr(endcondV, loopBodyBB, exitLoopBB);
-	}
-	else
-	{
-		// otherwise, we are just like for(...;...;)
-		// so we just loop anyways!
-		this->compilationUnit->builder.CreateBr(loopBodyBB);
 	}
+	return true;
+}
 
-
-	// loop body
-	this->compilationUnit->builder.SetInsertPoint(loopBodyBB);
-	n->loopBody->accept(this);
+void CodegenVisitor::leave(ForNode* n)
+{
+	this->blocks.pop_back();
+	llvm::BasicBlock* checkConditionBB = this->blocks.back();
+	this->blocks.pop_back();
 	if (!this->returnFlag)
 	{
 		// if we didn't get a return flag, we'll update our variable properly and
 		// jump back to the top of the loop
 		if (n->updateStmt)
 		{
-			// n->updateStmt->accept(this);
-			this->compilationUnit->builder.CreateBr(updateBB);
+			this->compilationUnit->builder.CreateBr(this->loopHeaders.back());
 		}
 		else
 		{
 			// if we don
 			this->compilationUnit->builder.CreateBr(checkConditionBB);
 		}
-		// this->compilationUnit->builder.CreateBr(updateBB);	
 	}
 	this->returnFlag = false;
 
+	// we continue inserting code after the for loop
+	this->compilationUnit->builder.SetInsertPoint(this->loopExits.back());
+
 	// when we're done evaluating the loop, we don't need our break/continue points anymore
 	this->loopExits.pop_back();
 	this->loopHeaders.pop_back();
-	// and we're done with the outer for loop scope as well
-	this->symTable->PopScope();
-
-	// we continue inserting code after the for loop
-	this->compilationUnit->builder.SetInsertPoint(exitLoopBB);
 }
 
-void CodegenVisitor::visit(WhileNode* n) 
+bool CodegenVisitor::enter(WhileNode* n) 
 {
 	// get the parent function
 	llvm::Function* theFunction = this->compilationUnit->builder.GetInsertBlock()->getParent();	
@@ -519,6 +545,7 @@ void CodegenVisitor::visit(WhileNode* n)
 
 	// basic block for loop body
 	llvm::BasicBlock* loopbodybb = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "whilebody", theFunction);
+	this->blocks.push_back(loopbodybb);
 	
 	// block for end of loop
 	llvm::BasicBlock* exitloopbb = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "whileexit", theFunction);
@@ -532,102 +559,119 @@ void CodegenVisitor::visit(WhileNode* n)
 	this->compilationUnit->builder.SetInsertPoint(headerbb);
 
 	// evaluate loop condition
-	n->whileExpr->accept(this);
-	llvm::Value* endcondV = this->consumeRetValue();
-	if (!endcondV)
+	return true;
+}
+
+bool CodegenVisitor::before_child(WhileNode* n, uint32_t slot)
+{
+	if (slot == 0)
 	{
-		std::cout << "Error: Can't evaluate end condition of for loop\n";
-		exit(1);
+		return true;
 	}
-	endcondV = this->compilationUnit->builder.CreateICmpNE(
-		endcondV, 
+	llvm::Value* endcondV = this->compilationUnit->builder.CreateICmpNE(
+		this->popValue(), 
 		llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), 0), 
 		"whilecond"
 	);
 	// on true, evaluate the loop body, on false go to the end of the loop
-	this->compilationUnit->builder.CreateCondBr(endcondV, loopbodybb, exitloopbb);
+	llvm::BasicBlock* loopbodybb = this->blocks.back();
+	this->compilationUnit->builder.CreateCondBr(endcondV, loopbodybb, this->loopExits.back());
 
 	// loop body is simply the body of the while statement
 	this->compilationUnit->builder.SetInsertPoint(loopbodybb);
-	n->loopBody->accept(this);
+	return true;
+}
+
+void CodegenVisitor::leave(WhileNode* n)
+{
 	if (!this->returnFlag)
 	{
 		// when we're done evaluating the body, jump back to the header 
-		this->compilationUnit->builder.CreateBr(headerbb);	
+		this->compilationUnit->builder.CreateBr(this->loopHeaders.back());	
 	}
 	this->returnFlag = false;
-	this->loopExits.pop_back();
-	this->loopHeaders.pop_back();
 
 	// set our insertion point to be after the loop exit
-	this->compilationUnit->builder.SetInsertPoint(exitloopbb);
+	this->compilationUnit->builder.SetInsertPoint(this->loopExits.back());
+	this->blocks.pop_back();
+	this->loopExits.pop_back();
+	this->loopHeaders.pop_back();
 }
 
-void CodegenVisitor::visit(UnaryNode* n) 
+void CodegenVisitor::leave(UnaryNode* n) 
 {
-	// TODO: This unary node is NOT necessarily just a negative number now, sometmes it is bitwise not
-	// evaluate the sub expression
+	// the sub expression has been evaluated
 	// assume the type of the child is float or int since -bool or -void doesn't really make
-	// any sense!
-	// create multiplication -1 and this->retValue
-	n->expr->accept(this);
-	llvm::Value* val = this->consumeRetValue();
+	// any sense! Semantic checking has already made sure ~ only gets integers
+	llvm::Value* val = this->popValue();
 
-	// We only have to check the left nodes evaluated type since, due to semantic checking, left and right
-	// are guaranteed to have matching types by the time we get here
-	if (n->expr->evaluatedType == TypeName::tFloat)
+	if (n->op == UnaryOps::Not)
 	{
-		// Floating point comparison
-		this->setRetValue(this->compilationUnit->builder.CreateFMul(val, llvm::ConstantFP::get(llvm::Type::getFloatTy(*(this->compilationUnit->context.get())), -1.0f)));
+		this->values.push_back(this->compilationUnit->builder.CreateNot(val));
+	}
+	else if (n->expr->evaluatedType == TypeName::tFloat)
+	{
+		this->values.push_back(this->compilationUnit->builder.CreateFNeg(val));
 	}
 	else
 	{
-		// Integer comparison
-		this->setRetValue(this->compilationUnit->builder.CreateMul(val, llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), -1)));
+		this->values.push_back(this->compilationUnit->builder.CreateNeg(val));
 	}
 }
 
-void CodegenVisitor::visit(TernaryNode* n) 
+bool CodegenVisitor::before_child(TernaryNode* n, uint32_t slot) 
 {
 	// get the parent function
 	llvm::Function* theFunction = this->compilationUnit->builder.GetInsertBlock()->getParent();	
 
-	// first we'll evaluate the if condition
-	n->condExpr->accept(this);
-	llvm::Value* condV = this->consumeRetValue();
-	if (!condV)
+	// blocks gets the false and merge blocks once we have our condition, then
+	// the block the true value ended up in
+	if (slot == 1)
 	{
-		std::cout << "Error: Cannot evaluate condition of ternary expression\n";
-		exit(1);
-	}
-	// now, we turn this condition into an bool (int1) by neq'ing it with 0
-	condV = this->compilationUnit->builder.CreateICmpNE(
-		condV, 
-		llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), 0), 
-		"ifcond"
-	);
+		// now, we turn the condition into an bool (int1) by neq'ing it with 0
+		llvm::Value* condV = this->compilationUnit->builder.CreateICmpNE(
+			this->popValue(), 
+			llvm::ConstantInt::get(llvm::Type::getInt1Ty(*(this->compilationUnit->context.get())), 0), 
+			"ifcond"
+		);
 
-	// setup basic blocks needed for ternary operation
-	llvm::BasicBlock* trueBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "trueval", theFunction);
-	llvm::BasicBlock* falseBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "falseval");
-	llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "mergeval");
+		// setup basic blocks needed for ternary operation
+		llvm::BasicBlock* trueBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "trueval", theFunction);
+		llvm::BasicBlock* falseBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "falseval");
+		llvm::BasicBlock* mergeBB = llvm::BasicBlock::Create(*(this->compilationUnit->context.get()), "mergeval");
+		this->blocks.push_back(falseBB);
+		this->blocks.push_back(mergeBB);
 
-	// jump based on condition
-	this->compilationUnit->builder.CreateCondBr(condV, trueBB, falseBB);
+		// jump based on condition
+		this->compilationUnit->builder.CreateCondBr(condV, trueBB, falseBB);
 
-	// true basic block
-	this->compilationUnit->builder.SetInsertPoint(trueBB);
-	n->trueExpr->accept(this);
-	llvm::Value* trueV = this->consumeRetValue();
-	this->compilationUnit->builder.CreateBr(mergeBB);
-	trueBB = this->compilationUnit->builder.GetInsertBlock();
+		// true basic block
+		this->compilationUnit->builder.SetInsertPoint(trueBB);
+	}
+	else if (slot == 2)
+	{
+		// the true value stays on values until we make the phi
+		llvm::BasicBlock* falseBB = this->blocks.end()[-2];
+		this->compilationUnit->builder.CreateBr(this->blocks.back());
+		this->blocks.push_back(this->compilationUnit->builder.GetInsertBlock());
 
-	// false basic block
-	theFunction->getBasicBlockList().push_back(falseBB);
-	this->compilationUnit->builder.SetInsertPoint(falseBB);
-	n->falseExpr->accept(this);
-	llvm::Value* falseV = this->consumeRetValue();
+		// false basic block
+		theFunction->getBasicBlockList().push_back(falseBB);
+		this->compilationUnit->builder.SetInsertPoint(falseBB);
+	}
+	return true;
+}
+
+void CodegenVisitor::leave(TernaryNode* n)
+{
+	llvm::Function* theFunction = this->compilationUnit->builder.GetInsertBlock()->getParent();	
+	llvm::BasicBlock* trueBB = this->blocks.back();
+	llvm::BasicBlock* mergeBB = this->blocks.end()[-2];
+	this->blocks.resize(this->blocks.size() - 3);
+	llvm::Value* falseV = this->popValue();
+	llvm::Value* trueV = this->popValue();
 	this->compilationUnit->builder.CreateBr(mergeBB);
+	llvm::BasicBlock* falseBB = this->compilationUnit->builder.GetInsertBlock();
 
 	// use phi to choose between two above values
 	theFunction->getBasicBlockList().push_back(mergeBB);
@@ -637,47 +681,46 @@ void CodegenVisitor::visit(TernaryNode* n)
 	PN->addIncoming(trueV, trueBB);
 	PN->addIncoming(falseV, falseBB);
 
-	this->setRetValue(PN);
+	this->values.push_back(PN);
 }
 
-void CodegenVisitor::visit(CastExpressionNode* n) 
+void CodegenVisitor::leave(CastExpressionNode* n) 
 {
 	// by the time we get here we should KNOW that this cast is between
 	// a float and an int
 	if (n->t == TypeName::tInt)
 	{
 		// we're casting from a float to an integer
-		n->expr->accept(this);
-		this->setRetValue(this->compilationUnit->builder.CreateFPToSI(this->consumeRetValue(), this->compilationUnit->builder.getInt32Ty()));
+		this->values.push_back(this->compilationUnit->builder.CreateFPToSI(this->popValue(), this->compilationUnit->builder.getInt32Ty()));
 	}
 	else
 	{
 		// we'r casting from an integer to a float
-		n->expr->accept(this);
-		this->setRetValue(this->compilationUnit->builder.CreateSIToFP(this->consumeRetValue(), this->compilationUnit->builder.getFloatTy()));
+		this->values.push_back(this->compilationUnit->builder.CreateSIToFP(this->popValue(), this->compilationUnit->builder.getFloatTy()));
 	}
 }
 
-void CodegenVisitor::visit(ExpressionStatementNode* n)
+void CodegenVisitor::leave(ExpressionStatementNode* n)
 {
-	// evaluate the subexpression (in case of side effects)
+	// the subexpression was evaluated (in case of side effects)
 	// but then we can just toss the results!	
-	n->expr->accept(this);
-	this->setRetValue(nullptr);
+	this->values.pop_back();
 }
 
-void CodegenVisitor::visit(BreakNode* n) 
+bool CodegenVisitor::enter(BreakNode* n) 
 {
 	// break out a loop by jumping to the after label
 	this->returnFlag = true;
 	this->compilationUnit->builder.CreateBr(this->loopExits.back());
+	return false;
 }
 
-void CodegenVisitor::visit(ContinueNode* n) 
+bool CodegenVisitor::enter(ContinueNode* n) 
 {
 	// jump straight back to the current header label
 	this->returnFlag = true;
 	this->compilationUnit->builder.CreateBr(this->loopHeaders.back());
+	return false;
 }	
 
 // Helper functions for our types -> llvm types
@@ -2,10 +2,11 @@
 #include "headers/nodes.hpp"
 #include "headers/common.hpp"
 #include "headers/symtable.hpp"
+#include "headers/trace.hpp"
 #include <memory>
 #include <string>
 
-void EvaluateVisitor::visit(VariableNode* n) 
+void EvaluateVisitor::leave(VariableNode* n) 
 {
 	// grab this symbol from the symbol table
 	SymbolTableEntry* symbolTableEntry;
@@ -13,71 +14,80 @@ void EvaluateVisitor::visit(VariableNode* n)
 	// make sure this symbol had been declared already
 	if (symbolTableEntry == nullptr)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Undeclared variable: " << n->name <<"\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Undeclared variable: " << n->name <<"\n";
+		fatal_error();
 	}
 	// if it is, this expression evaluates to the type of this symbol
 	n->evaluatedType = symbolTableEntry->Type;
-	// Variables are not constant! (We don't support const)
-	n->isConstant = symbolTableEntry->isConstant;
+	n->slot = symbolTableEntry->slot;
+	// Variables are not constant, even const ones! The optimizer folds
+	// constant expressions by reading their literal values, which a const
+	// variable doesn't have
+	n->isConstant = false;
 }
 
-void EvaluateVisitor::visit(DeclarationNode* n) 
+void EvaluateVisitor::leave(DeclarationNode* n) 
 {
 	// make sure type isn't void
 	if (n->t == TypeName::tVoid)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Can only declare functions void.\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Can only declare functions void.\n";
+		fatal_error();
 	}
-	// try to add this symbol to our symbol table 
-	if (!this->symbolTable->AddSymbol(n->name, n->t, n->isConstant, n->location))
+	// try to add this symbol to our symbol table, giving it the next
+	// slot in the function's frame
+	n->slot = this->frameSlots++;
+	if (!this->symbolTable->AddSymbol(n->name, n->t, n->isConstant, n->location, n->slot))
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): ";
-		std::cout << "Variable " << n->name << " already declared in this scope.\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): ";
+		diag() << "Variable " << n->name << " already declared in this scope.\n";
+		fatal_error();
 	}
 }
 
-void EvaluateVisitor::visit(DeclAndAssignNode* n) 
+bool EvaluateVisitor::before_child(DeclAndAssignNode* n, uint32_t slot)
+{
+	// only the rhs expression is evaluated first, the declaration is only
+	// added once we know what's being assigned to it
+	return slot != 0;
+}
+
+void EvaluateVisitor::leave(DeclAndAssignNode* n) 
 {
-	// evaluate rhs expression
-	n->expr->accept(this);
 	// make sure type of rhs matches declared type
 	if (n->decl->t != n->expr->evaluatedType)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Type mismatch between declaration and expression.\n";
-		std::cout << "Expected type " << TypeNameString(n->decl->t);
-		std::cout << " but got type " << TypeNameString(n->expr->evaluatedType) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Type mismatch between declaration and expression.\n";
+		diag() << "Expected type " << TypeNameString(n->decl->t);
+		diag() << " but got type " << TypeNameString(n->expr->evaluatedType) << "\n";
+		fatal_error();
 	}
 	// make sure type isn't void
 	if (n->decl->t == TypeName::tVoid)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Can only declare functions void.\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Can only declare functions void.\n";
+		fatal_error();
 	}
 	// Try to add this symbol to our symbol table
-	if (!this->symbolTable->AddSymbol(n->decl->name, n->decl->t, n->decl->isConstant, n->decl->location))
+	n->decl->slot = this->frameSlots++;
+	if (!this->symbolTable->AddSymbol(n->decl->name, n->decl->t, n->decl->isConstant, n->decl->location, n->decl->slot))
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): ";
-		std::cout << "Variable " << n->decl->name << " already declared in this scope.\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): ";
+		diag() << "Variable " << n->decl->name << " already declared in this scope.\n";
+		fatal_error();
 	}
 }
 
-void EvaluateVisitor::visit(BinaryOpNode* n) 
+void EvaluateVisitor::leave(BinaryOpNode* n) 
 {
-	// evaluate our subexpressions
-	n->left->accept(this);
-	n->right->accept(this);
+	// our subexpressions have been evaluated,
 	// check that type of the children match
 	if (n->left->evaluatedType != n->right->evaluatedType)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Type mismatch in binary operation\n";
-		std::cout << "Got types " << TypeNameString(n->left->evaluatedType);
-		std::cout << " and " << TypeNameString(n->right->evaluatedType) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Type mismatch in binary operation\n";
+		diag() << "Got types " << TypeNameString(n->left->evaluatedType);
+		diag() << " and " << TypeNameString(n->right->evaluatedType) << "\n";
+		fatal_error();
 	}
 	// TODO: Some operations are only supported for tFloat and tInt
 	// TODO: result of a LOG_AND or LOG_OR will always be int!
@@ -88,18 +98,16 @@ void EvaluateVisitor::visit(BinaryOpNode* n)
 	n->isConstant = (n->left->isConstant && n->right->isConstant);
 }
 
-void EvaluateVisitor::visit(LogicalOpNode* n) 
+void EvaluateVisitor::leave(LogicalOpNode* n) 
 {
-	// evaluate our subexpressions
-	n->left->accept(this);
-	n->right->accept(this);
+	// our subexpressions have been evaluated,
 	// check that type of the children match
 	if (n->left->evaluatedType != n->right->evaluatedType)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Type mismatch in logical operation\n";
-		std::cout << "Got types " << TypeNameString(n->left->evaluatedType);
-		std::cout << " and " << TypeNameString(n->right->evaluatedType) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Type mismatch in logical operation\n";
+		diag() << "Got types " << TypeNameString(n->left->evaluatedType);
+		diag() << " and " << TypeNameString(n->right->evaluatedType) << "\n";
+		fatal_error();
 	}
 	// Type of a logical op node is always bool
 	n->evaluatedType = TypeName::tBool;
@@ -107,18 +115,16 @@ void EvaluateVisitor::visit(LogicalOpNode* n)
 	n->isConstant = (n->left->isConstant && n->right->isConstant);
 }
 
-void EvaluateVisitor::visit(RelationalOpNode* n) 
+void EvaluateVisitor::leave(RelationalOpNode* n) 
 {
-	// evaluate subexpressions
-	n->left->accept(this);
-	n->right->accept(this);
+	// subexpressions have been evaluated,
 	// make sure type of children match
 	if (n->left->evaluatedType != n->right->evaluatedType)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Type mismatch in relational operation \n";
-		std::cout << "Got types " << TypeNameString(n->left->evaluatedType);
-		std::cout << " and " << TypeNameString(n->right->evaluatedType) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Type mismatch in relational operation \n";
+		diag() << "Got types " << TypeNameString(n->left->evaluatedType);
+		diag() << " and " << TypeNameString(n->right->evaluatedType) << "\n";
+		fatal_error();
 	}
 	// RelationalOps always evaluate to bool
 	n->evaluatedType = TypeName::tBool;
@@ -126,64 +132,90 @@ void EvaluateVisitor::visit(RelationalOpNode* n)
 	n->isConstant = (n->left->isConstant && n->right->isConstant);
 }
 
-void EvaluateVisitor::visit(RootNode* n) 
+LineColumn EvaluateVisitor::at(Node* n) const
+{
+	// where n is, for an error message
+	return this->lines->find(n->location);
+}
+
+bool EvaluateVisitor::enter(RootNode* n) 
 {
 	// for root, just visit all functions
+	this->lines = n->lines;
 	// we don't have to make a new scope here since symbol table
 	// is initialized with an empty scope before the program starts
-	for (auto& func : n->funcs)
-	{
-		func->accept(this);
-	}
+	return true;
 }
 
-void EvaluateVisitor::visit(BlockNode* n) 
+bool EvaluateVisitor::enter(BlockNode* n) 
 {
 	// there is a new scope for a block
 	this->symbolTable->PushScope();
-	for (auto& stmt : n->stmts)
+	return true;
+}
+
+bool EvaluateVisitor::after_child(BlockNode* n, uint32_t slot)
+{
+	if (this->needReturn && isa<ReturnNode>(n->stmts[slot]))
 	{
-		stmt->accept(this);
-		if (this->needReturn && dynamic_cast<ReturnNode*>(stmt.get()))
-		{
-			this->hasReturn = true;
-		}
+		this->hasReturn = true;
 	}
+	return true;
+}
+
+void EvaluateVisitor::leave(BlockNode* n)
+{
 	this->symbolTable->PopScope();
 }
 
-void EvaluateVisitor::visit(FuncDefnNode* n) 
+bool EvaluateVisitor::enter(FuncDefnNode* n) 
 {
 	// Functions have their OWN SYMBOL TABLE! They DO NOT inherit symbols from the calling function!
 	this->symbolTable->PushScope();
 	this->inFuncDef = true;
-	// Let function table know we're going to define a function
-	std::string funcname = dynamic_cast<FuncDeclNode*>(n->funcDecl.get())->name;
-	n->funcDecl->accept(this);
+	this->checkingFunction.emplace("check function", "function", symbol_name(n->funcDecl->name));
+	// every function numbers its variables from 0, starting with its params
+	this->frameSlots = 0;
+	return true;
+}
+
+bool EvaluateVisitor::after_child(FuncDefnNode* n, uint32_t slot)
+{
+	if (slot != 0)
+	{
+		return true;
+	}
+	// with the declaration checked, let function table know we're going to define a function
+	Symbol funcname = n->funcDecl->name;
 	this->functionTable->EnterFunctionDefinition(funcname);
 
 	// setup for grabbing the type of the function and check that we're not void , if we are
 	// we don't necessarily need a return type
 	this->needReturn = false;
-	TypeName functype = dynamic_cast<FuncDeclNode*>(n->funcDecl.get())->t;
+	TypeName functype = n->funcDecl->t;
 	if (functype!=TypeName::tVoid)
 	{
 		this->needReturn = true;
 	}
 	this->hasReturn = false;
 
-	// evaluate the function body
-	n->funcBody->accept(this);
+	// on to evaluate the function body
+	return true;
+}
 
+void EvaluateVisitor::leave(FuncDefnNode* n)
+{
+	Symbol funcname = n->funcDecl->name;
 	// if we needed a return statement and we didn't have one, throw an error
 	if (this->needReturn && !this->hasReturn)
 	{
-		std::cout << "Error: Function " << funcname << " is not type void and doesn't have a return statement\n";
-		exit(1);
+		diag() << "Error: Function " << funcname << " is not type void and doesn't have a return statement\n";
+		fatal_error();
 	}
 
 	// The function is now defined
 	this->functionTable->DefineFunction(funcname, n->location);
+	n->frameSlots = this->frameSlots;
 	// make sure that one of the nodes in the body of the function is a return node
 	// UNLESS the function is declared void, then we don't need to return
 	// FunctionTableEntry* curfunc = this->functionTable->GetFunction(funcname);	
@@ -193,9 +225,10 @@ void EvaluateVisitor::visit(FuncDefnNode* n)
 	this->functionTable->ExitFunctionDefinition();
 	// tell the symbo table to leave it's current scope
 	this->symbolTable->PopScope();
+	this->checkingFunction.reset();
 }
 
-void EvaluateVisitor::visit(FuncDeclNode* n) 
+bool EvaluateVisitor::enter(FuncDeclNode* n) 
 {
 	// If this is a bare declaration, we don't want these variables to live ina global
 	// scope or else something like
@@ -209,31 +242,37 @@ void EvaluateVisitor::visit(FuncDeclNode* n)
 	if (this->functionTable->IsInFunctionDefinition()&&this->functionTable->IsFunctionDefined(n->name))
 	{
 		// // if we're here, we're a duplicate definition
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Function " << n->name << " already defined.\n";
+		diag() << "Error (" << this->at(n) << "): Function " << n->name << " already defined.\n";
 		FunctionTableEntry* ffunc = this->functionTable->GetFunction(n->name);
-		std::cout << "previous definition seen at (" << ffunc->definitionLocation.begin.line << ", " << ffunc->definitionLocation.begin.column << ")\n";
-		exit(1);
+		diag() << "previous definition seen at (" << this->lines->find(ffunc->definitionLocation) << ")\n";
+		fatal_error();
 	}
+	// then visit our param declarations to error check and add them to symbol table,
+	// we can also use these variables in our scope now!
+	return true;
+}
+
+void EvaluateVisitor::leave(FuncDeclNode* n)
+{
 	// create our parameter types list
 	std::vector<TypeName> paramTypes;
 	for (auto& param : n->params)
 	{
 		paramTypes.push_back(param->t);
-		param->accept(this);	// visit our declaration to error check and add to symbol table // TODO: Does this work?
-								// we can also use these variables in our scope now!
 	}
 	// TODO: Eventually, this is where we should check that our parameter list matches the function
 	// prototypes we've seen already. We don't do that for now.
 
 	// add our function to our function table
 	this->functionTable->AddFunction(n->name, n->t, paramTypes);
+	n->funcId = this->functionTable->GetFunction(n->name)->id;
 	if (!inFuncDef)
 	{
 		this->symbolTable->PopScope();
 	}
 }
 
-void EvaluateVisitor::visit(FuncCallNode* n) 
+bool EvaluateVisitor::enter(FuncCallNode* n) 
 {
 	// Grab this function from our function table
 	FunctionTableEntry* funcResult = this->functionTable->GetFunction(n->name);
@@ -241,35 +280,36 @@ void EvaluateVisitor::visit(FuncCallNode* n)
 	// Make sure we've seen a definition for this function
 	if (!funcResult)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Function " << n->name << " not defined\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Function " << n->name << " not defined\n";
+		fatal_error();
 	}
 
 	// Check we have the same number of arguments in each function
 	if (n->funcArgs.size() != funcResult->ParamTypes.size())
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): ";
-		std::cout << "Function call argument type mismatch in function " << n->name << "\n";
-		std::cout << "Got " << n->funcArgs.size() << " arguments, but expected " << funcResult->ParamTypes.size() << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): ";
+		diag() << "Function call argument type mismatch in function " << n->name << "\n";
+		diag() << "Got " << n->funcArgs.size() << " arguments, but expected " << funcResult->ParamTypes.size() << "\n";
+		fatal_error();
 	}
 
 	// Evaluate the type of the function call args
-	for (auto& arg : n->funcArgs)
-	{
-		arg->accept(this);
-	}
+	return true;
+}
 
+void EvaluateVisitor::leave(FuncCallNode* n)
+{
 	// Then, make sure the expected types match
+	FunctionTableEntry* funcResult = this->functionTable->GetFunction(n->name);
 	for (unsigned i = 0; i < n->funcArgs.size(); i++)
 	{
-		if (n->funcArgs.at(i)->evaluatedType != funcResult->ParamTypes.at(i))
+		if (n->funcArgs[i]->evaluatedType != funcResult->ParamTypes.at(i))
 		{
-			std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): ";
-			std::cout << "Function call argument type mismatch in function " << n->name << "\n";
-			std::cout << "Expected type " << TypeNameString(funcResult->ParamTypes.at(i)); 
-			std::cout << " but got type " << TypeNameString(n->funcArgs.at(i)->evaluatedType) << "\n";
-			exit(1);			
+			diag() << "Error (" << this->at(n) << "): ";
+			diag() << "Function call argument type mismatch in function " << n->name << "\n";
+			diag() << "Expected type " << TypeNameString(funcResult->ParamTypes.at(i)); 
+			diag() << " but got type " << TypeNameString(n->funcArgs[i]->evaluatedType) << "\n";
+			fatal_error();			
 		}
 	}
 
@@ -277,89 +317,88 @@ void EvaluateVisitor::visit(FuncCallNode* n)
 	// this function call expression will evaluate to the return
 	// type of this function
 	n->evaluatedType = funcResult->ReturnType;
+	n->funcId = funcResult->id;
 	n->isConstant = false;
 }
 
-void EvaluateVisitor::visit(ConstantIntNode* n) 
+void EvaluateVisitor::leave(ConstantIntNode* n) 
 {
 	// Constant int node is always of type int
 	n->evaluatedType = TypeName::tInt;
 	n->isConstant = true;
 }
 
-void EvaluateVisitor::visit(ConstantCharNode* n)
+void EvaluateVisitor::leave(ConstantCharNode* n)
 {
 	// constant char is always type char
 	n->evaluatedType = TypeName::tChar;
 	n->isConstant = true;
 }
 
-void EvaluateVisitor::visit(ConstantDoubleNode* n)
+void EvaluateVisitor::leave(ConstantDoubleNode* n)
 {
 	// constant double is always type double
 	n->evaluatedType = TypeName::tDouble;
 	n->isConstant = true;
 }
 
-void EvaluateVisitor::visit(AssignmentNode* n) 
+void EvaluateVisitor::leave(AssignmentNode* n) 
 {
 	// do we want to do anything here?
 	// make sure lhs and rhs are same type
 
-	n->expr->accept(this);
-
 	// grab this symbol from the symbol table
 	SymbolTableEntry* symbolTableEntry;
 	symbolTableEntry = this->symbolTable->GetSymbol(n->name);
 	// make sure this symbol had been declared already
 	if (symbolTableEntry == nullptr)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Undeclared variable: " << n->name <<"\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Undeclared variable: " << n->name <<"\n";
+		fatal_error();
 	}
+	n->slot = symbolTableEntry->slot;
 	// if it is, this expression evaluates to the type of this symbol
 	if (symbolTableEntry->Type != n->expr->evaluatedType)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Type mismatch in assignment operation\n";
-		std::cout << "Trying to assign type " << TypeNameString(n->expr->evaluatedType);
-		std::cout << " to variable of type " << TypeNameString(symbolTableEntry->Type) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Type mismatch in assignment operation\n";
+		diag() << "Trying to assign type " << TypeNameString(n->expr->evaluatedType);
+		diag() << " to variable of type " << TypeNameString(symbolTableEntry->Type) << "\n";
+		fatal_error();
 	}
 }
 
-void EvaluateVisitor::visit(AugmentedAssignmentNode* n) 
+void EvaluateVisitor::leave(AugmentedAssignmentNode* n) 
 {
 	// do we need to do anything here?
 
-	n->expr->accept(this);
-
 	// grab this symbol from the symbol table
 	SymbolTableEntry* symbolTableEntry;
 	symbolTableEntry = this->symbolTable->GetSymbol(n->name);
 	// make sure this symbol had been declared already
 	if (symbolTableEntry == nullptr)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Undeclared variable: " << n->name <<"\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Undeclared variable: " << n->name <<"\n";
+		fatal_error();
 	}
+	n->slot = symbolTableEntry->slot;
 	// if it is, this expression evaluates to the type of this symbol
 	if (symbolTableEntry->Type != n->expr->evaluatedType)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Type mismatch in augmented assignment operation\n";
-		std::cout << "Trying to assign type " << TypeNameString(n->expr->evaluatedType);
-		std::cout << " to variable of type " << TypeNameString(symbolTableEntry->Type) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Type mismatch in augmented assignment operation\n";
+		diag() << "Trying to assign type " << TypeNameString(n->expr->evaluatedType);
+		diag() << " to variable of type " << TypeNameString(symbolTableEntry->Type) << "\n";
+		fatal_error();
 	}
 }
 
-void EvaluateVisitor::visit(ConstantBoolNode* n) 
+void EvaluateVisitor::leave(ConstantBoolNode* n) 
 {
 	// Constant bool node is always of type bool
 	n->evaluatedType = TypeName::tBool;
 	n->isConstant = true;
 }
 
-void EvaluateVisitor::visit(ReturnNode* n) 
+bool EvaluateVisitor::enter(ReturnNode* n) 
 {
 	// Get our current function context
 	FunctionTableEntry* curfunc = this->functionTable->GetCurrentFunction();
@@ -367,167 +406,153 @@ void EvaluateVisitor::visit(ReturnNode* n)
 	// I guess we'll double check here in case something tricky has happened?
 	if (!curfunc)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Return outside of function definition\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Return outside of function definition\n";
+		fatal_error();
 	}
 	// If our return function has an expression, figure out it's type
-	if (n->expr)
-	{
-		n->expr->accept(this);
-	}
+	return true;
+}
+
+void EvaluateVisitor::leave(ReturnNode* n)
+{
+	FunctionTableEntry* curfunc = this->functionTable->GetCurrentFunction();
 	// If we have an expression, grab our return type from that, otherwise our return type is void
 	TypeName rtype = n->expr?n->expr->evaluatedType:TypeName::tVoid;
 	// Check for mismatch between return expression and expected type
 	if (rtype != curfunc->ReturnType)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Return type mistmatch in function " << curfunc->Name <<"\n";
-		std::cout << "Expected return type " << TypeNameString(curfunc->ReturnType) << " but got " << TypeNameString(rtype) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Return type mistmatch in function " << curfunc->Name <<"\n";
+		diag() << "Expected return type " << TypeNameString(curfunc->ReturnType) << " but got " << TypeNameString(rtype) << "\n";
+		fatal_error();
 	}
 }
 
-void EvaluateVisitor::visit(ConstantFloatNode* n) 
+void EvaluateVisitor::leave(ConstantFloatNode* n) 
 {
 	// constant float node is always of type float
 	n->evaluatedType = TypeName::tFloat;
 	n->isConstant = true;
 }
 
-void EvaluateVisitor::visit(IfNode* n) 
+bool EvaluateVisitor::after_child(IfNode* n, uint32_t slot) 
 {
 	// Evaluate if condition to make sure it evaluates to bool
-	n->ifExpr->accept(this);
-	if (n->ifExpr->evaluatedType != TypeName::tBool)
+	if (slot == 0 && n->ifExpr->evaluatedType != TypeName::tBool)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Condition of if statement must be a boolean\n";
-		std::cout << "but it evaluated to " << TypeNameString(n->ifExpr->evaluatedType) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Condition of if statement must be a boolean\n";
+		diag() << "but it evaluated to " << TypeNameString(n->ifExpr->evaluatedType) << "\n";
+		fatal_error();
 	}
 	// Evaluate the body of the if loop, this will create a new scope as well
-	n->ifBody->accept(this);
-	// Exit scope once we're done evaluating the function body
+	return true;
 }
 
-void EvaluateVisitor::visit(ForNode* n) 
+bool EvaluateVisitor::enter(ForNode* n) 
 {
 	// What else do we need to consider in this for loop?
 	// we start a new scope here so we can't redefine loop vars we use
 	this->symbolTable->PushScope();
-	// If we have an init statement, check it ou
-	if (n->initStmt)
-	{
-		n->initStmt->accept(this);
-	}
-	// If we have a predicate, evaluate predicate to make sure it evaluates to bool
-	if (n->loopCondExpr)
-	{
-		n->loopCondExpr->accept(this);
-		if (n->loopCondExpr->evaluatedType != TypeName::tBool)
-		{
-			std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Condition of for statement must be a boolean\n";
-			std::cout << "but it evaluated to " << TypeNameString(n->loopCondExpr->evaluatedType) << "\n";
-			exit(1);
-		}
-	}
-	// If we have a conditional, check it out
-	if (n->updateStmt)
+	return true;
+}
+
+bool EvaluateVisitor::after_child(ForNode* n, uint32_t slot)
+{
+	// If we have a predicate, make sure it evaluates to bool
+	if (slot == 1 && n->loopCondExpr->evaluatedType != TypeName::tBool)
 	{
-		n->updateStmt->accept(this);
+		diag() << "Error (" << this->at(n) << "): Condition of for statement must be a boolean\n";
+		diag() << "but it evaluated to " << TypeNameString(n->loopCondExpr->evaluatedType) << "\n";
+		fatal_error();
 	}
 	// check rest of for loop
-	n->loopBody->accept(this);
+	return true;
+}
+
+void EvaluateVisitor::leave(ForNode* n)
+{
 	this->symbolTable->PopScope();
 }
 
-void EvaluateVisitor::visit(WhileNode* n) 
+bool EvaluateVisitor::after_child(WhileNode* n, uint32_t slot) 
 {
 	// What else do we need to handle in this while block
 
 	// Evaluate predicate of while loop to make sure it evaluates to bool
-	n->whileExpr->accept(this);
-	if (n->whileExpr->evaluatedType != TypeName::tBool)
+	if (slot == 0 && n->whileExpr->evaluatedType != TypeName::tBool)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Condition of while statement must be a boolean\n";
-		std::cout << "but it evaluated to " << TypeNameString(n->whileExpr->evaluatedType) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Condition of while statement must be a boolean\n";
+		diag() << "but it evaluated to " << TypeNameString(n->whileExpr->evaluatedType) << "\n";
+		fatal_error();
 	}
 	// Evaluate body of while loop
-	n->loopBody->accept(this);
+	return true;
 }
 
-void EvaluateVisitor::visit(UnaryNode* n) 
+void EvaluateVisitor::leave(UnaryNode* n) 
 {
 	// Type of a Unary node is determined by the type of its
 	// subexpression, ie -int vs. -float
-	n->expr->accept(this);
 	n->evaluatedType = n->expr->evaluatedType;
+	// bitwise not only makes sense for integers
+	if (n->op == UnaryOps::Not && n->evaluatedType != TypeName::tInt)
+	{
+		diag() << "Error (" << this->at(n) << "): Bitwise not needs an int operand\n";
+		diag() << "but got type " << TypeNameString(n->evaluatedType) << "\n";
+		fatal_error();
+	}
 	// A unary node is constant if it's expression is constant
 	n->isConstant = n->expr->isConstant;
 }
 
-void EvaluateVisitor::visit(TernaryNode* n) 
+bool EvaluateVisitor::after_child(TernaryNode* n, uint32_t slot) 
 {
 	// Make sure predicate of ternary expression evaluates to bool
-	n->condExpr->accept(this);
-	if (n->condExpr->evaluatedType != TypeName::tBool)
+	if (slot == 0 && n->condExpr->evaluatedType != TypeName::tBool)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Condition of ternary expression must be boolean.\n";
-		std::cout << "but it evaluated to " << TypeNameString(n->condExpr->evaluatedType) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Condition of ternary expression must be boolean.\n";
+		diag() << "but it evaluated to " << TypeNameString(n->condExpr->evaluatedType) << "\n";
+		fatal_error();
 	}
-	// evaluate branches of a ternary expression
-	n->trueExpr->accept(this);
-	n->falseExpr->accept(this);
+	// then evaluate branches of a ternary expression
+	return true;
+}
+
+void EvaluateVisitor::leave(TernaryNode* n)
+{
 	// check that they are the same type
 	if (n->trueExpr->evaluatedType != n->falseExpr->evaluatedType)
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Type mismatch in ternary operands\n";
-		std::cout << "Got types " << TypeNameString(n->trueExpr->evaluatedType);
-		std::cout << " and " << TypeNameString(n->falseExpr->evaluatedType) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Type mismatch in ternary operands\n";
+		diag() << "Got types " << TypeNameString(n->trueExpr->evaluatedType);
+		diag() << " and " << TypeNameString(n->falseExpr->evaluatedType) << "\n";
+		fatal_error();
 	}
 	// If we're here, our type matches our children
 	n->evaluatedType = n->trueExpr->evaluatedType;
-	// if both operands are constant, it's good
-	n->isConstant = (n->trueExpr->isConstant && n->falseExpr->isConstant);
+	// only constant if we know which operand it'll be, too
+	n->isConstant = (n->condExpr->isConstant && n->trueExpr->isConstant && n->falseExpr->isConstant);
 
 }
 
-void EvaluateVisitor::visit(CastExpressionNode* n) 
+bool EvaluateVisitor::enter(CastExpressionNode* n) 
 {
 	// TODO: should be able to cast between a bunch of different types!
 	// You can cast between int, float, bool, char, short, long, etc.
 	if (!(n->t == TypeName::tInt || n->t == TypeName::tFloat))
 	{
-		std::cout << "Error (" << n->location.begin.line << ", " << n->location.begin.column << "): Can only cast between float and integer\n";
-		std::cout << "But tried to cast to type " << TypeNameString(n->t) << "\n";
-		exit(1);
+		diag() << "Error (" << this->at(n) << "): Can only cast between float and integer\n";
+		diag() << "But tried to cast to type " << TypeNameString(n->t) << "\n";
+		fatal_error();
 	}
 	// a cast expression evaluate to the type we are casting to
 	n->evaluatedType = n->t;
-	// we're only constant if the expression we are casting is constant
-	n->expr->accept(this);
-	n->isConstant = n->expr->isConstant;
+	return true;
 }
 
-void EvaluateVisitor::visit(ExpressionStatementNode* n)
+void EvaluateVisitor::leave(CastExpressionNode* n)
 {
-	// This is an expression that is wrapped in a statement
-	// we evaluate the expression in case there are any side
-	// effects, but this node won't evaluate to anything
-	n->expr->accept(this);
-}
-
-void EvaluateVisitor::visit(BreakNode* n) 
-{
-	// hmmm? Here we would probably have a link to whatever
-	// statement we are in. 
-}
-
-void EvaluateVisitor::visit(ContinueNode* n) 
-{
-	// hmmm? Here we would probably link to whatever statement
-	// we are in.
+	// we're only constant if the expression we are casting is constant
+	n->isConstant = n->expr->isConstant;
 }
 
 bool checkTypeCompatability(TypeName t1, TypeName t2)
@@ -7,6 +7,7 @@
 #include <iostream>
 #include <string>
 #include <functional>
+#include <vector>
 
 // Tyler Weston
 
@@ -20,7 +21,8 @@ TODO: Variables marked const can now be included in this optimization pass
 - while-statements with constant false predicate (eliminate the loop)
 
 Whenever this visitor touches the tree it marks the tree as dirty and the optimizer will check the
-tree again until it passes over the tree without optimizing anything.
+tree again until it passes over the tree without optimizing anything. It's a TreeWalker, so a node
+is only left once its children are, and by then they've simplified themselves as far as they go.
 
 There is LOTS of shared code here between these different functions,
 but it is all different enough that it will take some clever abstraction
@@ -31,13 +33,13 @@ to make it work.
 
 
 // make node template from parser.y, for creating new nodes
-template <typename T, typename... Args> static std::unique_ptr<T> make_node(YYLTYPE const& loc, Args&&... args) {
-	std::unique_ptr<T> n = std::make_unique<T>(std::forward<Args>(args)...);
+template <typename T, typename... Args> static T* make_node(AstArena& arena, uint32_t loc, Args&&... args) {
+	T* n = arena.make<T>(std::forward<Args>(args)...);
 	n->location = loc;
 	return n;
 }
 
-OptimizeVisitor::OptimizeVisitor()
+OptimizeVisitor::OptimizeVisitor(AstArena& arena) : arena(arena)
 {
 	// init the optimize pass
 	this->hasReplacement = false;
@@ -45,75 +47,46 @@ OptimizeVisitor::OptimizeVisitor()
 	this->insertNodeVector = false;
 }
 
-
-void OptimizeVisitor::visit(VariableNode* n) 
+void OptimizeVisitor::take_replacement(Node* n, uint32_t slot)
 {
-	// // TODO: If a variable is marked const, we can replace it with the value
-	// if (n->isConstant)
-	// {
-	// 	// we can replace this node with a ConstantNode with its value since
-	// 	// it's marked constant
-	// 	this->repl_expr_node = make_node<ConstantIntNode>(n->location, result);
-	// 	this->cleanTree = false;
-	// 	this->hasReplacement = true;
-	// }
-
+	// a child that simplified itself leaves what to put in its place for us
+	if (this->hasReplacement)
+	{
+		set_node_child(n, slot, this->repl_expr_node);
+		this->cleanTree = false;
+		this->hasReplacement = false;
+	}
 }
 
-void OptimizeVisitor::visit(DeclarationNode* n) 
+bool OptimizeVisitor::after_child(Node* n, uint32_t slot)
 {
-	// nothing to optimize here
+	// most nodes have nothing to optimize themselves, they just take their
+	// children's replacements
+	this->take_replacement(n, slot);
+	return true;
 }
 
-void OptimizeVisitor::visit(DeclAndAssignNode* n) 
+bool OptimizeVisitor::enter(LogicalOpNode* n)
 {
-	// has an expr that we need to optimize
-	n->expr->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->expr = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
+	// unless one side is constant already there's nothing to fold in here
+	return n->left->isConstant || n->right->isConstant;
 }
 
-void OptimizeVisitor::visit(LogicalOpNode* n)
+void OptimizeVisitor::leave(LogicalOpNode* n)
 {
 	/*
 		TODO: This is basically the same code repeated three times
 		there is probably a way to abstract this out but I'm not enough
 		of a C++ whiz yet to know what it is.
 	*/
-	if (!(n->left->isConstant||n->right->isConstant))
-		return;
-	// has a left that we need to optimize
-	n->left->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->left = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
-	// has a right that we need to optimize
-	n->right->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->right = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
-
 	// now we may need to be optimized as well
 	if (n->left->isConstant && n->right->isConstant)
 	{
 		// logical operator with int operands
 		if (n->left->evaluatedType == TypeName::tInt)
 		{
-			int lvalue = dynamic_cast<ConstantIntNode*>(n->left.get())->intValue;
-			int rvalue = dynamic_cast<ConstantIntNode*>(n->right.get())->intValue;
+			int lvalue = cast<ConstantIntNode>(n->left)->intValue;
+			int rvalue = cast<ConstantIntNode>(n->right)->intValue;
 
 			//auto op = _add<int>;
 			std::function<bool(int,int)> op;
@@ -131,7 +104,7 @@ void OptimizeVisitor::visit(LogicalOpNode* n)
 			}
 
 			bool result = op(lvalue, rvalue);
-			this->repl_expr_node = make_node<ConstantBoolNode>(n->location, result);
+			this->repl_expr_node = make_node<ConstantBoolNode>(this->arena, n->location, result);
 			this->cleanTree = false;
 			this->hasReplacement = true;
 		}
@@ -139,8 +112,8 @@ void OptimizeVisitor::visit(LogicalOpNode* n)
 		// logical operator with float operands
 		if (n->right->evaluatedType == TypeName::tFloat)
 		{
-			float lvalue = dynamic_cast<ConstantFloatNode*>(n->left.get())->floatValue;
-			float rvalue = dynamic_cast<ConstantFloatNode*>(n->right.get())->floatValue;
+			float lvalue = cast<ConstantFloatNode>(n->left)->floatValue;
+			float rvalue = cast<ConstantFloatNode>(n->right)->floatValue;
 
 			std::function<bool(float,float)> op;
 			switch (n->op)
@@ -156,7 +129,7 @@ void OptimizeVisitor::visit(LogicalOpNode* n)
 					break;
 			}
 			bool result = op(lvalue, rvalue);
-			this->repl_expr_node = make_node<ConstantBoolNode>(n->location, result);
+			this->repl_expr_node = make_node<ConstantBoolNode>(this->arena, n->location, result);
 			this->cleanTree = false;
 			this->hasReplacement = true;
 		}
@@ -164,8 +137,8 @@ void OptimizeVisitor::visit(LogicalOpNode* n)
 		// logical operator with bool operands
 		if (n->right->evaluatedType == TypeName::tBool)
 		{
-			float lvalue = dynamic_cast<ConstantBoolNode*>(n->left.get())->floatValue;
-			float rvalue = dynamic_cast<ConstantBoolNode*>(n->right.get())->floatValue;
+			bool lvalue = cast<ConstantBoolNode>(n->left)->boolValue;
+			bool rvalue = cast<ConstantBoolNode>(n->right)->boolValue;
 
 			std::function<bool(bool,bool)> op;
 			switch (n->op)
@@ -181,47 +154,33 @@ void OptimizeVisitor::visit(LogicalOpNode* n)
 					break;
 			}
 			bool result = op(lvalue, rvalue);
-			this->repl_expr_node = make_node<ConstantBoolNode>(n->location, result);
+			this->repl_expr_node = make_node<ConstantBoolNode>(this->arena, n->location, result);
 			this->cleanTree = false;
 			this->hasReplacement = true;
 		}
 	}
 }
 
-void OptimizeVisitor::visit(BinaryOpNode* n) 
+bool OptimizeVisitor::enter(BinaryOpNode* n)
+{
+	// same as a logical op, only worth looking inside with a constant operand
+	return n->left->isConstant || n->right->isConstant;
+}
+
+void OptimizeVisitor::leave(BinaryOpNode* n) 
 {
 	/*
 	TODO: This is basically the same code repeated three times
 	there is probably a way to abstract this out but I'm not enough
 	of a C++ whiz yet to know what it is.
 	*/
-	if (!(n->left->isConstant||n->right->isConstant))
-		return;
-	// has a left that we need to optimize
-	n->left->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->left = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
-	// has a right that we need to optimize
-	n->right->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->right = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
 	// now we may need to be optimized as well
 	if (n->left->isConstant && n->right->isConstant)
 	{
 		if (n->left->evaluatedType == TypeName::tInt)
 		{
-			int lvalue = dynamic_cast<ConstantIntNode*>(n->left.get())->intValue;
-			int rvalue = dynamic_cast<ConstantIntNode*>(n->right.get())->intValue;
+			int lvalue = cast<ConstantIntNode>(n->left)->intValue;
+			int rvalue = cast<ConstantIntNode>(n->right)->intValue;
 
 			std::function<int(int,int)> op;
 			switch (n->op)
@@ -262,14 +221,14 @@ void OptimizeVisitor::visit(BinaryOpNode* n)
 			}
 
 			int result = op(lvalue, rvalue);
-			this->repl_expr_node = make_node<ConstantIntNode>(n->location, result);
+			this->repl_expr_node = make_node<ConstantIntNode>(this->arena, n->location, result);
 			this->cleanTree = false;
 			this->hasReplacement = true;
 		}
 		if (n->right->evaluatedType == TypeName::tFloat)
 		{
-			float lvalue = dynamic_cast<ConstantFloatNode*>(n->left.get())->floatValue;
-			float rvalue = dynamic_cast<ConstantFloatNode*>(n->right.get())->floatValue;
+			float lvalue = cast<ConstantFloatNode>(n->left)->floatValue;
+			float rvalue = cast<ConstantFloatNode>(n->right)->floatValue;
 
 			std::function<float(float,float)> op;
 			switch (n->op)
@@ -291,14 +250,14 @@ void OptimizeVisitor::visit(BinaryOpNode* n)
 					break;
 			}
 			float result = op(lvalue, rvalue);
-			this->repl_expr_node = make_node<ConstantFloatNode>(n->location, result);
+			this->repl_expr_node = make_node<ConstantFloatNode>(this->arena, n->location, result);
 			this->cleanTree = false;
 			this->hasReplacement = true;
 		}
 		if (n->right->evaluatedType == TypeName::tDouble)
 		{
-			double lvalue = dynamic_cast<ConstantDoubleNode*>(n->left.get())->doubleValue;
-			double rvalue = dynamic_cast<ConstantDoubleNode*>(n->right.get())->doubleValue;
+			double lvalue = cast<ConstantDoubleNode>(n->left)->doubleValue;
+			double rvalue = cast<ConstantDoubleNode>(n->right)->doubleValue;
 
 			std::function<double(double,double)> op;
 			switch (n->op)
@@ -320,7 +279,7 @@ void OptimizeVisitor::visit(BinaryOpNode* n)
 					break;
 			}
 			double result = op(lvalue, rvalue);
-			this->repl_expr_node = make_node<ConstantDoubleNode>(n->location, result);
+			this->repl_expr_node = make_node<ConstantDoubleNode>(this->arena, n->location, result);
 			this->cleanTree = false;
 			this->hasReplacement = true;
 		}
@@ -328,28 +287,10 @@ void OptimizeVisitor::visit(BinaryOpNode* n)
 	}
 }
 
-void OptimizeVisitor::visit(RelationalOpNode* n) 
+void OptimizeVisitor::leave(RelationalOpNode* n) 
 {
 	// if the ops are strictly constant, replace ths node with either
 	// bool true or false
-
-	n->left->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->left = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
-	// has a right that we need to optimize
-	n->right->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->right = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
 	if (!(n->left->isConstant&&n->right->isConstant))
 		return;
 	// TODO: Gotta figure out a better way to do this!
@@ -358,8 +299,8 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 	// int relationals
 	if (n->left->evaluatedType == TypeName::tInt)
 	{
-		int lvalue = dynamic_cast<ConstantIntNode*>(n->left.get())->intValue;
-		int rvalue = dynamic_cast<ConstantIntNode*>(n->right.get())->intValue;
+		int lvalue = cast<ConstantIntNode>(n->left)->intValue;
+		int rvalue = cast<ConstantIntNode>(n->right)->intValue;
 
 		std::function<bool(int,int)> op;
 		switch (n->op)
@@ -388,15 +329,15 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 		}
 
 		bool result = op(lvalue, rvalue);
-		this->repl_expr_node = make_node<ConstantBoolNode>(n->location, result);
+		this->repl_expr_node = make_node<ConstantBoolNode>(this->arena, n->location, result);
 		this->cleanTree = false;
 		this->hasReplacement = true;
 	}
 	// relational float stuff	
 	if (n->left->evaluatedType == TypeName::tFloat)
 	{
-		float lvalue = dynamic_cast<ConstantFloatNode*>(n->left.get())->floatValue;
-		float rvalue = dynamic_cast<ConstantFloatNode*>(n->right.get())->floatValue;
+		float lvalue = cast<ConstantFloatNode>(n->left)->floatValue;
+		float rvalue = cast<ConstantFloatNode>(n->right)->floatValue;
 
 		std::function<bool(float,float)> op;
 		switch (n->op)
@@ -424,7 +365,7 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 				break;
 		}
 		bool result = op(lvalue, rvalue);
-		this->repl_expr_node = make_node<ConstantBoolNode>(n->location, result);
+		this->repl_expr_node = make_node<ConstantBoolNode>(this->arena, n->location, result);
 		this->cleanTree = false;
 		this->hasReplacement = true;
 	}
@@ -432,8 +373,8 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 	// relational double stuff	
 	if (n->left->evaluatedType == TypeName::tDouble)
 	{
-		double lvalue = dynamic_cast<ConstantDoubleNode*>(n->left.get())->doubleValue;
-		double rvalue = dynamic_cast<ConstantDoubleNode*>(n->right.get())->doubleValue;
+		double lvalue = cast<ConstantDoubleNode>(n->left)->doubleValue;
+		double rvalue = cast<ConstantDoubleNode>(n->right)->doubleValue;
 
 		std::function<bool(double,double)> op;
 		switch (n->op)
@@ -461,7 +402,7 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 				break;
 		}
 		bool result = op(lvalue, rvalue);
-		this->repl_expr_node = make_node<ConstantBoolNode>(n->location, result);
+		this->repl_expr_node = make_node<ConstantBoolNode>(this->arena, n->location, result);
 		this->cleanTree = false;
 		this->hasReplacement = true;
 	}
@@ -469,8 +410,8 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 	// relational char stuff	
 	if (n->left->evaluatedType == TypeName::tChar)
 	{
-		char lvalue = dynamic_cast<ConstantCharNode*>(n->left.get())->charValue;
-		char rvalue = dynamic_cast<ConstantCharNode*>(n->right.get())->charValue;
+		char lvalue = cast<ConstantCharNode>(n->left)->charValue;
+		char rvalue = cast<ConstantCharNode>(n->right)->charValue;
 
 		std::function<bool(char,char)> op;
 		switch (n->op)
@@ -498,7 +439,7 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 				break;
 		}
 		bool result = op(lvalue, rvalue);
-		this->repl_expr_node = make_node<ConstantBoolNode>(n->location, result);
+		this->repl_expr_node = make_node<ConstantBoolNode>(this->arena, n->location, result);
 		this->cleanTree = false;
 		this->hasReplacement = true;
 	}
@@ -508,8 +449,8 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 	// Support optimizing == and != for bool type	
 	if (n->right->evaluatedType == TypeName::tBool && (n->op == RelationalOps::Eq || n->op == RelationalOps::Ne))
 	{
-		float lvalue = dynamic_cast<ConstantBoolNode*>(n->left.get())->boolValue;
-		float rvalue = dynamic_cast<ConstantBoolNode*>(n->right.get())->boolValue;
+		float lvalue = cast<ConstantBoolNode>(n->left)->boolValue;
+		float rvalue = cast<ConstantBoolNode>(n->right)->boolValue;
 
 		std::function<bool(bool,bool)> op;
 		switch (n->op)
@@ -525,197 +466,85 @@ void OptimizeVisitor::visit(RelationalOpNode* n)
 				break;
 		}
 		bool result = op(lvalue, rvalue);
-		this->repl_expr_node = make_node<ConstantBoolNode>(n->location, result);
+		this->repl_expr_node = make_node<ConstantBoolNode>(this->arena, n->location, result);
 		this->cleanTree = false;
 		this->hasReplacement = true;
 	}
 }
 
-void OptimizeVisitor::visit(RootNode* n) 
+bool OptimizeVisitor::enter(BlockNode* n) 
 {
-	// nothing in RootNode to optimzie, so just visit our functions
-	for (auto& func : n->funcs)
-	{
-		func->accept(this);
-	}	
+	// this is the body of functions so this is where if/while loops, etc. will appear.
+	// Statements that go away and if bodies that get pulled up into this block
+	// are all dealt with as we go, building up the new list of statements, so
+	// a block full of them still only takes the one pass. The new list goes on
+	// top of blockScratch, above the block we're inside of, and any block
+	// inside of us takes its own off the top again before we carry on
+	this->blockBases.push_back(this->blockScratch.size());
+	return true;
 }
 
-void OptimizeVisitor::visit(BlockNode* n) 
+bool OptimizeVisitor::after_child(BlockNode* n, uint32_t slot)
 {
-	// this is the body of functions so this is where if/while loops, etc. will appear
-	//bool markedForRemove[n->stmts.size()] = {0};
-	std::vector<bool> markedForRemove(n->stmts.size(), false);
-	unsigned insertion_index = 0;
-	for (unsigned i = 0; i < n->stmts.size(); i++)
-	{
-		n->stmts[i]->accept(this);
-		if (this->hasReplacement)
-		{
-			n->stmts[i] = std::move(this->replacement_node);
-			this->cleanTree = false;
-			this->hasReplacement = false;
-		}
-
-		if (this->removeNode)
-		{
-			markedForRemove[i] = true;
-			this->cleanTree = false;
-			this->removeNode = false;
-			break;	// only deal with one insertion/removal at a time
-		}
-
-		if (this->insertNodeVector)
-		{
-			// if we need to bounce down our if loop, we do it here
-			n->stmts.insert(n->stmts.begin() + insertion_index + 1, 
-				std::make_move_iterator(this->node_list.begin()), 
-				std::make_move_iterator(this->node_list.end()));	// can insert an entire vector?
-
-			// todo: hmmmm how to make this work
-
-
-			markedForRemove[i] = true;
-			this->cleanTree = false;
-			this->insertNodeVector = false;
-			break;
-		}
-		insertion_index++;
-	}
-	// remove any nodes marked for removal, we do this in a different
-	// loop so we don't mess up the order of our commands or anything 
-	// above!
-	unsigned i = 0;
-	for(auto stmtit = n->stmts.begin(); stmtit!=n->stmts.end();)
-	{
-		if (markedForRemove[i])
-		{
-			stmtit = n->stmts.erase(stmtit);
-		}
-		else
-		{
-			++stmtit;
-		}
-		++i;
-	}
-}
-
-void OptimizeVisitor::visit(FuncDefnNode* n) 
-{
-	// visit the body to optimize it
-	n->funcBody->accept(this);
-}
-
-void OptimizeVisitor::visit(FuncDeclNode* n) 
-{
-	// Nothing to optimize
-}
-
-void OptimizeVisitor::visit(FuncCallNode* n) 
-{
-	// func args may be optimized
-	for (unsigned i = 0; i < n->funcArgs.size(); i++)
-	{
-		n->funcArgs[i]->accept(this);
-		if (this->hasReplacement)
-		{
-			n->funcArgs[i] = std::move(this->repl_expr_node);
-			this->cleanTree = false;
-			this->hasReplacement = false;
-		}
-	}
-}
-
-void OptimizeVisitor::visit(ConstantIntNode* n) 
-{
-	// nothing to optimize
-}
-
-void OptimizeVisitor::visit(AssignmentNode* n) 
-{
-	// has an expr that we need to optimize
-	n->expr->accept(this);
+	Node* stmt = n->stmts[slot];
 	if (this->hasReplacement)
 	{
-		// have to dynamic cast this to expression node?
-		n->expr = std::move(this->repl_expr_node);
+		stmt = this->replacement_node;
 		this->cleanTree = false;
 		this->hasReplacement = false;
 	}
-}
 
-void OptimizeVisitor::visit(AugmentedAssignmentNode* n) 
-{
-	// has as expr that needs to be optimized
-	// has an expr that we need to optimize
-	n->expr->accept(this);
-	if (this->hasReplacement)
+	if (this->removeNode)
 	{
-		// have to dynamic cast this to expression node?
-		n->expr = std::move(this->repl_expr_node);
 		this->cleanTree = false;
-		this->hasReplacement = false;
+		this->removeNode = false;
 	}
-}
-
-void OptimizeVisitor::visit(ConstantBoolNode* n) 
-{
-	// nothing to optimize
-}
-
-void OptimizeVisitor::visit(ReturnNode* n) 
-{
-	// MAY have an expr (or nullptr) that needs to be optimized
-	if (n->expr)
+	else if (this->insertNodeVector)
 	{
-		// has an expr that we need to optimize
-		n->expr->accept(this);
-		if (this->hasReplacement)
-		{
-			// have to dynamic cast this to expression node?
-			n->expr = std::move(this->repl_expr_node);
-			this->cleanTree = false;
-			this->hasReplacement = false;
-		}
+		// the body of an if that is always true takes its place
+		this->blockScratch.insert(this->blockScratch.end(), this->node_list.begin(), this->node_list.end());
+		this->node_list.clear();
+		this->cleanTree = false;
+		this->insertNodeVector = false;
 	}
+	else
+	{
+		this->blockScratch.push_back(stmt);
+	}
+	return true;
 }
 
-void OptimizeVisitor::visit(ConstantFloatNode* n) 
-{
-	// nothing to optimize
-}
-
-void OptimizeVisitor::visit(ConstantCharNode* n)
+void OptimizeVisitor::leave(BlockNode* n)
 {
-	// nothing to do
+	// back into the block's own storage in the arena, which only has to
+	// grow if an if body made the block longer
+	size_t base = this->blockBases.back();
+	this->blockBases.pop_back();
+	n->stmts.assign(this->blockScratch.begin() + base, this->blockScratch.end());
+	this->blockScratch.resize(base);
 }
 
-void OptimizeVisitor::visit(ConstantDoubleNode* n)
+bool OptimizeVisitor::enter(FuncDeclNode* n) 
 {
-	// nothing to do
+	// Nothing to optimize in a prototype or its params
+	return false;
 }
 
-void OptimizeVisitor::visit(IfNode* n) 
+bool OptimizeVisitor::after_child(IfNode* n, uint32_t slot) 
 {
 	// if the predicate is always false, remove the entire if loop
 	// if the predicate is always true, pop the entire body out into the outer loop
 	// TODO: Don't worry about variable shadowing
-	n->ifExpr->accept(this);
-	if (this->hasReplacement)
+	this->take_replacement(n, slot);
+	if (slot != 0)
 	{
-		// have to dynamic cast this to expression node?
-		n->ifExpr = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
+		return true;
 	}
 	// if we have a constant node, simplify that
 	if (n->ifExpr->isConstant && n->ifExpr->evaluatedType == TypeName::tBool)
 	{
 		// grab the bool value from the simplified node 
-		bool nvalue = dynamic_cast<ConstantBoolNode*>(n->ifExpr.get())->boolValue;
-		// // replace this node with the appropriate operand
-		// this->repl_expr_node = std::move(nvalue ? n->trueExpr : n->falseExpr);
-		// this->cleanTree = false;
-		// this->hasReplacement = true;
+		bool nvalue = cast<ConstantBoolNode>(n->ifExpr)->boolValue;
 		if (!nvalue)
 		{
 			this->removeNode = true;		
@@ -725,159 +554,109 @@ void OptimizeVisitor::visit(IfNode* n)
 			// here, we have to add all of our
 			// blocks elements to 
 			this->insertNodeVector = true;
-			this->node_list = std::move(dynamic_cast<BlockNode*>(n->ifBody.get())->stmts);
+			this->node_list = cast<BlockNode>(n->ifBody)->stmts;
 		}
-	}	
+		return false;
+	}
+	// we're staying, so our body might have something to optimize
+	return true;
 }
 
-void OptimizeVisitor::visit(ForNode* n) 
+bool OptimizeVisitor::before_child(ForNode* n, uint32_t slot) 
 {
-	// may have a midExpr that needs to be optimized
-	if (n->loopCondExpr)
-	{
-		n->loopCondExpr->accept(this);
-		if (this->hasReplacement)
-		{
-			// have to dynamic cast this to expression node?
-			n->loopCondExpr = std::move(this->repl_expr_node);
-			this->cleanTree = false;
-			this->hasReplacement = false;
-		}
-	}
-	// then visit the body
-	n->loopBody->accept(this);
+	// only the condition and the body may have something to optimize
+	return slot == 1 || slot == 3;
 }
 
-void OptimizeVisitor::visit(WhileNode* n) 
+bool OptimizeVisitor::after_child(WhileNode* n, uint32_t slot) 
 {
 	// if the predicate is always false, remove this
-	n->whileExpr->accept(this);
-	if (this->hasReplacement)
+	this->take_replacement(n, slot);
+	if (slot != 0)
 	{
-		// have to dynamic cast this to expression node?
-		n->whileExpr = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
+		return true;
 	}
 	// if we have a constant node that is a bool, and the value of that
 	// bool is false, mark this node for removal!
 	// NOTE: this HAS to be a bool because of error checking we did earlier?
 	if (n->whileExpr->isConstant && n->whileExpr->evaluatedType == TypeName::tBool)
 	{
-		bool nvalue = dynamic_cast<ConstantBoolNode*>(n->whileExpr.get())->boolValue;
+		bool nvalue = cast<ConstantBoolNode>(n->whileExpr)->boolValue;
 		if (!nvalue)
 		{
+			// no point optimizing the body, and the flag has to get back to
+			// our block before anything in the body looks at it
 			this->removeNode = true;
+			return false;
 		}
 	}
 	// visit the body of the while loop
-	n->loopBody->accept(this);
+	return true;
 }
 
-void OptimizeVisitor::visit(UnaryNode* n) 
+void OptimizeVisitor::leave(UnaryNode* n) 
 {
 	// this will have one expression, if it is marked constant
-	// we can replace it with -expression
-	// IF we had more unary oprators, say ~ or !, we'd have
-	// to keep track of the operator and apply the proper 
-	// transformation below
-
-	// evaluate expr and replace it with simplified ver
-	n->expr->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->expr = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
+	// we can replace it with -expression or ~expression
 	// if we have a constant node, simplify that
 	if (n->expr->isConstant)
 	{
 		if (n->expr->evaluatedType == TypeName::tInt)
 		{
-			// we're an int node! So make a new negative int node
-			int value = dynamic_cast<ConstantIntNode*>(n->expr.get())->intValue;
-			this->repl_expr_node = make_node<ConstantIntNode>(n->location, -value);
+			// we're an int node! So make a new negated (or inverted) int node
+			int value = cast<ConstantIntNode>(n->expr)->intValue;
+			this->repl_expr_node = make_node<ConstantIntNode>(this->arena, n->location, n->op == UnaryOps::Not ? ~value : -value);
 			this->cleanTree = false;
 			this->hasReplacement = true;	
 		}
 		if (n->expr->evaluatedType == TypeName::tFloat)
 		{
 			// we're a float node, so dittio
-			float value = dynamic_cast<ConstantFloatNode*>(n->expr.get())->floatValue;
-			this->repl_expr_node = make_node<ConstantFloatNode>(n->location, -value);
+			float value = cast<ConstantFloatNode>(n->expr)->floatValue;
+			this->repl_expr_node = make_node<ConstantFloatNode>(this->arena, n->location, -value);
 			this->cleanTree = false;
 			this->hasReplacement = true;			
 		}
 	}
 }
 
-void OptimizeVisitor::visit(TernaryNode* n) 
+void OptimizeVisitor::leave(TernaryNode* n) 
 {
 	// if the condition is always true or false, replace it with the appropriate
-	// operand
-	// evaluate expr and replace it with simplified ver
-	n->condExpr->accept(this);
-	if (this->hasReplacement)
-	{
-		// have to dynamic cast this to expression node?
-		n->condExpr = std::move(this->repl_expr_node);
-		this->cleanTree = false;
-		this->hasReplacement = false;
-	}
-	// if we have a constant node, simplify that
+	// operand. Both operands were simplified too, whichever one we end up as has
+	// to be folded already if our parent is going to read its value
 	if (n->condExpr->isConstant && n->condExpr->evaluatedType == TypeName::tBool)
 	{
 		// grab the bool value from the simplified node 
-		bool nvalue = dynamic_cast<ConstantBoolNode*>(n->condExpr.get())->boolValue;
+		bool nvalue = cast<ConstantBoolNode>(n->condExpr)->boolValue;
 		// replace this node with the appropriate operand
-		this->repl_expr_node = std::move(nvalue ? n->trueExpr : n->falseExpr);
+		this->repl_expr_node = nvalue ? n->trueExpr : n->falseExpr;
 		this->cleanTree = false;
 		this->hasReplacement = true;
-	}	
+	}
 }
 
-void OptimizeVisitor::visit(CastExpressionNode* n) 
+void OptimizeVisitor::leave(CastExpressionNode* n) 
 {
-	// has an expr that we need to optimize
-	n->expr->accept(this);
-	if (this->hasReplacement)
+	// if we are trying to cast to the same type our operand already is, optimize out
+	if (n->t == n->expr->evaluatedType)
 	{
-		n->expr = std::move(this->repl_expr_node);
+		this->repl_expr_node = n->expr;
 		this->cleanTree = false;
-		this->hasReplacement = false;
+		this->hasReplacement = true;
 	}
-	// if we are trying to cast to the same type our operand already is, optimize out
-	if (n->t == n->expr->evaluatedType)
+	// a constant operand we can convert right now. We have to, since we count as
+	// constant too and whoever's folding us expects to find a constant node
+	else if (n->t == TypeName::tInt && isa<ConstantFloatNode>(n->expr))
 	{
-		this->repl_expr_node = std::move(n->expr);
+		this->repl_expr_node = make_node<ConstantIntNode>(this->arena, n->location, (int) cast<ConstantFloatNode>(n->expr)->floatValue);
 		this->cleanTree = false;
 		this->hasReplacement = true;
 	}
-}
-
-void OptimizeVisitor::visit(BreakNode* n) 
-{
-	// nothing to optimize here
-	// maybe some other node will have something
-	// for you to optimize!
-}
-
-void OptimizeVisitor::visit(ContinueNode* n) 
-{
-	// nothing to optimize here
-	// move along! nothing to see here!
-}	
-
-void OptimizeVisitor::visit(ExpressionStatementNode* n) 
-{
-	// has an expression that could be optimized
-	n->expr->accept(this);
-	if (this->hasReplacement)
+	else if (n->t == TypeName::tFloat && isa<ConstantIntNode>(n->expr))
 	{
-		n->expr = std::move(this->repl_expr_node);
+		this->repl_expr_node = make_node<ConstantFloatNode>(this->arena, n->location, (float) cast<ConstantIntNode>(n->expr)->intValue);
 		this->cleanTree = false;
-		this->hasReplacement = false;
+		this->hasReplacement = true;
 	}
 }
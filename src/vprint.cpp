@@ -5,440 +5,486 @@
 #include <iostream>
 #include <string>
 
-// todo: yuck, is there a better way to deal with indenting in this? maybe wrap std::cout in like an INDENT_PRINT macro??
+// todo: yuck, is there a better way to deal with indenting in this? maybe wrap diag() in like an INDENT_PRINT macro??
 
-void PrintVisitor::visit(VariableNode* n) 
+bool PrintVisitor::enter(VariableNode* n) 
 {
 	this->indent();
-	std::cout 	<< "Variable "
-				<< "(" << n->location.begin.line << ", " << n->location.begin.column << ") "
+	diag() 	<< "Variable "
+				<< "(" << this->at(n) << ") "
 				<< (n->isConstant ? " Constant " : "")
 				<< "{ " << n->name << " }\n";
+	return false;
 }
 
-void PrintVisitor::visit(DeclarationNode* n) 
+bool PrintVisitor::enter(DeclarationNode* n) 
 {
 	this->indent();
-	std::cout << "Declaration (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n"; 
+	diag() << "Declaration (" << this->at(n) << ") {\n"; 
 	this->indent_level++;
 	if (n->isConstant)
 	{
 		this->indent();
-		std::cout << "Constant\n";
+		diag() << "Constant\n";
 	}
 	this->indent();
-	std::cout << "Type: " << TypeNameString(n->t) << "\n"; 
+	diag() << "Type: " << TypeNameString(n->t) << "\n"; 
 	this->indent();
-	std::cout << "Name: "<< n->name << "\n";
+	diag() << "Name: "<< n->name << "\n";
 
 	this->indent_level--;
 	this->indent();
-	std::cout << "}\n";
+	diag() << "}\n";
+	return false;
 }
 
-void PrintVisitor::visit(DeclAndAssignNode* n) 
+bool PrintVisitor::enter(DeclAndAssignNode* n) 
 {
 	this->indent();
-	std::cout << "DeclAndAssign (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "DeclAndAssign (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	n->decl->accept(this);
-	this->indent();
-	std::cout << "=\n";
-	n->expr->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	return true;
 }
 
-void PrintVisitor::visit(BinaryOpNode* n) 
+bool PrintVisitor::before_child(DeclAndAssignNode* n, uint32_t slot)
 {
-	this->indent();
-	std::cout << "BinaryOp (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
-	this->indent_level++;
-	n->left->accept(this);
-	this->indent();
-	std::cout << BinaryOpString(n->op) << "\n";
-	n->right->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	// between the declaration and the expression
+	if (slot == 1)
+	{
+		this->indent();
+		diag() << "=\n";
+	}
+	return true;
 }
 
-void PrintVisitor::visit(LogicalOpNode* n) 
+void PrintVisitor::leave(DeclAndAssignNode* n)
+{
+	this->close();
+}
+
+bool PrintVisitor::enter(BinaryOpNode* n) 
 {
 	this->indent();
-	std::cout << "LogicalOp (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "BinaryOp (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	n->left->accept(this);
-	this->indent();
-	std::cout << BinaryOpString(n->op) << "\n";
-	n->right->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	return true;
+}
+
+bool PrintVisitor::before_child(BinaryOpNode* n, uint32_t slot)
+{
+	// the operator goes between the operands
+	if (slot == 1)
+	{
+		this->indent();
+		diag() << BinaryOpString(n->op) << "\n";
+	}
+	return true;
+}
+
+void PrintVisitor::leave(BinaryOpNode* n)
+{
+	this->close();
 }
 
-void PrintVisitor::visit(RelationalOpNode* n) 
+bool PrintVisitor::enter(LogicalOpNode* n) 
 {
 	this->indent();
-	std::cout << "RelationalOp (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "LogicalOp (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	n->left->accept(this);
-	this->indent();
-	std::cout << RelationalOpsString(n->op) << "\n";
-	n->right->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	return true;
 }
 
-void PrintVisitor::visit(RootNode* n) 
+bool PrintVisitor::before_child(LogicalOpNode* n, uint32_t slot)
 {
-	std::cout << "RootNode (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
-	this->indent_level++;
-	for (auto& func : n->funcs)
+	if (slot == 1)
 	{
-		func->accept(this);
+		this->indent();
+		diag() << BinaryOpString(n->op) << "\n";
 	}
-	this->indent_level--;
-	std::cout << "}\n";
+	return true;
+}
+
+void PrintVisitor::leave(LogicalOpNode* n)
+{
+	this->close();
 }
 
-void PrintVisitor::visit(BlockNode* n) 
+bool PrintVisitor::enter(RelationalOpNode* n) 
 {
 	this->indent();
-	std::cout << "Block (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "RelationalOp (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	for (auto& stmt : n->stmts)
+	return true;
+}
+
+bool PrintVisitor::before_child(RelationalOpNode* n, uint32_t slot)
+{
+	if (slot == 1)
 	{
-		stmt->accept(this);
+		this->indent();
+		diag() << RelationalOpsString(n->op) << "\n";
 	}
+	return true;
+}
+
+void PrintVisitor::leave(RelationalOpNode* n)
+{
+	this->close();
+}
+
+bool PrintVisitor::enter(RootNode* n) 
+{
+	this->lines = n->lines;
+	diag() << "RootNode (" << this->at(n) << ") {\n";
+	this->indent_level++;
+	return true;
+}
+
+void PrintVisitor::leave(RootNode* n)
+{
+	// the root isn't indented
 	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	diag() << "}\n";
 }
 
-void PrintVisitor::visit(FuncDefnNode* n) 
+bool PrintVisitor::enter(BlockNode* n) 
 {
 	this->indent();
-	std::cout << "FuncDefn (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "Block (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	n->funcDecl->accept(this);
-	n->funcBody->accept(this);
-	this->indent_level--;
+	return true;
+}
+
+void PrintVisitor::leave(BlockNode* n)
+{
+	this->close();
+}
+
+bool PrintVisitor::enter(FuncDefnNode* n) 
+{
 	this->indent();
-	std::cout << "}\n";
+	diag() << "FuncDefn (" << this->at(n) << ") {\n";
+	this->indent_level++;
+	return true;
 }
 
-void PrintVisitor::visit(FuncDeclNode* n) 
+void PrintVisitor::leave(FuncDefnNode* n)
+{
+	this->close();
+}
+
+bool PrintVisitor::enter(FuncDeclNode* n) 
 {
 	this->indent();
-	std::cout << "FuncDecl (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "FuncDecl (" << this->at(n) << ") {\n";
 	// start fund decl
 	this->indent_level++;
 	this->indent();
-	std::cout << "Type: " << TypeNameString(n->t) << "\n"; 
+	diag() << "Type: " << TypeNameString(n->t) << "\n"; 
 	this->indent();
-	std::cout << "Name: "<< n->name << "\n";
+	diag() << "Name: "<< n->name << "\n";
 	this->indent();
-	std::cout << "Params {\n";
+	diag() << "Params {\n";
 	// start params
 	this->indent_level++;
-	for (auto& param : n->params)
-	{
-		param->accept(this);
-	}
+	return true;
+}
+
+void PrintVisitor::leave(FuncDeclNode* n)
+{
 	// end params
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	this->close();
 	// end func decl
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	this->close();
 }
 
-void PrintVisitor::visit(FuncCallNode* n) 
+bool PrintVisitor::enter(FuncCallNode* n) 
 {
 	this->indent();
-	std::cout << "FuncCall (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n"; 
+	diag() << "FuncCall (" << this->at(n) << ") {\n"; 
 	this->indent_level++;
 	this->indent();
-	std:: cout << "Name: " << n->name << "\n";
+	diag() << "Name: " << n->name << "\n";
 	this->indent();
-	std:: cout << "Args {\n";
+	diag() << "Args {\n";
 	this->indent_level++;
-	for (auto& arg : n->funcArgs)
-	{
-		arg->accept(this);
-	}
+	return true;
+}
+
+void PrintVisitor::leave(FuncCallNode* n)
+{
 	// end args
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	this->close();
 	// end func call
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	this->close();
 }
 
-void PrintVisitor::visit(ConstantIntNode* n) 
+bool PrintVisitor::enter(ConstantIntNode* n) 
 {
 	this->indent();
-	std::cout << "Integer (" << n->location.begin.line << ", " << n->location.begin.column << ") { " << n->intValue << " }\n";
+	diag() << "Integer (" << this->at(n) << ") { " << n->intValue << " }\n";
+	return false;
 }
 
-void PrintVisitor::visit(ConstantCharNode* n) 
+bool PrintVisitor::enter(ConstantCharNode* n)
 {
 	this->indent();
-	std::cout << "Char (" << n->location.begin.line << ", " << n->location.begin.column << ") { ";
+	diag() << "Char (" << this->at(n) << ") { ";
 	switch(n->charValue)
 	{
 			case '\a':
-				std::cout << '\\' << 'a';
+				diag() << '\\' << 'a';
 				break;
 			case '\b':
-				std::cout << '\\' << 'b';
+				diag() << '\\' << 'b';
 				break;
 			case '\f':
-				std::cout << '\\' << 'f';
+				diag() << '\\' << 'f';
 				break;
 			case '\n':
-				std::cout << '\\' << 'n';
+				diag() << '\\' << 'n';
 				break;
 			case '\r':
-				std::cout << '\\' << 'r';
+				diag() << '\\' << 'r';
 				break;
 			case '\t':
-				std::cout << '\\' << 't';
+				diag() << '\\' << 't';
 				break;
 			case '\v':
-				std::cout << '\\' << 'v';
+				diag() << '\\' << 'v';
 				break;
 			case '\0':
-				std::cout << '\\' << '0';
+				diag() << '\\' << '0';
 				break;
 			default:
-				std::cout << n->charValue;
+				diag() << n->charValue;
 	} 
-	std::cout << " }\n";
+	diag() << " }\n";
+	return false;
 }
 
-void PrintVisitor::visit(ConstantDoubleNode* n) 
+bool PrintVisitor::enter(ConstantDoubleNode* n) 
 {
 	this->indent();
-	std::cout << "Double (" << n->location.begin.line << ", " << n->location.begin.column << ") { " << n->doubleValue << " }\n";
+	diag() << "Double (" << this->at(n) << ") { " << n->doubleValue << " }\n";
+	return false;
 }
 
-void PrintVisitor::visit(AssignmentNode* n) 
+bool PrintVisitor::enter(AssignmentNode* n) 
 {
 	this->indent();
-	std::cout << "Assignment (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "Assignment (" << this->at(n) << ") {\n";
 	this->indent_level++;
 	this->indent();
-	std::cout << "Name:	" << n->name << "\n";
+	diag() << "Name:	" << n->name << "\n";
 	this->indent();
-	std::cout << "=";
-	n->expr->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	diag() << "=";
+	return true;
+}
+
+void PrintVisitor::leave(AssignmentNode* n)
+{
+	this->close();
 }
 
-void PrintVisitor::visit(AugmentedAssignmentNode* n) 
+bool PrintVisitor::enter(AugmentedAssignmentNode* n) 
 {
 	this->indent();
-	std::cout << "AugmentedAssignment (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "AugmentedAssignment (" << this->at(n) << ") {\n";
 	this->indent_level++;
 	this->indent();
-	std::cout << "Name: " << n->name << "\n";
+	diag() << "Name: " << n->name << "\n";
 	this->indent();
-	std::cout << AugmentedAssignOpsString(n->op) << "\n";
-	n->expr->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	diag() << AugmentedAssignOpsString(n->op) << "\n";
+	return true;
+}
+
+void PrintVisitor::leave(AugmentedAssignmentNode* n)
+{
+	this->close();
 }
 
-void PrintVisitor::visit(ConstantBoolNode* n) 
+bool PrintVisitor::enter(ConstantBoolNode* n) 
 {
 	this->indent();
-	std::cout << "Bool (" << n->location.begin.line << ", " << n->location.begin.column << ") { " << (n->boolValue?"true":"false") << " }\n";
+	diag() << "Bool (" << this->at(n) << ") { " << (n->boolValue?"true":"false") << " }\n";
+	return false;
 }
 
-void PrintVisitor::visit(ReturnNode* n) 
+bool PrintVisitor::enter(ReturnNode* n) 
 {
 	this->indent();
-	std::cout << "Return (" << n->location.begin.line << ", " << n->location.begin.column << ") { ";
+	diag() << "Return (" << this->at(n) << ") { ";
 	if (n->expr)
 	{
-		std::cout << "\n";
+		diag() << "\n";
 		this->indent_level++;
-		n->expr->accept(this);
+	}
+	return true;
+}
+
+void PrintVisitor::leave(ReturnNode* n)
+{
+	if (n->expr)
+	{
 		this->indent_level--;
 		this->indent();
 	}
-	std::cout << "}\n";
+	diag() << "}\n";
 }
 
-void PrintVisitor::visit(ConstantFloatNode* n) 
+bool PrintVisitor::enter(ConstantFloatNode* n) 
 {
 	this->indent();
-	std::cout << "Float (" << n->location.begin.line << ", " << n->location.begin.column << ") { " << n->floatValue << " }\n";
+	diag() << "Float (" << this->at(n) << ") { " << n->floatValue << " }\n";
+	return false;
 }
 
-void PrintVisitor::visit(IfNode* n) 
+bool PrintVisitor::enter(IfNode* n) 
 {
 	this->indent();
-	std::cout << "If (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "If (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	n->ifExpr->accept(this);
-	n->ifBody->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	return true;
 }
 
-void PrintVisitor::visit(ForNode* n) 
+void PrintVisitor::leave(IfNode* n)
 {
-	this->indent();
-	std::cout << "For (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
-	this->indent_level++;
+	this->close();
+}
 
+bool PrintVisitor::enter(ForNode* n) 
+{
 	this->indent();
-	std::cout << "InitStmt {\n";
+	diag() << "For (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	if (n->initStmt)
-		n->initStmt->accept(this);
-	else
-	{
-		this->indent();
-		std::cout << "null\n";
-	}
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	return true;
+}
 
-	this->indent();
-	std::cout << "LoopConditionExpr {\n";
-	this->indent_level++;
-	if (n->loopCondExpr)
-		n->loopCondExpr->accept(this);
-	else
+bool PrintVisitor::before_child(ForNode* n, uint32_t slot)
+{
+	// each part gets a heading, and the ones that were left out say so
+	static const char* const parts[] = {"InitStmt", "LoopConditionExpr", "UpdateStmt", "LoopBody"};
+	if (slot > 0)
 	{
-		this->indent();
-		std::cout << "null\n";
+		this->close();
 	}
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
-
 	this->indent();
-	std::cout << "UpdateStmt {\n";
+	diag() << parts[slot] << " {\n";
 	this->indent_level++;
-	if (n->updateStmt)
-		n->updateStmt->accept(this);
-	else
+	if (node_child(n, slot) == nullptr)
 	{
 		this->indent();
-		std::cout << "null\n";
+		diag() << "null\n";
 	}
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
-
-	this->indent();
-	std::cout << "LoopBody {\n";
-	this->indent_level++;
-	n->loopBody->accept(this);
+	return true;
+}
 
+void PrintVisitor::leave(ForNode* n)
+{
 	// end loop body
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
-	
+	this->close();
 	// end for statement
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	this->close();
 }
 
-void PrintVisitor::visit(WhileNode* n) 
+bool PrintVisitor::enter(WhileNode* n) 
 {
 	this->indent();
-	std::cout << "While (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "While (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	n->whileExpr->accept(this);
-	n->loopBody->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	return true;
+}
+
+void PrintVisitor::leave(WhileNode* n)
+{
+	this->close();
 }
 
-void PrintVisitor::visit(UnaryNode* n) 
+bool PrintVisitor::enter(UnaryNode* n) 
 {
 	this->indent();
-	std::cout << "UnaryOp (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "UnaryOp (" << this->at(n) << ") {\n";
 	this->indent_level++;
 	this->indent();
-	std::cout << "-\n";
-	n->expr->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	diag() << "-\n";
+	return true;
+}
+
+void PrintVisitor::leave(UnaryNode* n)
+{
+	this->close();
 }
 
-void PrintVisitor::visit(TernaryNode* n) 
+bool PrintVisitor::enter(TernaryNode* n) 
 {
 	this->indent();
-	std::cout << "Ternary (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "Ternary (" << this->at(n) << ") {\n";
 	this->indent_level++;
-	n->condExpr->accept(this);
-	this->indent();
-	std::cout << "?\n";
-	n->trueExpr->accept(this);
-	this->indent();
-	std::cout << ":\n";
-	n->falseExpr->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	return true;
 }
 
-void PrintVisitor::visit(CastExpressionNode* n) 
+bool PrintVisitor::before_child(TernaryNode* n, uint32_t slot)
+{
+	if (slot > 0)
+	{
+		this->indent();
+		diag() << (slot == 1 ? "?\n" : ":\n");
+	}
+	return true;
+}
+
+void PrintVisitor::leave(TernaryNode* n)
+{
+	this->close();
+}
+
+bool PrintVisitor::enter(CastExpressionNode* n) 
 {
 	this->indent();
-	std::cout << "Cast (" << n->location.begin.line << ", " << n->location.begin.column << ") {\n";
+	diag() << "Cast (" << this->at(n) << ") {\n";
 	this->indent_level++;
 	this->indent();
-	std::cout << "Type: " << TypeNameString(n->t) << "\n";
-	n->expr->accept(this);
-	this->indent_level--;
-	this->indent();
-	std::cout << "}\n";
+	diag() << "Type: " << TypeNameString(n->t) << "\n";
+	return true;
 }
 
-void PrintVisitor::visit(ExpressionStatementNode* n)
+void PrintVisitor::leave(CastExpressionNode* n)
 {
-	// This is a wrapper node, so just pass to child
-	n->expr->accept(this);
+	this->close();
 }
 
+// ExpressionStatement is a wrapper node, it just gets its child printed
 
-void PrintVisitor::visit(BreakNode* n) 
+bool PrintVisitor::enter(BreakNode* n) 
 {
 	this->indent();
-	std::cout << "Break (" << n->location.begin.line << ", " << n->location.begin.column << ")\n";
+	diag() << "Break (" << this->at(n) << ")\n";
+	return false;
 }
 
-void PrintVisitor::visit(ContinueNode* n) 
+bool PrintVisitor::enter(ContinueNode* n) 
 {
 	this->indent();
-	std::cout << "Continue (" << n->location.begin.line << ", " << n->location.begin.column << ")\n";
+	diag() << "Continue (" << this->at(n) << ")\n";
+	return false;
 }	
 
 void PrintVisitor::indent()
 {
 	// indent two spaces per level
-	std::cout << std::string(this->indent_level * 2, ' ');
+	diag() << std::string(this->indent_level * 2, ' ');
+}
+
+void PrintVisitor::close()
+{
+	// the end of whatever the last level of indenting was for
+	this->indent_level--;
+	this->indent();
+	diag() << "}\n";
+}
+
+LineColumn PrintVisitor::at(Node* n) const
+{
+	return this->lines->find(n->location);
 }
@@ -0,0 +1,14 @@
+; ModuleID = 'ccc'
+source_filename = "ccc"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+define void @foo() {
+entry:
+  ret void
+}
+
+define i32 @main() {
+entry:
+  ret i32 0
+}
@@ -0,0 +1,32 @@
+; ModuleID = 'ccc'
+source_filename = "ccc"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+define i32 @foo() {
+entry:
+  br label %checkcond
+
+checkcond:                                        ; preds = %update, %entry
+  br label %forbody
+
+update:                                           ; No predecessors!
+  br label %checkcond
+
+forexit:                                          ; No predecessors!
+  ret void
+
+forbody:                                          ; preds = %checkcond
+  br i1 true, label %iftrue, label %ifcont
+
+iftrue:                                           ; preds = %forbody
+  ret i32 0
+
+ifcont:                                           ; preds = %forbody
+  ret i32 1
+}
+
+define i32 @main() {
+entry:
+  ret i32 0
+}
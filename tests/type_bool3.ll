@@ -0,0 +1,32 @@
+; ModuleID = 'ccc'
+source_filename = "ccc"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+define i32 @main() {
+entry:
+  %i = alloca i32, align 4
+  store i32 0, i32* %i, align 4
+  br label %checkcond
+
+checkcond:                                        ; preds = %update, %entry
+  %i2 = load i32, i32* %i, align 4
+  %0 = icmp slt i32 %i2, 10
+  %forcond = icmp ne i1 %0, false
+  br i1 %forcond, label %forbody, label %forexit
+
+update:                                           ; preds = %forbody
+  %i1 = load i32, i32* %i, align 4
+  %1 = add i32 %i1, 1
+  store i32 %1, i32* %i, align 4
+  br label %checkcond
+
+forexit:                                          ; preds = %checkcond
+  ret i32 0
+
+forbody:                                          ; preds = %checkcond
+  %i3 = load i32, i32* %i, align 4
+  %2 = add i32 %i3, 0
+  store i32 %2, i32* %i, align 4
+  br label %update
+}
@@ -0,0 +1,19 @@
+; ModuleID = 'ccc'
+source_filename = "ccc"
+target datalayout = "e-m:e-p270:32:32-p271:32:32-p272:64:64-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-pc-linux-gnu"
+
+define i32 @main() {
+entry:
+  br i1 false, label %trueval, label %falseval
+
+trueval:                                          ; preds = %entry
+  br label %mergeval
+
+falseval:                                         ; preds = %entry
+  br label %mergeval
+
+mergeval:                                         ; preds = %falseval, %trueval
+  %ternary = phi i32 [ 7, %trueval ], [ 8, %falseval ]
+  ret i32 %ternary
+}